@@ -0,0 +1,74 @@
+"""Compare two runs of the native benchmarks (PlatformIO env native_bench) or of slidr-bench.
+
+Reads the Google Benchmark JSON written by `program --json FILE` or `slidr-bench --json FILE`
+and prints the change of every case both runs have, using the median when the runs had
+--repetitions:
+
+    .pio/build/native_bench/program --revision $(git describe --always) --json new.json
+    slidr-bench --port /dev/ttyACM0 --revision $(git describe --always) --json new.json
+    python benchcompare.py old.json new.json --threshold 10
+
+Exits with 1 if a case got slower by more than the threshold, so it can gate a CI job.
+"""
+from pathlib import Path
+import argparse
+import json
+import sys
+
+
+def load(path: Path) -> tuple[dict, dict[str, float]]:
+    """Return (context, {case name: CPU time in ns})"""
+    data = json.loads(path.read_text())
+    times = {}
+    medians = {}
+    for entry in data["benchmarks"]:
+        scale = {"ns": 1, "us": 1e3, "ms": 1e6, "s": 1e9}[entry.get("time_unit", "ns")]
+        cpu_ns = entry["cpu_time"] * scale
+        name = entry["run_name"]
+        if entry.get("run_type") == "aggregate":
+            if entry.get("aggregate_name") == "median":
+                medians[name] = cpu_ns
+        else:
+            times.setdefault(name, []).append(cpu_ns)
+    result = {name: sorted(values)[len(values) // 2] for name, values in times.items()}
+    result.update(medians)
+    return data.get("context", {}), result
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Compare two SlidR native benchmark runs")
+    parser.add_argument("baseline", type=Path)
+    parser.add_argument("contender", type=Path)
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="Percent slowdown reported as a regression (default 5)")
+    args = parser.parse_args()
+
+    old_context, old = load(args.baseline)
+    new_context, new = load(args.contender)
+    old_revision = old_context.get("firmware_revision") or args.baseline.name
+    new_revision = new_context.get("firmware_revision") or args.contender.name
+
+    print(f"{'case':40} {old_revision[:14]:>14} {new_revision[:14]:>14} {'change':>9}")
+    regressions = []
+    for name in new:
+        if name not in old:
+            continue
+        change = (new[name] - old[name]) / old[name] * 100 if old[name] else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  slower"
+            regressions.append(name)
+        elif change < -args.threshold:
+            flag = "  faster"
+        print(f"{name:40} {old[name]:12.0f}ns {new[name]:12.0f}ns {change:+8.1f}%{flag}")
+
+    for name in sorted(set(old) ^ set(new)):
+        print(f"note: {name} is only in {'the baseline' if name in old else 'the contender'}",
+              file=sys.stderr)
+    if regressions:
+        print(f"{len(regressions)} case(s) slower by more than {args.threshold:g}%", file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,258 @@
+"""Serial traffic captures: record, download and inspect sessions for the replay harness.
+
+The format, timestamped records of raw bytes per direction, is described in src/Capture.h.
+
+    python capture.py proxy --port /dev/ttyACM0 --link /tmp/slidr -o session.slcap
+    python capture.py dump --port COM4 -o device.slcap      # firmware built with SLIDR_CAPTURE
+    python capture.py show session.slcap
+
+`proxy` records any host application (point it at --link instead of the device; Linux and
+macOS only). pro.py records its own traffic when SLIDR_CAPTURE_FILE names a file. Replay a
+capture against the native build, optionally faster than it was recorded:
+
+    .pio/build/native/program --replay session.slcap --speed 4 --report replay.json fs
+"""
+from pathlib import Path
+import argparse
+import os
+import select
+import struct
+import sys
+import threading
+import time
+
+from cpuprofile import encode_packet, read_packet
+from protodef import Command
+
+MAGIC = 0x50434C53  # "SLCP"
+VERSION = 1
+FILE_HEADER = struct.Struct("<IHBBI")  # magic, version, source, reserved, dropped records
+RECORD_HEADER = struct.Struct("<QBBH")  # timestamp_us, direction, reserved, size
+
+HOST_TO_DEVICE = 0
+DEVICE_TO_HOST = 1
+SOURCE_HOST = 0
+SOURCE_DEVICE = 1
+
+CAPTURE_DUMP = Command.CAPTURE_DUMP
+CAPTURE_DATA = Command.CAPTURE_DATA
+MAX_RECORD_SIZE = 0xFFFF
+
+
+class CaptureWriter:
+    """Appends records to a capture file. Thread safe.
+
+    Reads and writes in the same direction within `merge_us` of each other are merged into one
+    record, for tools that read a byte at a time."""
+
+    def __init__(self, path: Path, merge_us: int = 0) -> None:
+        self._file = open(path, "wb")
+        self._file.write(FILE_HEADER.pack(MAGIC, VERSION, SOURCE_HOST, 0, 0))
+        self._lock = threading.Lock()
+        self._start_ns = time.monotonic_ns()
+        self._merge_us = merge_us
+        self._pending: tuple[int, int, bytearray] | None = None  # timestamp_us, direction, data
+        self._pending_last_us = 0
+
+    def record(self, direction: int, data: bytes) -> None:
+        if not data:
+            return
+        now_us = (time.monotonic_ns() - self._start_ns) // 1000
+        with self._lock:
+            pending = self._pending
+            if (pending and pending[1] == direction and now_us - self._pending_last_us <= self._merge_us
+                    and len(pending[2]) + len(data) <= MAX_RECORD_SIZE):
+                pending[2].extend(data)
+            else:
+                self._flush()
+                self._pending = (now_us, direction, bytearray(data))
+            self._pending_last_us = now_us
+            if not self._merge_us:
+                self._flush()
+
+    def close(self) -> None:
+        with self._lock:
+            self._flush()
+            self._file.close()
+
+    def _flush(self) -> None:
+        if self._pending:
+            timestamp_us, direction, data = self._pending
+            for offset in range(0, len(data), MAX_RECORD_SIZE):
+                chunk = data[offset:offset + MAX_RECORD_SIZE]
+                self._file.write(RECORD_HEADER.pack(timestamp_us, direction, 0, len(chunk)) + chunk)
+            self._file.flush()
+            self._pending = None
+
+
+class RecordingPort:
+    """Wraps a pyserial port and records what goes through read() and write()"""
+
+    def __init__(self, port, writer: CaptureWriter) -> None:
+        self._port = port
+        self._writer = writer
+
+    def read(self, size: int = 1) -> bytes:
+        data = self._port.read(size)
+        self._writer.record(DEVICE_TO_HOST, data)
+        return data
+
+    def write(self, data: bytes) -> int | None:
+        self._writer.record(HOST_TO_DEVICE, bytes(data))
+        return self._port.write(data)
+
+    def close(self) -> None:
+        self._writer.close()
+        self._port.close()
+
+    def __getattr__(self, name: str):
+        return getattr(self._port, name)
+
+
+def read_capture(path: Path) -> tuple[int, int, list[tuple[int, int, bytes]]]:
+    """Return (source, dropped records, [(timestamp_us, direction, data)])"""
+    data = Path(path).read_bytes()
+    magic, version, source, _, dropped = FILE_HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError(f"{path} is not a capture file")
+    if version != VERSION:
+        raise ValueError(f"{path} has capture version {version}, expected {VERSION}")
+    records = []
+    offset = FILE_HEADER.size
+    while offset + RECORD_HEADER.size <= len(data):
+        timestamp_us, direction, _, size = RECORD_HEADER.unpack_from(data, offset)
+        offset += RECORD_HEADER.size
+        records.append((timestamp_us, direction, data[offset:offset + size]))
+        offset += size
+    return source, dropped, records
+
+
+def frames(records: list[tuple[int, int, bytes]], direction: int) -> list[tuple[int, int, bytes]]:
+    """Valid frames sent in `direction`: [(timestamp_us of the completing record, command, payload)]"""
+    result = []
+    buffer = bytearray()
+    for timestamp_us, record_direction, data in records:
+        if record_direction != direction:
+            continue
+        buffer.extend(data)
+        while True:
+            start = buffer.find(b"\xaa")
+            if start < 0:
+                buffer.clear()
+                break
+            del buffer[:start]
+            if len(buffer) < 4:
+                break
+            command, length = struct.unpack_from("<BH", buffer, 1)
+            if len(buffer) < length + 5:
+                break
+            checksum = 0
+            for byte in buffer[1:length + 4]:
+                checksum ^= byte
+            if checksum == buffer[length + 4]:
+                result.append((timestamp_us, command, bytes(buffer[4:length + 4])))
+                del buffer[:length + 5]
+            else:
+                del buffer[:1]
+    return result
+
+
+def dump(port) -> bytes:
+    """Download the capture buffer of a device built with SLIDR_CAPTURE, as a capture file"""
+    port.write(encode_packet(CAPTURE_DUMP))
+    data = bytearray()
+    while True:
+        packet = read_packet(port, timeout=2.0)
+        if packet is None:
+            raise TimeoutError("No CAPTURE_DATA received, is the firmware built with SLIDR_CAPTURE?")
+        command, payload = packet
+        if command != CAPTURE_DATA:
+            continue
+        data += payload[1:]
+        if payload[0] & 1:
+            return bytes(data)
+
+
+def proxy(port_path: str, link: Path, output: Path) -> None:
+    """Forward between a new pty at `link` and the device, recording both directions"""
+    import pty
+    import tty
+
+    device = os.open(port_path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(device)
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    if link.is_symlink():
+        link.unlink()
+    link.symlink_to(os.ttyname(slave))
+    print(f"recording {port_path} on {link}, Ctrl+C to stop", file=sys.stderr)
+
+    writer = CaptureWriter(output)
+    try:
+        while True:
+            readable, _, _ = select.select([master, device], [], [])
+            for fd in readable:
+                try:
+                    data = os.read(fd, 4096)
+                except OSError:
+                    data = b""  # The application closed the pty, wait for it to reopen
+                if not data:
+                    if fd == device:
+                        return
+                    time.sleep(0.05)
+                    continue
+                if fd == master:
+                    writer.record(HOST_TO_DEVICE, data)
+                    os.write(device, data)
+                else:
+                    writer.record(DEVICE_TO_HOST, data)
+                    os.write(master, data)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        writer.close()
+        link.unlink(missing_ok=True)
+
+
+def show(path: Path) -> None:
+    source, dropped, records = read_capture(path)
+    print(f"{path}: recorded on the {'device' if source == SOURCE_DEVICE else 'host'}, "
+          f"{len(records)} records, {dropped} dropped")
+    host = [(t, "H->D", c, p) for t, c, p in frames(records, HOST_TO_DEVICE)]
+    device = [(t, "D->H", c, p) for t, c, p in frames(records, DEVICE_TO_HOST)]
+    events = sorted(host + device, key=lambda event: event[0])
+    start = events[0][0] if events else 0
+    for timestamp_us, arrow, command, payload in events:
+        preview = payload[:16].hex(" ") + (" ..." if len(payload) > 16 else "")
+        print(f"{(timestamp_us - start) / 1000:12.3f} ms  {arrow}  0x{command:02X}  {len(payload):5} B  {preview}")
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Record and inspect SlidR serial captures")
+    commands = parser.add_subparsers(dest="command", required=True)
+    proxy_parser = commands.add_parser("proxy", help="record a host application through a pty")
+    proxy_parser.add_argument("--port", required=True, help="Device serial port")
+    proxy_parser.add_argument("--link", type=Path, default=Path("/tmp/slidr-capture"),
+                              help="Symlink for the application to open (default /tmp/slidr-capture)")
+    proxy_parser.add_argument("-o", "--output", type=Path, required=True)
+    dump_parser = commands.add_parser("dump", help="download the device's capture buffer")
+    dump_parser.add_argument("--port", default="COM4")
+    dump_parser.add_argument("--baudrate", type=int, default=115200)
+    dump_parser.add_argument("-o", "--output", type=Path, required=True)
+    show_parser = commands.add_parser("show", help="list the frames in a capture")
+    show_parser.add_argument("capture", type=Path)
+    args = parser.parse_args()
+
+    if args.command == "proxy":
+        proxy(args.port, args.link, args.output)
+    elif args.command == "dump":
+        import serial
+
+        with serial.Serial(port=args.port, baudrate=args.baudrate, timeout=0.1) as port:
+            args.output.write_bytes(dump(port))
+    else:
+        show(args.capture)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,37 +1,12 @@
 import serial
 import struct
 import time
-from enum import IntEnum
 from typing import Optional, Callable
 from dataclasses import dataclass
 from PIL import Image
 import threading
 import getpass
-
-class Command(IntEnum):
-    PING = 0x01
-    PONG = 0x02
-    SET_CONFIG = 0x03
-    GET_CONFIG = 0x04
-    CONFIG_DATA = 0x05
-    UPLOAD_IMAGE_START = 0x06
-    UPLOAD_IMAGE_DATA = 0x07
-    UPLOAD_IMAGE_END = 0x08
-    IMAGE_ACK = 0x09
-    SLIDER_VALUE = 0x0A
-    SET_BACKLIGHT = 0x0B
-    ERROR_CMD = 0x0C
-    GET_STATUS = 0x0D
-    STATUS_DATA = 0x0E
-    LOG_MESSAGE = 0x0F
-
-class ErrorCode(IntEnum):
-    NONE = 0x00
-    INVALID_COMMAND = 0x01
-    CHECKSUM_ERROR = 0x02
-    FILE_ERROR = 0x03
-    INVALID_CONFIG = 0x04
-    BUFFER_OVERFLOW = 0x05
+from protodef import Command, ErrorCode
 
 class Controller:
     bytes_on_line = 16
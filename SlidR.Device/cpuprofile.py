@@ -0,0 +1,187 @@
+"""Sampling profiler client for firmware built with SLIDR_PROFILER.
+
+Starts the profiler over serial, collects PROFILE_DATA samples, symbolises them against the
+firmware ELF with addr2line and writes folded stacks ("task;outer;inner count") that
+flamegraph.pl, speedscope or inferno accept:
+
+    python cpuprofile.py --port COM4 --duration 10 -o slidr.folded
+    flamegraph.pl slidr.folded > slidr.svg
+
+Samples can be saved with --save-raw and symbolised later with --from-raw.
+"""
+from collections import Counter
+from pathlib import Path
+import argparse
+import json
+import re
+import struct
+import subprocess
+import sys
+import time
+
+from protodef import Command
+
+RTOS_HEADER = Path(__file__).parent / "src" / "Rtos.h"
+DEFAULT_ELF = Path(__file__).parent / ".pio" / "build" / "lolin_s2_mini_profile" / "firmware.elf"
+DEFAULT_ADDR2LINE = "xtensa-esp32s2-elf-addr2line"
+
+START_BYTE = 0xAA
+PROFILE_CONTROL = Command.PROFILE_CONTROL
+PROFILE_DUMP = Command.PROFILE_DUMP
+PROFILE_DATA = Command.PROFILE_DATA
+
+TASK_IDLE = 0xFE
+TASK_OTHER = 0xFF
+SAMPLE_CAPACITY = 2048
+
+_TASK_ENTRY = re.compile(r'\{\s*TaskId::\w+\s*,\s*"([^"]+)"')
+
+
+def load_task_names(path: Path = RTOS_HEADER) -> dict[int, str]:
+    """Task index in PROFILE_DATA -> name, from the TASKS table in src/Rtos.h"""
+    names = dict(enumerate(_TASK_ENTRY.findall(Path(path).read_text())))
+    names[TASK_IDLE] = "IDLE"
+    names[TASK_OTHER] = "Other"
+    return names
+
+
+def encode_packet(command: int, payload: bytes = b"") -> bytes:
+    header = struct.pack("<BH", command, len(payload))
+    checksum = 0
+    for byte in header + payload:
+        checksum ^= byte
+    return bytes([START_BYTE]) + header + payload + bytes([checksum])
+
+
+def read_packet(port, timeout: float) -> tuple[int, bytes] | None:
+    """Next valid packet, or None on timeout"""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if port.read(1) != bytes([START_BYTE]):
+            continue
+        header = port.read(3)
+        if len(header) < 3:
+            continue
+        command, length = struct.unpack("<BH", header)
+        rest = port.read(length + 1)
+        if len(rest) < length + 1:
+            continue
+        checksum = 0
+        for byte in header + rest[:-1]:
+            checksum ^= byte
+        if checksum == rest[-1]:
+            return command, rest[:-1]
+    return None
+
+
+def dump(port) -> tuple[list[tuple[int, int]], int]:
+    """Request a dump and return ([(pc, task)], dropped sample count)"""
+    port.write(encode_packet(PROFILE_DUMP))
+    samples = []
+    dropped = 0
+    while True:
+        packet = read_packet(port, timeout=2.0)
+        if packet is None:
+            raise TimeoutError("No PROFILE_DATA received, is the firmware built with SLIDR_PROFILER?")
+        command, payload = packet
+        if command != PROFILE_DATA:
+            continue
+        flags, dropped, count = struct.unpack_from("<BIH", payload, 0)
+        for i in range(count):
+            samples.append(struct.unpack_from("<IB", payload, 7 + i * 5))
+        if flags & 1:
+            return samples, dropped
+
+
+def collect(port_name: str, baudrate: int, rate_hz: int, duration: float) -> list[tuple[int, int]]:
+    import serial
+
+    samples = []
+    dropped = 0
+    # Dump well before the device buffer fills up
+    interval = max(0.1, SAMPLE_CAPACITY / rate_hz / 2)
+    with serial.Serial(port=port_name, baudrate=baudrate, timeout=0.1) as port:
+        port.write(encode_packet(PROFILE_CONTROL, struct.pack("<H", rate_hz)))
+        end = time.monotonic() + duration
+        try:
+            while time.monotonic() < end:
+                time.sleep(min(interval, max(0.0, end - time.monotonic())))
+                new_samples, new_dropped = dump(port)
+                samples += new_samples
+                dropped += new_dropped
+        finally:
+            port.write(encode_packet(PROFILE_CONTROL, struct.pack("<H", 0)))
+    if dropped:
+        print(f"warning: {dropped} samples dropped, lower --rate", file=sys.stderr)
+    return samples
+
+
+def symbolise(pcs: set[int], elf: Path, addr2line: str) -> dict[int, list[str]]:
+    """PC -> function names, outermost first (inlined frames included)"""
+    addresses = sorted(pcs)
+    if not addresses:
+        return {}
+    result = subprocess.run(
+        [addr2line, "-a", "-f", "-i", "-C", "-e", str(elf)],
+        input="\n".join(f"0x{pc:08x}" for pc in addresses) + "\n",
+        capture_output=True, text=True, check=True,
+    )
+
+    frames: dict[int, list[str]] = {}
+    current = None
+    lines = result.stdout.splitlines()
+    i = 0
+    while i < len(lines):
+        line = lines[i]
+        if line.startswith("0x"):
+            current = int(line, 16)
+            frames[current] = []
+            i += 1
+            continue
+        # Function name followed by file:line, innermost frame first
+        function = line if line != "??" else f"0x{current:08x}"
+        frames[current].insert(0, function)
+        i += 2
+    return frames
+
+
+def fold(samples: list[tuple[int, int]], frames: dict[int, list[str]], task_names: dict[int, str]) -> Counter:
+    stacks = Counter()
+    for pc, task in samples:
+        task_name = task_names.get(task, f"Task {task}")
+        stack = frames.get(pc) or [f"0x{pc:08x}"]
+        stacks[";".join([task_name] + stack)] += 1
+    return stacks
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Collect and symbolise SlidR CPU profiles")
+    parser.add_argument("--port", default="COM4")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--rate", type=int, default=1000, help="Samples per second (max 10000)")
+    parser.add_argument("--duration", type=float, default=10.0, help="Seconds to sample")
+    parser.add_argument("--elf", type=Path, default=DEFAULT_ELF)
+    parser.add_argument("--addr2line", default=DEFAULT_ADDR2LINE)
+    parser.add_argument("--save-raw", type=Path, help="Also write the raw samples as JSON")
+    parser.add_argument("--from-raw", type=Path, help="Symbolise samples saved with --save-raw")
+    parser.add_argument("-o", "--output", type=Path, help="Folded stacks output (default: stdout)")
+    args = parser.parse_args()
+
+    if args.from_raw:
+        samples = [tuple(sample) for sample in json.loads(args.from_raw.read_text())]
+    else:
+        samples = collect(args.port, args.baudrate, args.rate, args.duration)
+    if args.save_raw:
+        args.save_raw.write_text(json.dumps(samples))
+
+    frames = symbolise({pc for pc, _ in samples}, args.elf, args.addr2line)
+    stacks = fold(samples, frames, load_task_names())
+    text = "".join(f"{stack} {count}\n" for stack, count in stacks.most_common())
+    if args.output:
+        args.output.write_text(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,762 @@
+#include "Client.h"
+
+#include "Sha256.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace host {
+
+namespace {
+
+constexpr size_t READ_SIZE = 4096;
+constexpr size_t FRAME_OVERHEAD = 5; // Start byte, command, length and checksum
+
+speed_t baud_constant(uint32_t baudrate) {
+    switch (baudrate) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return B115200; // USB CDC ignores it anyway
+    }
+}
+
+int open_serial(const std::string& path, uint32_t baudrate) {
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        // The daemon's socket, see `Daemon.h`
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) return -1;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    int fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    termios tio{};
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        cfsetispeed(&tio, baud_constant(baudrate));
+        cfsetospeed(&tio, baud_constant(baudrate));
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+/// @brief zlib stream of `data` at the best compression, empty on failure
+std::vector<uint8_t> deflate(const std::vector<uint8_t>& data) {
+    uLongf size = compressBound(data.size());
+    std::vector<uint8_t> out(size);
+    if (compress2(out.data(), &size, data.data(), data.size(), Z_BEST_COMPRESSION) != Z_OK) return {};
+    out.resize(size);
+    return out;
+}
+
+ErrorCode error_of(const Frame& reply) {
+    messages::Error error;
+    return reply.decode(error) ? error.code : ErrorCode::NONE;
+}
+
+bool is_file_upload(Command command) {
+    return command == Command::UPLOAD_IMAGE_START || command == Command::UPLOAD_IMAGE_DATA ||
+           command == Command::UPLOAD_IMAGE_END;
+}
+
+/// @brief Resolve `promise` with a failed result if the request failed
+/// @return `true` if it did, the caller is done
+template <typename T>
+bool resolve_failure(std::promise<Result<T>>& promise, Status status, const Frame* reply) {
+    if (status == Status::OK) return false;
+    Result<T> result;
+    result.status = status;
+    if (status == Status::DEVICE_ERROR) result.error = error_of(*reply);
+    promise.set_value(std::move(result));
+    return true;
+}
+
+template <typename T>
+void resolve(std::promise<Result<T>>& promise, T value) {
+    Result<T> result;
+    result.value = std::move(value);
+    promise.set_value(std::move(result));
+}
+
+template <typename T>
+void resolve_invalid(std::promise<Result<T>>& promise) {
+    Result<T> result;
+    result.status = Status::INVALID_REPLY;
+    promise.set_value(std::move(result));
+}
+
+} // namespace
+
+const char* status_name(Status status) {
+    switch (status) {
+        case Status::OK: return "OK";
+        case Status::DEVICE_ERROR: return "DEVICE_ERROR";
+        case Status::TIMEOUT: return "TIMEOUT";
+        case Status::DISCONNECTED: return "DISCONNECTED";
+        case Status::INVALID_REPLY: return "INVALID_REPLY";
+    }
+    return "UNKNOWN";
+}
+
+void encode_frame(std::vector<uint8_t>& out, Command command, const uint8_t* payload, size_t size) {
+    uint8_t header[4] = {
+        START_BYTE,
+        static_cast<uint8_t>(command),
+        static_cast<uint8_t>(size & 0xFF),
+        static_cast<uint8_t>(size >> 8)
+    };
+    uint8_t checksum = FrameParser<4096>::checksum(header + 1, 3) ^ FrameParser<4096>::checksum(payload, size);
+    out.insert(out.end(), header, header + sizeof(header));
+    out.insert(out.end(), payload, payload + size);
+    out.push_back(checksum);
+}
+
+Client::Client(EventLoop& loop) : Client(loop, Options{}) {}
+
+Client::Client(EventLoop& loop, Options options) : _loop(loop), _options(options) {
+    _options.upload_chunk_size = std::min(std::max<size_t>(_options.upload_chunk_size, 1), messages::MAX_PAYLOAD_SIZE);
+    _options.max_in_flight = std::max<size_t>(_options.max_in_flight, 1);
+}
+
+Client::~Client() {
+    close();
+}
+
+void Client::call(std::function<void()> task) {
+    if (_loop.in_loop_thread()) {
+        task();
+        return;
+    }
+    std::promise<void> done;
+    _loop.post([&] {
+        task();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+bool Client::open(const std::string& path, uint32_t baudrate) {
+    close();
+    int fd = open_serial(path, baudrate);
+    if (fd < 0) return false;
+    bool watched = false;
+    call([&] {
+        watched = _loop.watch(fd, EPOLLIN, [this](uint32_t events) {
+            if (events & EPOLLOUT) flush();
+            if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) on_readable();
+        });
+        if (watched) {
+            _fd = fd;
+            _parser.reset();
+        }
+    });
+    if (!watched) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+}
+
+void Client::close() {
+    call([this] {
+        if (_fd < 0) return;
+        _loop.unwatch(_fd);
+        ::close(_fd);
+        _fd = -1;
+        disconnect();
+    });
+}
+
+void Client::set_event_handler(EventHandler handler) {
+    call([&] { _on_event = std::move(handler); });
+}
+
+void Client::set_disconnect_handler(DisconnectHandler handler) {
+    call([&] { _on_disconnect = std::move(handler); });
+}
+
+std::future<Result<Frame>> Client::request(Command command, std::vector<uint8_t> payload) {
+    auto promise = std::make_shared<std::promise<Result<Frame>>>();
+    request(command, std::move(payload), [promise](const Result<Frame>& result) { promise->set_value(result); });
+    return promise->get_future();
+}
+
+void Client::request(Command command, std::vector<uint8_t> payload, ReplyCallback callback) {
+    Request request{ command, std::move(payload) };
+    request.done = [callback = std::move(callback)](Status status, const Frame* reply) {
+        Result<Frame> result;
+        result.status = status;
+        if (status == Status::DEVICE_ERROR) result.error = error_of(*reply);
+        if (reply) result.value = *reply;
+        callback(result);
+    };
+    submit(std::move(request));
+}
+
+std::future<Result<Empty>> Client::ping() {
+    auto promise = std::make_shared<std::promise<Result<Empty>>>();
+    Request request{ Command::PING };
+    request.done = [promise](Status status, const Frame* reply) {
+        if (resolve_failure(*promise, status, reply)) return;
+        resolve(*promise, Empty{});
+    };
+    submit(std::move(request));
+    return promise->get_future();
+}
+
+std::future<Result<DeviceStatus>> Client::get_status() {
+    auto promise = std::make_shared<std::promise<Result<DeviceStatus>>>();
+    Request request{ Command::GET_STATUS };
+    request.done = [promise](Status status, const Frame* reply) {
+        if (resolve_failure(*promise, status, reply)) return;
+        messages::StatusData status_data;
+        if (!reply->decode(status_data)) {
+            resolve_invalid(*promise);
+            return;
+        }
+        resolve(*promise, DeviceStatus{ status_data.awake, status_data.backlight, status_data.segment_count });
+    };
+    submit(std::move(request));
+    return promise->get_future();
+}
+
+std::future<Result<DeviceConfig>> Client::get_config() {
+    auto promise = std::make_shared<std::promise<Result<DeviceConfig>>>();
+    Request request{ Command::GET_CONFIG };
+    request.done = [promise](Status status, const Frame* reply) {
+        if (resolve_failure(*promise, status, reply)) return;
+        DeviceConfig config{};
+        if (!config_schema::decode(reply->payload.data(), reply->payload.size(), config)) {
+            resolve_invalid(*promise);
+            return;
+        }
+        resolve(*promise, config);
+    };
+    submit(std::move(request));
+    return promise->get_future();
+}
+
+std::future<Result<ConfigJob>> Client::set_config(const DeviceConfig& config) {
+    auto promise = std::make_shared<std::promise<Result<ConfigJob>>>();
+    std::vector<uint8_t> payload(config_schema::MAX_ENCODED_SIZE);
+    size_t size = config_schema::encode(config, payload.data(), payload.size());
+    if (size == 0) {
+        Result<ConfigJob> result;
+        result.status = Status::DEVICE_ERROR;
+        result.error = ErrorCode::INVALID_CONFIG;
+        promise->set_value(result);
+        return promise->get_future();
+    }
+    payload.resize(size);
+    submit_config_job(Command::SET_CONFIG, std::move(payload), promise);
+    return promise->get_future();
+}
+
+std::future<Result<ConfigJob>> Client::patch_config(const DeviceConfig& config, const std::vector<config_schema::FieldPath>& paths) {
+    auto promise = std::make_shared<std::promise<Result<ConfigJob>>>();
+    std::vector<uint8_t> payload{ static_cast<uint8_t>(paths.size()) };
+    bool valid = !paths.empty() && paths.size() <= UINT8_MAX;
+    for (const config_schema::FieldPath& path : paths) {
+        uint8_t value[sizeof(uint32_t)];
+        size_t size = config_schema::encode_field(config, path, value, sizeof(value));
+        if (size == 0) valid = false;
+        payload.push_back(path.field);
+        payload.push_back(path.segment);
+        payload.insert(payload.end(), value, value + size);
+    }
+    if (!valid) {
+        Result<ConfigJob> result;
+        result.status = Status::DEVICE_ERROR;
+        result.error = ErrorCode::INVALID_CONFIG;
+        promise->set_value(result);
+        return promise->get_future();
+    }
+    submit_config_job(Command::PATCH_CONFIG, std::move(payload), promise);
+    return promise->get_future();
+}
+
+std::future<Result<ConfigJob>> Client::default_config() {
+    auto promise = std::make_shared<std::promise<Result<ConfigJob>>>();
+    submit_config_job(Command::DEFAULT_CONFIG, {}, promise);
+    return promise->get_future();
+}
+
+std::future<Result<Empty>> Client::set_backlight(uint8_t value) {
+    auto promise = std::make_shared<std::promise<Result<Empty>>>();
+    Request request{ Command::SET_BACKLIGHT, { value } };
+    request.done = [promise](Status status, const Frame* reply) {
+        if (resolve_failure(*promise, status, reply)) return;
+        resolve(*promise, Empty{});
+    };
+    submit(std::move(request));
+    return promise->get_future();
+}
+
+std::future<Result<Empty>> Client::upload_image(uint8_t segment, std::vector<uint8_t> data, size_t chunk_size) {
+    struct Upload {
+        std::promise<Result<Empty>> promise;
+        bool failed = false;
+    };
+    auto upload = std::make_shared<Upload>();
+    auto future = upload->promise.get_future();
+    auto shared_data = std::make_shared<std::vector<uint8_t>>(std::move(data));
+    chunk_size = chunk_size ? std::min(chunk_size, messages::MAX_PAYLOAD_SIZE) : _options.upload_chunk_size;
+
+    _loop.post([this, upload, shared_data, segment, chunk_size] {
+        uint32_t group = _next_group++;
+        // Every request of the upload fails it, the first failure wins and drops the rest
+        auto check = [this, upload, group](Status status, const Frame* reply) {
+            if (upload->failed) return false;
+            if (status == Status::OK) return true;
+            upload->failed = true;
+            end_transfer(group);
+            resolve_failure(upload->promise, status, reply);
+            drop_group(group);
+            return false;
+        };
+
+        const std::vector<uint8_t>& bytes = *shared_data;
+        uint32_t total = static_cast<uint32_t>(bytes.size());
+        Frame start_frame = Frame::of(messages::UploadImageStart{ segment, total });
+        Request start{ start_frame.command, std::move(start_frame.payload) };
+        start.group = group;
+        // The device's transfer watchdog runs from its `ACK` to the end of the upload
+        start.done = [this, check, group](Status status, const Frame* reply) {
+            if (check(status, reply)) _transfer = { group, check };
+        };
+        submit(std::move(start));
+
+        for (size_t offset = 0; offset < bytes.size(); offset += chunk_size) {
+            size_t size = std::min(chunk_size, bytes.size() - offset);
+            Request chunk{ Command::UPLOAD_IMAGE_DATA,
+                std::vector<uint8_t>(bytes.begin() + offset, bytes.begin() + offset + size) };
+            chunk.group = group;
+            chunk.done = [check](Status status, const Frame* reply) { check(status, reply); };
+            submit(std::move(chunk));
+        }
+
+        Request end{ Command::UPLOAD_IMAGE_END };
+        end.group = group;
+        end.done = [this, check, upload, group](Status status, const Frame* reply) {
+            if (!check(status, reply)) return;
+            end_transfer(group);
+            resolve(upload->promise, Empty{});
+        };
+        submit(std::move(end));
+    });
+    return future;
+}
+
+std::future<Result<Empty>> Client::update_firmware(std::vector<uint8_t> image, bool compress, ProgressCallback progress) {
+    struct Update {
+        std::promise<Result<Empty>> promise;
+        std::vector<uint8_t> stream;
+        ProgressCallback progress;
+        bool failed = false;
+    };
+    auto update = std::make_shared<Update>();
+    auto future = update->promise.get_future();
+
+    sha256::Digest digest = sha256::hash(image.data(), image.size());
+    messages::OtaBegin begin{ static_cast<uint32_t>(image.size()), 0, ByteView{ digest.bytes, sha256::DIGEST_SIZE } };
+    if (compress) {
+        update->stream = deflate(image);
+        begin.flags = messages::OTA_FLAG_COMPRESSED;
+    }
+    if (!compress || update->stream.empty()) {
+        update->stream = std::move(image);
+        begin.flags = 0;
+    }
+    update->progress = std::move(progress);
+    Frame begin_frame = Frame::of(begin);
+
+    _loop.post([this, update, begin_frame] {
+        uint32_t group = _next_group++;
+        auto check = [this, update, group](Status status, const Frame* reply) {
+            if (update->failed) return false;
+            messages::OtaStatus ota_status;
+            if (status == Status::OK && reply->command == Command::OTA_STATUS && !reply->decode(ota_status)) {
+                status = Status::INVALID_REPLY;
+            }
+            if (status == Status::OK) {
+                if (update->progress && reply->command == Command::OTA_STATUS) {
+                    update->progress(ota_status.received, static_cast<uint32_t>(update->stream.size()));
+                }
+                return true;
+            }
+            update->failed = true;
+            end_transfer(group);
+            if (status == Status::INVALID_REPLY) {
+                resolve_invalid(update->promise);
+            } else {
+                resolve_failure(update->promise, status, reply);
+            }
+            drop_group(group);
+            return false;
+        };
+
+        // The chunks follow once the device has said how much it buffers
+        Request start{ begin_frame.command, begin_frame.payload };
+        start.group = group;
+        start.barrier = true;
+        start.done = [this, update, group, check](Status status, const Frame* reply) {
+            if (!check(status, reply)) return;
+            // The device's transfer watchdog runs from here to `OTA_END`
+            _transfer = { group, check };
+            messages::OtaStatus ota_status;
+            reply->decode(ota_status);
+            // Every request in flight may be a full chunk
+            size_t frame_size = ota_status.window / std::max<size_t>(_options.max_in_flight, 1);
+            size_t chunk_size = frame_size > FRAME_OVERHEAD ? std::min(frame_size - FRAME_OVERHEAD, messages::MAX_PAYLOAD_SIZE) : 0;
+            if (chunk_size == 0) {
+                update->failed = true;
+                end_transfer(group);
+                resolve_invalid(update->promise);
+                return;
+            }
+
+            const std::vector<uint8_t>& stream = update->stream;
+            for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+                size_t size = std::min(chunk_size, stream.size() - offset);
+                Request chunk{ Command::OTA_DATA,
+                    std::vector<uint8_t>(stream.begin() + offset, stream.begin() + offset + size) };
+                chunk.group = group;
+                chunk.done = [check](Status status, const Frame* reply) { check(status, reply); };
+                submit(std::move(chunk));
+            }
+
+            Request end{ Command::OTA_END };
+            end.group = group;
+            end.done = [this, check, update, group](Status status, const Frame* reply) {
+                if (!check(status, reply)) return;
+                end_transfer(group);
+                resolve(update->promise, Empty{});
+            };
+            submit(std::move(end));
+        };
+        submit(std::move(start));
+    });
+    return future;
+}
+
+std::future<Result<std::vector<uint8_t>>> Client::download_image(uint8_t segment) {
+    auto promise = std::make_shared<std::promise<Result<std::vector<uint8_t>>>>();
+    download_image(segment, [promise](const Result<std::vector<uint8_t>>& result) { promise->set_value(result); });
+    return promise->get_future();
+}
+
+void Client::download_image(uint8_t segment, DownloadCallback callback) {
+    Request request{ Command::DOWNLOAD_IMAGE_START, { segment } };
+    request.barrier = true;
+    request.done = [this, callback = std::move(callback)](Status status, const Frame* reply) {
+        if (status != Status::OK) {
+            Result<std::vector<uint8_t>> result;
+            result.status = status;
+            if (status == Status::DEVICE_ERROR) result.error = error_of(*reply);
+            callback(result);
+            return;
+        }
+        _download = std::make_unique<Download>();
+        _download->done = callback;
+        on_download_frame(*reply);
+    };
+    submit(std::move(request));
+}
+
+void Client::submit_config_job(Command command, std::vector<uint8_t> payload,
+                               std::shared_ptr<std::promise<Result<ConfigJob>>> promise) {
+    Request request{ command, std::move(payload) };
+    request.done = [this, promise](Status status, const Frame* reply) {
+        if (resolve_failure(*promise, status, reply)) return;
+        messages::Ack ack;
+        if (!reply->decode(ack) || !ack.job_id.present) {
+            resolve_invalid(*promise);
+            return;
+        }
+        // `CONFIG_APPLIED` always follows the `ACK`, see `on_frame()`
+        uint16_t id = ack.job_id.value;
+        PendingJob& job = _jobs[id];
+        job.promise = promise;
+        job.timer = _loop.call_after(_options.job_timeout, [this, id] {
+            auto it = _jobs.find(id);
+            if (it == _jobs.end()) return;
+            Result<ConfigJob> result;
+            result.status = Status::TIMEOUT;
+            result.value.id = id;
+            it->second.promise->set_value(result);
+            _jobs.erase(it);
+        });
+    };
+    submit(std::move(request));
+}
+
+void Client::submit(Request request) {
+    auto shared = std::make_shared<Request>(std::move(request));
+    auto enqueue = [this, shared] {
+        if (_fd < 0) {
+            shared->done(Status::DISCONNECTED, nullptr);
+            return;
+        }
+        _queued.push_back(std::move(*shared));
+        pump();
+    };
+    if (_loop.in_loop_thread()) {
+        enqueue();
+    } else {
+        _loop.post(enqueue);
+    }
+}
+
+void Client::pump() {
+    while (!_queued.empty() && _in_flight.size() < _options.max_in_flight) {
+        if (!_in_flight.empty() && (_in_flight.back().barrier || _queued.front().barrier)) break;
+        // Requests wait for a download's first packet, not for the whole download
+        if (_queued.front().barrier && _download) break;
+        Request& request = _queued.front();
+        write_frame(request.command, request.payload);
+        bool was_idle = _in_flight.empty();
+        _in_flight.push_back(std::move(request));
+        _queued.pop_front();
+        if (was_idle) arm_timeout();
+    }
+    flush();
+}
+
+void Client::write_frame(Command command, const std::vector<uint8_t>& payload) {
+    encode_frame(_tx, command, payload.data(), payload.size());
+}
+
+void Client::flush() {
+    if (_fd < 0) return;
+    while (_tx_offset < _tx.size()) {
+        ssize_t written = ::write(_fd, _tx.data() + _tx_offset, _tx.size() - _tx_offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) return; // The read side reports the disconnect
+            if (!_waiting_writable) {
+                _loop.modify(_fd, EPOLLIN | EPOLLOUT);
+                _waiting_writable = true;
+            }
+            return;
+        }
+        _tx_offset += written;
+    }
+    _tx.clear();
+    _tx_offset = 0;
+    if (_waiting_writable) {
+        _loop.modify(_fd, EPOLLIN);
+        _waiting_writable = false;
+    }
+}
+
+void Client::on_readable() {
+    uint8_t buffer[READ_SIZE];
+    while (_fd >= 0) {
+        ssize_t count = ::read(_fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0 && errno == EAGAIN) return;
+        if (count <= 0) {
+            // EOF, or EIO once the other end of a pty is gone
+            _loop.unwatch(_fd);
+            ::close(_fd);
+            _fd = -1;
+            disconnect();
+            if (_on_disconnect) _on_disconnect();
+            return;
+        }
+        for (ssize_t i = 0; i < count; i++) {
+            if (_parser.push(buffer[i]) != FrameParser<4096>::Result::PACKET) continue;
+            ByteView payload = _parser.payload();
+            on_frame(Frame{ _parser.command(), std::vector<uint8_t>(payload.data(), payload.data() + payload.size()) });
+        }
+    }
+}
+
+void Client::on_frame(const Frame& frame) {
+    if (_download && (frame.command == Command::DOWNLOAD_IMAGE_DATA || frame.command == Command::DOWNLOAD_IMAGE_END)) {
+        on_download_frame(frame);
+        return;
+    }
+
+    if (frame.command == Command::ERROR_CMD && on_async_error(frame)) return;
+
+    if (!_in_flight.empty() && answers(_in_flight.front().command, frame.command)) {
+        Request request = std::move(_in_flight.front());
+        _in_flight.pop_front();
+        arm_timeout();
+        request.done(frame.command == Command::ERROR_CMD ? Status::DEVICE_ERROR : Status::OK, &frame);
+        pump();
+        return;
+    }
+
+    messages::ConfigApplied applied;
+    if (frame.decode(applied)) {
+        auto it = _jobs.find(applied.job_id);
+        if (it != _jobs.end()) {
+            _loop.cancel(it->second.timer);
+            Result<ConfigJob> result;
+            result.value.id = it->first;
+            result.value.error = applied.error;
+            result.value.duration_us = applied.duration_us;
+            it->second.promise->set_value(result);
+            _jobs.erase(it);
+            return;
+        }
+    }
+
+    if (_on_event) _on_event(frame);
+}
+
+void Client::on_download_frame(const Frame& frame) {
+    _loop.cancel(_download->timer);
+    if (frame.command == Command::DOWNLOAD_IMAGE_END) {
+        finish_download(Status::OK, ErrorCode::NONE);
+        pump();
+        return;
+    }
+    _download->data.insert(_download->data.end(), frame.payload.begin(), frame.payload.end());
+    write_frame(Command::ACK, {});
+    flush();
+    _download->timer = _loop.call_after(_options.timeout, [this] {
+        finish_download(Status::TIMEOUT, ErrorCode::NONE);
+        pump();
+    });
+}
+
+bool Client::on_async_error(const Frame& frame) {
+    ErrorCode error = error_of(frame);
+    if (error == ErrorCode::TRANSFER_TIMEOUT) {
+        // Never a reply: the watchdog cancelled the transfer after the host went quiet
+        if (!_transfer.fail) {
+            if (_on_event) _on_event(frame);
+            return true;
+        }
+        Completion fail = std::move(_transfer.fail);
+        _transfer = Transfer{};
+        fail(Status::DEVICE_ERROR, &frame);
+        pump();
+        return true;
+    }
+    // The stream reports a failed read from its own task; on the comm task only uploads answer `FILE_ERROR`
+    if (error == ErrorCode::FILE_ERROR && _download &&
+        (_in_flight.empty() || !is_file_upload(_in_flight.front().command))) {
+        finish_download(Status::DEVICE_ERROR, error);
+        pump();
+        return true;
+    }
+    return false;
+}
+
+void Client::end_transfer(uint32_t group) {
+    if (_transfer.group == group) _transfer = Transfer{};
+}
+
+void Client::finish_download(Status status, ErrorCode error) {
+    if (!_download) return;
+    _loop.cancel(_download->timer);
+    Result<std::vector<uint8_t>> result;
+    result.status = status;
+    result.error = error;
+    if (status == Status::OK) result.value = std::move(_download->data);
+    // Reset first, the callback may start the next download
+    std::unique_ptr<Download> download = std::move(_download);
+    download->done(result);
+}
+
+void Client::arm_timeout() {
+    _loop.cancel(_timeout_timer);
+    _timeout_timer = 0;
+    if (_in_flight.empty()) return;
+    _timeout_timer = _loop.call_after(_options.timeout, [this] { on_timeout(); });
+}
+
+void Client::on_timeout() {
+    _timeout_timer = 0;
+    if (_in_flight.empty()) return;
+    // A late reply would be taken for the next request's, there is no request ID to tell them apart
+    Request request = std::move(_in_flight.front());
+    _in_flight.pop_front();
+    arm_timeout();
+    request.done(Status::TIMEOUT, nullptr);
+    pump();
+}
+
+void Client::disconnect() {
+    _loop.cancel(_timeout_timer);
+    _timeout_timer = 0;
+    _tx.clear();
+    _tx_offset = 0;
+    _waiting_writable = false;
+
+    std::deque<Request> requests;
+    requests.swap(_in_flight);
+    requests.insert(requests.end(), std::make_move_iterator(_queued.begin()), std::make_move_iterator(_queued.end()));
+    _queued.clear();
+    for (Request& request : requests) {
+        request.done(Status::DISCONNECTED, nullptr);
+    }
+
+    _transfer = Transfer{};
+    finish_download(Status::DISCONNECTED, ErrorCode::NONE);
+    for (auto& entry : _jobs) {
+        _loop.cancel(entry.second.timer);
+        Result<ConfigJob> result;
+        result.status = Status::DISCONNECTED;
+        result.value.id = entry.first;
+        entry.second.promise->set_value(result);
+    }
+    _jobs.clear();
+}
+
+void Client::drop_group(uint32_t group) {
+    _queued.erase(std::remove_if(_queued.begin(), _queued.end(),
+        [group](const Request& request) { return request.group == group; }), _queued.end());
+}
+
+bool Client::answers(Command request, Command reply) {
+    if (reply == Command::ERROR_CMD) return true;
+    switch (request) {
+        case Command::PING: return reply == Command::PONG;
+        case Command::GET_CONFIG: return reply == Command::CONFIG_DATA;
+        case Command::GET_STATUS: return reply == Command::STATUS_DATA;
+        case Command::GET_TASK_INFO: return reply == Command::TASK_INFO;
+        case Command::GET_STATS: return reply == Command::STATS_DATA;
+        case Command::GET_LATENCY: return reply == Command::LATENCY_DATA;
+        case Command::PROFILE_DUMP: return reply == Command::PROFILE_DATA;
+        case Command::TRACE_DUMP: return reply == Command::TRACE_DATA;
+        case Command::CAPTURE_DUMP: return reply == Command::CAPTURE_DATA;
+        case Command::OTA_BEGIN:
+        case Command::OTA_DATA: return reply == Command::OTA_STATUS;
+        // There is no ACK, the stream starts right away
+        case Command::DOWNLOAD_IMAGE_START:
+            return reply == Command::DOWNLOAD_IMAGE_DATA || reply == Command::DOWNLOAD_IMAGE_END;
+        default: return reply == Command::ACK;
+    }
+}
+
+} // namespace host
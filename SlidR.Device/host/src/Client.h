@@ -0,0 +1,258 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#pragma once
+
+#include "EventLoop.h"
+
+#include "Config.h"
+#include "ConfigSchema.h"
+#include "FrameParser.h"
+#include "Messages.h"
+#include "ProtocolConstants.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Host side of the serial protocol, built from the firmware's own `ProtocolConstants.h`,
+/// `FrameParser.h` and `ConfigSchema.h`, on an epoll `EventLoop`. Works with a real port or the
+/// simulator's pty (`program --pty --link /tmp/slidr0 fs`, see `src/Simulator.h`).
+///
+///     host::EventLoop loop;
+///     loop.start();
+///     host::Client client(loop);
+///     client.open("/dev/ttyACM0");
+///     auto pong = client.ping();
+///     auto config = client.get_config();
+///     if (pong.get().ok() && config.get().ok()) ...
+///
+/// Operations return futures and are pipelined: up to `Options::max_in_flight` requests are on
+/// the link at once. The device answers the requests it handles on the comm task in order, so
+/// replies are matched to requests first in, first out. Uploads send their chunks through the
+/// same window instead of waiting for each `ACK`.
+///
+/// A firmware update streams its chunks through the same window, sized to stay within the
+/// receive buffer the device advertises in `OTA_STATUS`.
+///
+/// A download is the exception, the device streams it from another task: `DOWNLOAD_IMAGE_START`
+/// waits for the link to drain and later requests wait for its first packet.
+///
+/// Some `ERROR_CMD`s answer no request: `TRANSFER_TIMEOUT` from the device's transfer watchdog
+/// fails the upload or firmware update it cancelled, and `FILE_ERROR` from the download stream
+/// fails the download. Without one in progress they go to the event handler.
+///
+/// Frames that answer no request, such as `SLIDER_VALUE` and `LOG_EVENT`, go to the event
+/// handler. Handlers and the futures' results are produced on the loop thread; do not wait
+/// for a future there. The loop must be running while a `Client` is opened, closed or destroyed.
+namespace host {
+
+enum class Status : uint8_t {
+    OK,
+    DEVICE_ERROR,   // The device answered with `ERROR_CMD`, see `Result::error`
+    TIMEOUT,
+    DISCONNECTED,
+    INVALID_REPLY   // A reply of the expected command that could not be decoded
+};
+
+const char* status_name(Status status);
+
+struct Frame {
+    Command command;
+    std::vector<uint8_t> payload;
+
+    /// @brief Encode `message` into a frame of its command
+    template <typename M>
+    static Frame of(const M& message) {
+        Frame frame{ M::COMMAND, std::vector<uint8_t>(messages::MAX_SIZE<M>) };
+        size_t size = 0;
+        messages::encode(message, frame.payload.data(), frame.payload.size(), size);
+        frame.payload.resize(size);
+        return frame;
+    }
+
+    /// @brief Decode the payload as message `M`. `R` fields point into `payload`.
+    /// @return `false` if the command differs or the payload does not match the layout
+    template <typename M>
+    bool decode(M& out) const {
+        return command == M::COMMAND && messages::decode(payload.data(), payload.size(), out);
+    }
+};
+
+/// @brief Append `command` and `payload` to `out` as one frame on the wire
+void encode_frame(std::vector<uint8_t>& out, Command command, const uint8_t* payload, size_t size);
+
+template <typename T>
+struct Result {
+    Status status = Status::OK;
+    ErrorCode error = ErrorCode::NONE;
+    T value{};
+
+    bool ok() const { return status == Status::OK; }
+};
+
+struct Empty {};
+
+/// @brief Outcome of `SET_CONFIG`, `PATCH_CONFIG` or `DEFAULT_CONFIG`, from `CONFIG_APPLIED`
+struct ConfigJob {
+    uint16_t id = 0;
+    ErrorCode error = ErrorCode::NONE; // The job failed and left the config unchanged
+    uint32_t duration_us = 0;
+};
+
+struct DeviceStatus {
+    bool awake = false;
+    uint8_t backlight = 0;
+    uint8_t segment_count = 0;
+};
+
+class Client {
+public:
+    struct Options {
+        std::chrono::milliseconds timeout{ 2000 };       // Per reply
+        std::chrono::milliseconds job_timeout{ 10000 };  // From the job's `ACK` to `CONFIG_APPLIED`
+        size_t max_in_flight = 8;
+        size_t upload_chunk_size = 1024;                 // At most 4092
+    };
+
+    using EventHandler = std::function<void(const Frame& frame)>;
+    using DisconnectHandler = std::function<void()>;
+    using ReplyCallback = std::function<void(const Result<Frame>& result)>;
+    using DownloadCallback = std::function<void(const Result<std::vector<uint8_t>>& result)>;
+    /// @brief Bytes of the stream the device has taken so far, out of `total`
+    using ProgressCallback = std::function<void(uint32_t received, uint32_t total)>;
+
+    explicit Client(EventLoop& loop);
+    Client(EventLoop& loop, Options options);
+    /// @brief Closes the link, pending operations fail with `DISCONNECTED`
+    ~Client();
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /// @brief Open a serial port or pty in raw mode, or connect to the daemon's socket
+    /// @return `false` if it could not be opened, see `errno`
+    bool open(const std::string& path, uint32_t baudrate = 115200);
+    void close();
+    bool is_open() const { return _fd.load() >= 0; }
+
+    /// @brief Receives every frame that is not a reply, on the loop thread
+    void set_event_handler(EventHandler handler);
+    /// @brief Called on the loop thread when the device goes away
+    void set_disconnect_handler(DisconnectHandler handler);
+
+    /// @brief Send any request and wait for its reply, the next frame that is not an event.
+    /// For commands without a typed operation, e.g. `GET_TASK_INFO`.
+    std::future<Result<Frame>> request(Command command, std::vector<uint8_t> payload = {});
+    /// @brief As above, with `callback` called on the loop thread instead of a future. For
+    /// callers that live on the loop themselves, e.g. `Daemon`.
+    void request(Command command, std::vector<uint8_t> payload, ReplyCallback callback);
+
+    std::future<Result<Empty>> ping();
+    std::future<Result<DeviceStatus>> get_status();
+    std::future<Result<DeviceConfig>> get_config();
+    /// @brief Resolves once the device has applied the config, not at its `ACK`
+    std::future<Result<ConfigJob>> set_config(const DeviceConfig& config);
+    /// @brief Send the values of `config` at `paths` as one `PATCH_CONFIG`
+    std::future<Result<ConfigJob>> patch_config(const DeviceConfig& config, const std::vector<config_schema::FieldPath>& paths);
+    std::future<Result<ConfigJob>> default_config();
+    std::future<Result<Empty>> set_backlight(uint8_t value);
+
+    /// @brief Replace the image file of a segment, `width,height,pixels` as `Segment` reads it
+    /// @param chunk_size Bytes per `UPLOAD_IMAGE_DATA`, 0 for `Options::upload_chunk_size`
+    std::future<Result<Empty>> upload_image(uint8_t segment, std::vector<uint8_t> data, size_t chunk_size = 0);
+    std::future<Result<std::vector<uint8_t>>> download_image(uint8_t segment);
+    void download_image(uint8_t segment, DownloadCallback callback);
+
+    /// @brief Write an app image (`firmware.bin`) to the device's update partition, zlib
+    /// compressed unless `compress` is `false`. Resolves at the device's `ACK`, after which it
+    /// restarts into the new firmware on trial; the first `ping()` once it is back confirms it.
+    /// @param progress Called on the loop thread for every `OTA_STATUS`
+    std::future<Result<Empty>> update_firmware(std::vector<uint8_t> image, bool compress = true,
+                                               ProgressCallback progress = nullptr);
+
+private:
+    /// @brief Completes a request with its reply, `nullptr` unless `status` is `OK` or `DEVICE_ERROR`
+    using Completion = std::function<void(Status status, const Frame* reply)>;
+
+    struct Request {
+        Command command;
+        std::vector<uint8_t> payload;
+        Completion done;
+        uint32_t group = 0;   // Requests of one upload, dropped together when it fails
+        bool barrier = false; // Sent alone, later requests wait for its reply
+    };
+
+    struct Download {
+        std::vector<uint8_t> data;
+        DownloadCallback done;
+        EventLoop::TimerId timer = 0;
+    };
+
+    struct PendingJob {
+        std::shared_ptr<std::promise<Result<ConfigJob>>> promise;
+        EventLoop::TimerId timer = 0;
+    };
+
+    /// @brief The upload or firmware update the device's transfer watchdog covers
+    struct Transfer {
+        uint32_t group = 0;
+        Completion fail;
+    };
+
+    /// @brief Run `task` on the loop thread and wait for it
+    void call(std::function<void()> task);
+    /// @brief Queue on the loop thread and send as the window allows
+    void submit(Request request);
+    void submit_config_job(Command command, std::vector<uint8_t> payload,
+                           std::shared_ptr<std::promise<Result<ConfigJob>>> promise);
+    void pump();
+    void write_frame(Command command, const std::vector<uint8_t>& payload);
+    void flush();
+    void on_readable();
+    void on_frame(const Frame& frame);
+    void on_download_frame(const Frame& frame);
+    /// @brief Route an `ERROR_CMD` the device raises on its own instead of as a reply
+    /// @return `false` if it answers the request at the head of the window
+    bool on_async_error(const Frame& frame);
+    void end_transfer(uint32_t group);
+    void finish_download(Status status, ErrorCode error);
+    /// @brief Restart the reply timeout, or stop it if nothing is in flight
+    void arm_timeout();
+    void on_timeout();
+    void disconnect();
+    void drop_group(uint32_t group);
+
+    /// @brief Whether `reply` answers a `request`, `ERROR_CMD` answers all
+    static bool answers(Command request, Command reply);
+
+    EventLoop& _loop;
+    Options _options;
+    std::atomic<int> _fd{ -1 };
+    FrameParser<4096> _parser;
+    std::vector<uint8_t> _tx;
+    size_t _tx_offset = 0;
+    bool _waiting_writable = false;
+
+    std::deque<Request> _queued;
+    std::deque<Request> _in_flight;
+    EventLoop::TimerId _timeout_timer = 0;
+    std::unordered_map<uint16_t, PendingJob> _jobs;
+    std::unique_ptr<Download> _download;
+    Transfer _transfer;
+    uint32_t _next_group = 1;
+
+    EventHandler _on_event;
+    DisconnectHandler _on_disconnect;
+};
+
+} // namespace host
+
+#endif
@@ -0,0 +1,418 @@
+#include "Daemon.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace host {
+
+namespace {
+
+constexpr size_t READ_SIZE = 4096;
+constexpr size_t DOWNLOAD_CHUNK_SIZE = 1024;
+constexpr int LISTEN_BACKLOG = 16;
+
+void encode_error(std::vector<uint8_t>& out, ErrorCode error) {
+    uint8_t code = static_cast<uint8_t>(error);
+    encode_frame(out, Command::ERROR_CMD, &code, 1);
+}
+
+/// @brief What a connection gets for a request without a device reply. Not `TRANSFER_TIMEOUT`,
+/// clients take that for the device's transfer watchdog.
+constexpr ErrorCode NO_REPLY_ERROR = ErrorCode::BUSY;
+
+bool is_job(Command command) {
+    return command == Command::SET_CONFIG || command == Command::PATCH_CONFIG ||
+           command == Command::DEFAULT_CONFIG || command == Command::RUN_BENCHMARK;
+}
+
+bool is_upload(Command command) {
+    return command == Command::UPLOAD_IMAGE_START || command == Command::UPLOAD_IMAGE_DATA ||
+           command == Command::UPLOAD_IMAGE_END || command == Command::OTA_BEGIN ||
+           command == Command::OTA_DATA || command == Command::OTA_END;
+}
+
+bool make_address(const std::string& path, sockaddr_un& address) {
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+} // namespace
+
+std::string Daemon::default_socket_path() {
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) return std::string(runtime) + "/slidr.sock";
+    return "/tmp/slidr-" + std::to_string(getuid()) + ".sock";
+}
+
+Daemon::Daemon(EventLoop& loop, Client& client, Options options)
+    : _loop(loop), _client(client), _options(std::move(options)) {
+    if (_options.socket_path.empty()) _options.socket_path = default_socket_path();
+}
+
+Daemon::~Daemon() {
+    stop();
+}
+
+void Daemon::run_on_loop(std::function<void()> task) {
+    if (_loop.in_loop_thread()) {
+        task();
+        return;
+    }
+    std::promise<void> done;
+    _loop.post([&] {
+        task();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+bool Daemon::start(std::string& error) {
+    bool started = false;
+    run_on_loop([&] {
+        if (_started) {
+            started = true;
+            return;
+        }
+        sockaddr_un address;
+        if (!make_address(_options.socket_path, address)) {
+            error = "invalid socket path " + _options.socket_path;
+            return;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            error = strerror(errno);
+            return;
+        }
+        // A socket file left by a daemon that died is replaced, one that still answers is not
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            ::close(fd);
+            error = "another daemon listens on " + _options.socket_path;
+            return;
+        }
+        unlink(_options.socket_path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(fd, LISTEN_BACKLOG) != 0 ||
+            !_loop.watch(fd, EPOLLIN, [this](uint32_t) { accept_all(); })) {
+            error = _options.socket_path + ": " + strerror(errno);
+            ::close(fd);
+            return;
+        }
+        _listen_fd = fd;
+        _started = true;
+        started = true;
+
+        _client.set_event_handler([this](const Frame& frame) { on_event(frame); });
+        _client.set_disconnect_handler([this] { on_device_lost(); });
+        connect_device();
+    });
+    return started;
+}
+
+void Daemon::stop() {
+    run_on_loop([this] {
+        if (!_started) return;
+        _started = false;
+        _loop.cancel(_reconnect_timer);
+        _reconnect_timer = 0;
+        _client.set_event_handler(nullptr);
+        _client.set_disconnect_handler(nullptr);
+        _client.close();
+
+        std::vector<uint64_t> ids;
+        for (const auto& entry : _sessions) ids.push_back(entry.first);
+        for (uint64_t id : ids) close_session(id);
+
+        _loop.unwatch(_listen_fd);
+        ::close(_listen_fd);
+        _listen_fd = -1;
+        unlink(_options.socket_path.c_str());
+        _upload_owner = 0;
+        _jobs.clear();
+    });
+}
+
+void Daemon::connect_device() {
+    _reconnect_timer = 0;
+    if (!_started || _client.is_open()) return;
+    if (_client.open(_options.device, _options.baudrate)) {
+        fprintf(stderr, "slidrd: connected to %s\n", _options.device.c_str());
+        return;
+    }
+    _reconnect_timer = _loop.call_after(_options.reconnect_interval, [this] { connect_device(); });
+}
+
+void Daemon::on_device_lost() {
+    fprintf(stderr, "slidrd: lost %s, reconnecting\n", _options.device.c_str());
+    // The device forgets its transfer and jobs with the link, requests already failed with BUSY
+    _upload_owner = 0;
+    _jobs.clear();
+    _loop.cancel(_reconnect_timer);
+    _reconnect_timer = _loop.call_after(_options.reconnect_interval, [this] { connect_device(); });
+}
+
+void Daemon::accept_all() {
+    while (true) {
+        int fd = accept4(_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return; // EAGAIN, or out of descriptors until a connection closes
+        }
+        uint64_t id = _next_session++;
+        if (!_loop.watch(fd, EPOLLIN, [this, id](uint32_t events) { on_session_event(id, events); })) {
+            ::close(fd);
+            continue;
+        }
+        auto session = std::make_unique<Session>();
+        session->id = id;
+        session->fd = fd;
+        _sessions.emplace(id, std::move(session));
+    }
+}
+
+void Daemon::on_session_event(uint64_t id, uint32_t events) {
+    auto it = _sessions.find(id);
+    if (it == _sessions.end()) return;
+    Session& session = *it->second;
+    if (events & EPOLLOUT) flush(session);
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) return;
+
+    uint8_t buffer[READ_SIZE];
+    while (!session.closing) {
+        ssize_t count = ::read(session.fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0 && errno == EAGAIN) return;
+        if (count <= 0) {
+            close_session(id);
+            return;
+        }
+        // Answer parser errors as the device would, so the connection's replies stay in step
+        for (ssize_t i = 0; i < count && !session.closing; i++) {
+            switch (session.parser.push(buffer[i])) {
+                case FrameParser<4096>::Result::NONE:
+                    break;
+                case FrameParser<4096>::Result::CHECKSUM_ERROR:
+                    reply_error(session, session.next_slot++, ErrorCode::CHECKSUM_ERROR);
+                    break;
+                case FrameParser<4096>::Result::OVERFLOW:
+                    reply_error(session, session.next_slot++, ErrorCode::BUFFER_OVERFLOW);
+                    break;
+                case FrameParser<4096>::Result::PACKET: {
+                    ByteView payload = session.parser.payload();
+                    on_request(session, Frame{ session.parser.command(),
+                        std::vector<uint8_t>(payload.data(), payload.data() + payload.size()) });
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void Daemon::on_request(Session& session, const Frame& frame) {
+    // The daemon acknowledges download chunks itself
+    if (frame.command == Command::ACK) return;
+
+    uint64_t slot = session.next_slot++;
+    if (frame.command == SUBSCRIBE || frame.command == UNSUBSCRIBE) {
+        session.events.reset();
+        if (frame.command == SUBSCRIBE && frame.payload.empty()) session.events.set();
+        if (frame.command == SUBSCRIBE) {
+            for (uint8_t command : frame.payload) session.events.set(command);
+        }
+        std::vector<uint8_t> ack;
+        encode_frame(ack, Command::ACK, nullptr, 0);
+        finish(session.id, slot, std::move(ack));
+        return;
+    }
+
+    switch (frame.command) {
+        case Command::CHANGE_BAUDRATE:
+            reply_error(session, slot, ErrorCode::INVALID_COMMAND);
+            return;
+        case Command::DOWNLOAD_IMAGE_START: {
+            messages::DownloadImageStart start;
+            if (!frame.decode(start)) {
+                reply_error(session, slot, ErrorCode::INVALID_DATA);
+                return;
+            }
+            download(session, slot, start.segment);
+            return;
+        }
+        case Command::UPLOAD_IMAGE_START:
+        case Command::OTA_BEGIN:
+            if (_upload_owner != 0 && _upload_owner != session.id) {
+                reply_error(session, slot, ErrorCode::TRANSFER_IN_PROGRESS);
+                return;
+            }
+            _upload_owner = session.id;
+            forward(session, slot, frame);
+            return;
+        case Command::UPLOAD_IMAGE_DATA:
+        case Command::UPLOAD_IMAGE_END:
+        case Command::OTA_DATA:
+        case Command::OTA_END:
+            // What the device says when no upload is active, which is true for this connection
+            if (_upload_owner != session.id) {
+                reply_error(session, slot, ErrorCode::INVALID_COMMAND);
+                return;
+            }
+            forward(session, slot, frame);
+            return;
+        default:
+            forward(session, slot, frame);
+            return;
+    }
+}
+
+void Daemon::forward(Session& session, uint64_t slot, const Frame& frame) {
+    uint64_t id = session.id;
+    Command command = frame.command;
+    _client.request(command, frame.payload, [this, id, slot, command](const Result<Frame>& result) {
+        bool replied = result.status == Status::OK || result.status == Status::DEVICE_ERROR;
+        if (is_upload(command) && _upload_owner == id &&
+            (!result.ok() || command == Command::UPLOAD_IMAGE_END || command == Command::OTA_END)) {
+            _upload_owner = 0;
+        }
+        messages::Ack ack;
+        if (result.ok() && is_job(command) && result.value.decode(ack) && ack.job_id.present) {
+            _jobs[ack.job_id.value] = id;
+        }
+        std::vector<uint8_t> out;
+        if (replied) {
+            encode_frame(out, result.value.command, result.value.payload.data(), result.value.payload.size());
+        } else {
+            encode_error(out, NO_REPLY_ERROR);
+        }
+        finish(id, slot, std::move(out));
+    });
+}
+
+void Daemon::download(Session& session, uint64_t slot, uint8_t segment) {
+    uint64_t id = session.id;
+    _client.download_image(segment, [this, id, slot](const Result<std::vector<uint8_t>>& result) {
+        std::vector<uint8_t> out;
+        if (result.status == Status::DEVICE_ERROR) {
+            encode_error(out, result.error);
+        } else if (!result.ok()) {
+            encode_error(out, NO_REPLY_ERROR);
+        } else {
+            const std::vector<uint8_t>& data = result.value;
+            for (size_t offset = 0; offset < data.size(); offset += DOWNLOAD_CHUNK_SIZE) {
+                encode_frame(out, Command::DOWNLOAD_IMAGE_DATA, data.data() + offset,
+                             std::min(DOWNLOAD_CHUNK_SIZE, data.size() - offset));
+            }
+            encode_frame(out, Command::DOWNLOAD_IMAGE_END, nullptr, 0);
+        }
+        finish(id, slot, std::move(out));
+    });
+}
+
+void Daemon::reply_error(Session& session, uint64_t slot, ErrorCode error) {
+    std::vector<uint8_t> out;
+    encode_error(out, error);
+    finish(session.id, slot, std::move(out));
+}
+
+void Daemon::finish(uint64_t session_id, uint64_t slot, std::vector<uint8_t> frames) {
+    auto it = _sessions.find(session_id);
+    if (it == _sessions.end()) return;
+    Session& session = *it->second;
+    if (slot != session.next_to_send) {
+        session.finished.emplace(slot, std::move(frames));
+        return;
+    }
+    send(session, frames);
+    session.next_to_send++;
+    for (auto next = session.finished.begin();
+         next != session.finished.end() && next->first == session.next_to_send;
+         next = session.finished.erase(next)) {
+        send(session, next->second);
+        session.next_to_send++;
+    }
+}
+
+void Daemon::on_event(const Frame& frame) {
+    uint64_t owner = 0;
+    messages::ConfigApplied applied;
+    messages::BenchmarkData benchmark;
+    messages::Error error;
+    if (frame.decode(applied) || frame.decode(benchmark)) {
+        auto it = _jobs.find(frame.command == Command::CONFIG_APPLIED ? applied.job_id : benchmark.job_id);
+        if (it != _jobs.end()) {
+            owner = it->second;
+            _jobs.erase(it);
+        }
+    } else if (frame.decode(error) && error.code == ErrorCode::TRANSFER_TIMEOUT) {
+        // The device cancelled the upload, another connection may start one
+        owner = _upload_owner;
+        _upload_owner = 0;
+    }
+    std::vector<uint8_t> bytes;
+    encode_frame(bytes, frame.command, frame.payload.data(), frame.payload.size());
+    for (auto& entry : _sessions) {
+        Session& session = *entry.second;
+        if (session.events.test(static_cast<uint8_t>(frame.command)) || session.id == owner) {
+            send(session, bytes);
+        }
+    }
+}
+
+void Daemon::send(Session& session, const std::vector<uint8_t>& bytes) {
+    if (session.closing) return;
+    // A connection that stopped reading would otherwise hold every event in memory
+    if (session.tx.size() - session.tx_offset + bytes.size() > _options.max_backlog) {
+        fprintf(stderr, "slidrd: dropping connection %llu, it does not read\n",
+                static_cast<unsigned long long>(session.id));
+        session.closing = true;
+        uint64_t id = session.id;
+        _loop.post([this, id] { close_session(id); });
+        return;
+    }
+    session.tx.insert(session.tx.end(), bytes.begin(), bytes.end());
+    flush(session);
+}
+
+void Daemon::flush(Session& session) {
+    while (!session.closing && session.tx_offset < session.tx.size()) {
+        ssize_t written = ::send(session.fd, session.tx.data() + session.tx_offset,
+                                 session.tx.size() - session.tx_offset, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) return; // The read side sees the hangup
+            if (!session.waiting_writable) {
+                _loop.modify(session.fd, EPOLLIN | EPOLLOUT);
+                session.waiting_writable = true;
+            }
+            return;
+        }
+        session.tx_offset += written;
+    }
+    session.tx.clear();
+    session.tx_offset = 0;
+    if (session.waiting_writable) {
+        _loop.modify(session.fd, EPOLLIN);
+        session.waiting_writable = false;
+    }
+}
+
+void Daemon::close_session(uint64_t id) {
+    auto it = _sessions.find(id);
+    if (it == _sessions.end()) return;
+    _loop.unwatch(it->second->fd);
+    ::close(it->second->fd);
+    _sessions.erase(it);
+    // Chunks it already queued still reach the device, which cancels the upload on its own timeout
+    if (_upload_owner == id) _upload_owner = 0;
+}
+
+} // namespace host
@@ -0,0 +1,133 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#pragma once
+
+#include "Client.h"
+#include "EventLoop.h"
+
+#include "FrameParser.h"
+#include "ProtocolConstants.h"
+
+#include <bitset>
+#include <chrono>
+#include <cinttypes>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Shares one device between several programs: the daemon owns the serial link and
+/// listens on a Unix socket. A connection speaks the device protocol itself, same frames and
+/// checksums, so a tool that talks to the port talks to the socket the same way:
+///
+/// - Requests go to the device through one `Client`, pipelined with those of the other
+///   connections, and every reply comes back to the connection that sent the request, in
+///   the order it sent them.
+/// - `DOWNLOAD_IMAGE_START` is downloaded by the daemon, which acknowledges the device's
+///   chunks, then streamed to the connection as `DOWNLOAD_IMAGE_DATA` and `DOWNLOAD_IMAGE_END`.
+///   The connection's `ACK`s are accepted and ignored.
+/// - One connection uploads at a time; `UPLOAD_IMAGE_START` or `OTA_BEGIN` from another gets
+///   `TRANSFER_IN_PROGRESS` until the upload ends, so chunks are never interleaved.
+/// - Frames that answer no request (`SLIDER_VALUE`, `LOG_EVENT`, ...) go to the connections
+///   that subscribed to them, see `SUBSCRIBE`. `CONFIG_APPLIED` and `BENCHMARK_DATA` also go
+///   to the connection that started the job, `TRANSFER_TIMEOUT` to the one that uploads.
+/// - A request the daemon cannot deliver, because the device is away or did not reply, is
+///   answered with `ERROR_CMD` `BUSY`. `CHANGE_BAUDRATE` is refused with `INVALID_COMMAND`,
+///   the link is shared.
+///
+/// The device is reopened when it goes away, and connections stay open meanwhile, so
+/// clients do not resync after a replug.
+namespace host {
+
+class Daemon {
+public:
+    /// @brief Commands of the socket only, never sent to the device. Both reply `ACK`.
+    ///
+    ///     SUBSCRIBE    [command:uint8]...  Receive these events, replacing earlier ones; all if empty
+    ///     UNSUBSCRIBE                      Stop receiving events
+    static constexpr Command SUBSCRIBE = static_cast<Command>(0xF0);
+    static constexpr Command UNSUBSCRIBE = static_cast<Command>(0xF1);
+
+    struct Options {
+        std::string device;                           // Serial port or simulator pty
+        uint32_t baudrate = 115200;
+        std::string socket_path;                      // See `default_socket_path()`
+        std::chrono::milliseconds reconnect_interval{ 1000 };
+        size_t max_backlog = 1 << 20;                 // Unsent bytes before a connection is dropped
+    };
+
+    /// @brief `$XDG_RUNTIME_DIR/slidr.sock`, or `/tmp/slidr-<uid>.sock`
+    static std::string default_socket_path();
+
+    /// @param client Not opened yet, the daemon opens it and takes over its handlers
+    Daemon(EventLoop& loop, Client& client, Options options);
+    /// @brief Calls `stop()`
+    ~Daemon();
+
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    /// @brief Listen on the socket and connect to the device, retrying until it shows up.
+    /// The loop must be running.
+    /// @return `false` with `error` set if the socket cannot be created, or another daemon
+    /// already listens on it
+    bool start(std::string& error);
+    /// @brief Close every connection, the socket and the device
+    void stop();
+
+private:
+    struct Session {
+        uint64_t id = 0;
+        int fd = -1;
+        FrameParser<4096> parser;
+        std::vector<uint8_t> tx;
+        size_t tx_offset = 0;
+        bool waiting_writable = false;
+        bool closing = false;                         // Dropped, closed from a posted task
+
+        // Replies are written in request order: each request takes a slot, replies that
+        // arrive before those of earlier slots wait in `finished`
+        uint64_t next_slot = 0;
+        uint64_t next_to_send = 0;
+        std::map<uint64_t, std::vector<uint8_t>> finished;
+
+        std::bitset<256> events;
+    };
+
+    void run_on_loop(std::function<void()> task);
+    void accept_all();
+    void on_session_event(uint64_t id, uint32_t events);
+    void on_request(Session& session, const Frame& frame);
+    /// @brief Forward to the device, the reply fills `slot`
+    void forward(Session& session, uint64_t slot, const Frame& frame);
+    void download(Session& session, uint64_t slot, uint8_t segment);
+    /// @brief Queue the encoded reply of `slot`, and send what is now in order
+    void finish(uint64_t session_id, uint64_t slot, std::vector<uint8_t> frames);
+    void reply_error(Session& session, uint64_t slot, ErrorCode error);
+    void send(Session& session, const std::vector<uint8_t>& bytes);
+    void flush(Session& session);
+    void close_session(uint64_t id);
+
+    void on_event(const Frame& frame);
+    void on_device_lost();
+    void connect_device();
+
+    EventLoop& _loop;
+    Client& _client;
+    Options _options;
+    int _listen_fd = -1;
+    bool _started = false;
+    EventLoop::TimerId _reconnect_timer = 0;
+
+    std::unordered_map<uint64_t, std::unique_ptr<Session>> _sessions;
+    uint64_t _next_session = 1;
+    uint64_t _upload_owner = 0;                       // Session that uploads, 0 if none
+    std::unordered_map<uint16_t, uint64_t> _jobs;     // Job ID -> session that started it
+};
+
+} // namespace host
+
+#endif
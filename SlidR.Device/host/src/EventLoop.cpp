@@ -0,0 +1,159 @@
+#include "EventLoop.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace host {
+
+namespace {
+
+constexpr int MAX_EVENTS = 32;
+
+} // namespace
+
+EventLoop::EventLoop() {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epoll_fd < 0 || _wake_fd < 0) {
+        perror("event loop");
+        return;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = _wake_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &event);
+}
+
+EventLoop::~EventLoop() {
+    stop();
+    if (_wake_fd >= 0) close(_wake_fd);
+    if (_epoll_fd >= 0) close(_epoll_fd);
+}
+
+void EventLoop::start() {
+    _running = true;
+    _thread = std::thread([this] { loop(); });
+}
+
+void EventLoop::run() {
+    _running = true;
+    loop();
+}
+
+void EventLoop::loop() {
+    _loop_thread = std::this_thread::get_id();
+    epoll_event events[MAX_EVENTS];
+    while (_running) {
+        int count = epoll_wait(_epoll_fd, events, MAX_EVENTS, next_timeout_ms());
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == _wake_fd) {
+                uint64_t value;
+                while (read(_wake_fd, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            auto it = _handlers.find(fd);
+            if (it == _handlers.end()) continue;
+            std::shared_ptr<Handler> handler = it->second;
+            (*handler)(events[i].events);
+        }
+        run_timers();
+        run_posted();
+    }
+    _loop_thread = std::thread::id();
+}
+
+void EventLoop::stop() {
+    _running = false;
+    uint64_t one = 1;
+    if (write(_wake_fd, &one, sizeof(one)) < 0) {}
+    if (_thread.joinable()) _thread.join();
+}
+
+void EventLoop::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(_posted_mutex);
+        _posted.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    if (write(_wake_fd, &one, sizeof(one)) < 0) {}
+}
+
+bool EventLoop::watch(int fd, uint32_t events, Handler handler) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) return false;
+    _handlers[fd] = std::make_shared<Handler>(std::move(handler));
+    return true;
+}
+
+void EventLoop::modify(int fd, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void EventLoop::unwatch(int fd) {
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    _handlers.erase(fd);
+}
+
+EventLoop::TimerId EventLoop::call_after(Clock::duration delay, Task task) {
+    TimerId id = _next_timer++;
+    Clock::time_point deadline = Clock::now() + delay;
+    _timers.emplace(std::make_pair(deadline, id), std::move(task));
+    _timer_deadlines.emplace(id, deadline);
+    return id;
+}
+
+void EventLoop::cancel(TimerId id) {
+    auto it = _timer_deadlines.find(id);
+    if (it == _timer_deadlines.end()) return;
+    _timers.erase(std::make_pair(it->second, id));
+    _timer_deadlines.erase(it);
+}
+
+int EventLoop::next_timeout_ms() const {
+    {
+        std::lock_guard<std::mutex> lock(_posted_mutex);
+        if (!_posted.empty()) return 0;
+    }
+    if (_timers.empty()) return -1;
+    auto remaining = _timers.begin()->first.first - Clock::now();
+    if (remaining <= Clock::duration::zero()) return 0;
+    // Round up, waking early would only spin
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+}
+
+void EventLoop::run_timers() {
+    Clock::time_point now = Clock::now();
+    while (!_timers.empty() && _timers.begin()->first.first <= now) {
+        auto it = _timers.begin();
+        Task task = std::move(it->second);
+        _timer_deadlines.erase(it->first.second);
+        _timers.erase(it);
+        task();
+    }
+}
+
+void EventLoop::run_posted() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(_posted_mutex);
+        tasks.swap(_posted);
+    }
+    for (Task& task : tasks) {
+        task();
+    }
+}
+
+} // namespace host
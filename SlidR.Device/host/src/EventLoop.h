@@ -0,0 +1,85 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace host {
+
+/// @brief Single-threaded epoll reactor: file descriptor readiness, timers and tasks posted
+/// from other threads. Everything but `post()`, `start()` and `stop()` must be called on the
+/// loop thread, handlers run there and must not block.
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    /// @brief Called with the ready `EPOLL*` events of the watched descriptor
+    using Handler = std::function<void(uint32_t events)>;
+    using Task = std::function<void()>;
+    using TimerId = uint64_t;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /// @brief Run the loop on a new thread
+    void start();
+    /// @brief Run the loop on this thread until `stop()`
+    void run();
+    /// @brief Make `run()` return and join the thread of `start()`. Not from the loop thread.
+    void stop();
+
+    bool in_loop_thread() const {
+        return std::this_thread::get_id() == _loop_thread;
+    }
+
+    /// @brief Run `task` on the loop thread. Thread safe.
+    void post(Task task);
+
+    /// @return `false` if epoll refused the descriptor
+    bool watch(int fd, uint32_t events, Handler handler);
+    void modify(int fd, uint32_t events);
+    void unwatch(int fd);
+
+    TimerId call_after(Clock::duration delay, Task task);
+    /// @brief Cancel a timer that has not fired yet, 0 is ignored
+    void cancel(TimerId id);
+
+private:
+    void loop();
+    /// @return Milliseconds until the next timer, -1 if there is none
+    int next_timeout_ms() const;
+    void run_timers();
+    void run_posted();
+
+    int _epoll_fd = -1;
+    int _wake_fd = -1;
+    std::atomic<bool> _running{ false };
+    std::thread _thread;
+    std::thread::id _loop_thread;
+
+    mutable std::mutex _posted_mutex;
+    std::vector<Task> _posted;
+
+    // Shared so a handler can unwatch its own descriptor while it runs
+    std::unordered_map<int, std::shared_ptr<Handler>> _handlers;
+    std::map<std::pair<Clock::time_point, TimerId>, Task> _timers;
+    std::unordered_map<TimerId, Clock::time_point> _timer_deadlines;
+    TimerId _next_timer = 1;
+};
+
+} // namespace host
+
+#endif
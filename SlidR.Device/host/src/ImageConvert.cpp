@@ -0,0 +1,310 @@
+#include "ImageConvert.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+
+#ifdef SLIDR_IMAGE_PNG
+#include <png.h>
+#endif
+#ifdef SLIDR_IMAGE_JPEG
+#include <jpeglib.h>
+#endif
+
+namespace image {
+
+namespace {
+
+constexpr double LANCZOS_SUPPORT = 3.0;
+
+bool starts_with(const std::vector<uint8_t>& data, const char* magic, size_t size) {
+    return data.size() >= size && memcmp(data.data(), magic, size) == 0;
+}
+
+bool decode_ppm(const std::vector<uint8_t>& data, Image& out, std::string& error) {
+    // "P6" then width, height and maxval as text separated by whitespace or comments,
+    // one whitespace byte and the binary pixels
+    size_t offset = 2;
+    unsigned long values[3];
+    for (unsigned long& value : values) {
+        while (offset < data.size()) {
+            if (data[offset] == '#') {
+                while (offset < data.size() && data[offset] != '\n') offset++;
+            } else if (isspace(data[offset])) {
+                offset++;
+            } else {
+                break;
+            }
+        }
+        if (offset >= data.size() || !isdigit(data[offset])) {
+            error = "truncated PPM header";
+            return false;
+        }
+        value = 0;
+        while (offset < data.size() && isdigit(data[offset])) {
+            value = value * 10 + (data[offset++] - '0');
+            if (value > 0xFFFF) break;
+        }
+    }
+    offset++;
+    unsigned long width = values[0], height = values[1], maxval = values[2];
+    if (width == 0 || height == 0 || width > 0xFFFF || height > 0xFFFF || maxval == 0 || maxval > 255) {
+        error = "unsupported PPM size or depth";
+        return false;
+    }
+    size_t size = width * height * 3;
+    if (offset > data.size() || data.size() - offset < size) {
+        error = "truncated PPM pixels";
+        return false;
+    }
+    out.width = static_cast<uint16_t>(width);
+    out.height = static_cast<uint16_t>(height);
+    out.rgb.assign(data.begin() + offset, data.begin() + offset + size);
+    if (maxval != 255) {
+        for (uint8_t& value : out.rgb) {
+            value = static_cast<uint8_t>(std::min<unsigned long>(value, maxval) * 255 / maxval);
+        }
+    }
+    return true;
+}
+
+#ifdef SLIDR_IMAGE_PNG
+bool decode_png(const std::vector<uint8_t>& data, Image& out, std::string& error) {
+    png_image png{};
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&png, data.data(), data.size())) {
+        error = png.message;
+        return false;
+    }
+    if (png.width > 0xFFFF || png.height > 0xFFFF) {
+        png_image_free(&png);
+        error = "PNG too large";
+        return false;
+    }
+    // Transparent pixels are composited on black, the panel's background
+    png.format = PNG_FORMAT_RGB;
+    png_color black{ 0, 0, 0 };
+    out.width = static_cast<uint16_t>(png.width);
+    out.height = static_cast<uint16_t>(png.height);
+    out.rgb.resize(PNG_IMAGE_SIZE(png));
+    if (!png_image_finish_read(&png, &black, out.rgb.data(), 0, nullptr)) {
+        error = png.message;
+        return false;
+    }
+    return true;
+}
+#endif
+
+#ifdef SLIDR_IMAGE_JPEG
+struct JpegError {
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+void jpeg_error_exit(j_common_ptr info) {
+    auto* error = reinterpret_cast<JpegError*>(info->err);
+    info->err->format_message(info, error->message);
+    longjmp(error->jump, 1);
+}
+
+bool decode_jpeg(const std::vector<uint8_t>& data, Image& out, std::string& error) {
+    jpeg_decompress_struct info{};
+    JpegError jpeg_error{};
+    info.err = jpeg_std_error(&jpeg_error.manager);
+    jpeg_error.manager.error_exit = jpeg_error_exit;
+    if (setjmp(jpeg_error.jump)) {
+        jpeg_destroy_decompress(&info);
+        error = jpeg_error.message;
+        return false;
+    }
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, data.data(), data.size());
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&info);
+    if (info.output_width > 0xFFFF || info.output_height > 0xFFFF) {
+        jpeg_destroy_decompress(&info);
+        error = "JPEG too large";
+        return false;
+    }
+    out.width = static_cast<uint16_t>(info.output_width);
+    out.height = static_cast<uint16_t>(info.output_height);
+    out.rgb.resize(static_cast<size_t>(out.width) * out.height * 3);
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW row = out.rgb.data() + static_cast<size_t>(info.output_scanline) * out.width * 3;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return true;
+}
+#endif
+
+double lanczos(double x) {
+    if (x == 0.0) return 1.0;
+    if (x <= -LANCZOS_SUPPORT || x >= LANCZOS_SUPPORT) return 0.0;
+    double pi_x = M_PI * x;
+    return LANCZOS_SUPPORT * sin(pi_x) * sin(pi_x / LANCZOS_SUPPORT) / (pi_x * pi_x);
+}
+
+/// @brief Source range and normalised weights of every output position along one axis
+struct Coefficients {
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> count;
+    std::vector<float> weights; // `stride` per output position
+    size_t stride = 0;
+
+    Coefficients(uint32_t in_size, uint32_t out_size) {
+        double scale = static_cast<double>(in_size) / out_size;
+        double filter_scale = std::max(scale, 1.0);
+        double support = LANCZOS_SUPPORT * filter_scale;
+        stride = static_cast<size_t>(ceil(support)) * 2 + 1;
+        first.resize(out_size);
+        count.resize(out_size);
+        weights.assign(out_size * stride, 0.0f);
+        for (uint32_t i = 0; i < out_size; i++) {
+            double center = (i + 0.5) * scale;
+            int64_t begin = std::max<int64_t>(0, static_cast<int64_t>(center - support + 0.5));
+            int64_t end = std::min<int64_t>(in_size, static_cast<int64_t>(center + support + 0.5));
+            size_t n = std::min<size_t>(end - begin, stride);
+            double total = 0.0;
+            std::vector<double> w(n);
+            for (size_t k = 0; k < n; k++) {
+                w[k] = lanczos((begin + k - center + 0.5) / filter_scale);
+                total += w[k];
+            }
+            for (size_t k = 0; k < n; k++) {
+                weights[i * stride + k] = static_cast<float>(total != 0.0 ? w[k] / total : 0.0);
+            }
+            first[i] = static_cast<uint32_t>(begin);
+            count[i] = static_cast<uint32_t>(n);
+        }
+    }
+};
+
+uint8_t clamp_round(float value) {
+    return static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value + 0.5f)));
+}
+
+uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+bool decode(const std::vector<uint8_t>& data, Image& out, std::string& error) {
+    if (starts_with(data, "\x89PNG", 4)) {
+#ifdef SLIDR_IMAGE_PNG
+        return decode_png(data, out, error);
+#else
+        error = "built without PNG support";
+        return false;
+#endif
+    }
+    if (starts_with(data, "\xFF\xD8", 2)) {
+#ifdef SLIDR_IMAGE_JPEG
+        return decode_jpeg(data, out, error);
+#else
+        error = "built without JPEG support";
+        return false;
+#endif
+    }
+    if (starts_with(data, "P6", 2)) {
+        return decode_ppm(data, out, error);
+    }
+    error = "unknown image format";
+    return false;
+}
+
+Image resize(const Image& in, uint16_t width, uint16_t height) {
+    if (in.width == width && in.height == height) return in;
+
+    // Horizontal pass into floats, then vertical into bytes, each with its own kernel width
+    Coefficients horizontal(in.width, width);
+    std::vector<float> rows(static_cast<size_t>(in.height) * width * 3);
+    for (uint32_t y = 0; y < in.height; y++) {
+        const uint8_t* src = in.rgb.data() + static_cast<size_t>(y) * in.width * 3;
+        float* dst = rows.data() + static_cast<size_t>(y) * width * 3;
+        for (uint32_t x = 0; x < width; x++) {
+            const float* w = horizontal.weights.data() + x * horizontal.stride;
+            const uint8_t* p = src + horizontal.first[x] * 3;
+            float r = 0, g = 0, b = 0;
+            for (uint32_t k = 0; k < horizontal.count[x]; k++) {
+                r += w[k] * p[k * 3];
+                g += w[k] * p[k * 3 + 1];
+                b += w[k] * p[k * 3 + 2];
+            }
+            dst[x * 3] = r;
+            dst[x * 3 + 1] = g;
+            dst[x * 3 + 2] = b;
+        }
+    }
+
+    Coefficients vertical(in.height, height);
+    Image out;
+    out.width = width;
+    out.height = height;
+    out.rgb.resize(static_cast<size_t>(width) * height * 3);
+    std::vector<float> sum(static_cast<size_t>(width) * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        std::fill(sum.begin(), sum.end(), 0.0f);
+        const float* w = vertical.weights.data() + y * vertical.stride;
+        for (uint32_t k = 0; k < vertical.count[y]; k++) {
+            const float* src = rows.data() + static_cast<size_t>(vertical.first[y] + k) * width * 3;
+            for (size_t i = 0; i < sum.size(); i++) {
+                sum[i] += w[k] * src[i];
+            }
+        }
+        uint8_t* dst = out.rgb.data() + static_cast<size_t>(y) * width * 3;
+        for (size_t i = 0; i < sum.size(); i++) {
+            dst[i] = clamp_round(sum[i]);
+        }
+    }
+    return out;
+}
+
+std::vector<uint8_t> encode_segment_file(const Image& image, bool dither, rgb565::Kernel kernel) {
+    std::vector<uint8_t> out(FILE_HEADER_SIZE + static_cast<size_t>(image.width) * image.height * 2);
+    out[0] = image.width & 0xFF;
+    out[1] = image.width >> 8;
+    out[2] = image.height & 0xFF;
+    out[3] = image.height >> 8;
+    for (uint16_t y = 0; y < image.height; y++) {
+        rgb565::pack_row(image.rgb.data() + static_cast<size_t>(y) * image.width * 3,
+                         out.data() + FILE_HEADER_SIZE + static_cast<size_t>(y) * image.width * 2,
+                         image.width, dither, y, kernel);
+    }
+    return out;
+}
+
+bool convert(const std::vector<uint8_t>& data, const Options& options, std::vector<uint8_t>& out, std::string& error) {
+    Image decoded;
+    if (!decode(data, decoded, error)) return false;
+    if (options.width == 0 || options.height == 0) {
+        error = "empty output size";
+        return false;
+    }
+    out = encode_segment_file(resize(decoded, options.width, options.height), options.dither, options.kernel);
+    return true;
+}
+
+uint64_t cache_key(const std::vector<uint8_t>& data, const Options& options) {
+    uint8_t parameters[] = {
+        static_cast<uint8_t>(CONVERTER_VERSION), static_cast<uint8_t>(CONVERTER_VERSION >> 8),
+        static_cast<uint8_t>(options.width), static_cast<uint8_t>(options.width >> 8),
+        static_cast<uint8_t>(options.height), static_cast<uint8_t>(options.height >> 8),
+        options.dither
+    };
+    uint64_t hash = fnv1a(0xCBF29CE484222325ull, parameters, sizeof(parameters));
+    return fnv1a(hash, data.data(), data.size());
+}
+
+} // namespace image
@@ -0,0 +1,59 @@
+#ifndef IMAGE_CONVERT_H
+#define IMAGE_CONVERT_H
+
+#pragma once
+
+#include "Rgb565.h"
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+/// @brief Turns PNG, JPEG or binary PPM images into segment image files:
+///
+///     [width:uint16][height:uint16] then width × height big-endian RGB565 pixels, row by row
+///
+/// which is what `Segment::load_and_display_image` streams to the panel. PNG and JPEG need
+/// libpng and libjpeg at build time, PPM always works.
+///
+/// Conversions are cached by the hash of the input bytes and the options, so re-running a
+/// profile or a fleet over mostly unchanged icons only decodes the new ones.
+namespace image {
+
+struct Image {
+    uint16_t width = 0;
+    uint16_t height = 0;
+    std::vector<uint8_t> rgb; // RGB888, row by row
+};
+
+struct Options {
+    uint16_t width = 128; // Panel size, see `hal::Panel::SIZE`
+    uint16_t height = 128;
+    bool dither = false;
+    rgb565::Kernel kernel = rgb565::best_kernel();
+};
+
+/// @brief Bump when the output of a conversion changes, so cached files are not reused
+constexpr uint32_t CONVERTER_VERSION = 1;
+
+constexpr size_t FILE_HEADER_SIZE = 4;
+
+/// @return `false` with `error` set if the format is unknown or the data corrupt
+bool decode(const std::vector<uint8_t>& data, Image& out, std::string& error);
+
+/// @brief Scale to `width` × `height` with a Lanczos-3 filter widened when shrinking, as PIL's
+/// `Image.resize(..., LANCZOS)` does. The aspect ratio is not kept.
+Image resize(const Image& in, uint16_t width, uint16_t height);
+
+/// @brief Pack as a segment image file, see above
+std::vector<uint8_t> encode_segment_file(const Image& image, bool dither, rgb565::Kernel kernel);
+
+/// @brief Decode, resize and pack
+bool convert(const std::vector<uint8_t>& data, const Options& options, std::vector<uint8_t>& out, std::string& error);
+
+/// @brief Cache key of converting `data` with `options`; the kernel does not affect the output
+uint64_t cache_key(const std::vector<uint8_t>& data, const Options& options);
+
+} // namespace image
+
+#endif
@@ -0,0 +1,210 @@
+#include "Rgb565.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RGB565_X86 1
+#include <immintrin.h>
+#endif
+
+namespace rgb565 {
+
+namespace {
+
+constexpr uint8_t BAYER[4][4] = {
+    { 0, 8, 2, 10 },
+    { 12, 4, 14, 6 },
+    { 3, 11, 1, 9 },
+    { 15, 7, 13, 5 }
+};
+
+/// @brief Thresholds for column `x` of row `y`: below one step of the 5-bit (red, blue)
+/// or 6-bit (green) channel
+uint8_t threshold5(uint16_t y, size_t x) { return BAYER[y & 3][x & 3] >> 1; }
+uint8_t threshold6(uint16_t y, size_t x) { return BAYER[y & 3][x & 3] >> 2; }
+
+uint8_t add_saturated(uint8_t a, uint8_t b) {
+    unsigned sum = a + b;
+    return sum > 255 ? 255 : sum;
+}
+
+void pack_scalar(const uint8_t* rgb, uint8_t* out, size_t begin, size_t count, bool dither, uint16_t y) {
+    for (size_t x = begin; x < count; x++) {
+        uint8_t r = rgb[x * 3];
+        uint8_t g = rgb[x * 3 + 1];
+        uint8_t b = rgb[x * 3 + 2];
+        if (dither) {
+            r = add_saturated(r, threshold5(y, x));
+            g = add_saturated(g, threshold6(y, x));
+            b = add_saturated(b, threshold5(y, x));
+        }
+        out[x * 2] = (r & 0xF8) | (g >> 5);
+        out[x * 2 + 1] = ((g << 3) & 0xE0) | (b >> 3);
+    }
+}
+
+#ifdef RGB565_X86
+
+/// @brief `pshufb` masks gathering channel `channel` of 16 pixels from the 16-byte block
+/// `block` of their 48 bytes; lanes from other blocks are zeroed (0x80)
+using ShuffleMasks = std::array<std::array<std::array<uint8_t, 16>, 3>, 3>;
+
+constexpr ShuffleMasks make_shuffle_masks() {
+    ShuffleMasks masks{};
+    for (size_t channel = 0; channel < 3; channel++) {
+        for (size_t block = 0; block < 3; block++) {
+            for (size_t pixel = 0; pixel < 16; pixel++) {
+                size_t offset = pixel * 3 + channel;
+                masks[channel][block][pixel] = offset / 16 == block ? static_cast<uint8_t>(offset % 16) : 0x80;
+            }
+        }
+    }
+    return masks;
+}
+
+constexpr ShuffleMasks SHUFFLE_MASKS = make_shuffle_masks();
+
+/// @brief 16 thresholds per channel for row `y`, the pattern repeats every 4 columns
+struct RowThresholds {
+    alignas(16) uint8_t t5[16];
+    alignas(16) uint8_t t6[16];
+
+    RowThresholds(bool dither, uint16_t y) {
+        for (size_t x = 0; x < 16; x++) {
+            t5[x] = dither ? threshold5(y, x) : 0;
+            t6[x] = dither ? threshold6(y, x) : 0;
+        }
+    }
+};
+
+__attribute__((target("ssse3")))
+inline __m128i gather(__m128i a0, __m128i a1, __m128i a2, size_t channel) {
+    const auto& masks = SHUFFLE_MASKS[channel];
+    __m128i c = _mm_shuffle_epi8(a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[0].data())));
+    c = _mm_or_si128(c, _mm_shuffle_epi8(a1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[1].data()))));
+    return _mm_or_si128(c, _mm_shuffle_epi8(a2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[2].data()))));
+}
+
+__attribute__((target("ssse3")))
+size_t pack_ssse3(const uint8_t* rgb, uint8_t* out, size_t count, bool dither, uint16_t y) {
+    RowThresholds thresholds(dither, y);
+    const __m128i t5 = _mm_load_si128(reinterpret_cast<const __m128i*>(thresholds.t5));
+    const __m128i t6 = _mm_load_si128(reinterpret_cast<const __m128i*>(thresholds.t6));
+    const __m128i mask_f8 = _mm_set1_epi8(static_cast<char>(0xF8));
+    const __m128i mask_e0 = _mm_set1_epi8(static_cast<char>(0xE0));
+    const __m128i mask_07 = _mm_set1_epi8(0x07);
+    const __m128i mask_1f = _mm_set1_epi8(0x1F);
+
+    size_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        const uint8_t* in = rgb + x * 3;
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16));
+        __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 32));
+        __m128i r = _mm_adds_epu8(gather(a0, a1, a2, 0), t5);
+        __m128i g = _mm_adds_epu8(gather(a0, a1, a2, 1), t6);
+        __m128i b = _mm_adds_epu8(gather(a0, a1, a2, 2), t5);
+
+        // No byte shifts in SSE: shift 16-bit lanes and mask off what crossed between bytes
+        __m128i hi = _mm_or_si128(_mm_and_si128(r, mask_f8), _mm_and_si128(_mm_srli_epi16(g, 5), mask_07));
+        __m128i lo = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(g, 3), mask_e0), _mm_and_si128(_mm_srli_epi16(b, 3), mask_1f));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+inline __m256i gather(__m256i a0, __m256i a1, __m256i a2, size_t channel) {
+    const auto& masks = SHUFFLE_MASKS[channel];
+    __m256i c = _mm256_shuffle_epi8(a0, _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[0].data()))));
+    c = _mm256_or_si256(c, _mm256_shuffle_epi8(a1, _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[1].data())))));
+    return _mm256_or_si256(c, _mm256_shuffle_epi8(a2, _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(masks[2].data())))));
+}
+
+__attribute__((target("avx2")))
+inline __m256i load_lanes(const uint8_t* low, const uint8_t* high) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low))),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(high)), 1);
+}
+
+__attribute__((target("avx2")))
+size_t pack_avx2(const uint8_t* rgb, uint8_t* out, size_t count, bool dither, uint16_t y) {
+    RowThresholds thresholds(dither, y);
+    const __m256i t5 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(thresholds.t5)));
+    const __m256i t6 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(thresholds.t6)));
+    const __m256i mask_f8 = _mm256_set1_epi8(static_cast<char>(0xF8));
+    const __m256i mask_e0 = _mm256_set1_epi8(static_cast<char>(0xE0));
+    const __m256i mask_07 = _mm256_set1_epi8(0x07);
+    const __m256i mask_1f = _mm256_set1_epi8(0x1F);
+
+    size_t x = 0;
+    for (; x + 32 <= count; x += 32) {
+        // Shuffles stay within 128-bit lanes: pixels 0-15 in the low lanes, 16-31 in the high
+        const uint8_t* in = rgb + x * 3;
+        __m256i a0 = load_lanes(in, in + 48);
+        __m256i a1 = load_lanes(in + 16, in + 64);
+        __m256i a2 = load_lanes(in + 32, in + 80);
+        __m256i r = _mm256_adds_epu8(gather(a0, a1, a2, 0), t5);
+        __m256i g = _mm256_adds_epu8(gather(a0, a1, a2, 1), t6);
+        __m256i b = _mm256_adds_epu8(gather(a0, a1, a2, 2), t5);
+
+        __m256i hi = _mm256_or_si256(_mm256_and_si256(r, mask_f8), _mm256_and_si256(_mm256_srli_epi16(g, 5), mask_07));
+        __m256i lo = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(g, 3), mask_e0), _mm256_and_si256(_mm256_srli_epi16(b, 3), mask_1f));
+
+        // Per lane: unpacklo holds pixels 0-7 / 16-23, unpackhi 8-15 / 24-31
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 2), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return x;
+}
+
+#endif
+
+} // namespace
+
+const char* kernel_name(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::SCALAR: return "scalar";
+        case Kernel::SSSE3: return "ssse3";
+        case Kernel::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+bool supported(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::SCALAR: return true;
+#ifdef RGB565_X86
+        case Kernel::SSSE3: return __builtin_cpu_supports("ssse3");
+        case Kernel::AVX2: return __builtin_cpu_supports("avx2");
+#endif
+        default: return false;
+    }
+}
+
+Kernel best_kernel() {
+    static const Kernel best = supported(Kernel::AVX2) ? Kernel::AVX2
+                             : supported(Kernel::SSSE3) ? Kernel::SSSE3
+                             : Kernel::SCALAR;
+    return best;
+}
+
+void pack_row(const uint8_t* rgb, uint8_t* out, size_t count, bool dither, uint16_t y, Kernel kernel) {
+    size_t done = 0;
+#ifdef RGB565_X86
+    // The SSSE3 step also picks up what is left after the AVX2 one, both keep the dither phase
+    if (kernel == Kernel::AVX2) {
+        done = pack_avx2(rgb, out, count, dither, y);
+    }
+    if (kernel == Kernel::AVX2 || kernel == Kernel::SSSE3) {
+        done += pack_ssse3(rgb + done * 3, out + done * 2, count - done, dither, y);
+    }
+#endif
+    pack_scalar(rgb, out, done, count, dither, y);
+}
+
+} // namespace rgb565
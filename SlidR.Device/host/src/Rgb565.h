@@ -0,0 +1,39 @@
+#ifndef RGB565_H
+#define RGB565_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+/// @brief RGB888 to big-endian RGB565 packing, the pixel format the panels are written in
+/// (`ST7735::write_pixels` sends the bytes as they are). Every kernel produces identical output;
+/// the SIMD ones are picked at run time so the binary still runs on older CPUs.
+namespace rgb565 {
+
+enum class Kernel : uint8_t {
+    SCALAR,
+    SSSE3, // 16 pixels per step
+    AVX2   // 32 pixels per step
+};
+
+const char* kernel_name(Kernel kernel);
+
+/// @brief Whether this CPU can run `kernel`
+bool supported(Kernel kernel);
+
+/// @brief Fastest kernel this CPU supports
+Kernel best_kernel();
+
+/// @brief Pack one row of `count` RGB888 pixels into `2 * count` bytes.
+/// @param dither Add a 4×4 ordered (Bayer) dither before truncating, so gradients do not band.
+/// The pattern depends on the row and column, pass the row index as `y` and whole rows.
+void pack_row(const uint8_t* rgb, uint8_t* out, size_t count, bool dither, uint16_t y, Kernel kernel);
+
+inline void pack_row(const uint8_t* rgb, uint8_t* out, size_t count, bool dither, uint16_t y) {
+    pack_row(rgb, out, count, dither, y, best_kernel());
+}
+
+} // namespace rgb565
+
+#endif
@@ -0,0 +1,309 @@
+// Command line front end of the host library, see src/Client.h
+//
+//     slidr --port /tmp/slidr0 ping --count 10
+//     slidr --port /dev/ttyACM0 patch tft_backlight_value=40 seg0.pot_min_value=12
+//     slidr --port /dev/ttyACM0 upload 2 icon.bin
+//     slidr --port /dev/ttyACM0 ota .pio/build/lolin_s2_mini/firmware.bin
+//     slidr --port $XDG_RUNTIME_DIR/slidr.sock events   (through slidrd)
+#include "Client.h"
+#include "Daemon.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr std::chrono::seconds OTA_CONFIRM_TIMEOUT{ 30 };
+
+void usage() {
+    fprintf(stderr,
+        "usage: slidr --port PATH|SOCKET [--baud N] [--window N] [--chunk BYTES] COMMAND\n"
+        "commands:\n"
+        "  ping [--count N]        round trip of N pipelined pings\n"
+        "  status\n"
+        "  config                  print the device config\n"
+        "  patch NAME=VALUE...     change fields, segN.NAME for segment fields\n"
+        "  default-config\n"
+        "  backlight VALUE\n"
+        "  upload SEGMENT FILE     replace the segment's image file\n"
+        "  download SEGMENT FILE\n"
+        "  ota FILE [--uncompressed]\n"
+        "                          update the firmware, then wait for it to boot and confirm it\n"
+        "  events [SECONDS]        print events, until interrupted by default\n");
+}
+
+template <typename T>
+bool report(const char* what, const host::Result<T>& result) {
+    if (result.ok()) return true;
+    fprintf(stderr, "%s failed: %s", what, host::status_name(result.status));
+    if (result.status == host::Status::DEVICE_ERROR) fprintf(stderr, " %s", error_name(result.error));
+    fprintf(stderr, "\n");
+    return false;
+}
+
+bool report_job(const char* what, const host::Result<host::ConfigJob>& result) {
+    if (!report(what, result)) return false;
+    if (result.value.error != ErrorCode::NONE) {
+        fprintf(stderr, "%s job %u failed: %s\n", what, result.value.id, error_name(result.value.error));
+        return false;
+    }
+    printf("job %u applied in %.3f ms\n", result.value.id, result.value.duration_us / 1000.0);
+    return true;
+}
+
+/// @brief One field of a decoded message, as `name=value`; trailing bytes in hex
+template <typename T>
+void print_field(const char* name, const T& field) {
+    if constexpr (std::is_same<T, ByteView>::value) {
+        printf(" %s=", name);
+        for (size_t i = 0; i < field.length; i++) printf("%02x", field.ptr[i]);
+    } else if constexpr (messages::is_optional<T>::value) {
+        if (field.present) print_field(name, field.value);
+    } else if constexpr (std::is_same<T, ErrorCode>::value) {
+        printf(" %s=%s", name, error_name(field));
+    } else {
+        printf(" %s=%u", name, static_cast<unsigned>(field));
+    }
+}
+
+void print_event(const host::Frame& frame) {
+    printf("%s", command_name(frame.command));
+    ByteView payload{ frame.payload.data(), static_cast<uint16_t>(frame.payload.size()) };
+    auto result = messages::dispatch<messages::Direction::TO_HOST>(frame.command, payload, [](const auto& message) {
+        messages::for_each_field(message, [](const char* name, const auto& field) { print_field(name, field); });
+    });
+    if (result != messages::Dispatch::HANDLED) {
+        for (uint8_t byte : frame.payload) printf(" %02x", byte);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+void print_config(const DeviceConfig& config) {
+    config_schema::for_each_field(config_schema::DEVICE_FIELDS, [&](const auto& f) {
+        printf("%s = %lld\n", f.name, static_cast<long long>(config.*(f.member)));
+    });
+    printf("segment_count = %u\n", config.segment_count);
+    for (uint8_t i = 0; i < config.segment_count; i++) {
+        config_schema::for_each_field(config_schema::SEGMENT_FIELDS, [&](const auto& f) {
+            printf("seg%u.%s = %lld\n", i, f.name, static_cast<long long>(config.segments[i].*(f.member)));
+        });
+    }
+}
+
+/// @brief Set the field named by `assignment` (`name=value` or `segN.name=value`) in `config`
+bool parse_assignment(const char* assignment, DeviceConfig& config, config_schema::FieldPath& path) {
+    const char* equals = strchr(assignment, '=');
+    if (!equals) return false;
+    std::string name(assignment, equals);
+    long long value = strtoll(equals + 1, nullptr, 0);
+
+    bool found = false;
+    size_t index = 0;
+    if (name.compare(0, 3, "seg") == 0 && name.find('.') != std::string::npos) {
+        uint8_t segment = static_cast<uint8_t>(strtoul(name.c_str() + 3, nullptr, 10));
+        std::string field = name.substr(name.find('.') + 1);
+        if (segment >= MAX_SEGMENTS) return false;
+        config_schema::for_each_field(config_schema::SEGMENT_FIELDS, [&](const auto& f) {
+            if (!found && field == f.name) {
+                using T = typename std::decay_t<decltype(f)>::value_type;
+                config.segments[segment].*(f.member) = static_cast<T>(value);
+                path = config_schema::FieldPath::of(segment, static_cast<config_schema::SegmentField>(index));
+                found = true;
+            }
+            index++;
+        });
+    } else {
+        config_schema::for_each_field(config_schema::DEVICE_FIELDS, [&](const auto& f) {
+            if (!found && name == f.name) {
+                using T = typename std::decay_t<decltype(f)>::value_type;
+                config.*(f.member) = static_cast<T>(value);
+                path = config_schema::FieldPath::of(static_cast<config_schema::DeviceField>(index));
+                found = true;
+            }
+            index++;
+        });
+    }
+    return found;
+}
+
+int run_ping(host::Client& client, int count) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    std::vector<std::future<host::Result<host::Empty>>> pongs;
+    for (int i = 0; i < count; i++) {
+        pongs.push_back(client.ping());
+    }
+    for (auto& pong : pongs) {
+        if (!report("ping", pong.get())) return 1;
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    printf("%d pongs in %.3f ms, %.3f ms per ping\n", count, elapsed_ms, elapsed_ms / count);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* port = nullptr;
+    uint32_t baudrate = 115200;
+    host::Client::Options options;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        bool has_value = arg + 1 < argc;
+        if (!strcmp(argv[arg], "--port") && has_value) {
+            port = argv[++arg];
+        } else if (!strcmp(argv[arg], "--baud") && has_value) {
+            baudrate = strtoul(argv[++arg], nullptr, 10);
+        } else if (!strcmp(argv[arg], "--window") && has_value) {
+            options.max_in_flight = strtoul(argv[++arg], nullptr, 10);
+        } else if (!strcmp(argv[arg], "--chunk") && has_value) {
+            options.upload_chunk_size = strtoul(argv[++arg], nullptr, 10);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!port || arg >= argc) {
+        usage();
+        return 2;
+    }
+    std::string command = argv[arg++];
+
+    signal(SIGPIPE, SIG_IGN);
+    host::EventLoop loop;
+    loop.start();
+    host::Client client(loop, options);
+    if (!client.open(port, baudrate)) {
+        perror(port);
+        return 1;
+    }
+
+    if (command == "ping") {
+        int count = 1;
+        if (arg + 1 < argc && !strcmp(argv[arg], "--count")) count = atoi(argv[arg + 1]);
+        return run_ping(client, count > 0 ? count : 1);
+    }
+    if (command == "status") {
+        auto result = client.get_status().get();
+        if (!report("status", result)) return 1;
+        printf("awake = %d\nbacklight = %u\nsegment_count = %u\n",
+               result.value.awake, result.value.backlight, result.value.segment_count);
+        return 0;
+    }
+    if (command == "config") {
+        auto result = client.get_config().get();
+        if (!report("config", result)) return 1;
+        print_config(result.value);
+        return 0;
+    }
+    if (command == "patch" && arg < argc) {
+        DeviceConfig config{};
+        std::vector<config_schema::FieldPath> paths;
+        for (; arg < argc; arg++) {
+            config_schema::FieldPath path{};
+            if (!parse_assignment(argv[arg], config, path)) {
+                fprintf(stderr, "unknown field in %s\n", argv[arg]);
+                return 2;
+            }
+            paths.push_back(path);
+        }
+        // The segment fields must be in range of the device's config, not of this empty one
+        config.segment_count = MAX_SEGMENTS;
+        return report_job("patch", client.patch_config(config, paths).get()) ? 0 : 1;
+    }
+    if (command == "default-config") {
+        return report_job("default-config", client.default_config().get()) ? 0 : 1;
+    }
+    if (command == "backlight" && arg < argc) {
+        auto value = static_cast<uint8_t>(strtoul(argv[arg], nullptr, 0));
+        return report("backlight", client.set_backlight(value).get()) ? 0 : 1;
+    }
+    if (command == "upload" && arg + 1 < argc) {
+        auto segment = static_cast<uint8_t>(strtoul(argv[arg], nullptr, 10));
+        std::ifstream file(argv[arg + 1], std::ios::binary);
+        if (!file) {
+            perror(argv[arg + 1]);
+            return 1;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto start = std::chrono::steady_clock::now();
+        if (!report("upload", client.upload_image(segment, std::move(data)).get())) return 1;
+        printf("uploaded in %.3f ms\n",
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        return 0;
+    }
+    if (command == "download" && arg + 1 < argc) {
+        auto segment = static_cast<uint8_t>(strtoul(argv[arg], nullptr, 10));
+        auto result = client.download_image(segment).get();
+        if (!report("download", result)) return 1;
+        std::ofstream file(argv[arg + 1], std::ios::binary);
+        file.write(reinterpret_cast<const char*>(result.value.data()), result.value.size());
+        printf("%zu bytes\n", result.value.size());
+        return file ? 0 : 1;
+    }
+    if (command == "events") {
+        client.set_event_handler(print_event);
+        // The daemon only sends events to connections that ask for them
+        struct stat info;
+        if (stat(port, &info) == 0 && S_ISSOCK(info.st_mode) &&
+            !report("subscribe", client.request(host::Daemon::SUBSCRIBE).get())) {
+            return 1;
+        }
+        if (arg < argc) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(atof(argv[arg])));
+        } else {
+            while (client.is_open()) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return 0;
+    }
+
+    if (command == "ota" && arg < argc) {
+        const char* path = argv[arg];
+        bool compress = !(arg + 1 < argc && !strcmp(argv[arg + 1], "--uncompressed"));
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            perror(path);
+            return 1;
+        }
+        std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        size_t image_size = image.size();
+        auto start = std::chrono::steady_clock::now();
+        auto progress = [](uint32_t received, uint32_t total) {
+            fprintf(stderr, "\r%u / %u bytes", received, total);
+        };
+        auto result = client.update_firmware(std::move(image), compress, progress).get();
+        fprintf(stderr, "\n");
+        if (!report("ota", result)) return 1;
+        printf("%zu byte image written in %.3f ms, restarting\n", image_size,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        // The new firmware is on trial until it answers a PING, see `Controller::MAX_TRIAL_BOOTS`
+        client.close();
+        auto deadline = std::chrono::steady_clock::now() + OTA_CONFIRM_TIMEOUT;
+        while (std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            if (!client.is_open() && !client.open(port, baudrate)) continue;
+            if (client.ping().get().ok()) {
+                printf("new firmware confirmed after %.1f s\n",
+                       std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                return 0;
+            }
+        }
+        fprintf(stderr, "ota: device did not come back, it returns to the previous firmware if not pinged\n");
+        return 1;
+    }
+
+    usage();
+    return 2;
+}
@@ -0,0 +1,391 @@
+// Characterises a device, or the simulator, from the host side: PING round trips, upload and
+// download throughput, slider event timing and config apply time
+//
+//     slidr-bench --port /dev/ttyACM0 --revision $(git describe --always) --json new.json
+//     python benchcompare.py old.json new.json
+//
+// The JSON is Google Benchmark's format, like that of the native benchmarks. Every entry holds
+// a time, so a larger value is a regression for `benchcompare.py`; throughput is in
+// `bytes_per_second` as well.
+#include "Client.h"
+#include "Daemon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    const char* port = nullptr;
+    uint32_t baudrate = 115200;
+    size_t window = 8;
+    int pings = 1000;
+    std::vector<size_t> chunk_sizes{ 256, 512, 1024, 2048, 4092 };
+    int transfers = 3;             // Per chunk size
+    uint8_t segment = 0;           // Its image is replaced during the run and restored after
+    double slider_seconds = 5.0;
+    int config_runs = 5;
+    const char* json_path = nullptr;
+    const char* revision = nullptr;
+    std::string only;              // Comma separated sections, all if empty
+};
+
+/// @brief One line of the table and one entry of the JSON
+struct Measurement {
+    std::string name;
+    double ns = 0;
+    uint64_t iterations = 1;
+    double bytes_per_second = 0;   // 0 if not a transfer
+};
+
+void usage() {
+    fprintf(stderr,
+        "usage: slidr-bench --port PATH|SOCKET [options]\n"
+        "options:\n"
+        "  --baud N\n"
+        "  --window N              requests in flight (default 8)\n"
+        "  --pings N               sequential pings for the round trip (default 1000)\n"
+        "  --chunks LIST           upload chunk sizes (default 256,512,1024,2048,4092)\n"
+        "  --transfers N           uploads per chunk size and downloads (default 3)\n"
+        "  --segment N             segment whose image is used, restored after (default 0)\n"
+        "  --slider-seconds S      listen for SLIDER_VALUE this long (default 5), move a slider\n"
+        "  --config-runs N         SET_CONFIG of the current config (default 5)\n"
+        "  --only LIST             ping, upload, download, slider, config\n"
+        "  --json FILE             write Google Benchmark JSON to FILE, - for stdout\n"
+        "  --revision TEXT         firmware revision recorded in the JSON context\n");
+}
+
+bool wanted(const Options& options, const char* section) {
+    if (options.only.empty()) return true;
+    std::string list = "," + options.only + ",";
+    return list.find(std::string(",") + section + ",") != std::string::npos;
+}
+
+template <typename T>
+bool report(const char* what, const host::Result<T>& result) {
+    if (result.ok()) return true;
+    fprintf(stderr, "%s failed: %s", what, host::status_name(result.status));
+    if (result.status == host::Status::DEVICE_ERROR) fprintf(stderr, " %s", error_name(result.error));
+    fprintf(stderr, "\n");
+    return false;
+}
+
+double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/// @brief Nearest-rank percentile of sorted `values`
+double percentile(const std::vector<double>& values, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    return values[std::min(values.size() - 1, rank ? rank - 1 : 0)];
+}
+
+void add_distribution(std::vector<Measurement>& out, const std::string& name, std::vector<double> ns) {
+    std::sort(ns.begin(), ns.end());
+    double sum = 0;
+    for (double value : ns) sum += value;
+    double mean = sum / ns.size();
+    double squares = 0;
+    for (double value : ns) squares += (value - mean) * (value - mean);
+    uint64_t count = ns.size();
+    out.push_back({ name + "/mean", mean, count });
+    out.push_back({ name + "/p50", percentile(ns, 50), count });
+    out.push_back({ name + "/p90", percentile(ns, 90), count });
+    out.push_back({ name + "/p99", percentile(ns, 99), count });
+    out.push_back({ name + "/max", ns.back(), count });
+    out.push_back({ name + "/stddev", ns.size() > 1 ? std::sqrt(squares / (ns.size() - 1)) : 0, count });
+}
+
+bool bench_ping(host::Client& client, const Options& options, std::vector<Measurement>& out) {
+    // One at a time for the round trip, then a window's worth at once for the rate
+    std::vector<double> rtt;
+    for (int i = 0; i < options.pings; i++) {
+        Clock::time_point start = Clock::now();
+        if (!report("ping", client.ping().get())) return false;
+        rtt.push_back(elapsed_ns(start));
+    }
+    add_distribution(out, "ping_rtt", rtt);
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::future<host::Result<host::Empty>>> pongs;
+    for (int i = 0; i < options.pings; i++) pongs.push_back(client.ping());
+    for (auto& pong : pongs) {
+        if (!report("ping", pong.get())) return false;
+    }
+    out.push_back({ "ping_pipelined/per_ping", elapsed_ns(start) / options.pings, static_cast<uint64_t>(options.pings) });
+    return true;
+}
+
+/// @brief A valid 128×128 segment image of random pixels, so the device can display it
+std::vector<uint8_t> test_image() {
+    std::vector<uint8_t> data{ 128, 0, 128, 0 };
+    std::mt19937 random(1);
+    for (size_t i = 0; i < 128 * 128 * 2; i++) data.push_back(static_cast<uint8_t>(random()));
+    return data;
+}
+
+bool bench_upload(host::Client& client, const Options& options, std::vector<Measurement>& out) {
+    std::vector<uint8_t> data = test_image();
+    for (size_t chunk : options.chunk_sizes) {
+        std::vector<double> ns;
+        for (int i = 0; i < options.transfers; i++) {
+            Clock::time_point start = Clock::now();
+            if (!report("upload", client.upload_image(options.segment, data, chunk).get())) return false;
+            ns.push_back(elapsed_ns(start));
+        }
+        std::sort(ns.begin(), ns.end());
+        double median = ns[ns.size() / 2];
+        out.push_back({ "upload/chunk:" + std::to_string(chunk), median, ns.size(), data.size() / median * 1e9 });
+    }
+    return true;
+}
+
+bool bench_download(host::Client& client, const Options& options, std::vector<Measurement>& out) {
+    // The device picks the chunk size, see `Communication::TRANSFER_SEND_MAX_CHUNK_SIZE`
+    std::vector<double> ns;
+    size_t size = 0;
+    for (int i = 0; i < options.transfers; i++) {
+        Clock::time_point start = Clock::now();
+        auto result = client.download_image(options.segment).get();
+        if (!report("download", result)) return false;
+        ns.push_back(elapsed_ns(start));
+        size = result.value.size();
+    }
+    std::sort(ns.begin(), ns.end());
+    double median = ns[ns.size() / 2];
+    out.push_back({ "download", median, ns.size(), size / median * 1e9 });
+    return true;
+}
+
+bool bench_slider(host::Client& client, const Options& options, std::vector<Measurement>& out) {
+    std::mutex mutex;
+    std::vector<Clock::time_point> arrivals;
+    client.set_event_handler([&](const host::Frame& frame) {
+        if (frame.command != Command::SLIDER_VALUE) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        arrivals.push_back(Clock::now());
+    });
+    struct stat info;
+    if (stat(options.port, &info) == 0 && S_ISSOCK(info.st_mode) &&
+        !report("subscribe", client.request(host::Daemon::SUBSCRIBE, { static_cast<uint8_t>(Command::SLIDER_VALUE) }).get())) {
+        return false;
+    }
+    fprintf(stderr, "listening for slider events for %.1f s, move a slider\n", options.slider_seconds);
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.slider_seconds));
+    client.set_event_handler(nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (arrivals.size() < 2) {
+        fprintf(stderr, "slider: %zu events, skipped\n", arrivals.size());
+        return true;
+    }
+    std::vector<double> intervals;
+    for (size_t i = 1; i < arrivals.size(); i++) {
+        intervals.push_back(std::chrono::duration<double, std::nano>(arrivals[i] - arrivals[i - 1]).count());
+    }
+    // Rate while moving, from the first to the last event, as the time per event
+    double span = std::chrono::duration<double, std::nano>(arrivals.back() - arrivals.front()).count();
+    out.push_back({ "slider/per_event", span / intervals.size(), intervals.size() });
+    add_distribution(out, "slider_interval", intervals);
+    return true;
+}
+
+bool bench_config(host::Client& client, const Options& options, std::vector<Measurement>& out) {
+    auto current = client.get_config().get();
+    if (!report("config", current)) return false;
+    std::vector<double> round_trip;
+    std::vector<double> apply;
+    for (int i = 0; i < options.config_runs; i++) {
+        Clock::time_point start = Clock::now();
+        auto result = client.set_config(current.value).get();
+        if (!report("set_config", result)) return false;
+        if (result.value.error != ErrorCode::NONE) {
+            fprintf(stderr, "set_config job failed: %s\n", error_name(result.value.error));
+            return false;
+        }
+        round_trip.push_back(elapsed_ns(start));
+        apply.push_back(result.value.duration_us * 1000.0);
+    }
+    add_distribution(out, "set_config_host", round_trip);
+    add_distribution(out, "set_config_apply", apply);
+    return true;
+}
+
+void print_table(const std::vector<Measurement>& results) {
+    printf("%-32s %14s %8s %14s\n", "measurement", "time", "samples", "throughput");
+    for (const Measurement& m : results) {
+        printf("%-32s %11.1f us %8llu", m.name.c_str(), m.ns / 1000.0, static_cast<unsigned long long>(m.iterations));
+        if (m.bytes_per_second > 0) printf(" %8.1f KiB/s", m.bytes_per_second / 1024.0);
+        printf("\n");
+    }
+}
+
+std::string json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+bool write_json(const char* path, const std::vector<Measurement>& results, const Options& options, const char* executable) {
+    FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    char host_name[256] = "";
+    gethostname(host_name, sizeof(host_name) - 1);
+
+    fprintf(out, "{\n  \"context\": {\n");
+    fprintf(out, "    \"date\": %s,\n", json_string(date).c_str());
+    fprintf(out, "    \"host_name\": %s,\n", json_string(host_name).c_str());
+    fprintf(out, "    \"executable\": %s,\n", json_string(executable).c_str());
+    fprintf(out, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(out, "    \"library_build_type\": \"release\",\n");
+    fprintf(out, "    \"port\": %s,\n", json_string(options.port).c_str());
+    fprintf(out, "    \"firmware_revision\": %s\n", json_string(options.revision ? options.revision : "").c_str());
+    fprintf(out, "  },\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Measurement& m = results[i];
+        fprintf(out, "%s    {\n", i ? ",\n" : "");
+        fprintf(out, "      \"name\": %s,\n", json_string(m.name).c_str());
+        fprintf(out, "      \"family_index\": %zu,\n", i);
+        fprintf(out, "      \"per_family_instance_index\": 0,\n");
+        fprintf(out, "      \"run_name\": %s,\n", json_string(m.name).c_str());
+        fprintf(out, "      \"run_type\": \"iteration\",\n");
+        fprintf(out, "      \"repetitions\": 1,\n");
+        fprintf(out, "      \"repetition_index\": 0,\n");
+        fprintf(out, "      \"threads\": 1,\n");
+        fprintf(out, "      \"iterations\": %llu,\n", static_cast<unsigned long long>(m.iterations));
+        // Wall clock, the device's time is what is measured
+        fprintf(out, "      \"real_time\": %.3f,\n", m.ns);
+        fprintf(out, "      \"cpu_time\": %.3f,\n", m.ns);
+        fprintf(out, "      \"time_unit\": \"ns\"");
+        if (m.bytes_per_second > 0) fprintf(out, ",\n      \"bytes_per_second\": %.1f", m.bytes_per_second);
+        fprintf(out, "\n    }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    bool ok = !ferror(out);
+    if (out != stdout) ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int arg = 1; arg < argc; arg++) {
+        bool has_value = arg + 1 < argc;
+        if (!strcmp(argv[arg], "--port") && has_value) {
+            options.port = argv[++arg];
+        } else if (!strcmp(argv[arg], "--baud") && has_value) {
+            options.baudrate = strtoul(argv[++arg], nullptr, 10);
+        } else if (!strcmp(argv[arg], "--window") && has_value) {
+            options.window = std::max(1ul, strtoul(argv[++arg], nullptr, 10));
+        } else if (!strcmp(argv[arg], "--pings") && has_value) {
+            options.pings = std::max(1, atoi(argv[++arg]));
+        } else if (!strcmp(argv[arg], "--chunks") && has_value) {
+            options.chunk_sizes.clear();
+            for (char* item = strtok(argv[++arg], ","); item; item = strtok(nullptr, ",")) {
+                size_t size = strtoul(item, nullptr, 10);
+                if (size == 0 || size > 4092) {
+                    fprintf(stderr, "chunk sizes are 1 to 4092 bytes\n");
+                    return 2;
+                }
+                options.chunk_sizes.push_back(size);
+            }
+        } else if (!strcmp(argv[arg], "--transfers") && has_value) {
+            options.transfers = std::max(1, atoi(argv[++arg]));
+        } else if (!strcmp(argv[arg], "--segment") && has_value) {
+            options.segment = static_cast<uint8_t>(strtoul(argv[++arg], nullptr, 10));
+        } else if (!strcmp(argv[arg], "--slider-seconds") && has_value) {
+            options.slider_seconds = atof(argv[++arg]);
+        } else if (!strcmp(argv[arg], "--config-runs") && has_value) {
+            options.config_runs = std::max(1, atoi(argv[++arg]));
+        } else if (!strcmp(argv[arg], "--only") && has_value) {
+            options.only = argv[++arg];
+        } else if (!strcmp(argv[arg], "--json") && has_value) {
+            options.json_path = argv[++arg];
+        } else if (!strcmp(argv[arg], "--revision") && has_value) {
+            options.revision = argv[++arg];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!options.port) {
+        usage();
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    host::EventLoop loop;
+    loop.start();
+    std::vector<Measurement> results;
+    bool ok = true;
+    {
+        host::Client::Options client_options;
+        client_options.max_in_flight = options.window;
+        host::Client client(loop, client_options);
+        if (!client.open(options.port, options.baudrate)) {
+            perror(options.port);
+            return 1;
+        }
+
+        if (ok && wanted(options, "ping")) ok = bench_ping(client, options, results);
+
+        bool transfers = wanted(options, "upload") || wanted(options, "download");
+        std::vector<uint8_t> original;
+        bool had_original = false;
+        if (ok && transfers) {
+            // Keep the segment's image to put it back, a missing one is not an error
+            auto saved = client.download_image(options.segment).get();
+            had_original = saved.ok();
+            original = std::move(saved.value);
+        }
+        if (ok && wanted(options, "upload")) ok = bench_upload(client, options, results);
+        if (ok && wanted(options, "download")) {
+            if (!wanted(options, "upload")) ok = report("upload", client.upload_image(options.segment, test_image()).get());
+            if (ok) ok = bench_download(client, options, results);
+        }
+        if (transfers && had_original && !report("restoring the image", client.upload_image(options.segment, original).get())) {
+            ok = false;
+        }
+
+        if (ok && wanted(options, "slider")) ok = bench_slider(client, options, results);
+        if (ok && wanted(options, "config")) ok = bench_config(client, options, results);
+    }
+    loop.stop();
+
+    print_table(results);
+    if (options.json_path && !write_json(options.json_path, results, options, argv[0])) ok = false;
+    return ok ? 0 : 1;
+}
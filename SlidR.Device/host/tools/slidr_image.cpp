@@ -0,0 +1,289 @@
+// Converts images to segment image files, see src/ImageConvert.h
+//
+//     slidr-image -o icon.bin icon.png
+//     slidr-image --dither --jobs 8 --out-dir profile/ icons/*.png
+//     slidr-image --bench
+#include "ImageConvert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void usage() {
+    fprintf(stderr,
+        "usage: slidr-image [options] (-o FILE INPUT | --out-dir DIR INPUT...)\n"
+        "       slidr-image --bench\n"
+        "options:\n"
+        "  --size WxH          output size (default 128x128, the panel)\n"
+        "  --dither            4x4 ordered dither before packing to RGB565\n"
+        "  --kernel NAME       scalar, ssse3 or avx2 (default: fastest supported)\n"
+        "  --jobs N            convert N files at once (default: one per CPU)\n"
+        "  --cache DIR         reuse earlier conversions (default ~/.cache/slidr/images)\n"
+        "  --no-cache\n");
+}
+
+bool read_file(const std::string& path, std::vector<uint8_t>& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+/// @brief Write through a temporary file, so readers never see half a file
+bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    std::string temp = path + ".tmp" + std::to_string(getpid()) + "-" +
+                       std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream file(temp, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            unlink(temp.c_str());
+            return false;
+        }
+    }
+    return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+std::string default_cache_dir() {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return std::string(xdg) + "/slidr/images";
+    const char* home = getenv("HOME");
+    return home ? std::string(home) + "/.cache/slidr/images" : std::string();
+}
+
+bool make_dirs(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (slash == std::string::npos) return true;
+    }
+}
+
+std::string output_name(const std::string& input) {
+    size_t slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return (dot == std::string::npos || dot == 0 ? name : name.substr(0, dot)) + ".bin";
+}
+
+struct Job {
+    std::string input;
+    std::string output;
+};
+
+enum class Outcome { CONVERTED, CACHED, FAILED };
+
+Outcome run_job(const Job& job, const image::Options& options, const std::string& cache_dir) {
+    std::vector<uint8_t> data;
+    if (!read_file(job.input, data)) {
+        fprintf(stderr, "%s: cannot read\n", job.input.c_str());
+        return Outcome::FAILED;
+    }
+
+    std::string cached;
+    if (!cache_dir.empty()) {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016" PRIx64 ".bin", image::cache_key(data, options));
+        cached = cache_dir + name;
+        std::vector<uint8_t> out;
+        if (read_file(cached, out) && out.size() == image::FILE_HEADER_SIZE + 2u * options.width * options.height) {
+            if (write_file(job.output, out)) return Outcome::CACHED;
+            fprintf(stderr, "%s: cannot write\n", job.output.c_str());
+            return Outcome::FAILED;
+        }
+    }
+
+    std::vector<uint8_t> out;
+    std::string error;
+    if (!image::convert(data, options, out, error)) {
+        fprintf(stderr, "%s: %s\n", job.input.c_str(), error.c_str());
+        return Outcome::FAILED;
+    }
+    if (!write_file(job.output, out)) {
+        fprintf(stderr, "%s: cannot write\n", job.output.c_str());
+        return Outcome::FAILED;
+    }
+    if (!cached.empty() && !write_file(cached, out)) {
+        fprintf(stderr, "%s: cannot write to the cache\n", cached.c_str());
+    }
+    return Outcome::CONVERTED;
+}
+
+/// @brief Pack random rows with every supported kernel, check they agree and print the rate
+int run_bench() {
+    constexpr uint16_t WIDTH = 1024;
+    constexpr uint16_t HEIGHT = 1024;
+    image::Image source;
+    source.width = WIDTH;
+    source.height = HEIGHT;
+    source.rgb.resize(WIDTH * HEIGHT * 3);
+    std::mt19937 random(1);
+    for (uint8_t& value : source.rgb) value = static_cast<uint8_t>(random());
+
+    int status = 0;
+    for (bool dither : { false, true }) {
+        std::vector<uint8_t> reference = image::encode_segment_file(source, dither, rgb565::Kernel::SCALAR);
+        double scalar_mpix = 0;
+        for (rgb565::Kernel kernel : { rgb565::Kernel::SCALAR, rgb565::Kernel::SSSE3, rgb565::Kernel::AVX2 }) {
+            if (!rgb565::supported(kernel)) continue;
+            std::vector<uint8_t> out = image::encode_segment_file(source, dither, kernel);
+            if (out != reference) {
+                fprintf(stderr, "%s output differs from scalar\n", rgb565::kernel_name(kernel));
+                status = 1;
+            }
+            int iterations = 0;
+            Clock::time_point start = Clock::now();
+            double elapsed;
+            do {
+                out = image::encode_segment_file(source, dither, kernel);
+                iterations++;
+                elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            } while (elapsed < 0.5);
+            double mpix = iterations * (WIDTH * HEIGHT / 1e6) / elapsed;
+            if (kernel == rgb565::Kernel::SCALAR) scalar_mpix = mpix;
+            printf("pack %-7s dither %d  %8.1f Mpixel/s  %5.2fx\n", rgb565::kernel_name(kernel), dither, mpix, mpix / scalar_mpix);
+        }
+    }
+
+    image::Image photo = image::resize(source, 512, 512);
+    Clock::time_point start = Clock::now();
+    int iterations = 0;
+    double elapsed;
+    do {
+        image::encode_segment_file(image::resize(photo, 128, 128), false, rgb565::best_kernel());
+        iterations++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < 0.5);
+    printf("512x512 -> 128x128 resize and pack  %8.3f ms\n", elapsed * 1000 / iterations);
+    return status;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    image::Options options;
+    std::string output;
+    std::string out_dir;
+    std::string cache_dir = default_cache_dir();
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> inputs;
+
+    for (int arg = 1; arg < argc; arg++) {
+        bool has_value = arg + 1 < argc;
+        if (!strcmp(argv[arg], "--bench")) {
+            return run_bench();
+        } else if (!strcmp(argv[arg], "-o") && has_value) {
+            output = argv[++arg];
+        } else if (!strcmp(argv[arg], "--out-dir") && has_value) {
+            out_dir = argv[++arg];
+        } else if (!strcmp(argv[arg], "--size") && has_value) {
+            unsigned width, height;
+            if (sscanf(argv[++arg], "%ux%u", &width, &height) != 2 || !width || !height || width > 0xFFFF || height > 0xFFFF) {
+                usage();
+                return 2;
+            }
+            options.width = static_cast<uint16_t>(width);
+            options.height = static_cast<uint16_t>(height);
+        } else if (!strcmp(argv[arg], "--dither")) {
+            options.dither = true;
+        } else if (!strcmp(argv[arg], "--kernel") && has_value) {
+            const char* name = argv[++arg];
+            bool found = false;
+            for (rgb565::Kernel kernel : { rgb565::Kernel::SCALAR, rgb565::Kernel::SSSE3, rgb565::Kernel::AVX2 }) {
+                if (!strcmp(name, rgb565::kernel_name(kernel))) {
+                    if (!rgb565::supported(kernel)) {
+                        fprintf(stderr, "this CPU has no %s\n", name);
+                        return 2;
+                    }
+                    options.kernel = kernel;
+                    found = true;
+                }
+            }
+            if (!found) {
+                usage();
+                return 2;
+            }
+        } else if (!strcmp(argv[arg], "--jobs") && has_value) {
+            jobs = std::max(1, atoi(argv[++arg]));
+        } else if (!strcmp(argv[arg], "--cache") && has_value) {
+            cache_dir = argv[++arg];
+        } else if (!strcmp(argv[arg], "--no-cache")) {
+            cache_dir.clear();
+        } else if (argv[arg][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            inputs.push_back(argv[arg]);
+        }
+    }
+    if (inputs.empty() || output.empty() == out_dir.empty() || (!output.empty() && inputs.size() != 1)) {
+        usage();
+        return 2;
+    }
+    if (!out_dir.empty() && !make_dirs(out_dir)) {
+        perror(out_dir.c_str());
+        return 1;
+    }
+    if (!cache_dir.empty() && !make_dirs(cache_dir)) {
+        fprintf(stderr, "%s: cannot create, not caching\n", cache_dir.c_str());
+        cache_dir.clear();
+    }
+
+    std::vector<Job> work;
+    std::map<std::string, std::string> outputs;
+    for (const std::string& input : inputs) {
+        Job job{ input, output.empty() ? out_dir + "/" + output_name(input) : output };
+        auto [it, added] = outputs.emplace(job.output, input);
+        if (!added) {
+            fprintf(stderr, "%s and %s would both write %s\n", it->second.c_str(), input.c_str(), job.output.c_str());
+            return 2;
+        }
+        work.push_back(job);
+    }
+
+    // Files are independent: each worker takes the next one until none are left
+    Clock::time_point start = Clock::now();
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> converted{ 0 }, cached{ 0 }, failed{ 0 };
+    auto worker = [&] {
+        for (size_t i; (i = next++) < work.size();) {
+            switch (run_job(work[i], options, cache_dir)) {
+                case Outcome::CONVERTED: converted++; break;
+                case Outcome::CACHED: cached++; break;
+                case Outcome::FAILED: failed++; break;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::min<size_t>(jobs, work.size()); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    fprintf(stderr, "%zu converted, %zu cached, %zu failed in %.1f ms (%s)\n",
+            converted.load(), cached.load(), failed.load(), elapsed_ms, rgb565::kernel_name(options.kernel));
+    return failed ? 1 : 0;
+}
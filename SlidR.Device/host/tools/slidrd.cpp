@@ -0,0 +1,265 @@
+// Daemon that shares one device between programs over a Unix socket, see src/Daemon.h
+//
+//     slidrd --port /dev/ttyACM0
+//     slidr --port $XDG_RUNTIME_DIR/slidr.sock events
+//     slidrd --bench
+#include "Daemon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void usage() {
+    fprintf(stderr,
+        "usage: slidrd --port PATH [--baud N] [--socket PATH] [--window N]\n"
+        "       slidrd --bench [--events N] [--clients N]\n"
+        "  --socket PATH   default %s\n"
+        "  --bench         latency of slider events through the daemon, against a pty it drives\n",
+        host::Daemon::default_socket_path().c_str());
+}
+
+bool read_exactly(int fd, uint8_t* data, size_t size) {
+    while (size) {
+        ssize_t count = ::read(fd, data, size);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        data += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool write_all(int fd, const std::vector<uint8_t>& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t count = ::write(fd, data.data() + offset, data.size() - offset);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        offset += count;
+    }
+    return true;
+}
+
+int connect_socket(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), std::min(path.size() + 1, sizeof(address.sun_path) - 1));
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+void print_latency(const char* what, const std::vector<double>& us) {
+    printf("%-16s p50 %7.1f us  p99 %7.1f us  max %7.1f us\n",
+           what, percentile(us, 0.5), percentile(us, 0.99), percentile(us, 1.0));
+}
+
+/// @brief Time `SLIDER_VALUE` frames written to a pty until they are read: straight from its
+/// other end, then from `clients` subscribers of a daemon that owns it. The difference is
+/// what the daemon adds. Fails if that is a millisecond or more at the 99th percentile.
+int run_bench(int events, int clients) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("pty");
+        return 1;
+    }
+    std::string device = ptsname(master);
+    termios tio{};
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    auto frame = [](int i) {
+        std::vector<uint8_t> out;
+        host::Frame event = host::Frame::of(messages::SliderValue{ static_cast<uint8_t>(i % 5), static_cast<uint8_t>(i) });
+        host::encode_frame(out, event.command, event.payload.data(), event.payload.size());
+        return out;
+    };
+    const size_t frame_size = frame(0).size();
+    // Paced like a slider being moved, not back to back
+    const auto spacing = std::chrono::microseconds(500);
+
+    std::vector<double> direct;
+    {
+        int slave = open(device.c_str(), O_RDWR | O_NOCTTY);
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+        std::vector<uint8_t> buffer(frame_size);
+        for (int i = 0; i < events; i++) {
+            Clock::time_point start = Clock::now();
+            if (!write_all(master, frame(i)) || !read_exactly(slave, buffer.data(), buffer.size())) {
+                perror("pty");
+                return 1;
+            }
+            direct.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            std::this_thread::sleep_for(spacing);
+        }
+        close(slave);
+    }
+
+    char directory[] = "/tmp/slidrd-bench-XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    host::EventLoop loop;
+    loop.start();
+    std::vector<double> through;
+    int status = 0;
+    {
+        host::Client client(loop);
+        host::Daemon::Options options;
+        options.device = device;
+        options.socket_path = std::string(directory) + "/slidr.sock";
+        host::Daemon daemon(loop, client, options);
+        std::string error;
+        if (!daemon.start(error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            loop.stop();
+            return 1;
+        }
+
+        std::vector<int> subscribers;
+        for (int c = 0; c < clients; c++) {
+            int fd = connect_socket(options.socket_path);
+            std::vector<uint8_t> subscribe;
+            uint8_t command = static_cast<uint8_t>(Command::SLIDER_VALUE);
+            host::encode_frame(subscribe, host::Daemon::SUBSCRIBE, &command, 1);
+            uint8_t ack[5];
+            if (fd < 0 || !write_all(fd, subscribe) || !read_exactly(fd, ack, sizeof(ack)) ||
+                ack[1] != static_cast<uint8_t>(Command::ACK)) {
+                fprintf(stderr, "subscribe failed\n");
+                status = 1;
+                break;
+            }
+            subscribers.push_back(fd);
+        }
+
+        std::vector<uint8_t> buffer(frame_size);
+        for (int i = 0; status == 0 && i < events; i++) {
+            Clock::time_point start = Clock::now();
+            if (!write_all(master, frame(i))) {
+                status = 1;
+                break;
+            }
+            // The last subscriber to get it is the latency of the event
+            for (int fd : subscribers) {
+                if (!read_exactly(fd, buffer.data(), buffer.size()) || buffer != frame(i)) {
+                    fprintf(stderr, "event %d lost or corrupt\n", i);
+                    status = 1;
+                    break;
+                }
+            }
+            through.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            std::this_thread::sleep_for(spacing);
+        }
+        for (int fd : subscribers) close(fd);
+        daemon.stop();
+    }
+    loop.stop();
+    rmdir(directory);
+    close(master);
+    if (status != 0) return status;
+
+    char label[32];
+    snprintf(label, sizeof(label), "daemon, %d subs", clients);
+    print_latency("pty", direct);
+    print_latency(label, through);
+    double overhead = percentile(through, 0.99) - percentile(direct, 0.99);
+    printf("daemon overhead  p50 %7.1f us  p99 %7.1f us  over %d events\n",
+           percentile(through, 0.5) - percentile(direct, 0.5), overhead, events);
+    return overhead < 1000.0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    host::Daemon::Options options;
+    host::Client::Options client_options;
+    bool bench = false;
+    int events = 2000;
+    int clients = 4;
+
+    for (int arg = 1; arg < argc; arg++) {
+        bool has_value = arg + 1 < argc;
+        if (!strcmp(argv[arg], "--port") && has_value) {
+            options.device = argv[++arg];
+        } else if (!strcmp(argv[arg], "--baud") && has_value) {
+            options.baudrate = static_cast<uint32_t>(atoi(argv[++arg]));
+        } else if (!strcmp(argv[arg], "--socket") && has_value) {
+            options.socket_path = argv[++arg];
+        } else if (!strcmp(argv[arg], "--window") && has_value) {
+            client_options.max_in_flight = static_cast<size_t>(atoi(argv[++arg]));
+        } else if (!strcmp(argv[arg], "--bench")) {
+            bench = true;
+        } else if (!strcmp(argv[arg], "--events") && has_value) {
+            events = std::max(1, atoi(argv[++arg]));
+        } else if (!strcmp(argv[arg], "--clients") && has_value) {
+            clients = std::max(1, atoi(argv[++arg]));
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    // A connection that goes away mid-write must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+    if (bench) return run_bench(events, clients);
+    if (options.device.empty()) {
+        usage();
+        return 2;
+    }
+
+    // Signals are taken by `sigwait()` below, not by the loop thread
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    host::EventLoop loop;
+    loop.start();
+    int status = 0;
+    {
+        host::Client client(loop, client_options);
+        host::Daemon daemon(loop, client, options);
+        std::string error;
+        if (daemon.start(error)) {
+            fprintf(stderr, "slidrd: listening on %s\n",
+                    options.socket_path.empty() ? host::Daemon::default_socket_path().c_str() : options.socket_path.c_str());
+            int signal_number;
+            sigwait(&signals, &signal_number);
+            daemon.stop();
+        } else {
+            fprintf(stderr, "slidrd: %s\n", error.c_str());
+            status = 1;
+        }
+    }
+    loop.stop();
+    return status;
+}
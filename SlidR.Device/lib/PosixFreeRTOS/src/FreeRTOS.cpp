@@ -0,0 +1,205 @@
+#include "FreeRTOS.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+struct tskTaskControlBlock {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notify_value = 0;
+};
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    size_t length;
+    size_t item_size;
+    size_t head = 0; // Oldest item
+    size_t count = 0;
+    std::vector<uint8_t> items;
+
+    QueueDefinition(size_t length, size_t item_size)
+        : length(length), item_size(item_size), items(length * item_size) {}
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point start_time = Clock::now();
+thread_local TaskHandle_t current_task = nullptr;
+tskTaskControlBlock idle_task;
+
+/// @brief Wait on `condition` until `done()` or `ticks` milliseconds pass
+template <typename Predicate>
+bool wait_for(std::condition_variable& condition, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate done) {
+    if (ticks == portMAX_DELAY) {
+        condition.wait(lock, done);
+        return true;
+    }
+    return condition.wait_for(lock, std::chrono::milliseconds(ticks), done);
+}
+
+} // namespace
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* param,
+                       UBaseType_t priority, TaskHandle_t* created) {
+    // Tasks live as long as the process, like the firmware's
+    auto* task = new tskTaskControlBlock();
+    std::thread thread([task, function, param]() {
+        current_task = task;
+        function(param);
+    });
+#ifdef __linux__
+    char thread_name[16];
+    strncpy(thread_name, name, sizeof(thread_name) - 1);
+    thread_name[sizeof(thread_name) - 1] = '\0';
+    pthread_setname_np(thread.native_handle(), thread_name);
+#endif
+    thread.detach();
+
+    if (created) *created = task;
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (!current_task) {
+        current_task = new tskTaskControlBlock();
+    }
+    return current_task;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandle() {
+    return &idle_task;
+}
+
+BaseType_t xTaskGetSchedulerState() {
+    return taskSCHEDULER_RUNNING;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 0;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == portMAX_DELAY) {
+        while (true) std::this_thread::sleep_for(std::chrono::hours(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time).count();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notify_value++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    wait_for(task->notified, lock, ticks_to_wait, [task]() { return task->notify_value > 0; });
+
+    uint32_t value = task->notify_value;
+    if (value > 0) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return new QueueDefinition(length, item_size);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    {
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        if (!wait_for(queue->not_full, lock, ticks_to_wait, [queue]() { return queue->count < queue->length; })) {
+            return pdFALSE;
+        }
+        size_t slot = (queue->head + queue->count) % queue->length;
+        if (queue->item_size) {
+            memcpy(&queue->items[slot * queue->item_size], item, queue->item_size);
+        }
+        queue->count++;
+    }
+    queue->not_empty.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    {
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        if (!wait_for(queue->not_empty, lock, ticks_to_wait, [queue]() { return queue->count > 0; })) {
+            return pdFALSE;
+        }
+        if (queue->item_size) {
+            memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+        }
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+    }
+    queue->not_full.notify_one();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->length - queue->count;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    xQueueSend(mutex, nullptr, 0);
+    return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    return xQueueReceive(semaphore, nullptr, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return xQueueSend(semaphore, nullptr, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    vQueueDelete(semaphore);
+}
+
+void portENTER_CRITICAL(portMUX_TYPE* mux) {
+    while (mux->locked.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE* mux) {
+    mux->locked.store(false, std::memory_order_release);
+}
@@ -0,0 +1,88 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+
+/// @brief The part of the FreeRTOS API the firmware uses, implemented on POSIX threads so the
+/// firmware logic runs on a host (PlatformIO env `native`).
+///
+/// Tasks are detached threads, queues and semaphores are mutex/condition-variable queues and one
+/// tick is one millisecond. Priorities are ignored and stack sizes only reported back, so this
+/// checks logic and ordering, not scheduling or stack use.
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+typedef void (*TaskFunction_t)(void*);
+
+struct tskTaskControlBlock;
+typedef tskTaskControlBlock* TaskHandle_t;
+struct QueueDefinition;
+typedef QueueDefinition* QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS ((TickType_t)1)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#define configUSE_TRACE_FACILITY 0
+#define configGENERATE_RUN_TIME_STATS 0
+
+#define taskSCHEDULER_NOT_STARTED ((BaseType_t)1)
+#define taskSCHEDULER_RUNNING ((BaseType_t)2)
+
+// Placement attributes of the ESP32 port
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+// Tasks
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* param,
+                       UBaseType_t priority, TaskHandle_t* created);
+/// @brief Threads not created by `xTaskCreate()`, such as `main()`, get a handle on first use
+TaskHandle_t xTaskGetCurrentTaskHandle();
+/// @brief A handle no thread runs as; there is no idle task
+TaskHandle_t xTaskGetIdleTaskHandle();
+BaseType_t xTaskGetSchedulerState();
+/// @brief Always `0`, host stacks are not measured
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+// Direct-to-task notifications, as a counting semaphore per task
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+
+// Queues
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+// Semaphores, queues of zero-size items as in FreeRTOS. Mutexes have no priority inheritance.
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+/// @brief Critical sections of the ESP32 port, a spinlock here. Not recursive.
+struct portMUX_TYPE {
+    std::atomic<bool> locked{ false };
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+void portENTER_CRITICAL(portMUX_TYPE* mux);
+void portEXIT_CRITICAL(portMUX_TYPE* mux);
+
+#endif
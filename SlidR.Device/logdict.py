@@ -0,0 +1,74 @@
+"""Log message dictionary for LOG_EVENT packets.
+
+Reads the SLIDR_LOG_MESSAGES table in src/LogMessages.h and decodes event payloads.
+Run directly to write the dictionary as JSON:
+
+    python logdict.py [-o log_dictionary.json]
+"""
+from pathlib import Path
+import argparse
+import json
+import re
+import struct
+
+HEADER_PATH = Path(__file__).parent / "src" / "LogMessages.h"
+LEVELS = ["DEBUG", "INFO", "WARN", "ERROR"]
+
+_ENTRY = re.compile(r'X\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+_CONVERSION = re.compile(r"%([-+ #0]*[0-9.]*)(hh|h)?([diuxXocs%])")
+
+
+def load_messages(path: Path = HEADER_PATH) -> list[dict]:
+    """Message table in ID order: [{"id", "name", "level", "format"}]"""
+    text = Path(path).read_text()
+    return [
+        {"id": i, "name": name, "level": level, "format": fmt.encode().decode("unicode_escape")}
+        for i, (name, level, fmt) in enumerate(_ENTRY.findall(text))
+    ]
+
+
+def load_dictionary(path: Path) -> list[dict]:
+    """Messages from a JSON dictionary written by this script"""
+    return json.loads(Path(path).read_text())["messages"]
+
+
+def decode_event(payload: bytes, messages: list[dict]) -> tuple[str, str, int]:
+    """Decode a LOG_EVENT payload into (level, text, suppressed count)"""
+    msg_id, suppressed = struct.unpack_from("<HH", payload, 0)
+    if msg_id >= len(messages):
+        return "?", f"Unknown log message {msg_id}: {payload[4:].hex()}", suppressed
+
+    message = messages[msg_id]
+    offset = 4
+    args = []
+    for flags, length, conversion in _CONVERSION.findall(message["format"]):
+        if conversion == "%":
+            continue
+        if conversion == "s":
+            size = payload[offset]
+            args.append(payload[offset + 1:offset + 1 + size].decode("utf-8", errors="replace"))
+            offset += 1 + size
+            continue
+        width = {"hh": 1, "h": 2}.get(length, 4)
+        signed = conversion in "di"
+        args.append(int.from_bytes(payload[offset:offset + width], "little", signed=signed))
+        offset += width
+
+    text = _CONVERSION.sub(lambda m: "%" + m.group(1) + m.group(3), message["format"]) % tuple(args)
+    return message["level"], text, suppressed
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Generate the LOG_EVENT dictionary")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    dictionary = json.dumps({"levels": LEVELS, "messages": load_messages()}, indent=2)
+    if args.output:
+        Path(args.output).write_text(dictionary + "\n")
+    else:
+        print(dictionary)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,43 +1,175 @@
 from tkinter import Tk, ttk, Text, Label, Button, OptionMenu, StringVar, Checkbutton, BooleanVar, NORMAL, DISABLED
 from tkinter import filedialog as fd
 from typing import Callable
-from enum import IntEnum
 from PIL import Image
+import os
 import serial
+import struct
 import threading
 import time
-
-class Command(IntEnum):
-    PING = 0x01
-    PONG = 0x02
-    SET_CONFIG = 0x03
-    GET_CONFIG = 0x04
-    CONFIG_DATA = 0x05
-    DEFAULT_CONFIG = 0x06
-    UPLOAD_IMAGE_START = 0x07
-    UPLOAD_IMAGE_DATA = 0x08
-    UPLOAD_IMAGE_END = 0x09
-    DOWNLOAD_IMAGE_START = 0x0A
-    DOWNLOAD_IMAGE_DATA = 0x0B
-    DOWNLOAD_IMAGE_END = 0x0C
-    ACK = 0x0D
-    SLIDER_VALUE = 0x0E
-    SET_BACKLIGHT = 0x0F
-    ERROR_CMD = 0x10
-    GET_STATUS = 0x11
-    STATUS_DATA = 0x12
-    LOG_MESSAGE = 0x13
-
-class ErrorCode(IntEnum):
-    NONE = 0x00
-    INVALID_COMMAND = 0x01
-    INVALID_DATA = 0x02
-    CHECKSUM_ERROR = 0x03
-    FILE_ERROR = 0x04
-    INVALID_CONFIG = 0x05
-    BUFFER_OVERFLOW = 0x06
-    TRANSFER_IN_PROGRESS = 0x07
-    TRANSFER_TIMEOUT = 0x08
+import logdict
+import protodef
+from protodef import Command, ErrorCode
+from capture import CaptureWriter, RecordingPort
+
+# The field tables of src/ConfigSchema.h (struct format per field, wire order)
+CONFIG_VERSION = protodef.CONFIG_SCHEMA["version"]
+CONFIG_DEVICE_FIELDS = [(f["name"], f["format"]) for f in protodef.CONFIG_SCHEMA["device_fields"]]
+CONFIG_SEGMENT_FIELDS = [(f["name"], f["format"]) for f in protodef.CONFIG_SCHEMA["segment_fields"]]
+
+# Mirrors TASKS in src/Rtos.h, in TaskId order
+TASK_NAMES = [
+    "Comm Task",
+    "Segment Task",
+    "Watchdog Task",
+    "Config Job Task",
+    "Config Writer Task",
+    "Send Image Task",
+    "Transfer Watchdog Task",
+]
+
+# Order of stats::Counter in src/Stats.h
+STAT_NAMES = [
+    "packets_rx",
+    "packets_tx",
+    "bytes_rx",
+    "bytes_tx",
+    "checksum_errors",
+    "packet_timeouts",
+    "packet_overflows",
+    "errors_sent",
+    "download_ack_timeouts",
+    "transfer_timeouts",
+    "uploads",
+    "downloads",
+    "last_upload_ms",
+    "last_download_ms",
+    "slider_events",
+    "images_drawn",
+    "display_mutex_timeouts",
+    "config_jobs",
+    "config_job_errors",
+    "config_jobs_rejected",
+    "wakeups",
+    "sleeps",
+    "log_events_suppressed",
+    "firmware_updates",
+    "last_firmware_update_ms",
+]
+
+def decode_stats(data: bytes) -> dict:
+    uptime_ms, count = struct.unpack_from("<IB", data, 0)
+    offset = 5
+    counters = {}
+    for i in range(count):
+        name = STAT_NAMES[i] if i < len(STAT_NAMES) else f"counter_{i}"
+        counters[name], = struct.unpack_from("<I", data, offset)
+        offset += 4
+    heap_free, heap_min_free, runtime_total, runtime_idle, task_count = struct.unpack_from("<IIIIB", data, offset)
+    offset += 17
+    runtime_tasks = list(struct.unpack_from(f"<{task_count}I", data, offset))
+    return {
+        "uptime_ms": uptime_ms,
+        "counters": counters,
+        "heap_free": heap_free,
+        "heap_min_free": heap_min_free,
+        "runtime_total": runtime_total,
+        "runtime_idle": runtime_idle,
+        "runtime_tasks": runtime_tasks,
+    }
+
+def decode_latency(data: bytes) -> dict:
+    """Per-command histograms from LATENCY_DATA. Bucket 0 is < 1 us, bucket i is [2^(i-1), 2^i) us."""
+    bucket_count, command_count = data[0], data[1]
+    offset = 2
+    histograms = {}
+    for _ in range(command_count):
+        command, count, total_us, max_us = struct.unpack_from("<BIQI", data, offset)
+        offset += 17
+        buckets = list(struct.unpack_from(f"<{bucket_count}I", data, offset))
+        offset += 4 * bucket_count
+        histograms[command] = {"count": count, "total_us": total_us, "max_us": max_us, "buckets": buckets}
+    return histograms
+
+def latency_percentile(buckets: list[int], fraction: float) -> int:
+    """Upper bound in us of the bucket holding the given fraction of samples"""
+    target = fraction * sum(buckets)
+    seen = 0
+    for i, count in enumerate(buckets):
+        seen += count
+        if count and seen >= target:
+            return 1 << i
+    return 0
+
+# benchmark::Id in src/Benchmark.h: (name, parameter, unit)
+BENCHMARKS = [
+    ("fs_write", "chunk B", "B/s"),
+    ("fs_read", "chunk B", "B/s"),
+    ("blit", "SPI Hz", "us/frame"),
+    ("adc", "pin", "samples/s"),
+    ("rx_parse", "payload B", "B/s"),
+    ("checksum", "block B", "B/s"),
+    ("crc32", "block B", "B/s"),
+]
+
+def decode_benchmark(data: bytes) -> tuple[int, list[tuple[str, int, int]]]:
+    """BENCHMARK_DATA -> (job ID, [(benchmark, param, value)])"""
+    job_id, count = struct.unpack_from("<HB", data, 0)
+    results = []
+    for i in range(count):
+        benchmark, param, value = struct.unpack_from("<BII", data, 3 + i * 9)
+        name = BENCHMARKS[benchmark][0] if benchmark < len(BENCHMARKS) else f"benchmark_{benchmark}"
+        results.append((name, param, value))
+    return job_id, results
+
+def decode_config(data: bytes) -> dict:
+    device_fmt = "<" + "".join(f for _, f in CONFIG_DEVICE_FIELDS)
+    segment_fmt = "<" + "".join(f for _, f in CONFIG_SEGMENT_FIELDS)
+    (version,) = struct.unpack_from("<I", data, 0)
+    if version != CONFIG_VERSION:
+        raise ValueError(f"Unsupported config version {version}")
+    offset = 4
+    config = dict(zip((n for n, _ in CONFIG_DEVICE_FIELDS), struct.unpack_from(device_fmt, data, offset)))
+    offset += struct.calcsize(device_fmt)
+    (count,) = struct.unpack_from("<B", data, offset)
+    offset += 1
+    config["segments"] = []
+    for _ in range(count):
+        values = struct.unpack_from(segment_fmt, data, offset)
+        config["segments"].append(dict(zip((n for n, _ in CONFIG_SEGMENT_FIELDS), values)))
+        offset += struct.calcsize(segment_fmt)
+    if offset != len(data):
+        raise ValueError(f"Config size mismatch: expected {offset}, got {len(data)}")
+    return config
+
+def encode_config(config: dict) -> bytes:
+    device_fmt = "<" + "".join(f for _, f in CONFIG_DEVICE_FIELDS)
+    segment_fmt = "<" + "".join(f for _, f in CONFIG_SEGMENT_FIELDS)
+    out = bytearray(struct.pack("<I", CONFIG_VERSION))
+    out += struct.pack(device_fmt, *(config[n] for n, _ in CONFIG_DEVICE_FIELDS))
+    out += struct.pack("<B", len(config["segments"]))
+    for seg in config["segments"]:
+        out += struct.pack(segment_fmt, *(seg[n] for n, _ in CONFIG_SEGMENT_FIELDS))
+    return bytes(out)
+
+SEGMENT_FIELD_FLAG = protodef.CONFIG_SCHEMA["segment_field_flag"]
+
+def encode_patch(device: dict, segments: dict[int, dict] | None = None) -> bytes:
+    """Build a PATCH_CONFIG payload, e.g. encode_patch({"spi_speed_hz": 4000000}, {2: {"pot_max_value": 4000}})"""
+    device_ids = {name: (i, fmt) for i, (name, fmt) in enumerate(CONFIG_DEVICE_FIELDS)}
+    segment_ids = {name: (i, fmt) for i, (name, fmt) in enumerate(CONFIG_SEGMENT_FIELDS)}
+    entries = bytearray()
+    count = 0
+    for name, value in device.items():
+        field_id, fmt = device_ids[name]
+        entries += struct.pack("<BB" + fmt, field_id, 0, value)
+        count += 1
+    for index, fields in (segments or {}).items():
+        for name, value in fields.items():
+            field_id, fmt = segment_ids[name]
+            entries += struct.pack("<BB" + fmt, field_id | SEGMENT_FIELD_FLAG, index, value)
+            count += 1
+    return bytes([count]) + bytes(entries)
 
 class Packet:
     command: Command
@@ -53,6 +185,10 @@ class Serial:
 
     def __init__(self, port: str, baudrate: int) -> None:
         self.serial = serial.Serial(port=port, baudrate=baudrate, timeout=1)
+        # Replayable with the native build, see capture.py
+        capture_path = os.environ.get("SLIDR_CAPTURE_FILE")
+        if capture_path:
+            self.serial = RecordingPort(self.serial, CaptureWriter(capture_path, merge_us=2000))
         threading.Thread(target=self._read_serial, daemon=True).start()
         threading.Thread(target=self._keep_alive, daemon=True).start()
 
@@ -127,6 +263,7 @@ class App:
     _parser = Parser()
     _additional_packet_receiver: Callable[[Packet], None] | None = None
     _waiting_for_ack: threading.Event | None = None
+    _log_messages = logdict.load_messages()
 
     def __init__(self, root):
         self.raw_in_label = Label(root, text="Raw Input")
@@ -238,46 +375,96 @@ class App:
             out += f"  Length: {packet.length}\n"
 
         if packet.command == Command.CONFIG_DATA:
-            out += f"  Received config (V: {int.from_bytes(packet.data[0:4], byteorder='little')}):\n"
-            out += f"    SPI Clk: {int.from_bytes(packet.data[4].to_bytes(1), signed=True)}\n"
-            out += f"    SPI Dta: {int.from_bytes(packet.data[5].to_bytes(1), signed=True)}\n"
-            out += f"    TFT Dc: {packet.data[6]}\n"
-            out += f"    TFT Bl: {packet.data[7]}\n"
-            out += f"    Backlight: {packet.data[8]}\n"
-            out += f"    SPI Freq: {int.from_bytes(packet.data[9:13], byteorder='little')}\n"
-            out += f"    Baudrate: {int.from_bytes(packet.data[13:17], byteorder='little')}\n"
-            out += f"    Wait for serial: {packet.data[17] != 0}\n"
-            out += f"    Do sleep: {packet.data[18] != 0}\n"
-            out += f"    Segments: {packet.data[19]}\n"
-            pos = 20
-            while pos < packet.length - 1:
-                tft_cs = packet.data[pos]
-                pot = packet.data[pos + 1]
-                min_val = int.from_bytes(packet.data[pos + 2:pos + 4], byteorder='little')
-                max_val = int.from_bytes(packet.data[pos + 4:pos + 6], byteorder='little')
-                out += f"      TFT Cs: {tft_cs}, Pot: {pot}, Min: {min_val}, Max: {max_val}\n"
-                pos += 6
+            try:
+                config = decode_config(packet.data)
+                out += f"  Received config (V: {CONFIG_VERSION}):\n"
+                for name, _ in CONFIG_DEVICE_FIELDS:
+                    out += f"    {name}: {config[name]}\n"
+                out += f"    segments: {len(config['segments'])}\n"
+                for seg in config["segments"]:
+                    out += "      " + ", ".join(f"{k}: {v}" for k, v in seg.items()) + "\n"
+            except (ValueError, struct.error) as e:
+                out += f"  Invalid config: {e}\n"
+
+        elif packet.command == Command.ACK and packet.length == 2:
+            out += f"  Config job: {protodef.decode(Command.ACK, packet.data)['job_id']}\n"
+
+        elif packet.command == Command.CONFIG_APPLIED:
+            applied = protodef.decode(Command.CONFIG_APPLIED, packet.data)
+            out += f"  Config job {applied['job_id']}: {ErrorCode(applied['error']).name} in {applied['duration_us']} us\n"
+
+        elif packet.command == Command.TASK_INFO:
+            for i in range(packet.data[0]):
+                stack_size, free_min = struct.unpack_from("<HH", packet.data, 1 + i * 4)
+                name = TASK_NAMES[i] if i < len(TASK_NAMES) else f"Task {i}"
+                out += f"  {name}: {stack_size - free_min}/{stack_size} B stack used at peak\n"
+
+        elif packet.command == Command.STATS_DATA:
+            stats = decode_stats(packet.data)
+            out += f"  Uptime: {stats['uptime_ms']} ms\n"
+            out += f"  Heap: {stats['heap_free']} B free, {stats['heap_min_free']} B min\n"
+            for name, value in stats["counters"].items():
+                if value:
+                    out += f"  {name}: {value}\n"
+            total = stats["runtime_total"]
+            if total:
+                out += f"  CPU since boot: idle {100 * stats['runtime_idle'] / total:.1f}%\n"
+                for i, runtime in enumerate(stats["runtime_tasks"]):
+                    name = TASK_NAMES[i] if i < len(TASK_NAMES) else f"Task {i}"
+                    out += f"    {name}: {100 * runtime / total:.1f}%\n"
+
+        elif packet.command == Command.LATENCY_DATA:
+            for command, hist in decode_latency(packet.data).items():
+                name = Command(command).name if command in Command._value2member_map_ else f"0x{command:02X}"
+                mean = hist["total_us"] // hist["count"] if hist["count"] else 0
+                p50 = latency_percentile(hist["buckets"], 0.5)
+                p99 = latency_percentile(hist["buckets"], 0.99)
+                out += f"  {name}: n={hist['count']} mean={mean} us p50<{p50} us p99<{p99} us max={hist['max_us']} us\n"
+
+        elif packet.command == Command.PROFILE_DATA:
+            flags, dropped, count = struct.unpack_from("<BIH", packet.data, 0)
+            out += f"  {count} samples{' (last)' if flags & 1 else ''}, {dropped} dropped; use cpuprofile.py to symbolise\n"
+
+        elif packet.command == Command.BENCHMARK_DATA:
+            job_id, results = decode_benchmark(packet.data)
+            out += f"  Benchmark job {job_id}:\n"
+            units = {name: (param, unit) for name, param, unit in BENCHMARKS}
+            for name, param, value in results:
+                param_name, unit = units.get(name, ("param", ""))
+                out += f"    {name} ({param_name} {param}): {value} {unit}\n"
+
+        elif packet.command == Command.TRACE_DATA:
+            flags, overwritten, count = struct.unpack_from("<BIH", packet.data, 0)
+            out += f"  {count} events{' (last)' if flags & 1 else ''}, {overwritten} overwritten; use timeline.py to convert\n"
+
+        elif packet.command == Command.CAPTURE_DATA:
+            out += f"  {len(packet.data) - 1} capture bytes{' (last)' if packet.data[0] & 1 else ''}; use capture.py dump to save\n"
 
         elif packet.command == Command.SLIDER_VALUE:
+            slider = protodef.decode(Command.SLIDER_VALUE, packet.data)
             out += f"  Slider Change:\n"
-            out += f"    Segment [{packet.data[0]}] Value: {int.from_bytes(packet.data[1:3], byteorder='little')}\n"
+            out += f"    Segment [{slider['segment']}] Value: {slider['value']}\n"
 
         elif packet.command == Command.ERROR_CMD:
             error_code = ErrorCode(packet.data[0])
             out += f"  Error Code: {error_code.name} (0x{error_code.value:02X})\n"
 
         elif packet.command == Command.STATUS_DATA:
-            awake = packet.data[0] != 0
-            backlight = packet.data[1]
-            segs = packet.data[2]
-            out += f"  Awake: {awake}\n"
-            out += f"  Backlight: {backlight}\n"
-            out += f"  Segments: {segs}\n"
+            status = protodef.decode(Command.STATUS_DATA, packet.data)
+            out += f"  Awake: {status['awake']}\n"
+            out += f"  Backlight: {status['backlight']}\n"
+            out += f"  Segments: {status['segment_count']}\n"
 
         elif packet.command == Command.LOG_MESSAGE:
             message = packet.data.decode('utf-8', errors='ignore')
             out += f"  Log Message: {message}\n"
 
+        elif packet.command == Command.LOG_EVENT:
+            level, text, suppressed = logdict.decode_event(packet.data, self._log_messages)
+            out += f"  [{level}] {text}\n"
+            if suppressed:
+                out += f"  ({suppressed} earlier messages suppressed)\n"
+
         self.parsed_in.insert("end", out + "\n")
         self.parsed_in.see("end")
         self.parsed_in.configure(state=DISABLED)
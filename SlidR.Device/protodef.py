@@ -0,0 +1,159 @@
+"""Protocol definition for host scripts.
+
+Reads the SLIDR_MESSAGES and SLIDR_ERROR_CODES tables in src/ProtocolMessages.h and the
+config field tables in src/ConfigSchema.h, the same tables the firmware and the C++ host
+library are generated from, and encodes and decodes payloads with them. Run directly to write
+the definition as JSON:
+
+    python protodef.py [-o protocol.json]
+"""
+from enum import IntEnum
+from pathlib import Path
+import argparse
+import json
+import re
+import struct
+
+HEADER_PATH = Path(__file__).parent / "src" / "ProtocolMessages.h"
+CONFIG_SCHEMA_PATH = Path(__file__).parent / "src" / "ConfigSchema.h"
+CONFIG_STRUCTS_PATH = Path(__file__).parent / "src" / "Config.h"
+
+_MESSAGE = re.compile(r"X\(\s*(\w+)\s*,\s*(0x[0-9A-Fa-f]+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,(.*)\)\s*\\?$", re.M)
+_FIELD = re.compile(r"([FOR])\(\s*(\w+)\s*(?:,\s*(\w+)\s*)?\)")
+_ERROR = re.compile(r'X\(\s*(\w+)\s*,\s*(0x[0-9A-Fa-f]+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+_CONFIG_FIELD = re.compile(r'field\(\s*"(\w+)"\s*,\s*&(\w+)::(\w+)\s*(?:,\s*(\d+)\s*)?\)')
+_STRUCT = re.compile(r"struct\s+(\w+)\s*\{(.*?)\};", re.S)
+_MEMBER = re.compile(r"^\s*(\w+)\s+(\w+)\s*;", re.M)
+_FORMATS = {
+    "uint8_t": "B", "int8_t": "b", "uint16_t": "H", "int16_t": "h",
+    "uint32_t": "I", "int32_t": "i", "bool": "?", "ErrorCode": "B",
+}
+
+
+def _table(text: str, name: str) -> str:
+    """Body of the `#define name(...)` macro"""
+    start = text.index(f"#define {name}(")
+    end = text.find("\n\n", start)
+    return text[start:end if end >= 0 else len(text)]
+
+
+def load_messages(path: Path = HEADER_PATH) -> list[dict]:
+    """Message table in ID order: [{"command", "id", "type", "direction", "fields"}],
+    each field {"kind": "fixed" | "optional" | "rest", "name", "type", "format"}"""
+    text = _table(Path(path).read_text(), "SLIDR_MESSAGES")
+    messages = []
+    for command, command_id, type_name, direction, fields in _MESSAGE.findall(text):
+        parsed = []
+        for kind, first, second in _FIELD.findall(fields):
+            if kind == "R":
+                parsed.append({"kind": "rest", "name": first, "type": "bytes", "format": None})
+            else:
+                parsed.append({"kind": "fixed" if kind == "F" else "optional", "name": second,
+                               "type": first, "format": _FORMATS[first]})
+        messages.append({"command": command, "id": int(command_id, 16), "type": type_name,
+                         "direction": direction, "fields": parsed})
+    return messages
+
+
+def load_errors(path: Path = HEADER_PATH) -> list[dict]:
+    """Error codes: [{"name", "value", "description"}]"""
+    text = _table(Path(path).read_text(), "SLIDR_ERROR_CODES")
+    return [{"name": name, "value": int(value, 16), "description": description}
+            for name, value, description in _ERROR.findall(text)]
+
+
+def _constant(text: str, name: str) -> int:
+    return int(re.search(rf"\b{name}\s*=\s*(\w+)\s*;", text).group(1), 0)
+
+
+def load_config_schema(path: Path = CONFIG_SCHEMA_PATH, structs_path: Path = CONFIG_STRUCTS_PATH) -> dict:
+    """Config blob layout: {"version", "min_version", "segment_field_flag", "device_fields",
+    "segment_fields"}, each field {"name", "type", "format", "since"} in wire order"""
+    text = Path(path).read_text()
+    members = {name: dict((member, type_name) for type_name, member in _MEMBER.findall(body))
+               for name, body in _STRUCT.findall(Path(structs_path).read_text())}
+
+    def fields(table: str) -> list[dict]:
+        start = text.index(f"constexpr auto {table} =")
+        body = text[start:text.index(");", start)]
+        parsed = []
+        for name, owner, member, since in _CONFIG_FIELD.findall(body):
+            type_name = members[owner][member]
+            parsed.append({"name": name, "type": type_name, "format": _FORMATS[type_name],
+                           "since": int(since or 1)})
+        return parsed
+
+    return {"version": _constant(text, "CONFIG_VERSION"), "min_version": _constant(text, "MIN_CONFIG_VERSION"),
+            "segment_field_flag": _constant(text, "SEGMENT_FIELD_FLAG"),
+            "device_fields": fields("DEVICE_FIELDS"), "segment_fields": fields("SEGMENT_FIELDS")}
+
+
+MESSAGES = {m["id"]: m for m in load_messages()}
+Command = IntEnum("Command", [(m["command"], m["id"]) for m in MESSAGES.values()])
+ErrorCode = IntEnum("ErrorCode", [(e["name"], e["value"]) for e in load_errors()])
+CONFIG_SCHEMA = load_config_schema()
+
+
+def encode(command: int, **fields) -> bytes:
+    """Payload of `command` from its fields by name. Optional fields are written up to the first
+    one left out, the rest field is bytes."""
+    out = bytearray()
+    more = True
+    for field in MESSAGES[command]["fields"]:
+        value = fields.get(field["name"])
+        if field["kind"] == "rest":
+            out += bytes(value or b"")
+        elif field["kind"] == "optional":
+            more = more and value is not None
+            if more:
+                out += struct.pack("<" + field["format"], value)
+        else:
+            if value is None:
+                raise ValueError(f"{Command(command).name}: missing {field['name']}")
+            out += struct.pack("<" + field["format"], value)
+    return bytes(out)
+
+
+def decode(command: int, payload: bytes) -> dict:
+    """Fields of a `command` payload by name; optional fields left out are missing. Raises
+    ValueError if the size does not match the layout."""
+    message = MESSAGES.get(command)
+    if message is None:
+        raise ValueError(f"Unknown command 0x{command:02X}")
+    out = {}
+    offset = 0
+    for field in message["fields"]:
+        if field["kind"] == "rest":
+            out[field["name"]] = bytes(payload[offset:])
+            offset = len(payload)
+            continue
+        if field["kind"] == "optional" and offset == len(payload):
+            continue
+        size = struct.calcsize("<" + field["format"])
+        if offset + size > len(payload):
+            raise ValueError(f"{message['command']}: payload too short ({len(payload)} bytes)")
+        (value,) = struct.unpack_from("<" + field["format"], payload, offset)
+        if field["type"] == "ErrorCode" and value in ErrorCode._value2member_map_:
+            value = ErrorCode(value)
+        out[field["name"]] = value
+        offset += size
+    if offset != len(payload):
+        raise ValueError(f"{message['command']}: {len(payload) - offset} unexpected bytes")
+    return out
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Generate the protocol definition")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    definition = json.dumps({"messages": load_messages(), "errors": load_errors(),
+                             "config": load_config_schema()}, indent=2)
+    if args.output:
+        Path(args.output).write_text(definition + "\n")
+    else:
+        print(definition)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#include "Benchmark.h"
+#include "Crc32.h"
+#include "FrameParser.h"
+#include "Hal.h"
+
+#include <initializer_list>
+
+namespace benchmark {
+
+namespace {
+
+constexpr const char* FS_PATH = "/benchmark.tmp";
+constexpr size_t SCRATCH_SIZE = 2048;
+constexpr uint32_t ADC_SAMPLES = 1000;
+constexpr uint16_t RX_PAYLOAD_SIZE = 256;
+constexpr uint32_t RX_PACKETS = 64;
+constexpr uint32_t CHECKSUM_ROUNDS = 64;
+
+// Kept off the config job task stack
+uint8_t scratch[SCRATCH_SIZE];
+using Parser = FrameParser<RX_PAYLOAD_SIZE + 4>;
+Parser parser;
+
+void fill_scratch() {
+    for (size_t i = 0; i < SCRATCH_SIZE; i++) {
+        scratch[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+}
+
+} // namespace
+
+void Results::add(Id id, uint32_t param, uint32_t value) {
+    if (_count < CAPACITY) {
+        _entries[_count++] = Entry{ id, param, value };
+    }
+}
+
+size_t Results::serialize(uint8_t* out, size_t capacity) const {
+    if (capacity < 1 + _count * ENTRY_SIZE) return 0;
+
+    size_t size = 0;
+    out[size++] = _count;
+    for (size_t i = 0; i < _count; i++) {
+        const Entry& entry = _entries[i];
+        out[size++] = static_cast<uint8_t>(entry.id);
+        for (uint32_t value : { entry.param, entry.value }) {
+            out[size++] = value & 0xFF;
+            out[size++] = (value >> 8) & 0xFF;
+            out[size++] = (value >> 16) & 0xFF;
+            out[size++] = (value >> 24) & 0xFF;
+        }
+    }
+    return size;
+}
+
+uint32_t rate(uint64_t bytes, uint32_t duration_us) {
+    if (duration_us == 0) return 0;
+    return static_cast<uint32_t>(bytes * 1000000 / duration_us);
+}
+
+void filesystem(Results& results) {
+    fill_scratch();
+    for (uint16_t chunk_size : FS_CHUNK_SIZES) {
+        // Open and close are part of the measurement, as in an upload or image load
+        uint32_t start_us = hal::micros();
+        hal::File file = hal::filesystem().open(FS_PATH, "w");
+        if (!file) break;
+        uint32_t written = 0;
+        while (written < FS_FILE_SIZE) {
+            size_t size = file.write(scratch, chunk_size);
+            if (size != chunk_size) break;
+            written += size;
+        }
+        file.close();
+        results.add(Id::FS_WRITE, chunk_size, rate(written, hal::micros() - start_us));
+
+        start_us = hal::micros();
+        file = hal::filesystem().open(FS_PATH, "r");
+        // Still remove the file the write pass left behind
+        if (!file) break;
+        uint32_t read = 0;
+        while (read < written) {
+            size_t size = file.read(scratch, chunk_size);
+            if (size == 0) break;
+            read += size;
+        }
+        file.close();
+        results.add(Id::FS_READ, chunk_size, rate(read, hal::micros() - start_us));
+    }
+    hal::filesystem().remove(FS_PATH);
+}
+
+void adc(uint8_t pin, Results& results) {
+    uint32_t start_us = hal::micros();
+    for (uint32_t i = 0; i < ADC_SAMPLES; i++) {
+        hal::analog_read(pin);
+    }
+    results.add(Id::ADC, pin, rate(ADC_SAMPLES, hal::micros() - start_us));
+}
+
+void rx_parse(Results& results) {
+    // One complete frame: start byte, command, length, payload, checksum
+    constexpr size_t FRAME_SIZE = 1 + 3 + RX_PAYLOAD_SIZE + 1;
+    static_assert(FRAME_SIZE <= SCRATCH_SIZE, "Frame must fit the scratch buffer");
+    fill_scratch();
+    scratch[0] = START_BYTE;
+    scratch[1] = static_cast<uint8_t>(Command::UPLOAD_IMAGE_DATA);
+    scratch[2] = RX_PAYLOAD_SIZE & 0xFF;
+    scratch[3] = RX_PAYLOAD_SIZE >> 8;
+    scratch[FRAME_SIZE - 1] = Parser::checksum(scratch + 1, FRAME_SIZE - 2);
+
+    parser.reset();
+    uint32_t packets = 0;
+    uint32_t start_us = hal::micros();
+    for (uint32_t round = 0; round < RX_PACKETS; round++) {
+        for (size_t i = 0; i < FRAME_SIZE; i++) {
+            if (parser.push(scratch[i]) == Parser::Result::PACKET) {
+                packets++;
+            }
+        }
+    }
+    uint32_t duration_us = hal::micros() - start_us;
+    results.add(Id::RX_PARSE, RX_PAYLOAD_SIZE, packets == RX_PACKETS ? rate(RX_PACKETS * FRAME_SIZE, duration_us) : 0);
+}
+
+void checksums(Results& results) {
+    fill_scratch();
+
+    // Accumulate the results so the loops cannot be optimized away
+    volatile uint32_t sink = 0;
+    uint32_t start_us = hal::micros();
+    for (uint32_t round = 0; round < CHECKSUM_ROUNDS; round++) {
+        sink = sink + Parser::checksum(scratch, SCRATCH_SIZE);
+    }
+    results.add(Id::CHECKSUM, SCRATCH_SIZE, rate(CHECKSUM_ROUNDS * SCRATCH_SIZE, hal::micros() - start_us));
+
+    start_us = hal::micros();
+    for (uint32_t round = 0; round < CHECKSUM_ROUNDS; round++) {
+        sink = sink + crc32::update(scratch, SCRATCH_SIZE);
+    }
+    results.add(Id::CRC32, SCRATCH_SIZE, rate(CHECKSUM_ROUNDS * SCRATCH_SIZE, hal::micros() - start_us));
+}
+
+} // namespace benchmark
@@ -0,0 +1,71 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+/// @brief Microbenchmarks run by `RUN_BENCHMARK`, so boards, settings and firmware builds can be
+/// compared with numbers from the real hardware. Blits live in `Segment::benchmark_blit()`.
+namespace benchmark {
+
+/// @brief Result kinds in `BENCHMARK_DATA`
+enum class Id : uint8_t {
+    FS_WRITE, // param: chunk size in bytes, value: bytes/s
+    FS_READ,  // param: chunk size in bytes, value: bytes/s
+    BLIT,     // param: SPI clock in Hz, value: us per full panel
+    ADC,      // param: pin, value: samples/s
+    RX_PARSE, // param: payload size in bytes, value: bytes/s
+    CHECKSUM, // param: block size in bytes, value: bytes/s (packet XOR checksum)
+    CRC32     // param: block size in bytes, value: bytes/s (config CRC-32)
+};
+
+/// @brief Groups selected by the `RUN_BENCHMARK` mask
+enum Suite : uint8_t {
+    SUITE_FILESYSTEM = 1 << 0,
+    SUITE_BLIT = 1 << 1,
+    SUITE_ADC = 1 << 2,
+    SUITE_RX_PARSE = 1 << 3,
+    SUITE_CHECKSUM = 1 << 4,
+    SUITE_ALL = 0x1F
+};
+
+constexpr uint32_t BLIT_SPI_HZ[] = { 1000000, 4000000, 10000000, 20000000, 27000000, 40000000 };
+constexpr uint16_t FS_CHUNK_SIZES[] = { 128, 512, 2048 };
+constexpr uint32_t FS_FILE_SIZE = 64 * 1024;
+
+class Results {
+public:
+    static constexpr size_t CAPACITY = 24;
+    static constexpr size_t ENTRY_SIZE = 1 + 4 + 4;
+
+    void add(Id id, uint32_t param, uint32_t value);
+    size_t count() const { return _count; }
+    /// @brief Write `[count:uint8]` then count × `[id:uint8][param:uint32][value:uint32]`
+    /// @return Bytes written
+    size_t serialize(uint8_t* out, size_t capacity) const;
+
+private:
+    struct Entry {
+        Id id;
+        uint32_t param;
+        uint32_t value;
+    };
+    Entry _entries[CAPACITY];
+    size_t _count = 0;
+};
+
+/// @brief Bytes per second for `bytes` processed in `duration_us`
+uint32_t rate(uint64_t bytes, uint32_t duration_us);
+
+/// @brief Sequential write and read of `FS_FILE_SIZE` bytes on LittleFS per chunk size
+void filesystem(Results& results);
+void adc(uint8_t pin, Results& results);
+/// @brief Feed packets through the same parser the comm task uses
+void rx_parse(Results& results);
+void checksums(Results& results);
+
+} // namespace benchmark
+
+#endif
@@ -0,0 +1,48 @@
+#include "BootProfile.h"
+#include "Communication.h"
+#include "Hal.h"
+
+namespace boot_profile {
+
+namespace {
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::COUNT);
+
+uint32_t stage_us[STAGE_COUNT] = {};
+bool stage_failed[STAGE_COUNT] = {};
+
+} // namespace
+
+void mark(Stage stage, bool ok) {
+    size_t index = static_cast<size_t>(stage);
+    if (stage_us[index]) return;
+    uint32_t now = hal::micros();
+    stage_us[index] = now ? now : 1;
+    stage_failed[index] = !ok;
+}
+
+bool reached(Stage stage) {
+    return stage_us[static_cast<size_t>(stage)] != 0;
+}
+
+uint32_t at_us(Stage stage) {
+    return stage_us[static_cast<size_t>(stage)];
+}
+
+void report(Communication& communication, const char* config_backend) {
+    uint16_t failed_mask = 0;
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        if (stage_failed[i]) failed_mask |= 1 << i;
+    }
+
+    auto ms = [](Stage stage) { return at_us(stage) / 1000; };
+    SLIDR_LOG(communication, BOOT_REPORT, config_backend,
+        ms(Stage::SERIAL_STARTED), ms(Stage::PANELS_STARTED), ms(Stage::FS_MOUNTED), ms(Stage::CONFIG_LOADED),
+        ms(Stage::PANELS_READY), ms(Stage::FIRST_PIXEL), ms(Stage::IMAGES_LOADED), ms(Stage::BOOT_DONE),
+        failed_mask);
+    if (reached(Stage::FIRST_PONG)) {
+        SLIDR_LOG(communication, BOOT_FIRST_PONG, ms(Stage::FIRST_PONG));
+    }
+}
+
+} // namespace boot_profile
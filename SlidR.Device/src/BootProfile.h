@@ -0,0 +1,38 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#pragma once
+
+#include <cinttypes>
+
+class Communication;
+
+/// @brief Timestamps of the boot stages, reported once as a single log line.
+namespace boot_profile {
+
+enum class Stage : uint8_t {
+    SERIAL_STARTED,
+    PANELS_STARTED, // First panel init stage sent
+    FS_MOUNTED,
+    CONFIG_LOADED,
+    PANELS_READY,
+    FIRST_PIXEL,
+    IMAGES_LOADED,
+    BOOT_DONE,
+    FIRST_PONG,
+    COUNT
+};
+
+/// @brief Record the time `stage` was reached. Only the first call per stage counts.
+/// @param ok `false` if the stage failed or fell back (e.g. default config)
+void mark(Stage stage, bool ok = true);
+bool reached(Stage stage);
+/// @brief Microseconds since reset when `stage` was reached, 0 if it was not
+uint32_t at_us(Stage stage);
+
+/// @brief Log the time of every stage, 0 for stages that were not reached
+void report(Communication& communication, const char* config_backend);
+
+} // namespace boot_profile
+
+#endif
@@ -0,0 +1,132 @@
+#include "Capture.h"
+
+#ifdef SLIDR_CAPTURE
+
+#include "Communication.h"
+#include "Hal.h"
+#include "Rtos.h"
+
+#include <FreeRTOS.h>
+#include <algorithm>
+
+namespace capture {
+
+namespace {
+
+constexpr size_t BYTES_PER_PACKET = 512;
+
+// Records back to back, wrapping at the end of the buffer
+uint8_t buffer[BUFFER_SIZE];
+size_t head = 0; // Next byte to write
+size_t used = 0; // Bytes of whole records before `head`, oldest first
+uint32_t dropped = 0;
+bool paused = false;
+// Records are copied with the lock held, too long for a critical section
+rtos::Semaphore mutex{ rtos::Semaphore::Kind::MUTEX };
+
+size_t tail() {
+    return (head + BUFFER_SIZE - used) % BUFFER_SIZE;
+}
+
+void put(const uint8_t* data, size_t size) {
+    while (size) {
+        size_t run = std::min(size, BUFFER_SIZE - head);
+        std::copy_n(data, run, buffer + head);
+        head = (head + run) % BUFFER_SIZE;
+        data += run;
+        size -= run;
+    }
+}
+
+uint8_t at(size_t offset) {
+    return buffer[(tail() + offset) % BUFFER_SIZE];
+}
+
+void drop_oldest() {
+    size_t size = at(RECORD_HEADER_SIZE - 2) | (at(RECORD_HEADER_SIZE - 1) << 8);
+    used -= RECORD_HEADER_SIZE + size;
+    dropped++;
+}
+
+void put_int(uint8_t* out, size_t& size, uint64_t value, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        out[size++] = (value >> (i * 8)) & 0xFF;
+    }
+}
+
+} // namespace
+
+void record(Direction direction, std::initializer_list<ByteView> parts) {
+    size_t size = 0;
+    for (const ByteView& part : parts) {
+        size += part.size();
+    }
+    if (size == 0) return;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (paused) {
+        xSemaphoreGive(mutex);
+        return;
+    }
+    if (RECORD_HEADER_SIZE + size > BUFFER_SIZE) {
+        dropped++;
+        xSemaphoreGive(mutex);
+        return;
+    }
+    while (used + RECORD_HEADER_SIZE + size > BUFFER_SIZE) {
+        drop_oldest();
+    }
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    size_t header_size = 0;
+    put_int(header, header_size, hal::micros64(), 8);
+    header[header_size++] = static_cast<uint8_t>(direction);
+    header[header_size++] = 0;
+    put_int(header, header_size, size, 2);
+    put(header, header_size);
+    for (const ByteView& part : parts) {
+        put(part.data(), part.size());
+    }
+    used += RECORD_HEADER_SIZE + size;
+    xSemaphoreGive(mutex);
+}
+
+void dump(Communication& communication) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    paused = true;
+    xSemaphoreGive(mutex);
+
+    // [flags:uint8] then the next bytes of the capture file, the file header first
+    static uint8_t payload[1 + BYTES_PER_PACKET];
+    size_t size = 1;
+    put_int(payload, size, MAGIC, 4);
+    put_int(payload, size, VERSION, 2);
+    payload[size++] = static_cast<uint8_t>(Source::DEVICE);
+    payload[size++] = 0;
+    put_int(payload, size, dropped, 4);
+
+    size_t sent = 0;
+    while (true) {
+        size_t batch = std::min(BYTES_PER_PACKET + 1 - size, used - sent);
+        for (size_t i = 0; i < batch; i++) {
+            payload[size++] = at(sent + i);
+        }
+        sent += batch;
+        bool last = sent == used;
+        payload[0] = last ? 1 : 0;
+        communication.send_packet(Command::CAPTURE_DATA, payload, size);
+        if (last) break;
+        size = 1;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    head = 0;
+    used = 0;
+    dropped = 0;
+    paused = false;
+    xSemaphoreGive(mutex);
+}
+
+} // namespace capture
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#pragma once
+
+#include "FrameParser.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <initializer_list>
+
+class Communication;
+
+/// @brief Serial traffic captures: the raw bytes of both directions with microsecond timestamps,
+/// for reproducing sessions with the replay harness (see `Replay.h`).
+///
+/// File layout, little-endian:
+///
+///     [magic:uint32 "SLCP"][version:uint16][source:uint8][reserved:uint8][dropped:uint32]
+///     then per record [timestamp_us:uint64][direction:uint8][reserved:uint8][size:uint16][bytes]
+///
+/// A record holds bytes as one side read or wrote them, so the chunking of the original session
+/// is kept. Timestamps only need to be monotonic; their origin is the source's own clock.
+/// `capture.py` records on the host, firmware built with `SLIDR_CAPTURE` (PlatformIO env
+/// `lolin_s2_mini_capture`) on the device into a ring buffer that `CAPTURE_DUMP` downloads.
+namespace capture {
+
+enum class Direction : uint8_t {
+    HOST_TO_DEVICE,
+    DEVICE_TO_HOST
+};
+
+enum class Source : uint8_t {
+    HOST,
+    DEVICE
+};
+
+constexpr uint32_t MAGIC = 0x50434C53; // "SLCP"
+constexpr uint16_t VERSION = 1;
+constexpr size_t FILE_HEADER_SIZE = 4 + 2 + 1 + 1 + 4;
+constexpr size_t RECORD_HEADER_SIZE = 8 + 1 + 1 + 2;
+
+#ifdef SLIDR_CAPTURE
+
+constexpr size_t BUFFER_SIZE = 32 * 1024;
+
+/// @brief Record the concatenation of `parts` as one record. Whole oldest records are
+/// overwritten to make room.
+void record(Direction direction, std::initializer_list<ByteView> parts);
+
+/// @brief Send the buffer as a capture file in `CAPTURE_DATA` packets and clear it.
+/// Recording pauses while it is sent. Comm task only.
+void dump(Communication& communication);
+
+#define CAPTURE_RECORD(direction, ...) capture::record(capture::Direction::direction, { __VA_ARGS__ })
+
+#else
+
+#define CAPTURE_RECORD(direction, ...)
+
+#endif
+
+} // namespace capture
+
+#endif
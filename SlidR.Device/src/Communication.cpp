@@ -1,120 +1,161 @@
 #include "Communication.h"
+#include "Capture.h"
+#include "HeapTrace.h"
+#include "Latency.h"
 #include "Segment.h"
-#include <Arduino.h>
+#include "Stats.h"
+#include "Trace.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
 
-Communication::Communication() {
-    _transfer_watchdog_reset = xSemaphoreCreateBinary();
-    _transfer_waiting_for_ack = xSemaphoreCreateBinary();
-}
+Communication::Communication() {}
 
 void Communication::begin() {
-  Serial.begin(115200);
-  Serial.setTimeout(1000);
-  while (!Serial) { // TODO: Make this a config option
-    delay(10);
+  // Not waiting for the host here, `DeviceConfig::wait_for_serial` only holds back the boot report
+  hal::transport().begin(115200);
+
+  if (!_transfer_watchdog_task_handle) {
+    _transfer_watchdog_task_handle = rtos::create_task(rtos::TaskId::TRANSFER_WATCHDOG, transfer_watchdog_task, this);
+  }
+  if (!_send_image_task_handle) {
+    _send_image_task_handle = rtos::create_task(rtos::TaskId::SEND_IMAGE, send_image_task, this);
   }
 }
 
 void Communication::update() {
-    if (_in_packet && (millis() - _last_in_data_time > PACKET_TIMEOUT_MS)) {
-        send_log("Packet timeout");
-        _in_packet = false;
-        _rx_index = 0;
-    }
-
-    while (Serial.available()) {
-        uint8_t byte = Serial.read();
-
-        if (!_in_packet && byte == START_BYTE) {
-            _rx_index = 0;
-            _in_packet = true;
-            _last_in_data_time = millis();
-            continue;
-        }
+    HEAP_STEADY_STATE(heap_trace::Subsystem::COMM);
 
-        if (_in_packet) {
-            _last_in_data_time = millis();
-            _rx_buffer[_rx_index++] = byte;
+    if (_parser.in_packet() && (hal::millis() - _last_in_data_time > PACKET_TIMEOUT_MS)) {
+        SLIDR_LOG(*this, PACKET_TIMEOUT);
+        stats::add(stats::Counter::PACKET_TIMEOUTS);
+        _parser.reset();
+    }
 
-            if (_rx_index == 3) {
-                _expected_size = _rx_buffer[1] | (_rx_buffer[2] << 8);
-                if (_expected_size > MAX_PACKET_SIZE - 4) {
-                    send_log(("Packet size overflow: " + String(_expected_size) + "\n").c_str());
-                    send_err(ErrorCode::BUFFER_OVERFLOW);
-                    _in_packet = false;
-                    continue;
-                }
+    handle_transfer_timeout();
+
+    hal::Transport& transport = hal::transport();
+    uint32_t bytes_received = 0;
+    // Whole chunks per call: USB CDC takes its queue lock per `read()`, not per byte
+    uint8_t buffer[RX_CHUNK_SIZE];
+    size_t count;
+    while ((count = transport.read(buffer, sizeof(buffer))) > 0) {
+        bytes_received += count;
+        CAPTURE_RECORD(HOST_TO_DEVICE, ByteView{ buffer, static_cast<uint16_t>(count) });
+        for (size_t i = 0; i < count; i++) {
+            uint8_t byte = buffer[i];
+
+            bool was_in_packet = _parser.in_packet();
+            auto result = _parser.push(byte);
+            if (was_in_packet || _parser.in_packet()) {
+                _last_in_data_time = hal::millis();
             }
 
-            if (_rx_index >= 3 && _rx_index == _expected_size + 4) {
-                uint8_t recv_checksum = _rx_buffer[_rx_index - 1];
-                uint8_t calc_checksum = calculate_checksum(_rx_buffer, _rx_index - 1);
-
-                if (recv_checksum == calc_checksum) {
-                    _last_in_packet_time = millis();
-                    Command cmd = static_cast<Command>(_rx_buffer[0]);
-                    std::vector<uint8_t> data(_rx_buffer + 3, _rx_buffer + 3 + _expected_size);
-                    packet_t packet{cmd, data};
+            switch (result) {
+                case Parser::Result::NONE:
+                    break;
 
-                    if (!handle_file_transfer(packet)) {
-                        on_packet(packet);
-                    }
+                case Parser::Result::OVERFLOW:
+                    SLIDR_LOG(*this, PACKET_SIZE_OVERFLOW, _parser.expected_size());
+                    stats::add(stats::Counter::PACKET_OVERFLOWS);
+                    send_err(ErrorCode::BUFFER_OVERFLOW);
+                    break;
 
-                } else {
-                    send_log(("Checksum mismatch (RX: 0x" + String(recv_checksum, HEX) + ", CALC: 0x" + String(calc_checksum, HEX) + ")\n").c_str());
+                case Parser::Result::CHECKSUM_ERROR:
+                    SLIDR_LOG(*this, CHECKSUM_MISMATCH, _parser.received_checksum(), _parser.calculated_checksum());
+                    stats::add(stats::Counter::CHECKSUM_ERRORS);
                     send_err(ErrorCode::CHECKSUM_ERROR);
+                    break;
+
+                case Parser::Result::PACKET: {
+                    _last_in_packet_time = hal::millis();
+                    stats::add(stats::Counter::PACKETS_RX);
+                    Command cmd = _parser.command();
+                    packet_t packet{cmd, _parser.payload()};
+                    TRACE_INSTANT(PACKET_RX, cmd);
+
+                    // Service time covers both dispatch paths, including LittleFS and the reply
+                    uint32_t start_us = hal::micros();
+                    {
+                        TRACE_SCOPE(DISPATCH, cmd);
+
+                        // File transfers open files and start tasks, so they are traced outside the steady state
+                        bool handled;
+                        {
+                            HEAP_TRACE_SCOPE(heap_trace::Subsystem::FILE_TRANSFER);
+                            handled = handle_file_transfer(packet);
+                        }
+                        if (!handled && _on_packet) {
+                            HEAP_STEADY_STATE(heap_trace::Subsystem::DISPATCH);
+                            _on_packet(_on_packet_context, packet);
+                        }
+                    }
+                    latency::record(cmd, hal::micros() - start_us);
+                    break;
                 }
-
-                _in_packet = false;
-                _rx_index = 0;
             }
         }
     }
+    if (bytes_received) {
+        stats::add(stats::Counter::BYTES_RX, bytes_received);
+    }
+}
+
+bool Communication::connected() const {
+    return hal::transport().connected();
 }
 
 void Communication::change_baudrate(uint32_t baudrate) { // TODO: implement
 }
 
 void Communication::send_packet(Command command, const uint8_t *data, uint16_t size) {
-    Serial.write(START_BYTE);
-    Serial.write(static_cast<uint8_t>(command));
-    Serial.write(size & 0xFF);
-    Serial.write((size >> 8) & 0xFF);
-
-    uint8_t checksum = static_cast<uint8_t>(command);
-    checksum ^= size & 0xFF;
-    checksum ^= (size >> 8) & 0xFF;
-
-    for (uint16_t i = 0; i < size; i++) {
-        Serial.write(data[i]);
-        checksum ^= data[i];
+    TRACE_SCOPE(TX, command);
+    uint8_t header[4] = {
+        START_BYTE,
+        static_cast<uint8_t>(command),
+        static_cast<uint8_t>(size & 0xFF),
+        static_cast<uint8_t>((size >> 8) & 0xFF)
+    };
+    uint8_t checksum = Parser::checksum(header + 1, 3) ^ Parser::checksum(data, size);
+
+    // Packets are sent from several tasks and must not interleave
+    hal::Transport& transport = hal::transport();
+    xSemaphoreTake(_tx_mutex, portMAX_DELAY);
+    transport.write(header, sizeof(header));
+    if (size) {
+        transport.write(data, size);
     }
-    
-    Serial.write(checksum);
+    transport.write(&checksum, 1);
+    CAPTURE_RECORD(DEVICE_TO_HOST, ByteView{ header, sizeof(header) }, ByteView{ data, size }, ByteView{ &checksum, 1 });
+    xSemaphoreGive(_tx_mutex);
+
+    stats::add(stats::Counter::PACKETS_TX);
+    stats::add(stats::Counter::BYTES_TX, size + 5);
 }
 
 void Communication::send_err(ErrorCode code) {
-    send_packet(Command::ERROR_CMD, reinterpret_cast<const uint8_t*>(&code), sizeof(code));
+    stats::add(stats::Counter::ERRORS_SENT);
+    send(messages::Error{ code });
 }
 
-void Communication::send_log(const char* message) {
-    send_packet(Command::LOG_MESSAGE, reinterpret_cast<const uint8_t*>(message), strlen(message));
-}
 
 bool Communication::handle_file_transfer(const packet_t &packet) {
     switch (packet.command) {
         case Command::UPLOAD_IMAGE_START: {
-            if (packet.data.size() != 5) {
+            if (!_transfers_enabled) {
+                send_err(ErrorCode::BUSY);
+                break;
+            }
+            messages::UploadImageStart start;
+            if (!messages::decode(packet.data, start)) {
                 send_err(ErrorCode::INVALID_DATA);
                 break;
             }
 
-            uint8_t segment_index = packet.data.at(0);
-            uint32_t total_bytes;
-            memcpy(&total_bytes, packet.data.data() + 1, 4);
-            std::string image_path = Segment::get_image_path(segment_index);
+            char image_path[Segment::IMAGE_PATH_SIZE];
+            Segment::get_image_path(start.segment, image_path);
 
-            if (start_file_upload(image_path, total_bytes)) {
+            if (start_file_upload(image_path, start.total_size)) {
                 send_packet(Command::ACK);
             }
 
@@ -122,8 +163,8 @@ bool Communication::handle_file_transfer(const packet_t &packet) {
         }
 
         case Command::UPLOAD_IMAGE_DATA: {
-            if (!transfer_in_progress()) {
-                send_log("Received UPLOAD_IMAGE_DATA without active transfer\n");
+            if (!transfer_in_progress() || _firmware.active()) {
+                SLIDR_LOG(*this, UPLOAD_NOT_ACTIVE, "UPLOAD_IMAGE_DATA");
                 send_err(ErrorCode::INVALID_COMMAND);
                 break;
             }
@@ -136,41 +177,54 @@ bool Communication::handle_file_transfer(const packet_t &packet) {
         }
         
         case Command::UPLOAD_IMAGE_END: {
-            if (!transfer_in_progress()) {
-                send_log("Received UPLOAD_IMAGE_END without active transfer\n");
+            if (!transfer_in_progress() || _firmware.active()) {
+                SLIDR_LOG(*this, UPLOAD_NOT_ACTIVE, "UPLOAD_IMAGE_END");
                 send_err(ErrorCode::INVALID_COMMAND);
                 break;
             }
 
             if (_upload_bytes_received != _upload_total_size) {
-                send_log("Upload size mismatch: received " + std::to_string(_upload_bytes_received) + " of " + std::to_string(_upload_total_size) + "\n");
+                SLIDR_LOG(*this, UPLOAD_SIZE_MISMATCH, _upload_bytes_received, _upload_total_size);
                 cancel_transfer();
                 send_err(ErrorCode::INVALID_COMMAND);
                 break;
             }
             finish_file_transfer();
             send_packet(Command::ACK);
+            stats::add(stats::Counter::UPLOADS);
+            stats::set(stats::Counter::LAST_UPLOAD_MS, hal::millis() - _transfer_start_ms);
             
-            if (on_file_received) {
-                on_file_received(_upload_path);
+            if (_on_file_received) {
+                _on_file_received(_on_file_received_context, _upload_path);
             }
             
             break;
         }
 
         case Command::DOWNLOAD_IMAGE_START: {
-            if (packet.data.size() != 1) {
+            if (!_transfers_enabled) {
+                send_err(ErrorCode::BUSY);
+                break;
+            }
+            messages::DownloadImageStart start;
+            if (!messages::decode(packet.data, start)) {
                 send_err(ErrorCode::INVALID_DATA);
                 break;
             }
-            uint8_t segment_index = packet.data.at(0);
-            std::string image_path = Segment::get_image_path(segment_index);
+            char image_path[Segment::IMAGE_PATH_SIZE];
+            Segment::get_image_path(start.segment, image_path);
             start_file_download(image_path);
             break;
         }
 
+        case Command::OTA_BEGIN:
+        case Command::OTA_DATA:
+        case Command::OTA_END:
+            handle_firmware_update(packet);
+            break;
+
         case Command::ACK: {
-            if (!transfer_in_progress()) {
+            if (!_download_active) {
                 return false;
             }
             xSemaphoreGive(_transfer_waiting_for_ack);
@@ -184,19 +238,24 @@ bool Communication::handle_file_transfer(const packet_t &packet) {
     return true;
 }
 
-bool Communication::start_file_upload(const std::string &path, uint32_t total_size) {
+bool Communication::start_file_upload(const char *path, uint32_t total_size) {
     if (transfer_in_progress()) {
         send_err(ErrorCode::TRANSFER_IN_PROGRESS);
         return false;
     }
+    if (strlen(path) >= MAX_PATH_SIZE) {
+        send_err(ErrorCode::INVALID_DATA);
+        return false;
+    }
 
-    _file = LittleFS.open(UPLOAD_TEMP_PATH, "w");
+    _file = hal::filesystem().open(UPLOAD_TEMP_PATH, "w");
     if (!_file) {
         send_err(ErrorCode::FILE_ERROR);
         return false;
     }
 
-    _upload_path = path;
+    strcpy(_upload_path, path);
+    _transfer_start_ms = hal::millis();
     start_transfer_watchdog();
 
     _upload_total_size = total_size;
@@ -204,19 +263,23 @@ bool Communication::start_file_upload(const std::string &path, uint32_t total_si
     return true;
 }
 
-bool Communication::receive_file_data(const std::vector<uint8_t>& data) {
+bool Communication::receive_file_data(const ByteView& data) {
     if (!_file) {
         finish_file_transfer();
-        send_log("Received UPLOAD_IMAGE_DATA without active transfer\n");
+        SLIDR_LOG(*this, UPLOAD_NOT_ACTIVE, "UPLOAD_IMAGE_DATA");
         send_err(ErrorCode::FILE_ERROR);
         return false;
     }
 
     xSemaphoreGive(_transfer_watchdog_reset);
-    size_t written = _file.write(data.data(), data.size());
+    size_t written;
+    {
+        TRACE_SCOPE(FLASH_WRITE, data.size());
+        written = _file.write(data.data(), data.size());
+    }
     
     if (written != data.size()) {
-        send_log("Failed to write all data to file - written: " + std::to_string(written) + ", expected: " + std::to_string(data.size()) + "\n");
+        SLIDR_LOG(*this, UPLOAD_WRITE_FAILED, static_cast<uint16_t>(written), data.size());
         stop_transfer_watchdog();
         cancel_transfer();
         send_err(ErrorCode::FILE_ERROR);
@@ -227,27 +290,23 @@ bool Communication::receive_file_data(const std::vector<uint8_t>& data) {
     return true;
 }
 
-void Communication::start_file_download(const std::string& path) {
-    _file = LittleFS.open(path.c_str(), "r");
+void Communication::start_file_download(const char* path) {
+    if (transfer_in_progress() || _download_active) {
+        send_err(ErrorCode::TRANSFER_IN_PROGRESS);
+        return;
+    }
+
+    _file = hal::filesystem().open(path, "r");
     if (!_file) {
-        send_log("Failed to open file for download\n");
+        SLIDR_LOG(*this, DOWNLOAD_OPEN_FAILED, path);
         send_err(ErrorCode::FILE_ERROR);
         return;
     }
     
     xSemaphoreTake(_transfer_waiting_for_ack, 0);
-    xSemaphoreGive(_transfer_watchdog_reset);
-    xTaskCreate(
-        [](void* param) {
-            static_cast<Communication*>(param)->send_image_task();
-            vTaskDelete(nullptr);
-        },
-        "Send Image Task",
-        8192,
-        this,
-        1,
-        nullptr
-    );
+    _transfer_start_ms = hal::millis();
+    _download_active = true;
+    xTaskNotifyGive(_send_image_task_handle);
 }
 
 void Communication::finish_file_transfer() {
@@ -255,51 +314,144 @@ void Communication::finish_file_transfer() {
 
     if (_file) {
         _file.close();
-        if (LittleFS.exists(_upload_path.c_str())) {
-            if (!LittleFS.remove(_upload_path.c_str())) {
-                send_log(("Failed to remove existing file: '" + _upload_path + "'\n").c_str());
+        if (hal::filesystem().exists(_upload_path)) {
+            if (!hal::filesystem().remove(_upload_path)) {
+                SLIDR_LOG(*this, UPLOAD_REMOVE_FAILED, _upload_path);
                 send_err(ErrorCode::FILE_ERROR);
                 return;
             }
         }
         if (!Communication::ensure_parent_dirs(_upload_path) ||
-            !LittleFS.rename(UPLOAD_TEMP_PATH, _upload_path.c_str())) {
-            send_log(("Failed to rename uploaded file to: '" + _upload_path + "'\n").c_str());
+            !hal::filesystem().rename(UPLOAD_TEMP_PATH, _upload_path)) {
+            SLIDR_LOG(*this, UPLOAD_RENAME_FAILED, _upload_path);
             send_err(ErrorCode::FILE_ERROR);
             return;
         }
     }
 }
 
-bool Communication::ensure_parent_dirs(const std::string& full_path) {
-    auto slash = full_path.find_last_of('/');
-    if (slash == std::string::npos || slash == 0) {
+void Communication::handle_firmware_update(const packet_t& packet) {
+    switch (packet.command) {
+        case Command::OTA_BEGIN: {
+            if (!_transfers_enabled || !_firmware_updates_enabled) {
+                send_err(ErrorCode::BUSY);
+                return;
+            }
+            messages::OtaBegin begin;
+            if (!messages::decode(packet.data, begin) || begin.sha256.size() != sha256::DIGEST_SIZE) {
+                send_err(ErrorCode::INVALID_DATA);
+                return;
+            }
+            if (transfer_in_progress() || _download_active) {
+                send_err(ErrorCode::TRANSFER_IN_PROGRESS);
+                return;
+            }
+
+            sha256::Digest digest;
+            memcpy(digest.bytes, begin.sha256.data(), sizeof(digest.bytes));
+            auto status = _firmware.begin(begin.size, begin.flags, digest);
+            if (status != FirmwareUpdate::Status::OK) {
+                firmware_update_failed(status);
+                return;
+            }
+            SLIDR_LOG(*this, FIRMWARE_UPDATE_STARTED, begin.size, _firmware.compressed() ? "compressed" : "uncompressed");
+            _transfer_start_ms = hal::millis();
+            start_transfer_watchdog();
+            break;
+        }
+
+        case Command::OTA_DATA: {
+            if (!transfer_in_progress() || !_firmware.active()) {
+                SLIDR_LOG(*this, UPLOAD_NOT_ACTIVE, "OTA_DATA");
+                send_err(ErrorCode::INVALID_COMMAND);
+                return;
+            }
+            xSemaphoreGive(_transfer_watchdog_reset);
+            FirmwareUpdate::Status status;
+            {
+                TRACE_SCOPE(FLASH_WRITE, packet.data.size());
+                status = _firmware.write(packet.data);
+            }
+            if (status != FirmwareUpdate::Status::OK) {
+                stop_transfer_watchdog();
+                firmware_update_failed(status);
+                return;
+            }
+            break;
+        }
+
+        case Command::OTA_END: {
+            if (!transfer_in_progress() || !_firmware.active()) {
+                SLIDR_LOG(*this, UPLOAD_NOT_ACTIVE, "OTA_END");
+                send_err(ErrorCode::INVALID_COMMAND);
+                return;
+            }
+            stop_transfer_watchdog();
+            auto status = _firmware.finish();
+            if (status != FirmwareUpdate::Status::OK) {
+                firmware_update_failed(status);
+                return;
+            }
+            uint32_t duration_ms = hal::millis() - _transfer_start_ms;
+            stats::add(stats::Counter::FIRMWARE_UPDATES);
+            stats::set(stats::Counter::LAST_FIRMWARE_UPDATE_MS, duration_ms);
+            SLIDR_LOG(*this, FIRMWARE_UPDATED, duration_ms);
+            send_packet(Command::ACK);
+            if (_on_firmware_updated) {
+                _on_firmware_updated(_on_firmware_updated_context);
+            }
+            return;
+        }
+
+        default:
+            return;
+    }
+
+    // Every packet of the stream is acknowledged with how far it got, which paces the host
+    send(messages::OtaStatus{ _firmware.received(), _firmware.written(),
+                              static_cast<uint16_t>(hal::Transport::RX_BUFFER_SIZE) });
+}
+
+void Communication::firmware_update_failed(FirmwareUpdate::Status status) {
+    SLIDR_LOG(*this, FIRMWARE_UPDATE_FAILED, FirmwareUpdate::status_name(status), _firmware.received(), _firmware.written());
+    send_err(ErrorCode::FIRMWARE_ERROR);
+}
+
+bool Communication::ensure_parent_dirs(const char* full_path) {
+    const char* slash = strrchr(full_path, '/');
+    if (slash == nullptr || slash == full_path) {
         return true;
     }
-    std::string path;
-    size_t pos = 1;
-    while ((pos = full_path.find('/', pos)) != std::string::npos && pos < slash) {
-        path = full_path.substr(0, pos);
-        if (!LittleFS.exists(path.c_str()) && !LittleFS.mkdir(path.c_str())) {
+    char path[MAX_PATH_SIZE];
+    size_t dir_length = slash - full_path;
+    if (dir_length >= sizeof(path)) {
+        return false;
+    }
+    for (size_t pos = 1; pos <= dir_length; ++pos) {
+        if (pos != dir_length && full_path[pos] != '/') {
+            continue;
+        }
+        memcpy(path, full_path, pos);
+        path[pos] = '\0';
+        if (!hal::filesystem().exists(path) && !hal::filesystem().mkdir(path)) {
             return false;
         }
-        ++pos;
     }
-    path = full_path.substr(0, slash);
-    return LittleFS.exists(path.c_str()) || LittleFS.mkdir(path.c_str());
+    return true;
 }
 
-uint8_t Communication::calculate_checksum(const uint8_t *data, size_t size) {
-    uint8_t checksum = 0;
-    for (size_t i = 0; i < size; ++i) {
-        checksum ^= data[i];
+void Communication::send_image_task(void* param) {
+    auto* communication = static_cast<Communication*>(param);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        communication->send_image();
+        communication->_download_active = false;
     }
-    return checksum;
 }
 
-void Communication::send_image_task() {
+void Communication::send_image() {
     if (!_file) {
-        send_log("No file opened for sending image\n");
+        SLIDR_LOG(*this, DOWNLOAD_NO_FILE);
         send_err(ErrorCode::FILE_ERROR);
         return;
     }
@@ -314,58 +466,64 @@ void Communication::send_image_task() {
 
         size_t read_bytes = _file.read(buffer, to_read);
         if (read_bytes != to_read) {
-            send_log("Failed to read expected number of bytes from file\n");
+            SLIDR_LOG(*this, DOWNLOAD_READ_FAILED);
             send_err(ErrorCode::FILE_ERROR);
             _file.close();
             return;
         } else {
             send_packet(Command::DOWNLOAD_IMAGE_DATA, buffer, read_bytes);
-            if (xSemaphoreTake(_transfer_waiting_for_ack, pdMS_TO_TICKS(PACKET_TIMEOUT_MS)) == pdTRUE) {
-                xSemaphoreGive(_transfer_watchdog_reset);
+            if (xSemaphoreTake(_transfer_waiting_for_ack, pdMS_TO_TICKS(PACKET_TIMEOUT_MS)) != pdTRUE) {
+                stats::add(stats::Counter::DOWNLOAD_ACK_TIMEOUTS);
             }
         }
     }
 
     _file.close();
     send_packet(Command::DOWNLOAD_IMAGE_END);
+    stats::add(stats::Counter::DOWNLOADS);
+    stats::set(stats::Counter::LAST_DOWNLOAD_MS, hal::millis() - _transfer_start_ms);
 }
 
 void Communication::cancel_transfer() {
+    _firmware.abort();
     if (_file) {
         _file.close();
-        LittleFS.remove(UPLOAD_TEMP_PATH);
+        hal::filesystem().remove(UPLOAD_TEMP_PATH);
     }
-    _upload_path.clear();
+    _upload_path[0] = '\0';
+}
+
+void Communication::handle_transfer_timeout() {
+    if (!_transfer_timed_out.exchange(false)) return;
+    // Stopped by the transfer's last packet since the watchdog fired
+    if (!_transfer_active) return;
+    _transfer_active = false;
+    stats::add(stats::Counter::TRANSFER_TIMEOUTS);
+    send_err(ErrorCode::TRANSFER_TIMEOUT);
+    cancel_transfer();
 }
 
 void Communication::start_transfer_watchdog() {
-    xSemaphoreGive(_transfer_watchdog_reset);
-    xTaskCreate(
-        [](void* param) {
-            static_cast<Communication*>(param)->transfer_watchdog_task();
-            vTaskDelete(nullptr);
-        },
-        "Transfer Watchdog Task",
-        1024,
-        this,
-        1,
-        &_transfer_watchdog_task_handle
-    );
+    xSemaphoreTake(_transfer_watchdog_reset, 0);
+    _transfer_timed_out = false;
+    _transfer_active = true;
+    xTaskNotifyGive(_transfer_watchdog_task_handle);
 }
 
 void Communication::stop_transfer_watchdog() {
-    if (_transfer_watchdog_task_handle) {
-        vTaskDelete(_transfer_watchdog_task_handle);
-        _transfer_watchdog_task_handle = nullptr;
-    }
+    _transfer_active = false;
+    xSemaphoreGive(_transfer_watchdog_reset);
 }
 
-void Communication::transfer_watchdog_task() {
+void Communication::transfer_watchdog_task(void* param) {
+    auto* communication = static_cast<Communication*>(param);
     while (true) {
-        if (xSemaphoreTake(_transfer_watchdog_reset, pdMS_TO_TICKS(PACKET_TIMEOUT_MS)) != pdTRUE) {
-            send_err(ErrorCode::TRANSFER_TIMEOUT);
-            cancel_transfer();
-            break;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (communication->_transfer_active && !communication->_transfer_timed_out) {
+            if (xSemaphoreTake(communication->_transfer_watchdog_reset, pdMS_TO_TICKS(PACKET_TIMEOUT_MS)) != pdTRUE) {
+                // The comm task may be writing the file or the update, it cancels them itself
+                communication->_transfer_timed_out = true;
+            }
         }
     }
 }
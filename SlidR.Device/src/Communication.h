@@ -3,49 +3,106 @@
 
 #pragma once
 
+#include "EventLog.h"
+#include "FirmwareUpdate.h"
+#include "FrameParser.h"
+#include "Hal.h"
+#include "Messages.h"
 #include "ProtocolConstants.h"
+#include "Rtos.h"
 
-#include <functional>
-#include <vector>
-#include <string>
-#include <FS.h>
-#include <LittleFS.h>
-#include <USBCDC.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <FreeRTOS.h>
 
 class Communication {
 public:
     using packet_t = struct {
         Command command;
-        std::vector<uint8_t> data;
+        ByteView data;
     };
 
-    std::function<void(packet_t packet)> on_packet;
-    std::function<void(const std::string& path)> on_file_received;
+    /// @brief Plain callbacks with a context pointer, so dispatch never copies or allocates
+    using PacketHandler = void (*)(void* context, const packet_t& packet);
+    using FileHandler = void (*)(void* context, const char* path);
+    using FirmwareHandler = void (*)(void* context);
 
     Communication();
     ~Communication() = default;
 
-    /// @brief Start serial communication
+    /// @brief Start serial communication and the file transfer tasks
     void begin();
     /// @brief Receive and process incoming packets
     void update();
     /// @brief Change the serial baudrate
     void change_baudrate(uint32_t baudrate);
 
+    /// @brief Whether a host has the serial port open
+    bool connected() const;
+
+    /// @brief Accept image uploads and downloads. Until then they are answered with `BUSY`.
+    void set_transfers_enabled(bool enabled) {
+        _transfers_enabled = enabled;
+    }
+
+    /// @brief Accept `OTA_BEGIN`. Until then it is answered with `BUSY`. Kept off while the running
+    /// firmware is on trial, so an update never overwrites the image a rollback returns to.
+    void set_firmware_updates_enabled(bool enabled) {
+        _firmware_updates_enabled = enabled;
+    }
+
+    /// @brief Set the handler for packets not consumed by file transfers
+    void set_packet_handler(PacketHandler handler, void* context) {
+        _on_packet = handler;
+        _on_packet_context = context;
+    }
+    /// @brief Set the handler called with the final path after an upload completes
+    void set_file_handler(FileHandler handler, void* context) {
+        _on_file_received = handler;
+        _on_file_received_context = context;
+    }
+    /// @brief Set the handler called after a firmware update is written and will boot next.
+    /// It restarts the device.
+    void set_firmware_handler(FirmwareHandler handler, void* context) {
+        _on_firmware_updated = handler;
+        _on_firmware_updated_context = context;
+    }
+
     /// @brief Send a packet with given command and data
     void send_packet(Command command, const uint8_t* data = nullptr, uint16_t size = 0);
-    void send_packet(Command command, const std::vector<uint8_t>& data) {
-        send_packet(command, data.data(), data.size());
-    }
     void send_err(ErrorCode code);
-    void send_log(const char* message);
-    void send_log(const std::string& message) {
-        send_log(message.c_str());
+
+    /// @brief Encode and send `message`. Messages with an `R` field are built by the caller
+    /// and sent with `send_packet()`.
+    template <typename Message>
+    void send(const Message& message) {
+        static_assert(!messages::layout<Message>().has_rest, "Payload size is not bounded");
+        uint8_t payload[messages::MAX_SIZE<Message> + 1];
+        size_t size = 0;
+        messages::encode(message, payload, sizeof(payload), size);
+        send_packet(Message::COMMAND, payload, size);
+    }
+
+    /// @brief Send log message `Id` unless its level is compiled out or it is rate limited.
+    /// Use through `SLIDR_LOG`.
+    template <event_log::LogId Id, typename... Args>
+    void log_event(const Args&... args) {
+        if constexpr (event_log::enabled(Id)) {
+            uint16_t suppressed;
+            if (!event_log::admit(Id, suppressed)) return;
+
+            uint8_t payload[event_log::MAX_EVENT_SIZE];
+            event_log::Packer packer{ payload, 0, sizeof(payload) };
+            packer.put_int(static_cast<uint16_t>(Id), 2);
+            packer.put_int(suppressed, 2);
+            event_log::pack<Id, 0>(packer, args...);
+            send_packet(Command::LOG_EVENT, payload, packer.size);
+        }
     }
 
     bool transfer_in_progress() const {
-        return _transfer_watchdog_task_handle != nullptr;
+        return _transfer_active;
     }
 
     uint32_t last_packet_time() const {
@@ -56,14 +113,8 @@ private:
     /// @brief Creates all parent directories for a given path
     /// @param full_path File path
     /// @return `bool` success
-    static bool ensure_parent_dirs(const std::string& full_path);
+    static bool ensure_parent_dirs(const char* full_path);
 
-    /// @brief Calculates the checksum of a data buffer
-    /// @param data Pointer to the data buffer
-    /// @param size Size of the data buffer
-    /// @return Checksum value
-    uint8_t calculate_checksum(const uint8_t* data, size_t size);
-    
     /// @brief Call for all incoming packets
     /// @param packet 
     /// @return `true` if the packet was handled and should not be processed further
@@ -73,55 +124,86 @@ private:
     /// @param path Path where the file will be stored
     /// @param total_size Total size of the file
     /// @return `true` if the upload was started successfully
-    bool start_file_upload(const std::string& path, uint32_t total_size);
+    bool start_file_upload(const char* path, uint32_t total_size);
 
     /// @brief Receive a chunk of file data. Handles errors.
     /// @param data The data chunk to receive
     /// @return `true` if the data was received successfully
-    bool receive_file_data(const std::vector<uint8_t>& data);
+    bool receive_file_data(const ByteView& data);
 
-    /// @brief Start sending a file
+    /// @brief Start sending a file from the send image task
     /// @param path Path of the file to send
-    void start_file_download(const std::string& path);
+    void start_file_download(const char* path);
 
     /// @brief Stop watchdog and replace target file
     void finish_file_transfer();
+
+    /// @brief `OTA_BEGIN`, `OTA_DATA` and `OTA_END`. Replies to each, `OTA_STATUS` while the
+    /// image is streaming.
+    void handle_firmware_update(const packet_t& packet);
+
+    /// @brief Log why `_firmware` failed and reply `FIRMWARE_ERROR`
+    void firmware_update_failed(FirmwareUpdate::Status status);
     
-    /// @brief Task responsible for sending the currently open file.
+    /// @brief Send the currently open file.
     /// Tries to take `_transfer_waiting_for_ack` semaphore after each chunk.
-    void send_image_task();
+    void send_image();
+
+    /// @brief Runs `send_image()` each time it is notified by `start_file_download()`
+    static void send_image_task(void* param);
 
-    /// @brief Delete temp file and clear upload path
+    /// @brief Delete temp file and clear upload path, or drop the firmware image
     void cancel_transfer();
 
-    /// @brief Starts the transfer watchdog task
+    /// @brief Arms the transfer watchdog
     void start_transfer_watchdog();
 
-    /// @brief Deletes the transfer watchdog task
+    /// @brief Disarms the transfer watchdog
     void stop_transfer_watchdog();
 
-    /// @brief Takes `_transfer_watchdog_reset` semaphore every `PACKET_TIMEOUT_MS` milliseconds.
-    /// Cancels the transfer if no data is received in time.
-    void transfer_watchdog_task();
+    /// @brief Cancel the transfer and reply `TRANSFER_TIMEOUT` if the watchdog fired. On the
+    /// comm task, which owns `_file` and `_firmware`.
+    void handle_transfer_timeout();
+
+    /// @brief While a transfer is active, takes `_transfer_watchdog_reset` semaphore every
+    /// `PACKET_TIMEOUT_MS` milliseconds. Sets `_transfer_timed_out` if no data is received in time.
+    static void transfer_watchdog_task(void* param);
     TaskHandle_t _transfer_watchdog_task_handle = nullptr;
-    SemaphoreHandle_t _transfer_watchdog_reset;
-    SemaphoreHandle_t _transfer_waiting_for_ack;
+    TaskHandle_t _send_image_task_handle = nullptr;
+    std::atomic<bool> _transfer_active{ false };
+    std::atomic<bool> _transfer_timed_out{ false };
+    std::atomic<bool> _download_active{ false };
+    std::atomic<bool> _transfers_enabled{ false };
+    std::atomic<bool> _firmware_updates_enabled{ false };
+    rtos::Semaphore _transfer_watchdog_reset{ rtos::Semaphore::Kind::BINARY };
+    rtos::Semaphore _transfer_waiting_for_ack{ rtos::Semaphore::Kind::BINARY };
+    rtos::Semaphore _tx_mutex{ rtos::Semaphore::Kind::MUTEX };
 
     static constexpr size_t MAX_PACKET_SIZE = 4096;
+    static constexpr size_t RX_CHUNK_SIZE = 64;
     static constexpr size_t TRANSFER_SEND_MAX_CHUNK_SIZE = 512;
     static constexpr uint32_t PACKET_TIMEOUT_MS = 1000;
+    static constexpr size_t MAX_PATH_SIZE = 32;
     static constexpr const char* UPLOAD_TEMP_PATH = "/upload_temp";
-    std::string _upload_path;
-    uint8_t _rx_buffer[MAX_PACKET_SIZE];
-    size_t _rx_index = 0;
-    bool _in_packet = false;
+    char _upload_path[MAX_PATH_SIZE] = {};
+
+    PacketHandler _on_packet = nullptr;
+    void* _on_packet_context = nullptr;
+    FileHandler _on_file_received = nullptr;
+    void* _on_file_received_context = nullptr;
+    FirmwareHandler _on_firmware_updated = nullptr;
+    void* _on_firmware_updated_context = nullptr;
+    using Parser = FrameParser<MAX_PACKET_SIZE>;
+    Parser _parser;
     uint32_t _last_in_data_time = 0;
     uint32_t _last_in_packet_time = 0;
-    uint16_t _expected_size = 0;
     
-    File _file;
+    hal::File _file;
     uint32_t _upload_bytes_received = 0;
+    uint32_t _transfer_start_ms = 0;
     uint32_t _upload_total_size = 0;
+
+    FirmwareUpdate _firmware;
 };
 
 #endif
\ No newline at end of file
@@ -4,8 +4,9 @@
 #pragma once
 
 #include <cinttypes>
-#include <vector>
-#include <string>
+
+/// @brief Upper bound on the number of segments a config can describe
+constexpr uint8_t MAX_SEGMENTS = 8;
 
 struct SegmentConfig {
     uint8_t tft_cs_pin;
@@ -24,7 +25,8 @@ struct DeviceConfig {
     uint32_t baudrate;
     bool wait_for_serial;
     bool do_sleep;
-    std::vector<SegmentConfig> segments;
+    uint8_t segment_count;
+    SegmentConfig segments[MAX_SEGMENTS];
 };
 
-#endif // CONFIG_H
\ No newline at end of file
+#endif // CONFIG_H
@@ -1,110 +1,173 @@
 #include "ConfigLoader.h"
+#include "Crc32.h"
 #include "DefaultConfig.h"
-#include <FS.h>
-#include <LittleFS.h>
-
-#define GET(x) memcpy(&x, data.data() + offset, sizeof(x)); offset += sizeof(x)
+#include "Hal.h"
+#include "Trace.h"
 
 std::shared_ptr<DeviceConfig> ConfigLoader::load() {
-    File config_file = LittleFS.open(CONFIG_PATH, "r");
-    if (!config_file) return nullptr;
+    auto config = std::make_shared<DeviceConfig>(DEFAULT_CONFIG);
+#ifdef SLIDR_CONFIG_NVS
+    if (_nvs.load(*config)) return config;
+
+    // First boot with the NVS backend: carry over the filesystem config
+    bool from_legacy;
+    if (!load_file(*config, from_legacy)) return nullptr;
+    if (_nvs.save(*config)) {
+        _write_count++;
+        remove_files();
+    }
+    return config;
+#else
+    bool from_legacy;
+    if (!load_file(*config, from_legacy)) return nullptr;
+    if (from_legacy && save_file(*config)) {
+        hal::filesystem().remove(LEGACY_CONFIG_PATH);
+    }
+    return config;
+#endif
+}
 
-    size_t file_size = config_file.size();
-    std::vector<uint8_t> buffer(file_size);
+std::shared_ptr<DeviceConfig> ConfigLoader::load_early() {
+#ifdef SLIDR_CONFIG_NVS
+    auto config = std::make_shared<DeviceConfig>(DEFAULT_CONFIG);
+    if (_nvs.load(*config)) return config;
+#endif
+    return nullptr;
+}
 
-    config_file.read(buffer.data(), file_size);
-    config_file.close();
+bool ConfigLoader::load_file(DeviceConfig &out, bool &from_legacy) {
+    bool found = false;
+    from_legacy = false;
+
+    for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+        DeviceConfig candidate;
+        uint32_t sequence;
+        if (!read_slot(slot, candidate, sequence)) continue;
+
+        // Wrap-safe "newer than"
+        if (!found || static_cast<int32_t>(sequence - _sequence) > 0) {
+            out = candidate;
+            _sequence = sequence;
+            _active_slot = slot;
+            found = true;
+        }
+    }
+    if (found) return true;
+
+    from_legacy = read_legacy(out);
+    return from_legacy;
+}
 
-    return from_bytes(buffer);
+void ConfigLoader::remove_files() {
+    for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+        hal::filesystem().remove(SLOT_PATHS[slot]);
+    }
+    hal::filesystem().remove(LEGACY_CONFIG_PATH);
 }
 
 std::shared_ptr<DeviceConfig> ConfigLoader::load_default() {
     return std::make_shared<DeviceConfig>(DEFAULT_CONFIG);
 }
 
+const DeviceConfig& ConfigLoader::defaults() {
+    return DEFAULT_CONFIG;
+}
+
 bool ConfigLoader::save(const DeviceConfig &config) {
-    File config_file = LittleFS.open(CONFIG_PATH, "w");
+#ifdef SLIDR_CONFIG_NVS
+    if (!_nvs.save(config)) return false;
+    _write_count++;
+    return true;
+#else
+    return save_file(config);
+#endif
+}
+
+bool ConfigLoader::save_file(const DeviceConfig &config) {
+    uint8_t data[SLOT_HEADER_SIZE + config_schema::MAX_ENCODED_SIZE];
+    size_t blob_size = to_bytes(config, data + SLOT_HEADER_SIZE, config_schema::MAX_ENCODED_SIZE);
+    if (blob_size == 0) return false;
+
+    uint32_t sequence = _sequence + 1;
+    uint8_t slot = (_active_slot + 1) % SLOT_COUNT;
+
+    config_schema::Writer header(data, SLOT_HEADER_SIZE);
+    header.put(SLOT_MAGIC);
+    header.put(sequence);
+    header.put(static_cast<uint16_t>(blob_size));
+    header.put(crc32::update(data + SLOT_HEADER_SIZE, blob_size));
+
+    hal::File config_file = hal::filesystem().open(SLOT_PATHS[slot], "w");
     if (!config_file) return false;
 
-    auto data = to_bytes(config);
-    if (data.empty()) {
+    size_t size = SLOT_HEADER_SIZE + blob_size;
+    size_t written;
+    {
+        TRACE_SCOPE(FLASH_WRITE, size);
+        written = config_file.write(data, size);
         config_file.close();
-        return false;
     }
+    _write_count++;
+    if (written != size) return false;
 
-    config_file.write(data.data(), data.size());
-    config_file.close();
-
+    _sequence = sequence;
+    _active_slot = slot;
     return true;
 }
 
-std::shared_ptr<DeviceConfig> ConfigLoader::from_bytes(const std::vector<uint8_t> &data) {
-    if (data.size() < sizeof(CONFIG_VERSION)) return nullptr;
-
-    size_t offset = 0;
-    size_t version;
-    GET(version);
-
-    if (version != CONFIG_VERSION) return nullptr;
-
-    auto config = std::make_shared<DeviceConfig>();
-
-    GET(config->spi_clk_pin);
-    GET(config->spi_data_pin);
-    GET(config->tft_dc_pin);
-    GET(config->tft_backlight_pin);
-    GET(config->tft_backlight_value);
-    GET(config->spi_speed_hz);
-    GET(config->baudrate);
-    GET(config->wait_for_serial);
-    GET(config->do_sleep);
-
-    uint8_t num_segments;
-    GET(num_segments);
-
-    config->segments.clear();
-    for (uint8_t i = 0; i < num_segments; i++) {
-        SegmentConfig seg;
-        GET(seg.tft_cs_pin);
-        GET(seg.pot_pin);
-        GET(seg.pot_min_value);
-        GET(seg.pot_max_value);
-        config->segments.push_back(seg);
-    }
+bool ConfigLoader::read_slot(uint8_t slot, DeviceConfig &out, uint32_t &sequence) {
+    hal::File config_file = hal::filesystem().open(SLOT_PATHS[slot], "r");
+    if (!config_file) return false;
 
-    return config;
+    uint8_t data[SLOT_HEADER_SIZE + config_schema::MAX_ENCODED_SIZE];
+    size_t file_size = config_file.size();
+    if (file_size < SLOT_HEADER_SIZE || file_size > sizeof(data)) {
+        config_file.close();
+        return false;
+    }
+    size_t read_bytes = config_file.read(data, file_size);
+    config_file.close();
+    if (read_bytes != file_size) return false;
+
+    config_schema::Reader header(data, SLOT_HEADER_SIZE);
+    uint32_t magic = 0;
+    uint16_t blob_size = 0;
+    uint32_t crc = 0;
+    header.get(magic);
+    header.get(sequence);
+    header.get(blob_size);
+    header.get(crc);
+    if (!header.ok() || magic != SLOT_MAGIC || SLOT_HEADER_SIZE + blob_size != file_size) return false;
+    if (crc32::update(data + SLOT_HEADER_SIZE, blob_size) != crc) return false;
+
+    return from_bytes(data + SLOT_HEADER_SIZE, blob_size, out);
 }
 
-std::vector<uint8_t> ConfigLoader::to_bytes(const DeviceConfig &config) {
-    std::vector<uint8_t> buffer;
-
-    auto append = [&](const void* src, size_t len) {
-        const uint8_t* byte_src = static_cast<const uint8_t*>(src);
-        buffer.insert(buffer.end(), byte_src, byte_src + len);
-    };
-
-    append(&CONFIG_VERSION, sizeof(CONFIG_VERSION));
-    append(&config.spi_clk_pin, sizeof(config.spi_clk_pin));
-    append(&config.spi_data_pin, sizeof(config.spi_data_pin));
-    append(&config.tft_dc_pin, sizeof(config.tft_dc_pin));
-    append(&config.tft_backlight_pin, sizeof(config.tft_backlight_pin));
-    append(&config.tft_backlight_value, sizeof(config.tft_backlight_value));
-    append(&config.spi_speed_hz, sizeof(config.spi_speed_hz));
-    append(&config.baudrate, sizeof(config.baudrate));
-    append(&config.wait_for_serial, sizeof(config.wait_for_serial));
-    append(&config.do_sleep, sizeof(config.do_sleep));
-
-    uint8_t num_segments = static_cast<uint8_t>(config.segments.size());
-    append(&num_segments, sizeof(num_segments));
-
-    for (const auto& seg : config.segments) {
-        append(&seg.tft_cs_pin, sizeof(seg.tft_cs_pin));
-        append(&seg.pot_pin, sizeof(seg.pot_pin));
-        append(&seg.pot_min_value, sizeof(seg.pot_min_value));
-        append(&seg.pot_max_value, sizeof(seg.pot_max_value));
+bool ConfigLoader::read_legacy(DeviceConfig &out) {
+    hal::File config_file = hal::filesystem().open(LEGACY_CONFIG_PATH, "r");
+    if (!config_file) return false;
+
+    size_t file_size = config_file.size();
+    if (file_size > config_schema::MAX_ENCODED_SIZE) {
+        config_file.close();
+        return false;
     }
 
-    return buffer;
+    uint8_t buffer[config_schema::MAX_ENCODED_SIZE];
+    size_t read_bytes = config_file.read(buffer, file_size);
+    config_file.close();
+    if (read_bytes != file_size) return false;
+
+    return from_bytes(buffer, read_bytes, out);
 }
 
-#undef GET
+bool ConfigLoader::from_bytes(const uint8_t* data, size_t size, DeviceConfig& out) {
+    DeviceConfig config = DEFAULT_CONFIG;
+    if (!config_schema::decode(data, size, config)) return false;
+    out = config;
+    return true;
+}
+
+size_t ConfigLoader::to_bytes(const DeviceConfig &config, uint8_t* out, size_t capacity) {
+    return config_schema::encode(config, out, capacity);
+}
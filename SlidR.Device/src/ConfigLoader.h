@@ -4,39 +4,96 @@
 #pragma once
 
 #include "Config.h"
+#include "ConfigSchema.h"
+#ifdef SLIDR_CONFIG_NVS
+#include "NvsConfigStore.h"
+#endif
 
 #include <cinttypes>
+#include <cstddef>
 #include <memory>
-#include <vector>
 
 class ConfigLoader {
 public:
     ConfigLoader() = default;
     ~ConfigLoader() = default;
 
-    /// @brief Load device configuration from the filesystem.
+    /// @brief Load device configuration from the configured backend. Requires LittleFS to be mounted.
+    /// With the NVS backend, a config still stored on the filesystem is migrated to NVS.
     /// @return A shared pointer to the loaded DeviceConfig, or nullptr on failure.
     std::shared_ptr<DeviceConfig> load();
+    /// @brief Load device configuration without touching the filesystem.
+    /// @return The config if the backend does not need LittleFS and holds a config, nullptr otherwise.
+    std::shared_ptr<DeviceConfig> load_early();
     /// @brief Load the default device configuration.
     /// @return A shared pointer to the default DeviceConfig.
     std::shared_ptr<DeviceConfig> load_default();
-    /// @brief Save the device configuration to the filesystem.
+    /// @brief The compiled-in default configuration, without copying it to the heap.
+    static const DeviceConfig& defaults();
+    /// @brief Save the device configuration to the configured backend.
     /// @param config The DeviceConfig to save.
     /// @return `bool` - success
     bool save(const DeviceConfig& config);
 
-    /// @brief Deserialize device configuration from byte array.
-    /// @param data The byte array containing the serialized configuration.
-    /// @return A shared pointer to the deserialized DeviceConfig, or nullptr on failure.
-    std::shared_ptr<DeviceConfig> from_bytes(const std::vector<uint8_t>& data);
-    /// @brief Serialize device configuration to byte array.
+    /// @brief Deserialize device configuration from a byte buffer. Does not allocate.
+    /// Blobs from older layout versions are migrated; fields they lack take default values.
+    /// @param data The buffer containing the serialized configuration.
+    /// @param size Size of `data` in bytes.
+    /// @param out Receives the configuration. Left untouched on failure.
+    /// @return `bool` - success
+    bool from_bytes(const uint8_t* data, size_t size, DeviceConfig& out);
+    /// @brief Serialize device configuration into a byte buffer. Does not allocate.
     /// @param config The DeviceConfig to serialize.
-    /// @return A byte array containing the serialized configuration.
-    std::vector<uint8_t> to_bytes(const DeviceConfig& config);
+    /// @param out Destination buffer, `config_schema::MAX_ENCODED_SIZE` bytes is always enough.
+    /// @param capacity Size of `out` in bytes.
+    /// @return Number of bytes written, 0 on failure.
+    size_t to_bytes(const DeviceConfig& config, uint8_t* out, size_t capacity);
+
+    /// @brief Number of config saves that reached flash since boot
+    uint32_t write_count() const { return _write_count; }
+
+    /// @brief Name of the compiled-in storage backend
+    static constexpr const char* backend_name() {
+#ifdef SLIDR_CONFIG_NVS
+        return "nvs";
+#else
+        return "file";
+#endif
+    }
 
 private:
-    static constexpr const char* CONFIG_PATH = "/config.bin";
-    static constexpr size_t CONFIG_VERSION = 1;
+    /// @brief Pick the newest valid slot, or a legacy `/config.bin` if no slot is valid.
+    /// @param out Receives the config
+    /// @param from_legacy Set if the config came from the legacy file and should be migrated
+    /// @return `bool` - a config was found
+    bool load_file(DeviceConfig& out, bool& from_legacy);
+    /// @brief Write the slot not holding the current config, so an interrupted write
+    /// never destroys the last good copy.
+    bool save_file(const DeviceConfig& config);
+    /// @brief Delete all config files
+    void remove_files();
+    /// @brief Read and validate one slot.
+    /// @param slot Slot index
+    /// @param out Receives the configuration
+    /// @param sequence Receives the slot's sequence number
+    /// @return `bool` - slot is valid
+    bool read_slot(uint8_t slot, DeviceConfig& out, uint32_t& sequence);
+    /// @brief Load the pre-slot single file format.
+    bool read_legacy(DeviceConfig& out);
+
+    /// Slot file: `[magic:uint32][sequence:uint32][length:uint16][crc32:uint32][blob]`
+    static constexpr uint32_t SLOT_MAGIC = 0x46434C53; // "SLCF"
+    static constexpr size_t SLOT_HEADER_SIZE = 4 + 4 + 2 + 4;
+    static constexpr uint8_t SLOT_COUNT = 2;
+    static constexpr const char* SLOT_PATHS[SLOT_COUNT] = { "/config.0.bin", "/config.1.bin" };
+    static constexpr const char* LEGACY_CONFIG_PATH = "/config.bin";
+
+    uint32_t _sequence = 0;
+    uint8_t _active_slot = SLOT_COUNT - 1;
+    uint32_t _write_count = 0;
+#ifdef SLIDR_CONFIG_NVS
+    NvsConfigStore _nvs;
+#endif
 };
 
-#endif
\ No newline at end of file
+#endif
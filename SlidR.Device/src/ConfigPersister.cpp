@@ -0,0 +1,59 @@
+#include "ConfigPersister.h"
+
+ConfigPersister::ConfigPersister(ConfigLoader &loader) : _loader(loader) {}
+
+void ConfigPersister::begin() {
+    if (!_writer_task_handle) {
+        _writer_task_handle = rtos::create_task(rtos::TaskId::CONFIG_WRITER, writer_task, this);
+    }
+}
+
+void ConfigPersister::request_save(const DeviceConfig &config) {
+    xSemaphoreTake(_pending_mutex, portMAX_DELAY);
+    _pending = config;
+    _dirty = true;
+    xSemaphoreGive(_pending_mutex);
+
+    if (_writer_task_handle) {
+        xTaskNotifyGive(_writer_task_handle);
+    }
+}
+
+bool ConfigPersister::flush() {
+    // Serialize writers so two flushes can not land in the slots out of order
+    xSemaphoreTake(_write_mutex, portMAX_DELAY);
+
+    xSemaphoreTake(_pending_mutex, portMAX_DELAY);
+    if (!_dirty) {
+        xSemaphoreGive(_pending_mutex);
+        xSemaphoreGive(_write_mutex);
+        return true;
+    }
+    DeviceConfig config = _pending;
+    _dirty = false;
+    xSemaphoreGive(_pending_mutex);
+
+    bool ok = _loader.save(config);
+    if (!ok) {
+        // Retry with the next request unless a newer config is already pending
+        xSemaphoreTake(_pending_mutex, portMAX_DELAY);
+        if (!_dirty) {
+            _pending = config;
+            _dirty = true;
+        }
+        xSemaphoreGive(_pending_mutex);
+    }
+
+    xSemaphoreGive(_write_mutex);
+    return ok;
+}
+
+void ConfigPersister::writer_task(void *param) {
+    auto* persister = static_cast<ConfigPersister*>(param);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Every new request restarts the quiet period
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(QUIET_PERIOD_MS)) > 0) {}
+        persister->flush();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef CONFIGPERSISTER_H
+#define CONFIGPERSISTER_H
+
+#pragma once
+
+#include "Config.h"
+#include "ConfigLoader.h"
+#include "Rtos.h"
+
+#include <FreeRTOS.h>
+#include <cinttypes>
+
+/// @brief Write-behind persistence for the device config.
+/// Changes are applied in RAM by the caller right away; the persister only stores a copy
+/// and writes it once no further change has arrived for `QUIET_PERIOD_MS`.
+class ConfigPersister {
+public:
+    explicit ConfigPersister(ConfigLoader& loader);
+    ~ConfigPersister() = default;
+
+    /// @brief Start the background writer task
+    void begin();
+
+    /// @brief Schedule `config` to be saved after the quiet period.
+    /// Later requests replace earlier ones that have not been written yet.
+    void request_save(const DeviceConfig& config);
+
+    /// @brief Write a pending config immediately. Call before sleep or restart.
+    /// @return `false` if a pending config could not be written
+    bool flush();
+
+    bool is_dirty() const { return _dirty; }
+
+private:
+    static void writer_task(void* param);
+
+    ConfigLoader& _loader;
+    DeviceConfig _pending;
+    volatile bool _dirty = false;
+    rtos::Semaphore _pending_mutex{ rtos::Semaphore::Kind::MUTEX };
+    rtos::Semaphore _write_mutex{ rtos::Semaphore::Kind::MUTEX };
+    TaskHandle_t _writer_task_handle = nullptr;
+
+    static constexpr uint32_t QUIET_PERIOD_MS = 2000;
+};
+
+#endif
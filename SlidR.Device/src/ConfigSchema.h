@@ -0,0 +1,390 @@
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#pragma once
+
+#include "Config.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/// Compile-time description of the serialized `DeviceConfig` layout.
+/// The same tables drive encoding and decoding on the firmware and on host builds,
+/// so this header must not depend on Arduino or FreeRTOS.
+///
+/// Wire layout (all integers little-endian, tightly packed):
+/// `[version:uint32][DEVICE_FIELDS...][segment_count:uint8][SEGMENT_FIELDS...] * segment_count`
+namespace config_schema {
+
+/// @brief Current layout version. Always encoded as 4 bytes, independent of the platform `size_t`.
+constexpr uint32_t CONFIG_VERSION = 1;
+/// @brief Oldest layout version that can still be decoded (and migrated).
+constexpr uint32_t MIN_CONFIG_VERSION = 1;
+
+/// @brief Describes one serialized member of `Owner`.
+/// @tparam Owner Struct the member belongs to
+/// @tparam T Member type, must be an integral type (or `bool`)
+template <typename Owner, typename T>
+struct Field {
+    static_assert(std::is_integral<T>::value, "Config fields must be integral");
+    using owner_type = Owner;
+    using value_type = T;
+    static constexpr size_t size = sizeof(T);
+
+    const char* name;
+    T Owner::* member;
+    /// First layout version that contains this field. Older blobs leave it untouched.
+    uint32_t since;
+};
+
+template <typename Owner, typename T>
+constexpr Field<Owner, T> field(const char* name, T Owner::* member, uint32_t since = 1) {
+    return { name, member, since };
+}
+
+/// Order of entries is the order on the wire. Append new fields at the end with `since` set
+/// to the new `CONFIG_VERSION`; never reorder or remove entries.
+constexpr auto DEVICE_FIELDS = std::make_tuple(
+    field("spi_clk_pin", &DeviceConfig::spi_clk_pin),
+    field("spi_data_pin", &DeviceConfig::spi_data_pin),
+    field("tft_dc_pin", &DeviceConfig::tft_dc_pin),
+    field("tft_backlight_pin", &DeviceConfig::tft_backlight_pin),
+    field("tft_backlight_value", &DeviceConfig::tft_backlight_value),
+    field("spi_speed_hz", &DeviceConfig::spi_speed_hz),
+    field("baudrate", &DeviceConfig::baudrate),
+    field("wait_for_serial", &DeviceConfig::wait_for_serial),
+    field("do_sleep", &DeviceConfig::do_sleep)
+);
+
+constexpr auto SEGMENT_FIELDS = std::make_tuple(
+    field("tft_cs_pin", &SegmentConfig::tft_cs_pin),
+    field("pot_pin", &SegmentConfig::pot_pin),
+    field("pot_min_value", &SegmentConfig::pot_min_value),
+    field("pot_max_value", &SegmentConfig::pot_max_value)
+);
+
+/// @brief Identifies a `DEVICE_FIELDS` entry by its position in the table.
+enum class DeviceField : uint8_t {
+    SPI_CLK_PIN,
+    SPI_DATA_PIN,
+    TFT_DC_PIN,
+    TFT_BACKLIGHT_PIN,
+    TFT_BACKLIGHT_VALUE,
+    SPI_SPEED_HZ,
+    BAUDRATE,
+    WAIT_FOR_SERIAL,
+    DO_SLEEP,
+    COUNT
+};
+
+/// @brief Identifies a `SEGMENT_FIELDS` entry by its position in the table.
+enum class SegmentField : uint8_t {
+    TFT_CS_PIN,
+    POT_PIN,
+    POT_MIN_VALUE,
+    POT_MAX_VALUE,
+    COUNT
+};
+
+static_assert(std::tuple_size<decltype(DEVICE_FIELDS)>::value == static_cast<size_t>(DeviceField::COUNT),
+    "DeviceField must list every DEVICE_FIELDS entry");
+static_assert(std::tuple_size<decltype(SEGMENT_FIELDS)>::value == static_cast<size_t>(SegmentField::COUNT),
+    "SegmentField must list every SEGMENT_FIELDS entry");
+
+/// @brief Calls `fn(field)` for every entry of a field table, in wire order.
+template <typename Tuple, typename Fn>
+constexpr void for_each_field(const Tuple& fields, Fn&& fn) {
+    std::apply([&](const auto&... f) { (fn(f), ...); }, fields);
+}
+
+/// @brief Size in bytes of one record described by `fields` in the given layout version.
+template <typename Tuple>
+constexpr size_t record_size(const Tuple& fields, uint32_t version = CONFIG_VERSION) {
+    size_t size = 0;
+    for_each_field(fields, [&](const auto& f) {
+        if (f.since <= version) size += f.size;
+    });
+    return size;
+}
+
+/// @brief Size of an encoded config with `segment_count` segments.
+constexpr size_t encoded_size(uint8_t segment_count, uint32_t version = CONFIG_VERSION) {
+    return sizeof(uint32_t)
+        + record_size(DEVICE_FIELDS, version)
+        + sizeof(uint8_t)
+        + segment_count * record_size(SEGMENT_FIELDS, version);
+}
+
+/// @brief Largest blob `encode` can produce. Use it to size stack buffers.
+constexpr size_t MAX_ENCODED_SIZE = encoded_size(MAX_SEGMENTS);
+
+/// @brief Unsigned type used to shift a field value onto the wire.
+template <typename T>
+struct wire_type { using type = typename std::make_unsigned<T>::type; };
+template <>
+struct wire_type<bool> { using type = uint8_t; };
+
+/// @brief Bounds-checked little-endian writer over a caller-owned buffer.
+/// Writing past the end sets the error flag and is otherwise ignored.
+class Writer {
+public:
+    constexpr Writer(uint8_t* buffer, size_t capacity) : _buffer(buffer), _capacity(capacity) {}
+
+    template <typename T>
+    constexpr void put(T value) {
+        static_assert(std::is_integral<T>::value, "Only integral values can be written");
+        if (!_ok || _capacity - _offset < sizeof(T)) {
+            _ok = false;
+            return;
+        }
+        using U = typename wire_type<T>::type;
+        U raw = static_cast<U>(value);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            _buffer[_offset++] = static_cast<uint8_t>(raw >> (8 * i));
+        }
+    }
+
+    /// @brief Append `size` raw bytes
+    constexpr void put_bytes(const uint8_t* data, size_t size) {
+        if (!_ok || _capacity - _offset < size) {
+            _ok = false;
+            return;
+        }
+        for (size_t i = 0; i < size; i++) {
+            _buffer[_offset++] = data[i];
+        }
+    }
+
+    constexpr bool ok() const { return _ok; }
+    constexpr size_t size() const { return _offset; }
+
+private:
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _offset = 0;
+    bool _ok = true;
+};
+
+/// @brief Bounds-checked little-endian reader over a borrowed buffer.
+/// Reading past the end sets the error flag and leaves the output untouched.
+class Reader {
+public:
+    constexpr Reader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+    template <typename T>
+    constexpr bool get(T& out) {
+        static_assert(std::is_integral<T>::value, "Only integral values can be read");
+        if (!_ok || _size - _offset < sizeof(T)) {
+            _ok = false;
+            return false;
+        }
+        using U = typename wire_type<T>::type;
+        U raw = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            raw |= static_cast<U>(static_cast<U>(_data[_offset++]) << (8 * i));
+        }
+        out = static_cast<T>(raw);
+        return true;
+    }
+
+    constexpr bool ok() const { return _ok; }
+    constexpr size_t remaining() const { return _size - _offset; }
+
+private:
+    const uint8_t* _data;
+    size_t _size;
+    size_t _offset = 0;
+    bool _ok = true;
+};
+
+template <typename Owner, typename Tuple>
+constexpr void write_record(Writer& w, const Owner& obj, const Tuple& fields) {
+    for_each_field(fields, [&](const auto& f) { w.put(obj.*(f.member)); });
+}
+
+template <typename Owner, typename Tuple>
+constexpr void read_record(Reader& r, Owner& obj, const Tuple& fields, uint32_t version) {
+    for_each_field(fields, [&](const auto& f) {
+        if (f.since > version) return;
+        typename std::decay_t<decltype(f)>::value_type value{};
+        if (r.get(value)) obj.*(f.member) = value;
+    });
+}
+
+/// @brief Calls `fn(field)` for the entry at `index` only.
+/// @return `false` if `index` is out of range
+template <typename Tuple, typename Fn>
+constexpr bool visit_field(const Tuple& fields, size_t index, Fn&& fn) {
+    size_t i = 0;
+    bool found = false;
+    for_each_field(fields, [&](const auto& f) {
+        if (i++ != index) return;
+        found = true;
+        fn(f);
+    });
+    return found;
+}
+
+/// @brief Byte offset of entry `index` within a record, in the current layout.
+template <typename Tuple>
+constexpr size_t field_offset(const Tuple& fields, size_t index) {
+    size_t i = 0;
+    size_t offset = 0;
+    for_each_field(fields, [&](const auto& f) {
+        if (i++ < index) offset += f.size;
+    });
+    return offset;
+}
+
+/// @brief Addresses a single value inside a `DeviceConfig`.
+/// On the wire: `[field:uint8][segment:uint8]`. Segment fields have `SEGMENT_FIELD_FLAG` set
+/// in `field`; `segment` is ignored (and should be 0) for device fields.
+struct FieldPath {
+    uint8_t field;
+    uint8_t segment;
+
+    static constexpr uint8_t SEGMENT_FIELD_FLAG = 0x80;
+
+    constexpr bool is_segment() const { return field & SEGMENT_FIELD_FLAG; }
+    constexpr uint8_t index() const { return field & ~SEGMENT_FIELD_FLAG; }
+    constexpr DeviceField device_field() const { return static_cast<DeviceField>(index()); }
+    constexpr SegmentField segment_field() const { return static_cast<SegmentField>(index()); }
+
+    static constexpr FieldPath of(DeviceField f) {
+        return { static_cast<uint8_t>(f), 0 };
+    }
+    static constexpr FieldPath of(uint8_t segment, SegmentField f) {
+        return { static_cast<uint8_t>(static_cast<uint8_t>(f) | SEGMENT_FIELD_FLAG), segment };
+    }
+};
+
+/// @brief Checks that `path` names an existing field of `config`.
+constexpr bool path_valid(const DeviceConfig& config, FieldPath path) {
+    if (path.is_segment()) {
+        return path.index() < static_cast<uint8_t>(SegmentField::COUNT) && path.segment < config.segment_count;
+    }
+    return path.index() < static_cast<uint8_t>(DeviceField::COUNT);
+}
+
+/// @brief Encode only the value addressed by `path`, as it appears in the full blob.
+/// @return Number of bytes written, 0 if the path is invalid or `out` is too small
+constexpr size_t encode_field(const DeviceConfig& config, FieldPath path, uint8_t* out, size_t capacity) {
+    if (!path_valid(config, path)) return 0;
+    Writer w(out, capacity);
+    if (path.is_segment()) {
+        visit_field(SEGMENT_FIELDS, path.index(), [&](const auto& f) { w.put(config.segments[path.segment].*(f.member)); });
+    } else {
+        visit_field(DEVICE_FIELDS, path.index(), [&](const auto& f) { w.put(config.*(f.member)); });
+    }
+    return w.ok() ? w.size() : 0;
+}
+
+/// @brief Read the value addressed by `path` from `r` into `config`.
+constexpr bool read_field(Reader& r, DeviceConfig& config, FieldPath path) {
+    if (!path_valid(config, path)) return false;
+    bool ok = false;
+    auto read_into = [&](auto& obj, const auto& f) {
+        typename std::decay_t<decltype(f)>::value_type value{};
+        ok = r.get(value);
+        if (ok) obj.*(f.member) = value;
+    };
+    if (path.is_segment()) {
+        visit_field(SEGMENT_FIELDS, path.index(), [&](const auto& f) { read_into(config.segments[path.segment], f); });
+    } else {
+        visit_field(DEVICE_FIELDS, path.index(), [&](const auto& f) { read_into(config, f); });
+    }
+    return ok;
+}
+
+/// @brief Apply a field-level patch to `config`.
+/// Payload: `[count:uint8]` followed by `count` entries of `[FieldPath][value]`, where the value
+/// has the width of the addressed field. The segment count itself cannot be patched.
+/// @param data Encoded patch
+/// @param size Size of `data`
+/// @param config Config to patch. Only modified on success.
+/// @param paths Receives the path of each applied entry, in order
+/// @param max_paths Capacity of `paths`
+/// @param out_count Receives the number of entries
+/// @return `bool` success
+constexpr bool decode_patch(const uint8_t* data, size_t size, DeviceConfig& config,
+                            FieldPath* paths, size_t max_paths, size_t& out_count) {
+    Reader r(data, size);
+    uint8_t count = 0;
+    if (!r.get(count) || count == 0 || count > max_paths) return false;
+
+    DeviceConfig result = config;
+    for (uint8_t i = 0; i < count; i++) {
+        FieldPath path{};
+        if (!r.get(path.field) || !r.get(path.segment)) return false;
+        if (!read_field(r, result, path)) return false;
+        paths[i] = path;
+    }
+    if (r.remaining() != 0) return false;
+
+    config = result;
+    out_count = count;
+    return true;
+}
+
+/// @brief Serialize `config` in the current layout.
+/// @param config Config to encode
+/// @param out Destination buffer
+/// @param capacity Size of `out`, `MAX_ENCODED_SIZE` is always enough
+/// @return Number of bytes written, or 0 if the config is invalid or does not fit
+constexpr size_t encode(const DeviceConfig& config, uint8_t* out, size_t capacity) {
+    if (config.segment_count > MAX_SEGMENTS) return 0;
+
+    Writer w(out, capacity);
+    w.put(CONFIG_VERSION);
+    write_record(w, config, DEVICE_FIELDS);
+    w.put(config.segment_count);
+    for (uint8_t i = 0; i < config.segment_count; i++) {
+        write_record(w, config.segments[i], SEGMENT_FIELDS);
+    }
+    return w.ok() ? w.size() : 0;
+}
+
+/// @brief Deserialize a config blob of any supported layout version.
+/// Fields that did not exist in the blob's version keep the value already in `out`,
+/// so callers should pre-fill it with defaults to migrate older blobs.
+/// @param data Encoded blob
+/// @param size Size of `data`
+/// @param out Config to fill. Only modified on success.
+/// @return `bool` success
+constexpr bool decode(const uint8_t* data, size_t size, DeviceConfig& out) {
+    Reader r(data, size);
+    uint32_t version = 0;
+    if (!r.get(version)) return false;
+    if (version < MIN_CONFIG_VERSION || version > CONFIG_VERSION) return false;
+
+    // Peek the segment count so the total size can be validated before touching `out`
+    size_t device_size = record_size(DEVICE_FIELDS, version);
+    if (r.remaining() < device_size + 1) return false;
+    uint8_t segment_count = data[sizeof(uint32_t) + device_size];
+    if (segment_count > MAX_SEGMENTS) return false;
+    if (size != encoded_size(segment_count, version)) return false;
+
+    DeviceConfig result = out;
+    read_record(r, result, DEVICE_FIELDS, version);
+    r.get(result.segment_count);
+    for (uint8_t i = 0; i < segment_count; i++) {
+        // Segments beyond the previous count have no meaningful base values
+        if (i >= out.segment_count) result.segments[i] = SegmentConfig{};
+        read_record(r, result.segments[i], SEGMENT_FIELDS, version);
+    }
+    if (!r.ok()) return false;
+
+    out = result;
+    return true;
+}
+
+// Published layouts are frozen; add fields with a new `since` version instead
+static_assert(record_size(SEGMENT_FIELDS, 1) == 6, "Version 1 segment layout must not change");
+static_assert(encoded_size(0, 1) == 20, "Version 1 device layout must not change");
+
+} // namespace config_schema
+
+#endif // CONFIG_SCHEMA_H
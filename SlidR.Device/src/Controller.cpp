@@ -1,252 +1,656 @@
 #include "Controller.h"
+#include "Benchmark.h"
+#include "BootProfile.h"
+#include "Capture.h"
+#include "Hal.h"
+#include "HeapTrace.h"
+#include "Latency.h"
+#include "Profiler.h"
+#include "Stats.h"
+#include "Trace.h"
 #include <FreeRTOS.h>
-#include <FS.h>
-#include <LittleFS.h>
-#include <SPI.h>
 #include <algorithm>
-#include <string>
+#include <cinttypes>
+#include <cstring>
 
-SPIClass spi(FSPI);
-
-Controller::Controller() : _is_awake(true) {}
+Controller::Controller() : _config_persister(_config_loader), _is_awake(true) {}
 
 void Controller::begin() {
-    _communication.begin();
-
-    if (!LittleFS.begin(true)) {
-        _communication.send_log("FS mount fail");
-    } else {
-        _communication.send_log("FS mount ok");
+    using boot_profile::Stage;
+
+    // Counted before anything that could crash, so an update failing during boot is rolled back
+    _trial_boots = hal::firmware().count_trial_boot();
+    if (_trial_boots > MAX_TRIAL_BOOTS) {
+        hal::firmware().rollback();
+        // No previous firmware to go back to
+        hal::firmware().confirm();
+        _trial_boots = 0;
     }
 
-    auto cfg = _config_loader.load();
+    _communication.begin();
+    boot_profile::mark(Stage::SERIAL_STARTED);
+
+    // The comm task answers PING during the rest of boot, other commands get BUSY until `_booted`
+    _communication.set_packet_handler([](void* context, const Communication::packet_t& packet) {
+        static_cast<Controller*>(context)->handle_command(packet);
+    }, this);
+    _communication.set_file_handler([](void* context, const char* path) {
+        static_cast<Controller*>(context)->on_file_received(path);
+    }, this);
+    _communication.set_firmware_handler([](void* context) {
+        static_cast<Controller*>(context)->on_firmware_updated();
+    }, this);
+    rtos::create_task(rtos::TaskId::COMM, comm_task, this);
+
+    // Backends that do not need the filesystem let the panels reset while it mounts
+    auto cfg = _config_loader.load_early();
     if (cfg) {
-        _device_config = cfg;
-    } else {
-        _communication.send_log("Failed to load config, using defaults");
-        _device_config = _config_loader.load_default();
-        _config_loader.save(*_device_config);
+        boot_profile::mark(Stage::CONFIG_LOADED);
+        start_panels(*cfg);
     }
 
-    init_hardware();
+    boot_profile::mark(Stage::FS_MOUNTED, hal::filesystem().begin(true));
+    if (cfg) {
+        advance_panels();
+    }
 
-    _communication.on_packet = [this](Communication::packet_t packet) {
-        handle_command(packet);
-    };
-    _communication.on_file_received = [this](const std::string& path) {
-        on_file_received(path);
-    };
+    if (!cfg) {
+        cfg = _config_loader.load();
+        boot_profile::mark(Stage::CONFIG_LOADED, cfg != nullptr);
+        if (!cfg) {
+            cfg = _config_loader.load_default();
+            _config_loader.save(*cfg);
+        }
+        start_panels(*cfg);
+    }
 
+    finish_panels();
+    load_images();
+    _config_persister.begin();
     create_tasks();
+
+    _communication.set_transfers_enabled(true);
+    _communication.set_firmware_updates_enabled(_trial_boots == 0);
+    _booted = true;
+    boot_profile::mark(Stage::BOOT_DONE);
 }
 
 void Controller::create_tasks() {
-    if (!_comm_task_handle) {
-        xTaskCreate(comm_task, "Comm Task", 4096, this, 2, &_comm_task_handle);
-    }
-    if (!_segment_task_handle) {
-        xTaskCreate(segment_task, "Segment Task", 4096, this, 1, &_segment_task_handle);
-    }
-    if (!_watchdog_task_handle && _device_config->do_sleep) {
-        xTaskCreate(watchdog_task, "Watchdog Task", 2048, this, 1, &_watchdog_task_handle);
-    }
+    rtos::create_task(rtos::TaskId::SEGMENT, segment_task, this);
+    rtos::create_task(rtos::TaskId::WATCHDOG, watchdog_task, this);
+    rtos::create_task(rtos::TaskId::CONFIG_JOB, config_job_task, this);
 }
 
-void Controller::init_hardware() {
-    spi.end();
-    spi.begin(
-        _device_config->spi_clk_pin,  // sck
-        -1,                           // miso
-        _device_config->spi_data_pin, // mosi
-        -1                            // ss/cs
-    );
+void Controller::start_panels(const DeviceConfig &config) {
+    State& next = _state.prepare();
+    _booting_state = &next;
+    next.config = config;
 
-    pinMode(_device_config->tft_backlight_pin, OUTPUT);
-    analogWrite(_device_config->tft_backlight_pin, 0);
+    restart_spi(config);
+
+    hal::pin_mode(config.tft_backlight_pin, hal::PinDirection::OUT);
+    hal::analog_write(config.tft_backlight_pin, 0);
     
-    for (auto& segment : _device_config->segments) {
-        pinMode(segment.pot_pin, INPUT);
+    for (uint8_t i = 0; i < config.segment_count; i++) {
+        hal::pin_mode(config.segments[i].pot_pin, hal::PinDirection::IN);
     }
     
-    _segments.clear();
-    for (size_t i = 0; i < _device_config->segments.size(); i++) {
-        _segments.push_back(std::make_unique<Segment>(
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++) {
+        next.segments[i].reset();
+    }
+    for (uint8_t i = 0; i < config.segment_count; i++) {
+        next.segments[i] = std::make_shared<Segment>(
             i,
-            _device_config->segments[i],
+            config.segments[i],
             _communication,
-            _device_config->tft_dc_pin,
-            &spi
-        ));
+            config.tft_dc_pin,
+            config.spi_speed_hz
+        );
+    }
+
+    _panel_stage = 0;
+    _panel_stage_ready_ms = hal::millis();
+    advance_panels();
+}
+
+bool Controller::advance_panels() {
+    State& next = *_booting_state;
+    // The panels share the bus, so a stage is sent to one panel after another,
+    // but the settle time after it is waited out only once for all of them
+    while (_panel_stage < Segment::INIT_STAGE_COUNT &&
+           static_cast<int32_t>(hal::millis() - _panel_stage_ready_ms) >= 0) {
+        uint16_t wait_ms = 0;
+        for (uint8_t i = 0; i < next.config.segment_count; i++) {
+            wait_ms = std::max(wait_ms, next.segments[i]->begin_stage(_panel_stage));
+        }
+        if (_panel_stage == 0) {
+            boot_profile::mark(boot_profile::Stage::PANELS_STARTED);
+        }
+        _panel_stage++;
+        _panel_stage_ready_ms = hal::millis() + wait_ms;
     }
-    for (auto& segment : _segments) {
-        segment->begin();
+    return _panel_stage == Segment::INIT_STAGE_COUNT &&
+           static_cast<int32_t>(hal::millis() - _panel_stage_ready_ms) >= 0;
+}
+
+void Controller::finish_panels() {
+    while (!advance_panels()) {
+        hal::delay_ms(1);
     }
-    for (auto& segment : _segments) {
-        segment->load_and_display_image();
-        segment->enable_logs(true);
+    boot_profile::mark(boot_profile::Stage::PANELS_READY);
+
+    _booting_state = nullptr;
+    _state.publish();
+}
+
+void Controller::load_images() {
+    using boot_profile::Stage;
+
+    auto state = _state.read(READER_BOOT);
+    const DeviceConfig& config = state->config;
+
+    for (uint8_t i = 0; i < config.segment_count; i++) {
+        bool shown = state->segments[i]->load_and_display_image();
+        state->segments[i]->enable_logs(true);
+        if (shown && !boot_profile::reached(Stage::FIRST_PIXEL)) {
+            hal::analog_write(config.tft_backlight_pin, config.tft_backlight_value);
+            boot_profile::mark(Stage::FIRST_PIXEL);
+        }
+    }
+
+    hal::analog_write(config.tft_backlight_pin, config.tft_backlight_value);
+    boot_profile::mark(Stage::FIRST_PIXEL);
+    boot_profile::mark(Stage::IMAGES_LOADED);
+}
+
+void Controller::report_boot() {
+    if (_boot_reported || !_booted) return;
+
+    bool wait_for_serial;
+    {
+        auto state = _state.read(READER_COMM);
+        wait_for_serial = state->config.wait_for_serial;
     }
+    if (wait_for_serial && !_communication.connected()) return;
 
-    analogWrite(_device_config->tft_backlight_pin, _device_config->tft_backlight_value);
+    boot_profile::report(_communication, ConfigLoader::backend_name());
+    _boot_reported = true;
 }
 
-void Controller::handle_command(Communication::packet_t packet) {
+void Controller::handle_command(const Communication::packet_t& packet) {
+    if (packet.command == Command::PING) {
+        _communication.send_packet(Command::PONG);
+        if (!boot_profile::reached(boot_profile::Stage::FIRST_PONG)) {
+            boot_profile::mark(boot_profile::Stage::FIRST_PONG);
+            if (_boot_reported) {
+                SLIDR_LOG(_communication, BOOT_FIRST_PONG, boot_profile::at_us(boot_profile::Stage::FIRST_PONG) / 1000);
+            }
+        }
+        if (_booted && !_is_awake) {
+            wake_up();
+        }
+        if (_booted && _trial_boots) {
+            confirm_firmware();
+        }
+        return;
+    }
+
+    if (!_booted) {
+        _communication.send_err(ErrorCode::BUSY);
+        return;
+    }
+
     if (!_is_awake) {
         wake_up();
     }
 
-    switch (packet.command) {
-        case Command::PING:
-            _communication.send_packet(Command::PONG);
-            break;
-        
-        case Command::SET_CONFIG: {
-            auto in_cfg = _config_loader.from_bytes(packet.data);
-            if (!in_cfg) {
-                _communication.send_err(ErrorCode::INVALID_CONFIG);
-                return;
-            }
+    auto result = messages::dispatch<messages::Direction::TO_DEVICE>(packet.command, packet.data,
+        [this](const auto& message) { handle(message); });
+    if (result == messages::Dispatch::UNKNOWN) {
+        _communication.send_err(ErrorCode::INVALID_COMMAND);
+    } else if (result == messages::Dispatch::INVALID) {
+        _communication.send_err(ErrorCode::INVALID_DATA);
+    }
+}
 
-            apply_config_changes(*in_cfg);
-            _device_config = in_cfg;
-            _config_loader.save(*_device_config);
+void Controller::handle(const messages::SetConfig& message) {
+    ConfigJob job;
+    job.kind = ConfigJob::Kind::REPLACE;
+    if (!_config_loader.from_bytes(message.config.data(), message.config.size(), job.config)) {
+        _communication.send_err(ErrorCode::INVALID_CONFIG);
+        return;
+    }
+    submit_config_job(job);
+}
 
-            _communication.send_packet(Command::ACK);
-            break;
-        }
+void Controller::handle(const messages::PatchConfig& message) {
+    // Checked against the current config so obvious errors are reported right away;
+    // the job validates again in case an earlier job changes the segment count
+    DeviceConfig patched;
+    {
+        auto state = _state.read(READER_COMM);
+        patched = state->config;
+    }
+    config_schema::FieldPath paths[MAX_PATCH_FIELDS];
+    size_t count = 0;
+    if (message.patch.size() > MAX_PATCH_SIZE ||
+        !config_schema::decode_patch(message.patch.data(), message.patch.size(), patched, paths, MAX_PATCH_FIELDS, count)) {
+        _communication.send_err(ErrorCode::INVALID_CONFIG);
+        return;
+    }
 
-        case Command::GET_CONFIG: {
-            auto cfg_data = _config_loader.to_bytes(*_device_config);
-            _communication.send_packet(Command::CONFIG_DATA, cfg_data.data(), cfg_data.size());
-            break;
-        }
+    ConfigJob job;
+    job.kind = ConfigJob::Kind::PATCH;
+    job.patch_size = message.patch.size();
+    memcpy(job.patch, message.patch.data(), message.patch.size());
+    submit_config_job(job);
+}
 
-        case Command::DEFAULT_CONFIG: {
-            auto default_cfg = _config_loader.load_default();
-            apply_config_changes(*default_cfg);
-            _device_config = default_cfg;
-            _config_loader.save(*_device_config);
+void Controller::handle(const messages::GetConfig&) {
+    uint8_t cfg_data[config_schema::MAX_ENCODED_SIZE];
+    size_t cfg_size;
+    {
+        auto state = _state.read(READER_COMM);
+        cfg_size = _config_loader.to_bytes(state->config, cfg_data, sizeof(cfg_data));
+    }
+    _communication.send_packet(Command::CONFIG_DATA, cfg_data, cfg_size);
+}
 
-            _communication.send_packet(Command::ACK);
-            break;
-        }
+void Controller::handle(const messages::DefaultConfig&) {
+    ConfigJob job;
+    job.kind = ConfigJob::Kind::REPLACE;
+    job.config = ConfigLoader::defaults();
+    submit_config_job(job);
+}
 
-        case Command::SET_BACKLIGHT: {
-            _device_config->tft_backlight_value = packet.data[0];
-            analogWrite(_device_config->tft_backlight_pin, _device_config->tft_backlight_value);
-            _config_loader.save(*_device_config);
-            _communication.send_packet(Command::ACK);
-            break;
-        }
+void Controller::handle(const messages::SetBacklight& message) {
+    // The snapshot and flash are updated by the job task; only the ACK is sent here
+    ConfigJob job;
+    job.kind = ConfigJob::Kind::BACKLIGHT;
+    job.backlight = message.brightness;
+    if (xQueueSend(_config_jobs, &job, pdMS_TO_TICKS(CONFIG_JOB_SUBMIT_TIMEOUT_MS)) != pdTRUE) {
+        stats::add(stats::Counter::CONFIG_JOBS_REJECTED);
+        _communication.send_err(ErrorCode::BUSY);
+        return;
+    }
 
-        case Command::GET_STATUS: {
-            std::vector<uint8_t> status_data;
-            status_data.push_back(_is_awake ? 1 : 0);
-            status_data.push_back(_device_config->tft_backlight_value);
-            status_data.push_back(_segments.size());
-            _communication.send_packet(Command::STATUS_DATA, status_data);
-            break;
-        }
-        
-        default:
-            _communication.send_err(ErrorCode::INVALID_COMMAND);
-            break;
+    // Only once the job is queued, so a rejected change leaves the hardware as the config says.
+    // Not waiting for jobs queued before it keeps brightness ramps smooth.
+    {
+        auto state = _state.read(READER_COMM);
+        hal::analog_write(state->config.tft_backlight_pin, message.brightness);
     }
+    _communication.send_packet(Command::ACK);
 }
 
-void Controller::apply_config_changes(const DeviceConfig &new_config) {
-    if (new_config.tft_backlight_pin != _device_config->tft_backlight_pin) {
-        pinMode(new_config.tft_backlight_pin, OUTPUT);
+void Controller::handle(const messages::RunBenchmark& message) {
+    ConfigJob job;
+    job.kind = ConfigJob::Kind::BENCHMARK;
+    job.benchmarks = message.suites.value_or(benchmark::SUITE_ALL) & benchmark::SUITE_ALL;
+    submit_config_job(job);
+}
+
+void Controller::handle(const messages::GetTaskInfo&) {
+    uint8_t info[1 + rtos::TASK_COUNT * 4];
+    size_t size = 0;
+    info[size++] = rtos::TASK_COUNT;
+    for (const rtos::TaskSpec& task : rtos::TASKS) {
+        uint16_t free_min = rtos::stack_high_water_mark(task.id);
+        info[size++] = task.stack_size & 0xFF;
+        info[size++] = task.stack_size >> 8;
+        info[size++] = free_min & 0xFF;
+        info[size++] = free_min >> 8;
     }
-    if (new_config.tft_backlight_value != _device_config->tft_backlight_value ||
-        new_config.tft_backlight_pin != _device_config->tft_backlight_pin ) {
-        analogWrite(new_config.tft_backlight_pin, new_config.tft_backlight_value);
+    _communication.send_packet(Command::TASK_INFO, info, size);
+}
+
+void Controller::handle(const messages::GetStatus&) {
+    messages::StatusData status;
+    {
+        auto state = _state.read(READER_COMM);
+        status.awake = _is_awake;
+        status.backlight = state->config.tft_backlight_value;
+        status.segment_count = state->config.segment_count;
     }
+    _communication.send(status);
+}
 
-    if (new_config.do_sleep != _device_config->do_sleep) {
-        if (new_config.do_sleep && !_watchdog_task_handle) {
-            xTaskCreate(watchdog_task, "Watchdog Task", 2048, this, 1, &_watchdog_task_handle);
-        } else if (!new_config.do_sleep && _watchdog_task_handle) {
-            vTaskDelete(_watchdog_task_handle);
-            _watchdog_task_handle = nullptr;
-        }
+void Controller::handle(const messages::GetStats& message) {
+    if (message.interval_ms.present) {
+        _stats_interval_ms = message.interval_ms.value;
     }
+    send_stats();
+}
 
-    if (new_config.baudrate != _device_config->baudrate) {
-        _communication.change_baudrate(new_config.baudrate);
+void Controller::handle(const messages::GetLatency& message) {
+    size_t size;
+    const uint8_t* payload = latency::snapshot(size);
+    _communication.send_packet(Command::LATENCY_DATA, payload, size);
+    if (message.reset.value_or(0) != 0) {
+        latency::reset();
     }
+}
 
-    if (new_config.segments.size() > _device_config->segments.size()) {
-        for (size_t i = _device_config->segments.size(); i < new_config.segments.size(); i++) {
-            _segments.push_back(Segment::create_and_init(i, new_config.segments[i], _communication, new_config.tft_dc_pin, &spi));
-        }
-    } else if (new_config.segments.size() < _device_config->segments.size()) {
-        _segments.resize(new_config.segments.size());
-    }
-
-    if (new_config.spi_clk_pin != _device_config->spi_clk_pin ||
-        new_config.spi_data_pin != _device_config->spi_data_pin) {
-        spi.end();
-        spi.begin(
-            new_config.spi_clk_pin,  // sck
-            -1,                      // miso
-            new_config.spi_data_pin, // mosi
-            -1                       // ss/cs
-        );
+#ifdef SLIDR_PROFILER
+void Controller::handle(const messages::ProfileControl& message) {
+    if (message.rate_hz == 0) {
+        profiler::stop();
+    } else if (!profiler::start(message.rate_hz)) {
+        _communication.send_err(ErrorCode::INVALID_DATA);
+        return;
+    }
+    _communication.send_packet(Command::ACK);
+}
+
+void Controller::handle(const messages::ProfileDump&) {
+    profiler::dump(_communication);
+}
+#endif
+
+#ifdef SLIDR_TRACE
+void Controller::handle(const messages::TraceDump&) {
+    trace::dump(_communication);
+}
+#endif
+
+#ifdef SLIDR_CAPTURE
+void Controller::handle(const messages::CaptureDump&) {
+    capture::dump(_communication);
+}
+#endif
+
+void Controller::apply_config_changes(State &next, const DeviceConfig &new_config) {
+    const DeviceConfig old_config = next.config;
+    next.config = new_config;
+
+    if (new_config.tft_backlight_pin != old_config.tft_backlight_pin) {
+        hal::pin_mode(new_config.tft_backlight_pin, hal::PinDirection::OUT);
     }
-    if (new_config.spi_speed_hz != _device_config->spi_speed_hz) {
-        spi.setFrequency(new_config.spi_speed_hz);
+    if (new_config.tft_backlight_value != old_config.tft_backlight_value ||
+        new_config.tft_backlight_pin != old_config.tft_backlight_pin ) {
+        hal::analog_write(new_config.tft_backlight_pin, new_config.tft_backlight_value);
+    }
+
+    if (new_config.baudrate != old_config.baudrate) {
+        _communication.change_baudrate(new_config.baudrate);
     }
-    if (new_config.tft_dc_pin != _device_config->tft_dc_pin) {
-        for (auto& segment : _segments) {
-            segment->set_dc_pin(new_config.tft_dc_pin);
+
+    if (new_config.segment_count > old_config.segment_count) {
+        for (uint8_t i = old_config.segment_count; i < new_config.segment_count; i++) {
+            hal::pin_mode(new_config.segments[i].pot_pin, hal::PinDirection::IN);
+            next.segments[i] = Segment::create_and_init(i, new_config.segments[i], _communication, new_config.tft_dc_pin, new_config.spi_speed_hz);
+        }
+    } else {
+        // Dropped segments are destroyed once no reader can see them anymore
+        for (uint8_t i = new_config.segment_count; i < old_config.segment_count; i++) {
+            next.segments[i].reset();
         }
     }
 
-    for (size_t i = 0; i < new_config.segments.size(); i++) {
-        auto& old_seg = _device_config->segments[i];
+    if (new_config.spi_clk_pin != old_config.spi_clk_pin ||
+        new_config.spi_data_pin != old_config.spi_data_pin) {
+        restart_spi(new_config);
+    }
+    for (uint8_t i = 0; i < new_config.segment_count; i++) {
+        auto& old_seg = old_config.segments[i];
         auto& new_seg = new_config.segments[i];
         // Newly created segments are already configured
-        if (i >= _device_config->segments.size()) break;
+        if (i >= old_config.segment_count) break;
 
-        if (new_seg.tft_cs_pin != old_seg.tft_cs_pin) {
-            _segments[i] = Segment::create_and_init(i, new_seg, _communication, new_config.tft_dc_pin, &spi);
-            continue;
+        // The published state still draws on the old segments, so pin changes get new ones
+        if (new_seg.tft_cs_pin != old_seg.tft_cs_pin || new_config.tft_dc_pin != old_config.tft_dc_pin) {
+            next.segments[i] = Segment::create_and_init(i, new_seg, _communication, new_config.tft_dc_pin, new_config.spi_speed_hz);
         }
-
         if (new_seg.pot_pin != old_seg.pot_pin) {
-            _segments[i]->config().pot_pin = new_seg.pot_pin;
+            hal::pin_mode(new_seg.pot_pin, hal::PinDirection::IN);
         }
-        if (new_seg.pot_min_value != old_seg.pot_min_value) {
-            _segments[i]->config().pot_min_value = new_seg.pot_min_value;
+        // Calibration is read from the published config, nothing to do for min/max
+    }
+
+    if (new_config.spi_speed_hz != old_config.spi_speed_hz) {
+        // Also the published segments, they drive the same panels
+        for (uint8_t i = 0; i < new_config.segment_count; i++) {
+            next.segments[i]->set_spi_speed(new_config.spi_speed_hz);
         }
-        if (new_seg.pot_max_value != old_seg.pot_max_value) {
-            _segments[i]->config().pot_max_value = new_seg.pot_max_value;
+    }
+}
+
+void Controller::apply_config_field(State &next, config_schema::FieldPath path) {
+    using config_schema::DeviceField;
+    using config_schema::SegmentField;
+    const DeviceConfig& new_config = next.config;
+
+    if (path.is_segment()) {
+        uint8_t i = path.segment;
+        const auto& new_seg = new_config.segments[i];
+        switch (path.segment_field()) {
+            case SegmentField::TFT_CS_PIN:
+                next.segments[i] = Segment::create_and_init(i, new_seg, _communication, new_config.tft_dc_pin, new_config.spi_speed_hz);
+                break;
+            case SegmentField::POT_PIN:
+                hal::pin_mode(new_seg.pot_pin, hal::PinDirection::IN);
+                break;
+            case SegmentField::POT_MIN_VALUE:
+            case SegmentField::POT_MAX_VALUE:
+                // Calibration is read from the published config
+                break;
+            default:
+                break;
         }
+        return;
+    }
+
+    switch (path.device_field()) {
+        case DeviceField::SPI_CLK_PIN:
+        case DeviceField::SPI_DATA_PIN:
+            restart_spi(new_config);
+            break;
+        case DeviceField::TFT_DC_PIN:
+            // As for `TFT_CS_PIN`, the published segments are left alone
+            for (uint8_t i = 0; i < new_config.segment_count; i++) {
+                next.segments[i] = Segment::create_and_init(i, new_config.segments[i], _communication, new_config.tft_dc_pin, new_config.spi_speed_hz);
+            }
+            break;
+        case DeviceField::TFT_BACKLIGHT_PIN:
+            hal::pin_mode(new_config.tft_backlight_pin, hal::PinDirection::OUT);
+            hal::analog_write(new_config.tft_backlight_pin, new_config.tft_backlight_value);
+            break;
+        case DeviceField::TFT_BACKLIGHT_VALUE:
+            hal::analog_write(new_config.tft_backlight_pin, new_config.tft_backlight_value);
+            break;
+        case DeviceField::SPI_SPEED_HZ:
+            for (uint8_t i = 0; i < new_config.segment_count; i++) {
+                next.segments[i]->set_spi_speed(new_config.spi_speed_hz);
+            }
+            break;
+        case DeviceField::BAUDRATE:
+            _communication.change_baudrate(new_config.baudrate);
+            break;
+        case DeviceField::DO_SLEEP:        // Read by the watchdog task
+        case DeviceField::WAIT_FOR_SERIAL: // Only used during boot
+        default:
+            break;
+    }
+}
+
+void Controller::restart_spi(const DeviceConfig &config) {
+    hal::spi_begin(config.spi_clk_pin, config.spi_data_pin);
+}
+
+void Controller::submit_config_job(ConfigJob &job) {
+    // The comm task is the only producer, so a free slot stays free until the send below
+    if (uxQueueSpacesAvailable(_config_jobs) == 0) {
+        stats::add(stats::Counter::CONFIG_JOBS_REJECTED);
+        _communication.send_err(ErrorCode::BUSY);
+        return;
     }
+
+    job.id = _next_job_id++;
+    if (_next_job_id == 0) _next_job_id = 1;
+
+    // ACK first so the host always sees the job ID before its completion event
+    _communication.send(messages::Ack{ job.id });
+    xQueueSend(_config_jobs, &job, 0);
 }
 
-void Controller::on_file_received(const std::string &path) {
-    for (uint8_t i = 0; i < _segments.size(); i++) {
-        if (path == Segment::get_image_path(i)) {
-            _segments[i]->load_and_display_image();
+void Controller::run_config_job(const ConfigJob &job) {
+    TRACE_SCOPE(CONFIG_JOB, job.id);
+    if (job.kind == ConfigJob::Kind::BENCHMARK) {
+        run_benchmark(job);
+        return;
+    }
+
+    uint32_t start_us = hal::micros();
+    ErrorCode result = ErrorCode::NONE;
+
+    State& next = _state.prepare();
+    switch (job.kind) {
+        case ConfigJob::Kind::REPLACE:
+            apply_config_changes(next, job.config);
+            break;
+
+        case ConfigJob::Kind::PATCH: {
+            config_schema::FieldPath paths[MAX_PATCH_FIELDS];
+            size_t count = 0;
+            if (!config_schema::decode_patch(job.patch, job.patch_size, next.config, paths, MAX_PATCH_FIELDS, count)) {
+                result = ErrorCode::INVALID_CONFIG;
+                break;
+            }
+            for (size_t i = 0; i < count; i++) {
+                apply_config_field(next, paths[i]);
+            }
             break;
         }
+
+        case ConfigJob::Kind::BACKLIGHT:
+            // Written again in case a job that ran in between set a different value
+            next.config.tft_backlight_value = job.backlight;
+            hal::analog_write(next.config.tft_backlight_pin, job.backlight);
+            break;
+
+        case ConfigJob::Kind::BENCHMARK:
+            break; // Does not change the config, see `run_benchmark()`
+    }
+
+    if (result == ErrorCode::NONE) {
+        _config_persister.request_save(next.config);
+        _state.publish();
+    } else {
+        _state.cancel();
+        stats::add(stats::Counter::CONFIG_JOB_ERRORS);
+    }
+    stats::add(stats::Counter::CONFIG_JOBS);
+
+    if (job.kind == ConfigJob::Kind::BACKLIGHT) return;
+
+    _communication.send(messages::ConfigApplied{ job.id, result, hal::micros() - start_us });
+}
+
+void Controller::run_benchmark(const ConfigJob &job) {
+    benchmark::Results results;
+    {
+        auto state = _state.read(READER_CONFIG_JOB);
+        const DeviceConfig& config = state->config;
+
+        if (job.benchmarks & benchmark::SUITE_FILESYSTEM) {
+            benchmark::filesystem(results);
+        }
+        if ((job.benchmarks & benchmark::SUITE_BLIT) && config.segment_count > 0) {
+            // Panels are identical, one is enough
+            Segment& segment = *state->segments[0];
+            for (uint32_t spi_hz : benchmark::BLIT_SPI_HZ) {
+                results.add(benchmark::Id::BLIT, spi_hz, segment.benchmark_blit(spi_hz));
+            }
+            if (_is_awake) {
+                segment.load_and_display_image();
+            }
+        }
+        if ((job.benchmarks & benchmark::SUITE_ADC) && config.segment_count > 0) {
+            benchmark::adc(config.segments[0].pot_pin, results);
+        }
+    }
+    if (job.benchmarks & benchmark::SUITE_RX_PARSE) {
+        benchmark::rx_parse(results);
+    }
+    if (job.benchmarks & benchmark::SUITE_CHECKSUM) {
+        benchmark::checksums(results);
+    }
+
+    uint8_t payload[2 + 1 + benchmark::Results::CAPACITY * benchmark::Results::ENTRY_SIZE];
+    payload[0] = job.id & 0xFF;
+    payload[1] = job.id >> 8;
+    size_t size = 2 + results.serialize(payload + 2, sizeof(payload) - 2);
+    _communication.send_packet(Command::BENCHMARK_DATA, payload, size);
+}
+
+void Controller::on_file_received(const char *path) {
+    auto state = _state.read(READER_COMM);
+    for (uint8_t i = 0; i < state->config.segment_count; i++) {
+        if (strcmp(path, state->segments[i]->image_path()) == 0) {
+            state->segments[i]->load_and_display_image();
+            break;
+        }
+    }
+}
+
+void Controller::on_firmware_updated() {
+    _config_persister.flush();
+    hal::delay_ms(RESTART_DELAY_MS);
+    hal::firmware().restart();
+}
+
+void Controller::confirm_firmware() {
+    uint8_t boots = _trial_boots.exchange(0);
+    if (!boots) return;
+    hal::firmware().confirm();
+    SLIDR_LOG(_communication, FIRMWARE_CONFIRMED, boots);
+    _communication.set_firmware_updates_enabled(true);
+}
+
+void Controller::check_firmware_trial() {
+    if (!_trial_boots || hal::millis() < FIRMWARE_TRIAL_MS || _trial_boots.exchange(0) == 0) return;
+
+    SLIDR_LOG(_communication, FIRMWARE_ROLLBACK, FIRMWARE_TRIAL_MS);
+    _config_persister.flush();
+    hal::delay_ms(RESTART_DELAY_MS);
+    hal::firmware().rollback();
+
+    SLIDR_LOG(_communication, FIRMWARE_ROLLBACK_FAILED);
+    hal::firmware().confirm();
+    _communication.set_firmware_updates_enabled(true);
+}
+
+void Controller::send_stats() {
+    uint8_t payload[stats::SNAPSHOT_SIZE];
+    size_t size = stats::snapshot(payload);
+    _communication.send_packet(Command::STATS_DATA, payload, size);
+    _last_stats_ms = hal::millis();
+}
+
+void Controller::push_stats() {
+    if (_stats_interval_ms != 0 && _booted && hal::millis() - _last_stats_ms >= _stats_interval_ms) {
+        send_stats();
     }
 }
 
 void Controller::wake_up() {
     _is_awake = true;
-    analogWrite(_device_config->tft_backlight_pin, _device_config->tft_backlight_value);
-    for (auto& segment : _segments) {
-        segment->load_and_display_image();
+    stats::add(stats::Counter::WAKEUPS);
+    auto state = _state.read(READER_COMM);
+    hal::analog_write(state->config.tft_backlight_pin, state->config.tft_backlight_value);
+    for (uint8_t i = 0; i < state->config.segment_count; i++) {
+        state->segments[i]->load_and_display_image();
     }
 }
 
 void Controller::sleep() {
     _is_awake = false;
-    analogWrite(_device_config->tft_backlight_pin, 0);
-    for (auto& segment : _segments) {
-        segment->sleep();
+    stats::add(stats::Counter::SLEEPS);
+    _config_persister.flush();
+    auto state = _state.read(READER_WATCHDOG);
+    hal::analog_write(state->config.tft_backlight_pin, 0);
+    for (uint8_t i = 0; i < state->config.segment_count; i++) {
+        state->segments[i]->sleep();
     }
 }
 
@@ -254,6 +658,8 @@ void Controller::comm_task(void *param) {
     auto* controller = static_cast<Controller*>(param);
     while (true) {
         controller->_communication.update();
+        controller->report_boot();
+        controller->push_stats();
         vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 }
@@ -262,11 +668,14 @@ void Controller::segment_task(void *param) {
     auto* controller = static_cast<Controller*>(param);
     while (true) {
         if (controller->_is_awake) {
-            for (uint8_t i = 0; i < controller->_segments.size(); i++) {
+            HEAP_STEADY_STATE(heap_trace::Subsystem::SEGMENT);
+            auto state = controller->_state.read(READER_SEGMENT);
+            TRACE_SCOPE(ADC_TICK, state->config.segment_count);
+            for (uint8_t i = 0; i < state->config.segment_count; i++) {
                 uint8_t vol;
-                if (controller->_segments[i]->has_volume_changed(vol)) {
-                    uint8_t payload[2] = { i, vol };
-                    controller->_communication.send_packet(Command::SLIDER_VALUE, payload, sizeof(payload));
+                if (state->segments[i]->has_volume_changed(state->config.segments[i], vol)) {
+                    controller->_communication.send(messages::SliderValue{ i, vol });
+                    stats::add(stats::Counter::SLIDER_EVENTS);
                 }
             }
         }
@@ -277,10 +686,29 @@ void Controller::segment_task(void *param) {
 void Controller::watchdog_task(void *param) {
     auto* controller = static_cast<Controller*>(param);
     while (true) {
-        if (controller->_is_awake &&
-            (millis() - controller->_communication.last_packet_time()) > Controller::PING_TIMEOUT_MS) {
+        bool do_sleep;
+        {
+            auto state = controller->_state.read(READER_WATCHDOG);
+            do_sleep = state->config.do_sleep;
+        }
+        if (do_sleep && controller->_is_awake &&
+            (hal::millis() - controller->_communication.last_packet_time()) > Controller::PING_TIMEOUT_MS) {
             controller->sleep();
         }
+        controller->check_firmware_trial();
+#ifdef SLIDR_HEAP_TRACE
+        heap_trace::report_violations(controller->_communication);
+#endif
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 }
+
+void Controller::config_job_task(void *param) {
+    auto* controller = static_cast<Controller*>(param);
+    ConfigJob job;
+    while (true) {
+        if (xQueueReceive(controller->_config_jobs, &job, portMAX_DELAY) == pdTRUE) {
+            controller->run_config_job(job);
+        }
+    }
+}
@@ -5,11 +5,15 @@
 
 #include "Config.h"
 #include "ConfigLoader.h"
+#include "ConfigPersister.h"
 #include "Communication.h"
+#include "Messages.h"
+#include "Rcu.h"
+#include "Rtos.h"
 #include "Segment.h"
 
+#include <atomic>
 #include <cinttypes>
-#include <vector>
 #include <memory>
 
 class Controller {
@@ -20,29 +24,143 @@ public:
     void begin();
 
 private:
+    /// @brief Config and segment table, published together as one immutable snapshot
+    struct State {
+        DeviceConfig config;
+        std::shared_ptr<Segment> segments[MAX_SEGMENTS];
+    };
+
+    /// @brief `_state` reader slots, one per task that reads it
+    enum ReaderSlot : size_t {
+        READER_BOOT,
+        READER_COMM,
+        READER_SEGMENT,
+        READER_WATCHDOG,
+        READER_CONFIG_JOB,
+        READER_COUNT
+    };
+
+    static constexpr size_t MAX_PATCH_FIELDS = 32;
+    static constexpr size_t MAX_PATCH_SIZE = 1 + MAX_PATCH_FIELDS * (sizeof(config_schema::FieldPath) + sizeof(uint32_t));
+
+    /// @brief A config change queued by the comm task and applied by the config job task,
+    /// which is the only writer of `_state`. Benchmarks go through the same queue because they
+    /// take over the panels and the bus.
+    struct ConfigJob {
+        enum class Kind : uint8_t {
+            REPLACE,   // SET_CONFIG, DEFAULT_CONFIG
+            PATCH,     // PATCH_CONFIG
+            BACKLIGHT, // SET_BACKLIGHT, hardware also updated by the comm task once queued
+            BENCHMARK  // RUN_BENCHMARK
+        };
+        Kind kind;
+        uint16_t id;
+        uint16_t patch_size;
+        union {
+            DeviceConfig config;
+            uint8_t patch[MAX_PATCH_SIZE];
+            uint8_t backlight;
+            uint8_t benchmarks; // `benchmark::Suite` mask
+        };
+    };
+
     void create_tasks();
-    void init_hardware();
-    void handle_command(Communication::packet_t packet);
-    void apply_config_changes(const DeviceConfig& new_config);
-    void on_file_received(const std::string& path);
+    /// @brief Bring up SPI, create the panels for `config` and send their first init stage.
+    /// Does not need the filesystem. The panels are published by `finish_panels()`.
+    void start_panels(const DeviceConfig& config);
+    /// @brief Run every panel init stage whose wait is over, each on all panels at once.
+    /// @return `true` once all stages have run and settled
+    bool advance_panels();
+    /// @brief Wait for the remaining init stages and publish the first state
+    void finish_panels();
+    /// @brief Draw each segment's image and turn on the backlight
+    void load_images();
+    void handle_command(const Communication::packet_t& packet);
+    // Commands after boot, decoded by `messages::dispatch()`
+    void handle(const messages::SetConfig& message);
+    void handle(const messages::PatchConfig& message);
+    void handle(const messages::GetConfig& message);
+    void handle(const messages::DefaultConfig& message);
+    void handle(const messages::SetBacklight& message);
+    void handle(const messages::RunBenchmark& message);
+    void handle(const messages::GetTaskInfo& message);
+    void handle(const messages::GetStatus& message);
+    void handle(const messages::GetStats& message);
+    void handle(const messages::GetLatency& message);
+#ifdef SLIDR_PROFILER
+    void handle(const messages::ProfileControl& message);
+    void handle(const messages::ProfileDump& message);
+#endif
+#ifdef SLIDR_TRACE
+    void handle(const messages::TraceDump& message);
+#endif
+#ifdef SLIDR_CAPTURE
+    void handle(const messages::CaptureDump& message);
+#endif
+    /// @brief Commands this build does not serve, and those consumed by `Communication` that
+    /// reach it out of place (`ACK` without a download)
+    template <typename Message>
+    void handle(const Message&) {
+        _communication.send_err(ErrorCode::INVALID_COMMAND);
+    }
+    /// @brief Log the boot profile once boot is done and, with `wait_for_serial`, a host is connected
+    void report_boot();
+    /// @brief Reconfigure hardware for `new_config` and update the prepared state to match
+    /// @param next Prepared copy of the current state, still holding the old config
+    void apply_config_changes(State& next, const DeviceConfig& new_config);
+    /// @brief Reconfigure only what `path` affects. `next.config` already holds the new value.
+    void apply_config_field(State& next, config_schema::FieldPath path);
+    void restart_spi(const DeviceConfig& config);
+    /// @brief Queue a config job and ACK it with its ID. Replies `BUSY` if the queue is full.
+    void submit_config_job(ConfigJob& job);
+    void run_config_job(const ConfigJob& job);
+    /// @brief Run the selected benchmarks and send `BENCHMARK_DATA`. Config job task only.
+    void run_benchmark(const ConfigJob& job);
+    void on_file_received(const char* path);
+    /// @brief Restart into the update `Communication` has just written
+    void on_firmware_updated();
+    /// @brief End the trial of the running firmware, if it is on one. Comm task only.
+    void confirm_firmware();
+    /// @brief Go back to the previous firmware if the running one was not confirmed in time
+    void check_firmware_trial();
+    /// @brief Send `STATS_DATA`. Comm task only.
+    void send_stats();
+    /// @brief Send `STATS_DATA` if the interval set by `GET_STATS` has passed
+    void push_stats();
     void wake_up();
     void sleep();
 
     static void comm_task(void* param);
     static void segment_task(void* param);
     static void watchdog_task(void* param);
+    static void config_job_task(void* param);
 
     ConfigLoader _config_loader;
-    std::shared_ptr<DeviceConfig> _device_config;
-    std::vector<std::unique_ptr<Segment>> _segments;
+    ConfigPersister _config_persister;
+    Rcu<State, READER_COUNT> _state;
     Communication _communication;
-    bool _is_awake;
-    TaskHandle_t _segment_task_handle;
-    TaskHandle_t _comm_task_handle;
-    TaskHandle_t _watchdog_task_handle;
+    std::atomic<bool> _is_awake;
+    rtos::Queue<ConfigJob, rtos::CONFIG_JOB_QUEUE_LENGTH> _config_jobs;
+    uint16_t _next_job_id = 1;
+    std::atomic<bool> _booted{ false };
+    bool _boot_reported = false;
+    State* _booting_state = nullptr;
+    uint8_t _panel_stage = 0;
+    uint32_t _panel_stage_ready_ms = 0;
+    uint16_t _stats_interval_ms = 0; // 0: only on request
+    uint32_t _last_stats_ms = 0;
+    std::atomic<uint8_t> _trial_boots{ 0 }; // 0: the running firmware is confirmed
 
     static constexpr uint32_t PING_TIMEOUT_MS = 10000;
+    /// @brief An updated firmware is on trial until the first `PING` after boot. It is rolled back
+    /// when it boots more often than this without one, e.g. because it crashes during boot.
+    static constexpr uint8_t MAX_TRIAL_BOOTS = 3;
+    /// @brief Also rolled back when no host pings it this long after boot
+    static constexpr uint32_t FIRMWARE_TRIAL_MS = 60000;
+    /// @brief Time for the last replies to reach the host before a restart
+    static constexpr uint32_t RESTART_DELAY_MS = 200;
     static constexpr uint8_t SLIDER_POLL_INTERVAL_MS = 50;
+    static constexpr uint32_t CONFIG_JOB_SUBMIT_TIMEOUT_MS = 100;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+/// Table-driven CRC-32 (IEEE 802.3, reflected, as used by zlib). Header-only so host tools
+/// produce identical values.
+namespace crc32 {
+
+struct Table {
+    uint32_t entries[256];
+};
+
+constexpr Table make_table() {
+    Table table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        }
+        table.entries[i] = c;
+    }
+    return table;
+}
+
+constexpr Table TABLE = make_table();
+
+/// @brief Continue a CRC over `data`. Pass the previous result as `crc` to checksum in pieces.
+/// @param data Pointer to the data buffer
+/// @param size Size of the data buffer
+/// @param crc Result of the previous call, 0 to start
+/// @return Updated CRC
+constexpr uint32_t update(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = TABLE.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+constexpr uint8_t CHECK_INPUT[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+static_assert(update(CHECK_INPUT, sizeof(CHECK_INPUT)) == 0xCBF43926u, "CRC-32 check value mismatch");
+
+} // namespace crc32
+
+#endif // CRC32_H
@@ -14,6 +14,7 @@ DeviceConfig DEFAULT_CONFIG = {
     .baudrate = 115200,
     .wait_for_serial = true,
     .do_sleep = false,
+    .segment_count = 5,
     .segments = {
         {
             .tft_cs_pin = 8,
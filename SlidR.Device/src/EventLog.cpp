@@ -0,0 +1,48 @@
+#include "EventLog.h"
+#include "Hal.h"
+#include "Stats.h"
+
+#include <FreeRTOS.h>
+
+namespace event_log {
+
+namespace {
+
+struct RateState {
+    uint32_t window_start_ms;
+    uint16_t sent;
+    uint16_t suppressed;
+};
+
+RateState rate_states[static_cast<size_t>(LogId::COUNT)] = {};
+portMUX_TYPE rate_mux = portMUX_INITIALIZER_UNLOCKED;
+
+} // namespace
+
+bool admit(LogId id, uint16_t& suppressed) {
+    uint32_t now = hal::millis();
+
+    portENTER_CRITICAL(&rate_mux);
+    RateState& state = rate_states[static_cast<size_t>(id)];
+    if (now - state.window_start_ms >= RATE_LIMIT_WINDOW_MS) {
+        state.window_start_ms = now;
+        state.sent = 0;
+    }
+
+    bool admitted = state.sent < RATE_LIMIT_BURST;
+    if (admitted) {
+        state.sent++;
+        suppressed = state.suppressed;
+        state.suppressed = 0;
+    } else if (state.suppressed < UINT16_MAX) {
+        state.suppressed++;
+    }
+    portEXIT_CRITICAL(&rate_mux);
+
+    if (!admitted) {
+        stats::add(stats::Counter::LOG_EVENTS_SUPPRESSED);
+    }
+    return admitted;
+}
+
+} // namespace event_log
@@ -0,0 +1,186 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#pragma once
+
+#include "LogMessages.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+/// @brief Lowest level that is compiled in: 0 debug, 1 info, 2 warn, 3 error
+#ifndef SLIDR_LOG_LEVEL
+#define SLIDR_LOG_LEVEL 1
+#endif
+
+/// @brief Structured logging. A log call sends the message ID and its arguments packed
+/// little-endian (`LOG_EVENT`); formatting happens on the host from the `LogMessages.h` table.
+///
+/// The format strings are only evaluated at compile time to check and pack the arguments,
+/// so they do not end up in the firmware.
+namespace event_log {
+
+enum class Level : uint8_t {
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3
+};
+
+enum class LogId : uint16_t {
+#define SLIDR_LOG_ID(name, level, format) name,
+    SLIDR_LOG_MESSAGES(SLIDR_LOG_ID)
+#undef SLIDR_LOG_ID
+    COUNT
+};
+
+struct Message {
+    Level level;
+    const char* format;
+};
+
+constexpr Message MESSAGES[] = {
+#define SLIDR_LOG_MESSAGE(name, level, format) { Level::level, format },
+    SLIDR_LOG_MESSAGES(SLIDR_LOG_MESSAGE)
+#undef SLIDR_LOG_MESSAGE
+};
+
+constexpr const Message& message(LogId id) {
+    return MESSAGES[static_cast<size_t>(id)];
+}
+
+constexpr bool enabled(LogId id) {
+    return static_cast<uint8_t>(message(id).level) >= SLIDR_LOG_LEVEL;
+}
+
+/// @brief Per message, at most `RATE_LIMIT_BURST` events are sent per `RATE_LIMIT_WINDOW_MS`.
+/// Dropped events are counted and reported with the next one that is sent.
+constexpr uint8_t RATE_LIMIT_BURST = 8;
+constexpr uint32_t RATE_LIMIT_WINDOW_MS = 1000;
+constexpr size_t MAX_EVENT_SIZE = 96;
+
+/// @brief Check the rate limit of `id` and count the event
+/// @param suppressed Events of `id` dropped since the last one that was sent
+/// @return `false` if the event must be dropped
+bool admit(LogId id, uint16_t& suppressed);
+
+enum class ArgType : uint8_t { NONE, U8, U16, U32, STRING, INVALID };
+
+constexpr bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/// @brief Type of the conversion starting at `format[pos]` (just after the `%`). Sets `pos` past it.
+constexpr ArgType parse_conversion(const char* format, size_t& pos) {
+    while (format[pos] == '-' || format[pos] == '+' || format[pos] == ' ' || format[pos] == '#' || format[pos] == '0') pos++;
+    while (is_digit(format[pos]) || format[pos] == '.') pos++;
+
+    ArgType type = ArgType::U32;
+    if (format[pos] == 'h' && format[pos + 1] == 'h') {
+        type = ArgType::U8;
+        pos += 2;
+    } else if (format[pos] == 'h') {
+        type = ArgType::U16;
+        pos++;
+    }
+
+    switch (format[pos++]) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            return type;
+        case 's':
+            return type == ArgType::U32 ? ArgType::STRING : ArgType::INVALID;
+        default:
+            return ArgType::INVALID;
+    }
+}
+
+/// @brief Type of argument `index` of `format`, `NONE` past the last one
+constexpr ArgType arg_type(const char* format, size_t index) {
+    size_t pos = 0;
+    size_t current = 0;
+    while (format[pos]) {
+        if (format[pos++] != '%') continue;
+        if (format[pos] == '%') {
+            pos++;
+            continue;
+        }
+        ArgType type = parse_conversion(format, pos);
+        if (current++ == index) return type;
+    }
+    return ArgType::NONE;
+}
+
+constexpr size_t arg_count(const char* format) {
+    size_t count = 0;
+    while (arg_type(format, count) != ArgType::NONE) count++;
+    return count;
+}
+
+constexpr size_t arg_width(ArgType type) {
+    return type == ArgType::U8 ? 1 : type == ArgType::U16 ? 2 : 4;
+}
+
+template <typename T>
+constexpr bool accepts(ArgType type) {
+    using U = std::decay_t<T>;
+    if (type == ArgType::STRING) {
+        return std::is_same<U, const char*>::value || std::is_same<U, char*>::value;
+    }
+    if (type == ArgType::U8 || type == ArgType::U16 || type == ArgType::U32) {
+        return std::is_integral<U>::value && sizeof(U) <= arg_width(type);
+    }
+    return false;
+}
+
+/// @brief Bounded little-endian writer for event payloads. Strings are truncated to fit.
+struct Packer {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+
+    void put_int(uint32_t value, size_t width) {
+        for (size_t i = 0; i < width && size < capacity; i++) {
+            data[size++] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    void put_string(const char* value) {
+        size_t length = strlen(value);
+        size_t room = size < capacity ? capacity - size - 1 : 0;
+        if (length > room) length = room;
+        if (length > 255) length = 255;
+        put_int(length, 1);
+        memcpy(data + size, value, length);
+        size += length;
+    }
+};
+
+template <LogId Id, size_t Index>
+void pack(Packer&) {
+    static_assert(Index == arg_count(message(Id).format), "Too few arguments for this log message");
+}
+
+template <LogId Id, size_t Index, typename T, typename... Rest>
+void pack(Packer& out, const T& value, const Rest&... rest) {
+    constexpr ArgType type = arg_type(message(Id).format, Index);
+    static_assert(type != ArgType::NONE, "Too many arguments for this log message");
+    static_assert(type != ArgType::INVALID, "Unsupported conversion in log message format");
+    static_assert(accepts<T>(type), "Argument does not match the log message format");
+
+    if constexpr (type == ArgType::STRING) {
+        out.put_string(value);
+    } else {
+        out.put_int(static_cast<uint32_t>(value), arg_width(type));
+    }
+    pack<Id, Index + 1>(out, rest...);
+}
+
+} // namespace event_log
+
+/// @brief Send log message `name` from `LogMessages.h` with its arguments
+#define SLIDR_LOG(communication, name, ...) \
+    (communication).log_event<event_log::LogId::name>(__VA_ARGS__)
+
+#endif
@@ -0,0 +1,89 @@
+#include "FirmwareUpdate.h"
+#include "Messages.h"
+
+const char* FirmwareUpdate::status_name(Status status) {
+    switch (status) {
+        case Status::OK: return "ok";
+        case Status::TOO_LARGE: return "image too large";
+        case Status::NO_MEMORY: return "no memory for the inflater";
+        case Status::WRITE_FAILED: return "partition write failed";
+        case Status::CORRUPT: return "corrupt stream";
+        case Status::SIZE_MISMATCH: return "size mismatch";
+        case Status::DIGEST_MISMATCH: return "SHA-256 mismatch";
+        case Status::INVALID_IMAGE: return "invalid image";
+    }
+    return "?";
+}
+
+FirmwareUpdate::Status FirmwareUpdate::begin(uint32_t size, uint8_t flags, const sha256::Digest& digest) {
+    abort();
+
+    if (flags & messages::OTA_FLAG_COMPRESSED) {
+        _inflater = hal::create_inflater();
+        if (!_inflater) return Status::NO_MEMORY;
+    }
+    if (!hal::firmware().begin(size)) {
+        _inflater.reset();
+        return Status::TOO_LARGE;
+    }
+
+    _hasher = sha256::Hasher();
+    _digest = digest;
+    _size = size;
+    _received = 0;
+    _written = 0;
+    _stream_done = false;
+    _write_failed = false;
+    _active = true;
+    return Status::OK;
+}
+
+FirmwareUpdate::Status FirmwareUpdate::write(const ByteView& data) {
+    _received += data.size();
+    bool ok;
+    if (!_inflater) {
+        ok = write_image(this, data.data(), data.size());
+    } else if (_stream_done) {
+        ok = false;
+    } else {
+        auto result = _inflater->push(data.data(), data.size(), write_image, this);
+        _stream_done = result == hal::Inflater::Result::DONE;
+        ok = result != hal::Inflater::Result::ERROR;
+    }
+    if (ok) return Status::OK;
+    return fail(_write_failed ? Status::WRITE_FAILED : Status::CORRUPT);
+}
+
+bool FirmwareUpdate::write_image(void* context, const uint8_t* data, size_t size) {
+    auto* update = static_cast<FirmwareUpdate*>(context);
+    if (size > update->_size - update->_written) return false;
+    if (!hal::firmware().write(data, size)) {
+        update->_write_failed = true;
+        return false;
+    }
+    update->_hasher.update(data, size);
+    update->_written += size;
+    return true;
+}
+
+FirmwareUpdate::Status FirmwareUpdate::finish() {
+    if ((_inflater && !_stream_done) || _written != _size) return fail(Status::SIZE_MISMATCH);
+    if (_hasher.finish() != _digest) return fail(Status::DIGEST_MISMATCH);
+
+    _active = false;
+    _inflater.reset();
+    return hal::firmware().finish() ? Status::OK : Status::INVALID_IMAGE;
+}
+
+void FirmwareUpdate::abort() {
+    if (_active) {
+        hal::firmware().abort();
+        _active = false;
+    }
+    _inflater.reset();
+}
+
+FirmwareUpdate::Status FirmwareUpdate::fail(Status status) {
+    abort();
+    return status;
+}
@@ -0,0 +1,66 @@
+#ifndef FIRMWARE_UPDATE_H
+#define FIRMWARE_UPDATE_H
+
+#pragma once
+
+#include "FrameParser.h"
+#include "Hal.h"
+#include "Sha256.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+
+/// @brief Streams a firmware image from `OTA_DATA` packets into the update partition,
+/// inflating it first if it was sent compressed, and checks its size and SHA-256 before the
+/// partition is switched. Owned by `Communication`, which sends the replies.
+class FirmwareUpdate {
+public:
+    enum class Status : uint8_t {
+        OK,
+        TOO_LARGE,       // No update partition, or the image does not fit in it
+        NO_MEMORY,       // No room for the inflater
+        WRITE_FAILED,
+        CORRUPT,         // Compressed stream invalid, or longer than the image
+        SIZE_MISMATCH,   // Stream ended with fewer bytes than announced
+        DIGEST_MISMATCH,
+        INVALID_IMAGE    // Rejected by the partition, e.g. not an app image for this chip
+    };
+
+    static const char* status_name(Status status);
+
+    /// @brief Start an update, dropping any unfinished one
+    /// @param size Image size after decompression
+    /// @param flags `messages::OTA_FLAG_*`
+    Status begin(uint32_t size, uint8_t flags, const sha256::Digest& digest);
+    /// @brief Write the next piece of the stream. An update that fails is aborted.
+    Status write(const ByteView& data);
+    /// @brief Check size and digest and make the image the boot partition
+    Status finish();
+    void abort();
+
+    bool active() const { return _active; }
+    /// @brief Stream bytes received, compressed if the image is
+    uint32_t received() const { return _received; }
+    /// @brief Image bytes written to the partition
+    uint32_t written() const { return _written; }
+    bool compressed() const { return _inflater != nullptr; }
+
+private:
+    /// @brief `hal::Inflater::Sink` writing to the partition
+    static bool write_image(void* context, const uint8_t* data, size_t size);
+
+    Status fail(Status status);
+
+    std::unique_ptr<hal::Inflater> _inflater;
+    sha256::Hasher _hasher;
+    sha256::Digest _digest{};
+    bool _active = false;
+    bool _stream_done = false;
+    bool _write_failed = false;
+    uint32_t _size = 0;
+    uint32_t _received = 0;
+    uint32_t _written = 0;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+#pragma once
+
+#include "ProtocolConstants.h"
+
+#include <cinttypes>
+#include <cstddef>
+
+/// @brief Non-owning view of a received payload. Only valid while the packet is being handled.
+struct ByteView {
+    const uint8_t* ptr;
+    uint16_t length;
+
+    const uint8_t* data() const { return ptr; }
+    uint16_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    uint8_t operator[](size_t index) const { return ptr[index]; }
+};
+
+/// @brief Reassembles packets from the serial byte stream
+/// @tparam MaxPacketSize Buffer size for command, length, payload and checksum
+template <size_t MaxPacketSize>
+class FrameParser {
+public:
+    enum class Result : uint8_t {
+        NONE,           // Need more bytes
+        PACKET,         // `command()` and `payload()` hold a valid packet
+        CHECKSUM_ERROR, // Packet complete but corrupt, see `received_checksum()`
+        OVERFLOW        // Announced payload does not fit, see `expected_size()`
+    };
+
+    /// @brief Feed the next received byte
+    Result push(uint8_t byte) {
+        if (!_in_packet) {
+            if (byte == START_BYTE) {
+                _index = 0;
+                _in_packet = true;
+            }
+            return Result::NONE;
+        }
+
+        _buffer[_index++] = byte;
+
+        if (_index == 3) {
+            _expected_size = _buffer[1] | (_buffer[2] << 8);
+            if (_expected_size > MaxPacketSize - 4) {
+                _in_packet = false;
+                return Result::OVERFLOW;
+            }
+        }
+
+        if (_index >= 3 && _index == static_cast<size_t>(_expected_size) + 4) {
+            _in_packet = false;
+            _received_checksum = _buffer[_index - 1];
+            _calculated_checksum = checksum(_buffer, _index - 1);
+            return _received_checksum == _calculated_checksum ? Result::PACKET : Result::CHECKSUM_ERROR;
+        }
+        return Result::NONE;
+    }
+
+    /// @brief Drop a partially received packet
+    void reset() {
+        _in_packet = false;
+        _index = 0;
+    }
+
+    /// @brief Whether a start byte was seen and the packet is not complete yet
+    bool in_packet() const {
+        return _in_packet;
+    }
+
+    Command command() const {
+        return static_cast<Command>(_buffer[0]);
+    }
+    ByteView payload() const {
+        return ByteView{ _buffer + 3, _expected_size };
+    }
+    uint16_t expected_size() const {
+        return _expected_size;
+    }
+    uint8_t received_checksum() const {
+        return _received_checksum;
+    }
+    uint8_t calculated_checksum() const {
+        return _calculated_checksum;
+    }
+
+    /// @brief XOR of `size` bytes
+    static uint8_t checksum(const uint8_t* data, size_t size) {
+        uint8_t result = 0;
+        for (size_t i = 0; i < size; ++i) {
+            result ^= data[i];
+        }
+        return result;
+    }
+
+private:
+    uint8_t _buffer[MaxPacketSize];
+    size_t _index = 0;
+    bool _in_packet = false;
+    uint16_t _expected_size = 0;
+    uint8_t _received_checksum = 0;
+    uint8_t _calculated_checksum = 0;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef HAL_H
+#define HAL_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+
+#ifdef ARDUINO
+#include <FS.h>
+#else
+#include <cstdio>
+#endif
+
+/// @brief Everything the firmware logic needs from the board: clock, GPIO and ADC, the serial
+/// transport, the filesystem, the panels on the SPI bus and the app partitions.
+///
+/// `HalEsp32.cpp` implements it with the Arduino core (USB CDC, LittleFS, Adafruit ST7735) and
+/// ESP-IDF (OTA partitions, the ROM inflater).
+/// PlatformIO env `native` links `HalNative.cpp` instead, see `HalNative.h`, together with the
+/// FreeRTOS API on POSIX threads from `lib/PosixFreeRTOS`, so the firmware runs on Linux.
+namespace hal {
+
+uint32_t millis();
+uint32_t micros();
+/// @brief Microseconds since boot without the 71 minute wrap of `micros()`
+uint64_t micros64();
+/// @brief Block the calling task
+void delay_ms(uint32_t ms);
+
+/// @brief Not `INPUT`/`OUTPUT`, the Arduino core defines those as macros
+enum class PinDirection : uint8_t { IN, OUT };
+void pin_mode(uint8_t pin, PinDirection direction);
+/// @brief 8-bit PWM duty cycle, drives the backlight
+void analog_write(uint8_t pin, uint8_t value);
+/// @brief 12-bit ADC reading
+uint16_t analog_read(uint8_t pin);
+
+/// @brief Free heap now and the lowest it has been, in bytes. `0` where not measured.
+uint32_t free_heap();
+uint32_t min_free_heap();
+
+/// @brief Byte stream to the host. Only the comm task reads; writers serialize themselves.
+class Transport {
+public:
+    /// @brief Bytes received while the comm task is busy that are kept rather than dropped.
+    /// Hosts streaming without a reply per packet keep at most this much in flight.
+    static constexpr size_t RX_BUFFER_SIZE = 8192;
+
+    virtual ~Transport() = default;
+
+    virtual void begin(uint32_t baudrate) = 0;
+    /// @brief Whether a host has the port open
+    virtual bool connected() = 0;
+    /// @brief Read what has been received, up to `size` bytes, without blocking
+    /// @return Number of bytes read, `0` if none
+    virtual size_t read(uint8_t* buffer, size_t size) = 0;
+    virtual size_t write(const uint8_t* data, size_t size) = 0;
+};
+
+Transport& transport();
+
+#ifdef ARDUINO
+using File = fs::File;
+#else
+/// @brief Open host file with the subset of the `fs::File` interface the firmware uses.
+/// Copies share the file, which is closed with the last one, as with `fs::File`.
+class File {
+public:
+    File() = default;
+    explicit File(std::FILE* file);
+
+    explicit operator bool() const { return _file != nullptr; }
+    size_t read(uint8_t* buffer, size_t size);
+    size_t write(const uint8_t* data, size_t size);
+    size_t position() const;
+    size_t size() const;
+    int available() const { return _file ? static_cast<int>(size() - position()) : 0; }
+    void close() { _file.reset(); }
+
+private:
+    std::shared_ptr<std::FILE> _file;
+};
+#endif
+
+/// @brief The data partition. Paths are absolute, as on LittleFS.
+class FileSystem {
+public:
+    virtual ~FileSystem() = default;
+
+    /// @brief Mount, formatting first if `format_on_fail` and the partition does not mount
+    virtual bool begin(bool format_on_fail) = 0;
+    /// @param mode `"r"` or `"w"`
+    virtual File open(const char* path, const char* mode) = 0;
+    virtual bool exists(const char* path) = 0;
+    virtual bool remove(const char* path) = 0;
+    virtual bool rename(const char* from, const char* to) = 0;
+    virtual bool mkdir(const char* path) = 0;
+};
+
+FileSystem& filesystem();
+
+/// @brief (Re)start the SPI bus the panels share
+void spi_begin(int8_t clk_pin, int8_t data_pin);
+
+/// @brief A 128x128 RGB565 panel on the shared SPI bus
+class Panel {
+public:
+    static constexpr int16_t SIZE = 128;
+    /// @brief Stages of `init_stage()`: controller init, then orientation and a black screen
+    static constexpr uint8_t INIT_STAGE_COUNT = 5;
+    static constexpr uint16_t BLACK = 0x0000;
+
+    virtual ~Panel() = default;
+
+    /// @brief Run one init stage without waiting, so panels sharing the bus can run a stage
+    /// one after another and wait it out together
+    /// @param stage `0` to `INIT_STAGE_COUNT - 1`
+    /// @return Milliseconds the panel needs before the next stage
+    virtual uint16_t init_stage(uint8_t stage) = 0;
+    virtual void set_dc_pin(uint8_t dc) = 0;
+    virtual void fill(uint16_t color) = 0;
+
+    /// @brief Pixel writes go between `begin_write()` and `end_write()`
+    virtual void begin_write() = 0;
+    virtual void set_window(int16_t x, int16_t y, int16_t width, int16_t height) = 0;
+    /// @brief Stream pixels into the window, row by row
+    /// @param pixels Big-endian RGB565, as stored in image files
+    virtual void write_pixels(const uint16_t* pixels, size_t count) = 0;
+    virtual void end_write() = 0;
+
+    /// @brief The panel's SPI clock, `DeviceConfig::spi_speed_hz`. Each panel runs its own
+    /// transactions, so this is per panel rather than per bus.
+    virtual void set_spi_speed(uint32_t hz) = 0;
+    /// @brief Use `hz` until `reset_spi_speed()` returns to the `set_spi_speed()` clock
+    virtual void override_spi_speed(uint32_t hz) = 0;
+    virtual void reset_spi_speed() = 0;
+};
+
+std::unique_ptr<Panel> create_panel(uint8_t cs_pin, uint8_t dc_pin);
+
+/// @brief Streaming zlib (RFC 1950) decompressor
+class Inflater {
+public:
+    enum class Result : uint8_t {
+        MORE,  // All input used, the stream continues
+        DONE,  // End of the stream, checksum verified
+        ERROR  // Corrupt stream, data after its end, or the sink refused
+    };
+    /// @brief Takes decompressed data as it is produced. Return `false` to stop.
+    using Sink = bool (*)(void* context, const uint8_t* data, size_t size);
+
+    virtual ~Inflater() = default;
+
+    /// @brief Decompress the next `size` bytes of the stream into `sink`
+    virtual Result push(const uint8_t* data, size_t size, Sink sink, void* context) = 0;
+};
+
+/// @return `nullptr` if the decompressor and its 32 KiB window do not fit in the heap
+std::unique_ptr<Inflater> create_inflater();
+
+/// @brief The app partitions. An update is written to the one not running while the firmware
+/// keeps going, then booted on trial: until `confirm()` it counts its boots and may `rollback()`.
+class Firmware {
+public:
+    virtual ~Firmware() = default;
+
+    /// @brief Start writing an image to the partition not running. Flash is erased as the writes
+    /// reach it, so no call blocks for long.
+    /// @return `false` if there is no such partition or the image does not fit in it
+    virtual bool begin(uint32_t size) = 0;
+    virtual bool write(const uint8_t* data, size_t size) = 0;
+    /// @brief Validate the written image and boot it, on trial, from the next restart
+    virtual bool finish() = 0;
+    /// @brief Drop a started image. The running firmware stays the boot partition.
+    virtual void abort() = 0;
+
+    /// @brief Count this boot if the running firmware is on trial. Call once per boot.
+    /// @return Trial boots including this one, `0` if the firmware is confirmed
+    virtual uint8_t count_trial_boot() = 0;
+    /// @brief Keep the running firmware and end its trial
+    virtual void confirm() = 0;
+    /// @brief Make the previous firmware the boot partition again and restart
+    /// @return Only on failure, `false` if there is no valid previous firmware
+    virtual bool rollback() = 0;
+    [[noreturn]] virtual void restart() = 0;
+};
+
+Firmware& firmware();
+
+} // namespace hal
+
+#endif
@@ -0,0 +1,281 @@
+#include "Hal.h"
+#include "ST7735.h"
+
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <SPI.h>
+#include <USBCDC.h>
+#include <esp32s2/rom/miniz.h>
+#include <esp_ota_ops.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <new>
+
+namespace hal {
+
+namespace {
+
+SPIClass spi(FSPI);
+
+class SerialTransport : public Transport {
+public:
+    void begin(uint32_t baudrate) override {
+        Serial.setRxBufferSize(RX_BUFFER_SIZE);
+        Serial.begin(baudrate);
+        Serial.setTimeout(1000);
+    }
+    bool connected() override { return static_cast<bool>(Serial); }
+    size_t read(uint8_t* buffer, size_t size) override { return Serial.read(buffer, size); }
+    size_t write(const uint8_t* data, size_t size) override { return Serial.write(data, size); }
+};
+
+class LittleFileSystem : public FileSystem {
+public:
+    bool begin(bool format_on_fail) override { return LittleFS.begin(format_on_fail); }
+    File open(const char* path, const char* mode) override { return LittleFS.open(path, mode); }
+    bool exists(const char* path) override { return LittleFS.exists(path); }
+    bool remove(const char* path) override { return LittleFS.remove(path); }
+    bool rename(const char* from, const char* to) override { return LittleFS.rename(from, to); }
+    bool mkdir(const char* path) override { return LittleFS.mkdir(path); }
+};
+
+class St7735Panel : public Panel {
+public:
+    St7735Panel(uint8_t cs_pin, uint8_t dc_pin) : _tft(cs_pin, &spi, dc_pin, -1) {}
+
+    uint16_t init_stage(uint8_t stage) override {
+        if (stage < static_cast<uint8_t>(ST7735::InitStage::COUNT)) {
+            return _tft.initStage(static_cast<ST7735::InitStage>(stage), _spi_hz);
+        }
+
+        _tft.setRotation(0);
+        _tft.setColRowStart(2, 1);
+        _tft.fillScreen(BLACK);
+        _tft.invertDisplay(true);
+        return 0;
+    }
+
+    void set_dc_pin(uint8_t dc) override { _tft.setDcPin(dc); }
+    void fill(uint16_t color) override { _tft.fillScreen(color); }
+    void begin_write() override { _tft.startWrite(); }
+    void set_window(int16_t x, int16_t y, int16_t width, int16_t height) override {
+        _tft.setAddrWindow(x, y, width, height);
+    }
+    void write_pixels(const uint16_t* pixels, size_t count) override {
+        // Big-endian data is sent as is, the buffer is not modified
+        _tft.writePixels(const_cast<uint16_t*>(pixels), count, true, true);
+    }
+    void end_write() override { _tft.endWrite(); }
+
+    // Adafruit_SPITFT applies its own SPI settings on every transaction, and `begin()` resets
+    // them, so the clock is kept here and passed to the first init stage
+    void set_spi_speed(uint32_t hz) override {
+        _spi_hz = hz;
+        _tft.setSPISpeed(hz);
+    }
+    void override_spi_speed(uint32_t hz) override { _tft.setSPISpeed(hz); }
+    void reset_spi_speed() override { _tft.setSPISpeed(_spi_hz); }
+
+private:
+    ST7735 _tft;
+    uint32_t _spi_hz = SPI_DEFAULT_FREQ;
+};
+
+static_assert(ST7735::PANEL_SIZE == Panel::SIZE, "Panel size mismatch");
+static_assert(static_cast<uint8_t>(ST7735::InitStage::COUNT) + 1 == Panel::INIT_STAGE_COUNT,
+              "The last init stage is orientation and clear");
+
+/// @brief The inflater in ROM. Output goes through a ring buffer the size of the largest
+/// deflate window, which doubles as the dictionary.
+class RomInflater : public Inflater {
+public:
+    RomInflater() {
+        tinfl_init(&_decompressor);
+    }
+
+    Result push(const uint8_t* data, size_t size, Sink sink, void* context) override {
+        while (true) {
+            size_t in_size = size;
+            size_t out_size = TINFL_LZ_DICT_SIZE - _out_pos;
+            tinfl_status status = tinfl_decompress(&_decompressor, data, &in_size, _window, _window + _out_pos, &out_size,
+                TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT | TINFL_FLAG_COMPUTE_ADLER32);
+            data += in_size;
+            size -= in_size;
+            if (out_size && !sink(context, _window + _out_pos, out_size)) return Result::ERROR;
+            _out_pos = (_out_pos + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+
+            if (status == TINFL_STATUS_DONE) return size == 0 ? Result::DONE : Result::ERROR;
+            if (status < TINFL_STATUS_DONE) return Result::ERROR;
+            if (status == TINFL_STATUS_NEEDS_MORE_INPUT && size == 0) return Result::MORE;
+        }
+    }
+
+private:
+    tinfl_decompressor _decompressor;
+    size_t _out_pos = 0;
+    uint8_t _window[TINFL_LZ_DICT_SIZE];
+};
+
+/// @brief ESP-IDF OTA partitions. The trial is counted in NVS rather than left to the bootloader,
+/// whose rollback the Arduino core builds without; `verifyRollbackLater()` below keeps the core
+/// from confirming images itself where it is built in.
+class OtaFirmware : public Firmware {
+public:
+    bool begin(uint32_t size) override {
+        abort();
+        _partition = esp_ota_get_next_update_partition(nullptr);
+        if (!_partition || size > _partition->size) return false;
+        // Sequential writes erase each sector when it is reached instead of the whole image up front
+        if (esp_ota_begin(_partition, OTA_WITH_SEQUENTIAL_WRITES, &_handle) != ESP_OK) {
+            _handle = 0;
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const uint8_t* data, size_t size) override {
+        return _handle && esp_ota_write(_handle, data, size) == ESP_OK;
+    }
+
+    bool finish() override {
+        if (!_handle) return false;
+        // Checks the image header, segments and its own SHA-256
+        esp_err_t result = esp_ota_end(_handle);
+        _handle = 0;
+        if (result != ESP_OK || esp_ota_set_boot_partition(_partition) != ESP_OK) return false;
+
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE, false)) return false;
+        bool ok = prefs.putUChar(TRIAL_BOOTS_KEY, 0) == sizeof(uint8_t);
+        prefs.end();
+        return ok;
+    }
+
+    void abort() override {
+        if (_handle) {
+            esp_ota_abort(_handle);
+            _handle = 0;
+        }
+    }
+
+    uint8_t count_trial_boot() override {
+        Preferences prefs;
+        if (!prefs.begin(NVS_NAMESPACE, false)) return 0;
+        uint8_t boots = 0;
+        if (prefs.isKey(TRIAL_BOOTS_KEY)) {
+            boots = prefs.getUChar(TRIAL_BOOTS_KEY) + 1;
+            prefs.putUChar(TRIAL_BOOTS_KEY, boots);
+        }
+        prefs.end();
+        return boots;
+    }
+
+    void confirm() override {
+        Preferences prefs;
+        if (prefs.begin(NVS_NAMESPACE, false)) {
+            prefs.remove(TRIAL_BOOTS_KEY);
+            prefs.end();
+        }
+        esp_ota_mark_app_valid_cancel_rollback();
+    }
+
+    bool rollback() override {
+        // With two app partitions the update partition is the one this firmware was written from
+        const esp_partition_t* previous = esp_ota_get_next_update_partition(nullptr);
+        if (!previous || esp_ota_set_boot_partition(previous) != ESP_OK) return false;
+        confirm();
+        restart();
+    }
+
+    [[noreturn]] void restart() override {
+        esp_restart();
+    }
+
+private:
+    static constexpr const char* NVS_NAMESPACE = "slidr_fw";
+    static constexpr const char* TRIAL_BOOTS_KEY = "trial_boots";
+
+    const esp_partition_t* _partition = nullptr;
+    esp_ota_handle_t _handle = 0;
+};
+
+SerialTransport serial_transport;
+LittleFileSystem little_fs;
+OtaFirmware ota_firmware;
+
+} // namespace
+
+uint32_t millis() {
+    return ::millis();
+}
+
+uint32_t micros() {
+    return ::micros();
+}
+
+uint64_t micros64() {
+    return esp_timer_get_time();
+}
+
+void delay_ms(uint32_t ms) {
+    ::delay(ms);
+}
+
+void pin_mode(uint8_t pin, PinDirection direction) {
+    ::pinMode(pin, direction == PinDirection::OUT ? OUTPUT : INPUT);
+}
+
+void analog_write(uint8_t pin, uint8_t value) {
+    ::analogWrite(pin, value);
+}
+
+uint16_t analog_read(uint8_t pin) {
+    return ::analogRead(pin);
+}
+
+uint32_t free_heap() {
+    return ESP.getFreeHeap();
+}
+
+uint32_t min_free_heap() {
+    return ESP.getMinFreeHeap();
+}
+
+Transport& transport() {
+    return serial_transport;
+}
+
+FileSystem& filesystem() {
+    return little_fs;
+}
+
+void spi_begin(int8_t clk_pin, int8_t data_pin) {
+    spi.end();
+    spi.begin(
+        clk_pin,  // sck
+        -1,       // miso
+        data_pin, // mosi
+        -1        // ss/cs
+    );
+}
+
+std::unique_ptr<Panel> create_panel(uint8_t cs_pin, uint8_t dc_pin) {
+    return std::make_unique<St7735Panel>(cs_pin, dc_pin);
+}
+
+std::unique_ptr<Inflater> create_inflater() {
+    return std::unique_ptr<Inflater>(new (std::nothrow) RomInflater());
+}
+
+Firmware& firmware() {
+    return ota_firmware;
+}
+
+} // namespace hal
+
+/// @brief Images are confirmed by `Controller` once a host has talked to them, see `hal::Firmware`
+bool verifyRollbackLater() {
+    return true;
+}
@@ -0,0 +1,452 @@
+#include "HalNative.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <poll.h>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace hal {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point start_time = Clock::now();
+
+native::FdTransport stdio_transport(STDIN_FILENO, STDOUT_FILENO);
+native::DirectoryFileSystem directory_fs("native_fs");
+native::FileFirmware file_firmware("native_firmware.bin");
+Transport* active_transport = &stdio_transport;
+FileSystem* active_filesystem = &directory_fs;
+Firmware* active_firmware = &file_firmware;
+
+constexpr size_t PIN_COUNT = 256;
+std::atomic<uint16_t> analog_inputs[PIN_COUNT] = {};
+std::atomic<uint8_t> analog_outputs[PIN_COUNT] = {};
+
+native::Timing timing;
+
+std::mutex panels_mutex;
+std::set<const native::FakePanel*> panels;
+
+// Settle times of `ST7735::initStage()`, so native boots see the same waits
+constexpr uint16_t INIT_STAGE_WAIT_MS[Panel::INIT_STAGE_COUNT] = { 150, 500, 10, 100, 0 };
+
+/// @brief Let `us` microseconds of simulated hardware time pass. Short waits are collected per
+/// thread until they add up to a millisecond, as sleeping is not more precise than that.
+void spend_us(uint64_t us) {
+    thread_local int64_t debt_us = 0;
+    debt_us += us;
+    if (debt_us < 1000) return;
+
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::microseconds(debt_us));
+    debt_us -= std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+void spend_bytes(size_t size, uint32_t bytes_per_s) {
+    if (bytes_per_s) spend_us(static_cast<uint64_t>(size) * 1000000 / bytes_per_s);
+}
+
+void spend_flash_op() {
+    spend_us(timing.flash_op_us);
+}
+
+class ZlibInflater : public Inflater {
+public:
+    ZlibInflater() {
+        _ok = inflateInit(&_stream) == Z_OK;
+    }
+
+    ~ZlibInflater() override {
+        if (_ok) inflateEnd(&_stream);
+    }
+
+    Result push(const uint8_t* data, size_t size, Sink sink, void* context) override {
+        if (!_ok) return Result::ERROR;
+        _stream.next_in = const_cast<uint8_t*>(data);
+        _stream.avail_in = size;
+        while (true) {
+            uint8_t out[4096];
+            _stream.next_out = out;
+            _stream.avail_out = sizeof(out);
+            int status = inflate(&_stream, Z_NO_FLUSH);
+            size_t produced = sizeof(out) - _stream.avail_out;
+            if (produced && !sink(context, out, produced)) return Result::ERROR;
+
+            if (status == Z_STREAM_END) return _stream.avail_in == 0 ? Result::DONE : Result::ERROR;
+            if (status != Z_OK && status != Z_BUF_ERROR) return Result::ERROR;
+            if (_stream.avail_in == 0 && _stream.avail_out != 0) return Result::MORE;
+        }
+    }
+
+private:
+    z_stream _stream{};
+    bool _ok;
+};
+
+} // namespace
+
+uint32_t millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time).count();
+}
+
+uint32_t micros() {
+    return micros64();
+}
+
+uint64_t micros64() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_time).count();
+}
+
+void delay_ms(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void pin_mode(uint8_t pin, PinDirection direction) {}
+
+void analog_write(uint8_t pin, uint8_t value) {
+    analog_outputs[pin] = value;
+}
+
+uint16_t analog_read(uint8_t pin) {
+    return analog_inputs[pin];
+}
+
+uint32_t free_heap() {
+    return 0;
+}
+
+uint32_t min_free_heap() {
+    return 0;
+}
+
+Transport& transport() {
+    return *active_transport;
+}
+
+FileSystem& filesystem() {
+    return *active_filesystem;
+}
+
+void spi_begin(int8_t clk_pin, int8_t data_pin) {}
+
+std::unique_ptr<Panel> create_panel(uint8_t cs_pin, uint8_t dc_pin) {
+    return std::make_unique<native::FakePanel>(cs_pin, dc_pin);
+}
+
+std::unique_ptr<Inflater> create_inflater() {
+    return std::make_unique<ZlibInflater>();
+}
+
+Firmware& firmware() {
+    return *active_firmware;
+}
+
+File::File(std::FILE* file) : _file(file, [](std::FILE* f) { std::fclose(f); }) {}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!_file) return 0;
+    size_t read = std::fread(buffer, 1, size, _file.get());
+    spend_bytes(read, timing.flash_read_bytes_per_s);
+    return read;
+}
+
+size_t File::write(const uint8_t* data, size_t size) {
+    if (!_file) return 0;
+    size_t written = std::fwrite(data, 1, size, _file.get());
+    spend_bytes(written, timing.flash_write_bytes_per_s);
+    return written;
+}
+
+size_t File::position() const {
+    if (!_file) return 0;
+    long position = std::ftell(_file.get());
+    return position < 0 ? 0 : position;
+}
+
+size_t File::size() const {
+    if (!_file) return 0;
+    // Buffered writes are not in the host file yet
+    std::fflush(_file.get());
+    struct stat info;
+    return fstat(fileno(_file.get()), &info) == 0 ? info.st_size : 0;
+}
+
+namespace native {
+
+void FdTransport::begin(uint32_t baudrate) {
+    _connected = true;
+}
+
+size_t FdTransport::read(uint8_t* buffer, size_t size) {
+    if (!_connected) return 0;
+    pollfd fd{ _in_fd, POLLIN, 0 };
+    if (poll(&fd, 1, 0) <= 0) return 0;
+
+    ssize_t result = ::read(_in_fd, buffer, size);
+    if (result > 0) return result;
+    if (result == 0 || (errno != EAGAIN && errno != EINTR)) {
+        _connected = false;
+    }
+    return 0;
+}
+
+size_t FdTransport::write(const uint8_t* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = ::write(_out_fd, data + written, size - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                pollfd fd{ _out_fd, POLLOUT, 0 };
+                if (poll(&fd, 1, WRITE_TIMEOUT_MS) > 0) continue;
+            }
+            break;
+        }
+        written += result;
+    }
+    return written;
+}
+
+size_t MemoryTransport::read(uint8_t* buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size = std::min(size, _rx.size());
+    std::copy_n(_rx.begin(), size, buffer);
+    _rx.erase(_rx.begin(), _rx.begin() + size);
+    return size;
+}
+
+size_t MemoryTransport::write(const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tx.insert(_tx.end(), data, data + size);
+    return size;
+}
+
+void MemoryTransport::push(const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _rx.insert(_rx.end(), data, data + size);
+}
+
+std::vector<uint8_t> MemoryTransport::take() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Copied out so `_tx` keeps its capacity and the device's writes stop allocating, as on USB CDC
+    std::vector<uint8_t> tx(_tx.begin(), _tx.end());
+    _tx.clear();
+    return tx;
+}
+
+bool DirectoryFileSystem::begin(bool format_on_fail) {
+    struct stat info;
+    if (stat(_root.c_str(), &info) == 0) return S_ISDIR(info.st_mode);
+    return format_on_fail && ::mkdir(_root.c_str(), 0755) == 0;
+}
+
+File DirectoryFileSystem::open(const char* path, const char* mode) {
+    // Binary mode and no "+": the firmware only ever reads or writes a file whole
+    const char* host_mode = mode[0] == 'w' ? "wb" : mode[0] == 'a' ? "ab" : "rb";
+    spend_flash_op();
+    std::FILE* file = std::fopen(host_path(path).c_str(), host_mode);
+    return file ? File(file) : File();
+}
+
+bool DirectoryFileSystem::exists(const char* path) {
+    spend_flash_op();
+    struct stat info;
+    return stat(host_path(path).c_str(), &info) == 0;
+}
+
+bool DirectoryFileSystem::remove(const char* path) {
+    spend_flash_op();
+    return std::remove(host_path(path).c_str()) == 0;
+}
+
+bool DirectoryFileSystem::rename(const char* from, const char* to) {
+    spend_flash_op();
+    return std::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+}
+
+bool DirectoryFileSystem::mkdir(const char* path) {
+    spend_flash_op();
+    return ::mkdir(host_path(path).c_str(), 0755) == 0;
+}
+
+bool FileFirmware::begin(uint32_t size) {
+    abort();
+    if (size > CAPACITY) return false;
+    spend_flash_op();
+    _file = std::fopen((_path + ".part").c_str(), "wb");
+    return _file != nullptr;
+}
+
+bool FileFirmware::write(const uint8_t* data, size_t size) {
+    if (!_file) return false;
+    size_t written = std::fwrite(data, 1, size, _file);
+    spend_bytes(written, timing.flash_write_bytes_per_s);
+    return written == size;
+}
+
+bool FileFirmware::finish() {
+    if (!_file) return false;
+    bool ok = std::fclose(_file) == 0;
+    _file = nullptr;
+    spend_flash_op();
+    ok = ok && std::rename((_path + ".part").c_str(), _path.c_str()) == 0;
+    if (!ok) return false;
+
+    std::FILE* trial = std::fopen((_path + ".trial").c_str(), "w");
+    if (!trial) return false;
+    std::fputs("0\n", trial);
+    return std::fclose(trial) == 0;
+}
+
+void FileFirmware::abort() {
+    if (_file) {
+        std::fclose(_file);
+        _file = nullptr;
+        std::remove((_path + ".part").c_str());
+    }
+}
+
+uint8_t FileFirmware::count_trial_boot() {
+    std::string trial_path = _path + ".trial";
+    std::FILE* trial = std::fopen(trial_path.c_str(), "r");
+    if (!trial) return 0;
+    unsigned boots = 0;
+    if (std::fscanf(trial, "%u", &boots) != 1) boots = 0;
+    std::fclose(trial);
+
+    boots = std::min(boots + 1, 255u);
+    trial = std::fopen(trial_path.c_str(), "w");
+    if (trial) {
+        std::fprintf(trial, "%u\n", boots);
+        std::fclose(trial);
+    }
+    return boots;
+}
+
+void FileFirmware::confirm() {
+    std::remove((_path + ".trial").c_str());
+}
+
+bool FileFirmware::rollback() {
+    if (std::rename(_path.c_str(), (_path + ".rejected").c_str()) != 0) return false;
+    confirm();
+    FileFirmware::restart();
+}
+
+void FileFirmware::restart() {
+    fprintf(stderr, "slidr-sim: restart\n");
+    std::_Exit(0);
+}
+
+FakePanel::FakePanel(uint8_t cs_pin, uint8_t dc_pin) : _cs_pin(cs_pin), _dc_pin(dc_pin) {
+    std::lock_guard<std::mutex> lock(panels_mutex);
+    panels.insert(this);
+}
+
+FakePanel::~FakePanel() {
+    std::lock_guard<std::mutex> lock(panels_mutex);
+    panels.erase(this);
+}
+
+uint16_t FakePanel::init_stage(uint8_t stage) {
+    if (stage >= INIT_STAGE_COUNT) return 0;
+    if (stage == INIT_STAGE_COUNT - 1) {
+        fill(BLACK);
+        _initialized = true;
+    }
+    return INIT_STAGE_WAIT_MS[stage];
+}
+
+void FakePanel::fill(uint16_t color) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::fill(std::begin(_pixels), std::end(_pixels), color);
+    }
+    _pixels_written += SIZE * SIZE;
+    spend_pixels(SIZE * SIZE);
+}
+
+void FakePanel::set_window(int16_t x, int16_t y, int16_t width, int16_t height) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _window_x = x;
+    _window_y = y;
+    _window_width = std::max<int16_t>(width, 1);
+    _window_height = std::max<int16_t>(height, 1);
+    _cursor = 0;
+}
+
+void FakePanel::write_pixels(const uint16_t* pixels, size_t count) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto* bytes = reinterpret_cast<const uint8_t*>(pixels);
+        for (size_t i = 0; i < count; i++) {
+            put((bytes[i * 2] << 8) | bytes[i * 2 + 1]);
+        }
+    }
+    _pixels_written += count;
+    spend_pixels(count);
+}
+
+void FakePanel::spend_pixels(size_t count) {
+    if (!timing.spi_hz) return;
+    uint32_t hz = _spi_hz ? _spi_hz.load() : timing.spi_hz;
+    spend_us(static_cast<uint64_t>(count) * 16 * 1000000 / hz);
+}
+
+void FakePanel::put(uint16_t color) {
+    // Like the controller, wrap to the start of the window after its last pixel
+    int32_t x = _window_x + _cursor % _window_width;
+    int32_t y = _window_y + _cursor / _window_width;
+    if (x >= 0 && x < SIZE && y >= 0 && y < SIZE) {
+        _pixels[y * SIZE + x] = color;
+    }
+    _cursor = (_cursor + 1) % (static_cast<int32_t>(_window_width) * _window_height);
+}
+
+void FakePanel::copy_pixels(uint16_t (&out)[SIZE * SIZE]) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::copy(std::begin(_pixels), std::end(_pixels), out);
+}
+
+void set_timing(const Timing& new_timing) {
+    timing = new_timing;
+}
+
+void set_transport(Transport& transport) {
+    active_transport = &transport;
+}
+
+void set_filesystem(FileSystem& filesystem) {
+    active_filesystem = &filesystem;
+}
+
+void set_firmware(Firmware& firmware) {
+    active_firmware = &firmware;
+}
+
+void set_analog_input(uint8_t pin, uint16_t value) {
+    analog_inputs[pin] = value;
+}
+
+uint8_t analog_output(uint8_t pin) {
+    return analog_outputs[pin];
+}
+
+void for_each_panel(const std::function<void(const FakePanel&)>& visit) {
+    std::lock_guard<std::mutex> lock(panels_mutex);
+    for (const FakePanel* panel : panels) {
+        visit(*panel);
+    }
+}
+
+} // namespace native
+
+} // namespace hal
@@ -0,0 +1,184 @@
+#ifndef HALNATIVE_H
+#define HALNATIVE_H
+
+#pragma once
+
+#include "Hal.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// @brief Host implementations behind `Hal.h` for PlatformIO env `native`.
+///
+/// The defaults are a `FdTransport` on stdin/stdout, a `DirectoryFileSystem` in `./native_fs` and
+/// a `FileFirmware` in `./native_firmware.bin`; `set_transport()`, `set_filesystem()` and
+/// `set_firmware()` swap them before the controller starts. Panels are `FakePanel` framebuffers
+/// and analog inputs read whatever `set_analog_input()` last set. Compressed updates are inflated
+/// with zlib.
+namespace hal::native {
+
+/// @brief Transport over POSIX file descriptors: stdin/stdout, a pty or a socket.
+/// Disconnected once the input reaches end of file. Like USB CDC without a host, writes that
+/// make no progress for `WRITE_TIMEOUT_MS` are dropped.
+class FdTransport : public Transport {
+public:
+    FdTransport(int in_fd, int out_fd) : _in_fd(in_fd), _out_fd(out_fd) {}
+
+    void begin(uint32_t baudrate) override;
+    bool connected() override { return _connected; }
+    size_t read(uint8_t* buffer, size_t size) override;
+    size_t write(const uint8_t* data, size_t size) override;
+
+    static constexpr int WRITE_TIMEOUT_MS = 100;
+
+private:
+    int _in_fd;
+    int _out_fd;
+    std::atomic<bool> _connected{ true };
+};
+
+/// @brief In-memory transport: the host side pushes bytes in and takes the device's bytes out
+class MemoryTransport : public Transport {
+public:
+    void begin(uint32_t baudrate) override {}
+    bool connected() override { return _connected; }
+    size_t read(uint8_t* buffer, size_t size) override;
+    size_t write(const uint8_t* data, size_t size) override;
+
+    void set_connected(bool connected) { _connected = connected; }
+    /// @brief Queue bytes for the device to receive
+    void push(const uint8_t* data, size_t size);
+    /// @brief Remove and return everything the device has sent
+    std::vector<uint8_t> take();
+
+private:
+    std::mutex _mutex;
+    std::deque<uint8_t> _rx;
+    std::vector<uint8_t> _tx;
+    std::atomic<bool> _connected{ true };
+};
+
+/// @brief The data partition as a host directory. `begin()` creates it if needed.
+class DirectoryFileSystem : public FileSystem {
+public:
+    explicit DirectoryFileSystem(std::string root) : _root(std::move(root)) {}
+
+    bool begin(bool format_on_fail) override;
+    File open(const char* path, const char* mode) override;
+    bool exists(const char* path) override;
+    bool remove(const char* path) override;
+    bool rename(const char* from, const char* to) override;
+    bool mkdir(const char* path) override;
+
+    const std::string& root() const { return _root; }
+
+private:
+    std::string host_path(const char* path) const { return _root + path; }
+
+    std::string _root;
+};
+
+/// @brief The update partition as a host file. An image is written to `<path>.part` and renamed
+/// to `path` when finished; `<path>.trial` holds the trial boot count until it is confirmed.
+/// A restart exits the process, the next run counts as the next boot.
+class FileFirmware : public Firmware {
+public:
+    explicit FileFirmware(std::string path) : _path(std::move(path)) {}
+
+    bool begin(uint32_t size) override;
+    bool write(const uint8_t* data, size_t size) override;
+    bool finish() override;
+    void abort() override;
+    uint8_t count_trial_boot() override;
+    void confirm() override;
+    /// @brief Moves the image to `<path>.rejected`
+    bool rollback() override;
+    [[noreturn]] void restart() override;
+
+    const std::string& path() const { return _path; }
+
+    static constexpr uint32_t CAPACITY = 0x140000; // The 1.25 MiB app partitions of the ESP32-S2 layout
+
+private:
+    std::string _path;
+    std::FILE* _file = nullptr;
+};
+
+/// @brief Framebuffer recording the pixels written to the panel, in image file colors
+class FakePanel : public Panel {
+public:
+    FakePanel(uint8_t cs_pin, uint8_t dc_pin);
+    ~FakePanel() override;
+
+    uint16_t init_stage(uint8_t stage) override;
+    void set_dc_pin(uint8_t dc) override { _dc_pin = dc; }
+    void fill(uint16_t color) override;
+    void begin_write() override {}
+    void set_window(int16_t x, int16_t y, int16_t width, int16_t height) override;
+    void write_pixels(const uint16_t* pixels, size_t count) override;
+    void end_write() override {}
+    void set_spi_speed(uint32_t hz) override { _configured_spi_hz = _spi_hz = hz; }
+    void override_spi_speed(uint32_t hz) override { _spi_hz = hz; }
+    void reset_spi_speed() override { _spi_hz = _configured_spi_hz.load(); }
+
+    uint8_t cs_pin() const { return _cs_pin; }
+    /// @brief Whether every init stage has run
+    bool initialized() const { return _initialized; }
+    /// @brief Copy the pixels out, RGB565, row by row
+    void copy_pixels(uint16_t (&out)[SIZE * SIZE]) const;
+    /// @brief Pixels written since the panel was created, to tell when it changed
+    uint32_t pixels_written() const { return _pixels_written; }
+
+private:
+    void put(uint16_t color);
+    /// @brief Bus time of `count` pixels under the SPI timing model
+    void spend_pixels(size_t count);
+
+    uint8_t _cs_pin;
+    uint8_t _dc_pin;
+    std::atomic<bool> _initialized{ false };
+    std::atomic<uint32_t> _configured_spi_hz{ 0 };
+    std::atomic<uint32_t> _spi_hz{ 0 }; // 0: `Timing::spi_hz`
+    std::atomic<uint32_t> _pixels_written{ 0 };
+
+    mutable std::mutex _mutex;
+    uint16_t _pixels[SIZE * SIZE] = {};
+    int16_t _window_x = 0;
+    int16_t _window_y = 0;
+    int16_t _window_width = SIZE;
+    int16_t _window_height = SIZE;
+    int32_t _cursor = 0; // Offset into the window
+};
+
+/// @brief Simulated hardware timing, slowing the fakes down to device speed. Zero fields are not
+/// simulated and run at host speed.
+struct Timing {
+    uint32_t spi_hz = 0;                  // Panel clock until the firmware sets the configured one
+    uint32_t flash_read_bytes_per_s = 0;
+    uint32_t flash_write_bytes_per_s = 0;
+    uint32_t flash_op_us = 0;             // Per open, exists, remove, rename and mkdir
+};
+
+/// @brief Call before the controller starts
+void set_timing(const Timing& timing);
+
+void set_transport(Transport& transport);
+void set_filesystem(FileSystem& filesystem);
+void set_firmware(Firmware& firmware);
+
+void set_analog_input(uint8_t pin, uint16_t value);
+/// @brief Last `analog_write()` value on `pin`, e.g. the backlight
+uint8_t analog_output(uint8_t pin);
+
+/// @brief Call `visit` for every live panel. Panels are not destroyed during the call.
+void for_each_panel(const std::function<void(const FakePanel&)>& visit);
+
+} // namespace hal::native
+
+#endif
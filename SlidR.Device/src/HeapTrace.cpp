@@ -0,0 +1,226 @@
+#include "HeapTrace.h"
+
+#include <FreeRTOS.h>
+
+namespace heap_trace {
+
+const char* name(Subsystem subsystem) {
+    switch (subsystem) {
+        case Subsystem::OTHER: return "other";
+        case Subsystem::COMM: return "comm";
+        case Subsystem::DISPATCH: return "dispatch";
+        case Subsystem::FILE_TRANSFER: return "file_transfer";
+        case Subsystem::SEGMENT: return "segment";
+        case Subsystem::DISPLAY: return "display";
+        case Subsystem::COUNT: break;
+    }
+    return "?";
+}
+
+} // namespace heap_trace
+
+#ifdef SLIDR_HEAP_TRACE
+
+#include "Communication.h"
+
+#include <atomic>
+
+namespace heap_trace {
+
+/// @brief Scope state of one task. Claimed on the task's first scope and never released,
+/// only long-lived tasks open scopes.
+struct TaskState {
+    TaskHandle_t task;
+    Subsystem subsystem;
+    bool steady_state;
+};
+
+namespace {
+
+constexpr size_t MAX_TASKS = 8;
+constexpr size_t SUBSYSTEM_COUNT = static_cast<size_t>(Subsystem::COUNT);
+
+TaskState task_states[MAX_TASKS];
+std::atomic<size_t> task_state_count{ 0 };
+portMUX_TYPE task_states_mux = portMUX_INITIALIZER_UNLOCKED;
+
+std::atomic<uint32_t> allocations[SUBSYSTEM_COUNT];
+std::atomic<uint32_t> steady_state_allocations[SUBSYSTEM_COUNT];
+std::atomic<size_t> last_violation_size[SUBSYSTEM_COUNT];
+uint32_t reported_violations = 0;
+
+TaskState* find_task(TaskHandle_t task) {
+    size_t count = task_state_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        if (task_states[i].task == task) return &task_states[i];
+    }
+    return nullptr;
+}
+
+TaskState* claim_task(TaskHandle_t task) {
+    TaskState* state = find_task(task);
+    if (state) return state;
+
+    portENTER_CRITICAL(&task_states_mux);
+    size_t count = task_state_count.load(std::memory_order_relaxed);
+    if (count < MAX_TASKS) {
+        state = &task_states[count];
+        state->task = task;
+        state->subsystem = Subsystem::OTHER;
+        state->steady_state = false;
+        task_state_count.store(count + 1, std::memory_order_release);
+    }
+    portEXIT_CRITICAL(&task_states_mux);
+    return state;
+}
+
+} // namespace
+
+Scope::Scope(Subsystem subsystem, bool steady_state) : _task(claim_task(xTaskGetCurrentTaskHandle())) {
+    if (!_task) return;
+    _previous_subsystem = _task->subsystem;
+    _previous_steady_state = _task->steady_state;
+    _task->subsystem = subsystem;
+    _task->steady_state = steady_state;
+}
+
+Scope::~Scope() {
+    if (!_task) return;
+    _task->subsystem = _previous_subsystem;
+    _task->steady_state = _previous_steady_state;
+}
+
+void record(size_t size) {
+    // Allocations during startup happen before there is a current task
+    TaskState* state = nullptr;
+    if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+        state = find_task(xTaskGetCurrentTaskHandle());
+    }
+
+    size_t index = static_cast<size_t>(state ? state->subsystem : Subsystem::OTHER);
+    allocations[index].fetch_add(1, std::memory_order_relaxed);
+    if (state && state->steady_state) {
+        steady_state_allocations[index].fetch_add(1, std::memory_order_relaxed);
+        last_violation_size[index].store(size, std::memory_order_relaxed);
+    }
+}
+
+Counters counters(Subsystem subsystem) {
+    size_t index = static_cast<size_t>(subsystem);
+    return Counters{
+        allocations[index].load(std::memory_order_relaxed),
+        steady_state_allocations[index].load(std::memory_order_relaxed),
+        last_violation_size[index].load(std::memory_order_relaxed)
+    };
+}
+
+uint32_t steady_state_violations() {
+    uint32_t total = 0;
+    for (size_t i = 0; i < SUBSYSTEM_COUNT; i++) {
+        total += steady_state_allocations[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void reset() {
+    for (size_t i = 0; i < SUBSYSTEM_COUNT; i++) {
+        allocations[i].store(0, std::memory_order_relaxed);
+        steady_state_allocations[i].store(0, std::memory_order_relaxed);
+        last_violation_size[i].store(0, std::memory_order_relaxed);
+    }
+    reported_violations = 0;
+}
+
+void report(Communication& communication) {
+    for (size_t i = 0; i < SUBSYSTEM_COUNT; i++) {
+        Counters c = counters(static_cast<Subsystem>(i));
+        if (c.allocations == 0) continue;
+        SLIDR_LOG(communication, HEAP_SUBSYSTEM, name(static_cast<Subsystem>(i)), c.allocations,
+            c.steady_state_allocations, static_cast<uint32_t>(c.last_violation_size));
+    }
+}
+
+void report_violations(Communication& communication) {
+    uint32_t violations = steady_state_violations();
+    if (violations == reported_violations) return;
+    reported_violations = violations;
+    SLIDR_LOG(communication, HEAP_VIOLATIONS, violations);
+    report(communication);
+}
+
+} // namespace heap_trace
+
+#ifdef ARDUINO
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    heap_trace::record(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    heap_trace::record(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    heap_trace::record(size);
+    return __real_realloc(ptr, size);
+}
+
+}
+
+#else
+
+// Native: `--wrap` would miss the allocations inside libstdc++ (`new`, containers, threads), so
+// the program replaces glibc's allocator instead and forwards to its internal entry points.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+}
+
+namespace {
+
+/// @brief The POSIX port allocates a task handle the first time a thread asks for it, which
+/// would come back through `record()`
+thread_local bool recording = false;
+
+void record_once(size_t size) {
+    if (recording) return;
+    recording = true;
+    heap_trace::record(size);
+    recording = false;
+}
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    record_once(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    record_once(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    record_once(size);
+    return __libc_realloc(ptr, size);
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef HEAP_TRACE_H
+#define HEAP_TRACE_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+class Communication;
+
+/// @brief Debug heap tracing, enabled with `SLIDR_HEAP_TRACE` (PlatformIO envs `lolin_s2_mini_heap_trace`
+/// and `native_heap_trace`).
+///
+/// `malloc`, `calloc` and `realloc` are wrapped at link time (`-Wl,--wrap=...`), which also covers
+/// `new` and Arduino `String`; the native build replaces glibc's versions instead. Each allocation is
+/// counted for the subsystem of the innermost scope active on the calling task. Allocations inside a
+/// steady-state scope are violations: those paths run for every packet, slider poll or blit and must
+/// not touch the heap. `test/test_heap_trace` checks them natively.
+///
+/// Without the flag the macros expand to nothing.
+namespace heap_trace {
+
+enum class Subsystem : uint8_t {
+    OTHER,
+    COMM,          // Packet RX and framing
+    DISPATCH,      // Command handlers
+    FILE_TRANSFER, // Image uploads and downloads
+    SEGMENT,       // Slider polling
+    DISPLAY,       // Image blits
+    COUNT
+};
+
+const char* name(Subsystem subsystem);
+
+#ifdef SLIDR_HEAP_TRACE
+
+struct Counters {
+    uint32_t allocations;
+    uint32_t steady_state_allocations;
+    size_t last_violation_size;
+};
+
+/// @brief Attributes the current task's allocations to `subsystem` until destroyed. Scopes may nest.
+class Scope {
+public:
+    Scope(Subsystem subsystem, bool steady_state);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    struct TaskState* _task;
+    Subsystem _previous_subsystem;
+    bool _previous_steady_state;
+};
+
+/// @brief Called by the allocation wrappers
+void record(size_t size);
+
+Counters counters(Subsystem subsystem);
+/// @brief Total allocations made inside steady-state scopes since boot or `reset()`
+uint32_t steady_state_violations();
+void reset();
+
+/// @brief Log the counters of every subsystem that allocated
+void report(Communication& communication);
+/// @brief Log the counters if new steady-state violations happened since the last call
+void report_violations(Communication& communication);
+
+#define HEAP_TRACE_CONCAT_(a, b) a##b
+#define HEAP_TRACE_CONCAT(a, b) HEAP_TRACE_CONCAT_(a, b)
+#define HEAP_TRACE_SCOPE(subsystem) heap_trace::Scope HEAP_TRACE_CONCAT(heap_trace_scope_, __LINE__)(subsystem, false)
+#define HEAP_STEADY_STATE(subsystem) heap_trace::Scope HEAP_TRACE_CONCAT(heap_trace_scope_, __LINE__)(subsystem, true)
+
+#else
+
+#define HEAP_TRACE_SCOPE(subsystem)
+#define HEAP_STEADY_STATE(subsystem)
+
+#endif
+
+} // namespace heap_trace
+
+#endif
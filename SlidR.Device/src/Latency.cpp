@@ -0,0 +1,75 @@
+#include "Latency.h"
+
+#include <cstring>
+
+namespace latency {
+
+namespace {
+
+struct Histogram {
+    Command command;
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t buckets[BUCKET_COUNT];
+};
+
+Histogram histograms[MAX_COMMANDS];
+size_t histogram_count = 0;
+uint8_t snapshot_buffer[MAX_SNAPSHOT_SIZE];
+
+Histogram* find(Command command) {
+    for (size_t i = 0; i < histogram_count; i++) {
+        if (histograms[i].command == command) return &histograms[i];
+    }
+    if (histogram_count == MAX_COMMANDS) return nullptr;
+
+    Histogram& histogram = histograms[histogram_count++];
+    memset(&histogram, 0, sizeof(histogram));
+    histogram.command = command;
+    return &histogram;
+}
+
+void put_int(size_t& size, uint64_t value, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        snapshot_buffer[size++] = (value >> (i * 8)) & 0xFF;
+    }
+}
+
+} // namespace
+
+void record(Command command, uint32_t duration_us) {
+    if (!messages::received_by_device(command)) return;
+    Histogram* histogram = find(command);
+    if (!histogram) return;
+
+    histogram->count++;
+    histogram->total_us += duration_us;
+    if (duration_us > histogram->max_us) {
+        histogram->max_us = duration_us;
+    }
+    histogram->buckets[bucket(duration_us)]++;
+}
+
+const uint8_t* snapshot(size_t& size) {
+    size = 0;
+    snapshot_buffer[size++] = BUCKET_COUNT;
+    snapshot_buffer[size++] = histogram_count;
+    for (size_t i = 0; i < histogram_count; i++) {
+        const Histogram& histogram = histograms[i];
+        snapshot_buffer[size++] = static_cast<uint8_t>(histogram.command);
+        put_int(size, histogram.count, 4);
+        put_int(size, histogram.total_us, 8);
+        put_int(size, histogram.max_us, 4);
+        for (uint32_t count : histogram.buckets) {
+            put_int(size, count, 4);
+        }
+    }
+    return snapshot_buffer;
+}
+
+void reset() {
+    histogram_count = 0;
+}
+
+} // namespace latency
@@ -0,0 +1,48 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#pragma once
+
+#include "Messages.h"
+#include "ProtocolConstants.h"
+
+#include <cinttypes>
+#include <cstddef>
+
+/// @brief Service time of every received command, as log-scale histograms (`GET_LATENCY`).
+///
+/// Bucket 0 counts handlers that took under 1 us, bucket `i` those that took `[2^(i-1), 2^i)` us
+/// and the last bucket everything above. Recording, reading and resetting all happen on the comm
+/// task, so nothing is locked.
+namespace latency {
+
+constexpr size_t BUCKET_COUNT = 24;
+/// @brief A histogram for every command the device receives. IDs outside the table are not
+/// recorded, so stray bytes cannot take the slots of real commands.
+constexpr size_t MAX_COMMANDS = messages::DEVICE_COMMAND_COUNT;
+/// @brief Size of the largest `LATENCY_DATA` payload
+constexpr size_t MAX_SNAPSHOT_SIZE = 2 + MAX_COMMANDS * (1 + 4 + 8 + 4 + BUCKET_COUNT * 4);
+static_assert(MAX_SNAPSHOT_SIZE <= messages::MAX_PAYLOAD_SIZE, "LATENCY_DATA must fit in one packet");
+
+constexpr size_t bucket(uint32_t duration_us) {
+    size_t index = 0;
+    while (duration_us != 0 && index < BUCKET_COUNT - 1) {
+        duration_us >>= 1;
+        index++;
+    }
+    return index;
+}
+static_assert(bucket(0) == 0 && bucket(1) == 1 && bucket(3) == 2 && bucket(4) == 3, "Log-scale buckets");
+static_assert(bucket(UINT32_MAX) == BUCKET_COUNT - 1, "Last bucket is open-ended");
+
+void record(Command command, uint32_t duration_us);
+
+/// @brief Build the `LATENCY_DATA` payload in an internal buffer, valid until the next call
+/// @param size Set to the payload size
+const uint8_t* snapshot(size_t& size);
+
+void reset();
+
+} // namespace latency
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef LOG_MESSAGES_H
+#define LOG_MESSAGES_H
+
+#pragma once
+
+/// @brief Every log message the firmware can send, as X(name, level, format).
+///
+/// Only the message ID and the packed arguments go over the wire (`LOG_EVENT`); `logdict.py`
+/// reads this table to build the host dictionary. Append new messages at the end so IDs stay stable.
+///
+/// Argument types follow the printf length modifiers: `%hh*` 1 byte, `%h*` 2 bytes, `%d`/`%u`/`%x`
+/// 4 bytes, `%s` a string of up to 255 bytes. Flags and width (`%02hhX`) are only used by the host.
+#define SLIDR_LOG_MESSAGES(X) \
+    X(PACKET_TIMEOUT,           WARN,  "Packet timeout") \
+    X(PACKET_SIZE_OVERFLOW,     ERROR, "Packet size overflow: %hu") \
+    X(CHECKSUM_MISMATCH,        WARN,  "Checksum mismatch (RX: 0x%02hhX, CALC: 0x%02hhX)") \
+    X(UPLOAD_NOT_ACTIVE,        WARN,  "Received %s without active transfer") \
+    X(UPLOAD_SIZE_MISMATCH,     ERROR, "Upload size mismatch: received %u of %u") \
+    X(UPLOAD_WRITE_FAILED,      ERROR, "Failed to write all data to file - written: %hu, expected: %hu") \
+    X(DOWNLOAD_OPEN_FAILED,     ERROR, "Failed to open file for download: '%s'") \
+    X(UPLOAD_REMOVE_FAILED,     ERROR, "Failed to remove existing file: '%s'") \
+    X(UPLOAD_RENAME_FAILED,     ERROR, "Failed to rename uploaded file to: '%s'") \
+    X(DOWNLOAD_NO_FILE,         ERROR, "No file opened for sending image") \
+    X(DOWNLOAD_READ_FAILED,     ERROR, "Failed to read expected number of bytes from file") \
+    X(BOOT_REPORT,              INFO,  "Boot (%s config) in ms: serial %u, panels started %u, fs %u, config %u, panels ready %u, first pixel %u, images %u, done %u, failed stages 0x%02hX") \
+    X(BOOT_FIRST_PONG,          INFO,  "Boot: first PONG %u ms") \
+    X(DISPLAY_MUTEX_TIMEOUT,    WARN,  "Segment %hhu: failed to acquire display mutex") \
+    X(IMAGE_OPEN_FAILED,        WARN,  "Failed to open image: '%s'") \
+    X(IMAGE_LOADING,            DEBUG, "Loading image: '%s' (%hux%hu)") \
+    X(IMAGE_READ_FAILED,        ERROR, "Read error: expected %hu, got %hu") \
+    X(IMAGE_LOADED,             DEBUG, "Image '%s' loaded successfully") \
+    X(HEAP_SUBSYSTEM,           INFO,  "Heap: %s allocs=%u steady=%u last=%u") \
+    X(HEAP_VIOLATIONS,          WARN,  "Heap: %u steady-state allocations") \
+    X(FIRMWARE_UPDATE_STARTED,  INFO,  "Firmware update: %u byte image, %s") \
+    X(FIRMWARE_UPDATE_FAILED,   ERROR, "Firmware update failed: %s (received %u, written %u)") \
+    X(FIRMWARE_UPDATED,         INFO,  "Firmware update written in %u ms, restarting") \
+    X(FIRMWARE_CONFIRMED,       INFO,  "Firmware confirmed after %hhu trial boots") \
+    X(FIRMWARE_ROLLBACK,        WARN,  "Firmware not confirmed within %u ms, rolling back") \
+    X(FIRMWARE_ROLLBACK_FAILED, ERROR, "No previous firmware to roll back to, keeping this one")
+
+#endif
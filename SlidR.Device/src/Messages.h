@@ -0,0 +1,311 @@
+#ifndef MESSAGES_H
+#define MESSAGES_H
+
+#pragma once
+
+#include "ConfigSchema.h"
+#include "FrameParser.h"
+#include "ProtocolConstants.h"
+#include "ProtocolMessages.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <type_traits>
+
+/// Typed payloads of every command in `SLIDR_MESSAGES`, with their encoders, decoders and the
+/// receive dispatch, all generated from the table. Nothing here allocates, and it must not
+/// depend on Arduino or FreeRTOS: the host library uses the same code.
+///
+///     communication.send(messages::SliderValue{ segment, value });
+///
+///     messages::dispatch<messages::Direction::TO_DEVICE>(packet.command, packet.data,
+///         [&](const auto& message) { handle(message); });
+///
+/// Repeated records inside a payload (`TASK_INFO` entries, `LOG_EVENT` arguments, ...) stay in
+/// the trailing byte view and are parsed by their owners.
+namespace messages {
+
+/// @brief Largest payload of a packet: the device's 4096-byte frame buffer less command, length and checksum
+constexpr size_t MAX_PAYLOAD_SIZE = 4092;
+
+/// @brief `OtaBegin::flags`: the image is sent as a zlib stream
+constexpr uint8_t OTA_FLAG_COMPRESSED = 0x01;
+
+/// @brief Who sends a message, bit 0 the host and bit 1 the device
+enum class Direction : uint8_t {
+    TO_DEVICE = 1,
+    TO_HOST = 2,
+    BOTH = 3
+};
+
+constexpr bool sent(Direction message, Direction direction) {
+    return (static_cast<uint8_t>(message) & static_cast<uint8_t>(direction)) != 0;
+}
+
+/// @brief Whether `command` is in the table and sent to the device; stray IDs are not
+constexpr bool received_by_device(Command command) {
+    switch (command) {
+#define SLIDR_MESSAGE_RECEIVED(command, id, type, direction, fields) \
+        case Command::command: return sent(Direction::direction, Direction::TO_DEVICE);
+        SLIDR_MESSAGES(SLIDR_MESSAGE_RECEIVED, SLIDR_IGNORE, SLIDR_IGNORE, SLIDR_IGNORE)
+#undef SLIDR_MESSAGE_RECEIVED
+    }
+    return false;
+}
+
+/// @brief Number of commands sent to the device
+constexpr size_t DEVICE_COMMAND_COUNT = 0
+#define SLIDR_MESSAGE_COUNT_RECEIVED(command, id, type, direction, fields) \
+    + (sent(Direction::direction, Direction::TO_DEVICE) ? 1 : 0)
+    SLIDR_MESSAGES(SLIDR_MESSAGE_COUNT_RECEIVED, SLIDR_IGNORE, SLIDR_IGNORE, SLIDR_IGNORE);
+#undef SLIDR_MESSAGE_COUNT_RECEIVED
+
+/// @brief `O` field: may be left out at the end of the payload
+template <typename T>
+struct Optional {
+    using value_type = T;
+
+    T value{};
+    bool present = false;
+
+    constexpr Optional() = default;
+    constexpr Optional(T v) : value(v), present(true) {}
+
+    constexpr T value_or(T fallback) const { return present ? value : fallback; }
+};
+
+template <typename T>
+struct is_optional : std::false_type {};
+template <typename T>
+struct is_optional<Optional<T>> : std::true_type {};
+
+#define SLIDR_MESSAGE_FIELD(type, name) type name{};
+#define SLIDR_MESSAGE_OPTIONAL(type, name) Optional<type> name;
+#define SLIDR_MESSAGE_REST(name) ByteView name{ nullptr, 0 };
+#define SLIDR_MESSAGE_STRUCT(command, id, type, direction, fields) \
+    struct type { \
+        static constexpr Command COMMAND = Command::command; \
+        static constexpr Direction DIRECTION = Direction::direction; \
+        fields \
+    };
+SLIDR_MESSAGES(SLIDR_MESSAGE_STRUCT, SLIDR_MESSAGE_FIELD, SLIDR_MESSAGE_OPTIONAL, SLIDR_MESSAGE_REST)
+#undef SLIDR_MESSAGE_STRUCT
+#undef SLIDR_MESSAGE_REST
+#undef SLIDR_MESSAGE_OPTIONAL
+#undef SLIDR_MESSAGE_FIELD
+
+/// @brief Field list of message `M`, see `for_each_field()`
+template <typename M>
+struct Fields;
+
+#define SLIDR_MESSAGE_VISIT(type, name) fn(#name, message.name);
+#define SLIDR_MESSAGE_VISIT_REST(name) fn(#name, message.name);
+#define SLIDR_MESSAGE_FIELDS(command, id, type, direction, fields) \
+    template <> \
+    struct Fields<type> { \
+        template <typename Message, typename Fn> \
+        static constexpr void visit(Message& message, Fn& fn) { \
+            (void)message; \
+            (void)fn; \
+            fields \
+        } \
+    };
+SLIDR_MESSAGES(SLIDR_MESSAGE_FIELDS, SLIDR_MESSAGE_VISIT, SLIDR_MESSAGE_VISIT, SLIDR_MESSAGE_VISIT_REST)
+#undef SLIDR_MESSAGE_FIELDS
+#undef SLIDR_MESSAGE_VISIT_REST
+#undef SLIDR_MESSAGE_VISIT
+
+/// @brief Calls `fn(name, member)` for every field of `message`, in wire order
+template <typename M, typename Fn>
+constexpr void for_each_field(M& message, Fn&& fn) {
+    Fields<std::remove_const_t<M>>::visit(message, fn);
+}
+
+/// @brief Bytes a fixed or optional field of type `T` takes on the wire
+template <typename T>
+constexpr size_t wire_size() {
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Fields must be integers, bool or enums");
+    if constexpr (std::is_enum<T>::value) {
+        return sizeof(std::underlying_type_t<T>);
+    } else {
+        return sizeof(T);
+    }
+}
+
+/// @brief Payload sizes a message accepts and whether its fields follow the table rules
+struct Layout {
+    size_t min_size;  // All `F` fields
+    size_t max_size;  // With every `O` field, `MAX_PAYLOAD_SIZE` with an `R` field
+    bool has_rest;
+    bool valid;       // `O` only after every `F`, `R` last and not after an `O`
+};
+
+template <typename M>
+constexpr Layout layout() {
+    Layout result{ 0, 0, false, true };
+    bool seen_optional = false;
+    M message{};
+    for_each_field(message, [&](const char*, const auto& field) {
+        using T = std::decay_t<decltype(field)>;
+        if (result.has_rest) result.valid = false;
+        if constexpr (std::is_same<T, ByteView>::value) {
+            result.has_rest = true;
+            if (seen_optional) result.valid = false;
+        } else if constexpr (is_optional<T>::value) {
+            seen_optional = true;
+            result.max_size += wire_size<typename T::value_type>();
+        } else {
+            if (seen_optional) result.valid = false;
+            result.min_size += wire_size<T>();
+            result.max_size += wire_size<T>();
+        }
+    });
+    if (result.has_rest) result.max_size = MAX_PAYLOAD_SIZE;
+    return result;
+}
+
+/// @brief Smallest valid payload of `M`
+template <typename M>
+constexpr size_t MIN_SIZE = layout<M>().min_size;
+/// @brief Largest valid payload of `M`. Use it to size stack buffers.
+template <typename M>
+constexpr size_t MAX_SIZE = layout<M>().max_size;
+
+namespace detail {
+
+template <typename T>
+constexpr void put(config_schema::Writer& writer, T value) {
+    if constexpr (std::is_enum<T>::value) {
+        writer.put(static_cast<std::underlying_type_t<T>>(value));
+    } else {
+        writer.put(value);
+    }
+}
+
+template <typename T>
+constexpr bool get(config_schema::Reader& reader, T& out) {
+    if constexpr (std::is_enum<T>::value) {
+        std::underlying_type_t<T> raw = 0;
+        if (!reader.get(raw)) return false;
+        out = static_cast<T>(raw);
+        return true;
+    } else {
+        return reader.get(out);
+    }
+}
+
+} // namespace detail
+
+/// @brief Serialize the payload of `message`. Optional fields are written up to the first absent one.
+/// @param capacity Size of `out`, `MAX_SIZE<M>` is always enough for messages without an `R` field
+/// @param size Receives the payload size
+/// @return `false` if it does not fit
+template <typename M>
+constexpr bool encode(const M& message, uint8_t* out, size_t capacity, size_t& size) {
+    config_schema::Writer writer(out, capacity);
+    bool more = true;
+    for_each_field(message, [&](const char*, const auto& field) {
+        using T = std::decay_t<decltype(field)>;
+        if constexpr (std::is_same<T, ByteView>::value) {
+            writer.put_bytes(field.ptr, field.length);
+        } else if constexpr (is_optional<T>::value) {
+            more = more && field.present;
+            if (more) detail::put(writer, field.value);
+        } else {
+            detail::put(writer, field);
+        }
+    });
+    size = writer.size();
+    return writer.ok();
+}
+
+/// @brief Parse a payload of message `M`. `R` fields point into `data`.
+/// @param out Only modified on success
+/// @return `false` if the size does not match the layout
+template <typename M>
+constexpr bool decode(const uint8_t* data, size_t size, M& out) {
+    if (size > MAX_PAYLOAD_SIZE) return false;
+    config_schema::Reader reader(data, size);
+    M message{};
+    bool ok = true;
+    bool rest = false;
+    for_each_field(message, [&](const char*, auto& field) {
+        using T = std::decay_t<decltype(field)>;
+        if constexpr (std::is_same<T, ByteView>::value) {
+            field = ByteView{ data + (size - reader.remaining()), static_cast<uint16_t>(reader.remaining()) };
+            rest = true;
+        } else if constexpr (is_optional<T>::value) {
+            if (reader.remaining() == 0) return;
+            ok = ok && detail::get(reader, field.value);
+            field.present = true;
+        } else {
+            ok = ok && detail::get(reader, field);
+        }
+    });
+    if (!ok || (!rest && reader.remaining() != 0)) return false;
+    out = message;
+    return true;
+}
+
+template <typename M>
+constexpr bool decode(const ByteView& payload, M& out) {
+    return decode(payload.ptr, payload.length, out);
+}
+
+enum class Dispatch : uint8_t {
+    HANDLED, // Decoded and passed to the handler
+    UNKNOWN, // Not a command, or not one sent in this direction
+    INVALID  // Payload does not match the command's layout
+};
+
+namespace detail {
+
+template <Direction Received, typename M, typename Fn>
+Dispatch decode_and_handle(const ByteView& payload, Fn& handler) {
+    if constexpr (sent(M::DIRECTION, Received)) {
+        M message;
+        if (!decode(payload, message)) return Dispatch::INVALID;
+        handler(static_cast<const M&>(message));
+        return Dispatch::HANDLED;
+    } else {
+        return Dispatch::UNKNOWN;
+    }
+}
+
+} // namespace detail
+
+/// @brief Decode a received packet into its message type and call `handler(message)` with it.
+/// Only messages sent in direction `Received` are decoded, so `handler` is instantiated for those only.
+/// @param handler Callable with every such message, usually a generic lambda
+template <Direction Received, typename Fn>
+Dispatch dispatch(Command command, const ByteView& payload, Fn&& handler) {
+    switch (command) {
+#define SLIDR_MESSAGE_DISPATCH(command, id, type, direction, fields) \
+        case Command::command: return detail::decode_and_handle<Received, type>(payload, handler);
+        SLIDR_MESSAGES(SLIDR_MESSAGE_DISPATCH, SLIDR_IGNORE, SLIDR_IGNORE, SLIDR_IGNORE)
+#undef SLIDR_MESSAGE_DISPATCH
+    }
+    return Dispatch::UNKNOWN;
+}
+
+static_assert(sizeof(bool) == 1, "bool fields are sent as one byte");
+
+#define SLIDR_MESSAGE_CHECK(command, id, type, direction, fields) \
+    static_assert(layout<type>().valid, #type ": optional fields must follow the fixed ones and the rest come last"); \
+    static_assert(MIN_SIZE<type> <= MAX_PAYLOAD_SIZE, #type " does not fit in a packet");
+SLIDR_MESSAGES(SLIDR_MESSAGE_CHECK, SLIDR_IGNORE, SLIDR_IGNORE, SLIDR_IGNORE)
+#undef SLIDR_MESSAGE_CHECK
+
+// Published layouts are frozen; add commands or trailing optional fields instead
+static_assert(MIN_SIZE<UploadImageStart> == 5 && MAX_SIZE<UploadImageStart> == 5, "UPLOAD_IMAGE_START layout must not change");
+static_assert(MIN_SIZE<Ack> == 0 && MAX_SIZE<Ack> == 2, "ACK layout must not change");
+static_assert(MIN_SIZE<SliderValue> == 2 && MAX_SIZE<SliderValue> == 2, "SLIDER_VALUE layout must not change");
+static_assert(MIN_SIZE<StatusData> == 3 && MAX_SIZE<StatusData> == 3, "STATUS_DATA layout must not change");
+static_assert(MIN_SIZE<ConfigApplied> == 7 && MAX_SIZE<ConfigApplied> == 7, "CONFIG_APPLIED layout must not change");
+static_assert(MIN_SIZE<LogEvent> == 4, "LOG_EVENT header must not change");
+static_assert(MIN_SIZE<ProfileData> == 7 && MIN_SIZE<TraceData> == 7, "Dump headers must not change");
+static_assert(MIN_SIZE<BenchmarkData> == 3, "BENCHMARK_DATA header must not change");
+
+} // namespace messages
+
+#endif // MESSAGES_H
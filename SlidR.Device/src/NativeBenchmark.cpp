@@ -0,0 +1,483 @@
+// Microbenchmarks of the firmware's hot paths on the host, PlatformIO env `native_bench`:
+//
+//     .pio/build/native_bench/program --revision $(git describe --always) --json bench.json
+//     python benchcompare.py old.json bench.json
+//
+// The JSON is Google Benchmark's format, so its `compare.py` reads it as well. Times are host
+// times: they track relative changes between firmware revisions, not device speed.
+
+#include "Communication.h"
+#include "ConfigLoader.h"
+#include "Crc32.h"
+#include "HalNative.h"
+#include "Segment.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <getopt.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// The checksum does not depend on the buffer size
+using Parser = FrameParser<4096>;
+
+struct Options {
+    const char* filter = nullptr;
+    double min_time_s = 0.2;
+    uint32_t repetitions = 1;
+    const char* json_path = nullptr; // `-` for stdout
+    const char* revision = nullptr;
+};
+
+/// @brief One benchmark: `run(n)` does the measured work `n` times
+struct Case {
+    std::string name;
+    uint64_t bytes_per_iteration; // 0: no throughput
+    std::function<void(uint64_t iterations)> run;
+};
+
+struct Result {
+    const Case* bench;
+    uint32_t repetition;
+    uint64_t iterations;
+    double real_ns; // Per iteration
+    double cpu_ns;
+};
+
+/// @brief Keep the compiler from dropping a computation whose result is otherwise unused
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+double cpu_now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+double real_now_ns() {
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Result measure(const Case& bench, uint64_t iterations, uint32_t repetition) {
+    double real_start = real_now_ns();
+    double cpu_start = cpu_now_ns();
+    bench.run(iterations);
+    double cpu = cpu_now_ns() - cpu_start;
+    double real = real_now_ns() - real_start;
+    return { &bench, repetition, iterations, real / iterations, cpu / iterations };
+}
+
+/// @brief Grow the iteration count until one run takes `min_time_s`, as Google Benchmark does
+uint64_t calibrate(const Case& bench, double min_time_s) {
+    const double target_ns = min_time_s * 1e9;
+    uint64_t iterations = 1;
+    while (true) {
+        Result result = measure(bench, iterations, 0);
+        double total_ns = result.real_ns * iterations;
+        if (total_ns >= target_ns) return iterations;
+        double scale = total_ns > target_ns / 100 ? target_ns * 1.4 / total_ns : 10;
+        iterations = std::max<uint64_t>(iterations + 1, iterations * scale);
+    }
+}
+
+// Frame building and the cases
+
+void append_frame(std::vector<uint8_t>& out, Command command, const uint8_t* payload, uint16_t size) {
+    size_t start = out.size();
+    out.push_back(0xAA);
+    out.push_back(static_cast<uint8_t>(command));
+    out.push_back(size & 0xFF);
+    out.push_back(size >> 8);
+    out.insert(out.end(), payload, payload + size);
+    // Over command, length and payload, not the start byte
+    out.push_back(Parser::checksum(&out[start + 1], out.size() - start - 1));
+}
+
+/// @brief A host session: 64 frames mixing empty pings, slider-sized, config-sized and upload
+/// chunk-sized payloads, with `corrupt_percent` of them failing the checksum
+std::vector<uint8_t> make_stream(uint32_t corrupt_percent) {
+    static constexpr uint16_t PAYLOAD_SIZES[] = { 0, 8, 64, 512 };
+    std::vector<uint8_t> payload(512);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = i * 31 + 7;
+    }
+
+    std::vector<uint8_t> stream;
+    uint32_t rng = 1;
+    for (uint32_t frame = 0; frame < 64; frame++) {
+        append_frame(stream, Command::PING, payload.data(), PAYLOAD_SIZES[frame % 4]);
+        rng = rng * 1103515245 + 12345;
+        if ((rng >> 16) % 100 < corrupt_percent) {
+            stream.back() ^= 0x5A;
+        }
+    }
+    return stream;
+}
+
+void add_communication_cases(std::vector<Case>& cases) {
+    static hal::native::MemoryTransport transport;
+    static Communication communication;
+    static uint64_t packets = 0;
+    hal::native::set_transport(transport);
+    communication.set_packet_handler([](void*, const Communication::packet_t&) { packets++; }, nullptr);
+
+    // A clean stream must parse completely, or the cases would only measure the error path
+    std::vector<uint8_t> clean = make_stream(0);
+    transport.push(clean.data(), clean.size());
+    communication.update();
+    transport.take();
+    if (packets != 64) {
+        fprintf(stderr, "comm_update: %llu of 64 frames parsed\n", static_cast<unsigned long long>(packets));
+        exit(1);
+    }
+
+    for (uint32_t corrupt_percent : { 0, 1, 10 }) {
+        auto stream = std::make_shared<std::vector<uint8_t>>(make_stream(corrupt_percent));
+        // 1: a byte per poll, 64: a full-speed USB packet, 4096: a backlog after a stall
+        for (size_t chunk : { 1, 64, 4096 }) {
+            cases.push_back({
+                "comm_update/chunk:" + std::to_string(chunk) + "/corrupt:" + std::to_string(corrupt_percent),
+                stream->size(),
+                [stream, chunk](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        for (size_t offset = 0; offset < stream->size(); offset += chunk) {
+                            transport.push(stream->data() + offset, std::min(chunk, stream->size() - offset));
+                            communication.update();
+                        }
+                        // Error replies and logs
+                        keep(transport.take().size());
+                    }
+                    keep(packets);
+                },
+            });
+        }
+    }
+}
+
+void add_config_cases(std::vector<Case>& cases) {
+    static ConfigLoader loader;
+    static uint8_t encoded[config_schema::MAX_ENCODED_SIZE];
+    static size_t encoded_size = loader.to_bytes(ConfigLoader::defaults(), encoded, sizeof(encoded));
+
+    cases.push_back({ "config/to_bytes", encoded_size, [](uint64_t iterations) {
+        uint8_t out[config_schema::MAX_ENCODED_SIZE];
+        for (uint64_t i = 0; i < iterations; i++) {
+            keep(loader.to_bytes(ConfigLoader::defaults(), out, sizeof(out)));
+            keep(out);
+        }
+    } });
+    cases.push_back({ "config/from_bytes", encoded_size, [](uint64_t iterations) {
+        DeviceConfig config;
+        for (uint64_t i = 0; i < iterations; i++) {
+            keep(loader.from_bytes(encoded, encoded_size, config));
+            keep(config);
+        }
+    } });
+}
+
+void add_checksum_cases(std::vector<Case>& cases) {
+    static std::vector<uint8_t> data(4096);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i * 131 + 17;
+    }
+
+    // Frame payload sizes, and the config blob and upload chunk sizes for CRC
+    for (size_t size : { 64, 512, 4096 }) {
+        cases.push_back({ "checksum_xor/size:" + std::to_string(size), size, [size](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                keep(Parser::checksum(data.data(), size));
+            }
+        } });
+        cases.push_back({ "crc32/size:" + std::to_string(size), size, [size](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                keep(crc32::update(data.data(), size));
+            }
+        } });
+    }
+}
+
+void add_pixel_cases(std::vector<Case>& cases) {
+    // Image files are big-endian RGB565 and go to the panel as they are. This is what passing
+    // `bigEndian = false` to `writePixels()` would cost per chunk, for comparison.
+    cases.push_back({ "rgb565_byte_swap/pixels:256", 256 * sizeof(uint16_t), [](uint64_t iterations) {
+        uint16_t pixels[256];
+        for (size_t i = 0; i < 256; i++) {
+            pixels[i] = i * 0x0101;
+        }
+        for (uint64_t i = 0; i < iterations; i++) {
+            for (uint16_t& pixel : pixels) {
+                pixel = static_cast<uint16_t>((pixel << 8) | (pixel >> 8));
+            }
+            keep(pixels);
+        }
+    } });
+}
+
+/// @brief Temporary LittleFS stand-in, removed at exit
+std::string make_temp_fs() {
+    char path[] = "/tmp/slidr-bench-XXXXXX";
+    if (!mkdtemp(path)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    static std::string root = path;
+    atexit([] {
+        std::string command = "rm -rf '" + root + "'";
+        if (system(command.c_str()) != 0) fprintf(stderr, "could not remove %s\n", root.c_str());
+    });
+    return root;
+}
+
+void add_image_cases(std::vector<Case>& cases) {
+    static hal::native::DirectoryFileSystem filesystem(make_temp_fs());
+    static Communication communication;
+    hal::native::set_filesystem(filesystem);
+    filesystem.begin(true);
+    filesystem.mkdir("/images");
+
+    // Full panel, and a quarter of it
+    for (uint16_t size : { 128, 64 }) {
+        uint8_t index = size == 128 ? 0 : 1;
+        char path[Segment::IMAGE_PATH_SIZE];
+        Segment::get_image_path(index, path);
+        hal::File file = filesystem.open(path, "w");
+        file.write(reinterpret_cast<const uint8_t*>(&size), sizeof(size));
+        file.write(reinterpret_cast<const uint8_t*>(&size), sizeof(size));
+        for (uint32_t pixel = 0; pixel < static_cast<uint32_t>(size) * size; pixel++) {
+            uint8_t color[2] = { static_cast<uint8_t>(pixel >> 8), static_cast<uint8_t>(pixel) };
+            file.write(color, sizeof(color));
+        }
+        file.close();
+
+        SegmentConfig config{ static_cast<uint8_t>(10 + index), 0, 0, 4095 };
+        auto segment = std::make_shared<Segment>(index, config, communication, 9, ConfigLoader::defaults().spi_speed_hz);
+        cases.push_back({
+            "image_decode/" + std::to_string(size) + "x" + std::to_string(size),
+            4 + static_cast<uint64_t>(size) * size * sizeof(uint16_t),
+            [segment](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    if (!segment->load_and_display_image()) {
+                        fprintf(stderr, "image_decode: load failed\n");
+                        exit(1);
+                    }
+                }
+            },
+        });
+    }
+}
+
+// Output
+
+void print_result(const Result& result) {
+    fprintf(stderr, "%-40s %12.0f ns %12.0f ns %10llu", result.bench->name.c_str(), result.real_ns,
+            result.cpu_ns, static_cast<unsigned long long>(result.iterations));
+    if (result.bench->bytes_per_iteration) {
+        fprintf(stderr, " %9.1f MiB/s", result.bench->bytes_per_iteration / result.cpu_ns * 1e9 / (1 << 20));
+    }
+    fputc('\n', stderr);
+}
+
+std::string json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void write_entry(FILE* out, const Result& result, size_t family, uint32_t repetitions,
+                 const char* aggregate, bool first) {
+    const Case& bench = *result.bench;
+    std::string name = aggregate ? bench.name + "_" + aggregate : bench.name;
+    fprintf(out, "%s    {\n", first ? "" : ",\n");
+    fprintf(out, "      \"name\": %s,\n", json_string(name).c_str());
+    fprintf(out, "      \"family_index\": %zu,\n", family);
+    fprintf(out, "      \"per_family_instance_index\": 0,\n");
+    fprintf(out, "      \"run_name\": %s,\n", json_string(bench.name).c_str());
+    if (aggregate) {
+        fprintf(out, "      \"run_type\": \"aggregate\",\n");
+        fprintf(out, "      \"repetitions\": %u,\n", repetitions);
+        fprintf(out, "      \"threads\": 1,\n");
+        fprintf(out, "      \"aggregate_name\": \"%s\",\n", aggregate);
+        fprintf(out, "      \"aggregate_unit\": \"time\",\n");
+    } else {
+        fprintf(out, "      \"run_type\": \"iteration\",\n");
+        fprintf(out, "      \"repetitions\": %u,\n", repetitions);
+        fprintf(out, "      \"repetition_index\": %u,\n", result.repetition);
+        fprintf(out, "      \"threads\": 1,\n");
+    }
+    fprintf(out, "      \"iterations\": %llu,\n", static_cast<unsigned long long>(result.iterations));
+    fprintf(out, "      \"real_time\": %.3f,\n", result.real_ns);
+    fprintf(out, "      \"cpu_time\": %.3f,\n", result.cpu_ns);
+    fprintf(out, "      \"time_unit\": \"ns\"");
+    if (bench.bytes_per_iteration && result.cpu_ns > 0) {
+        fprintf(out, ",\n      \"bytes_per_second\": %.1f", bench.bytes_per_iteration / result.cpu_ns * 1e9);
+    }
+    fprintf(out, "\n    }");
+}
+
+/// @brief Mean, median and standard deviation of a case's repetitions
+void aggregate(const std::vector<Result>& runs, Result& mean, Result& median, Result& stddev) {
+    mean = median = stddev = runs.front();
+    auto pick = [&](double Result::*field, Result& out_mean, Result& out_median, Result& out_stddev) {
+        std::vector<double> values;
+        for (const Result& run : runs) values.push_back(run.*field);
+        double sum = 0;
+        for (double value : values) sum += value;
+        double m = sum / values.size();
+        double squares = 0;
+        for (double value : values) squares += (value - m) * (value - m);
+        std::sort(values.begin(), values.end());
+        size_t half = values.size() / 2;
+        out_mean.*field = m;
+        out_median.*field = values.size() % 2 ? values[half] : (values[half - 1] + values[half]) / 2;
+        out_stddev.*field = values.size() > 1 ? std::sqrt(squares / (values.size() - 1)) : 0;
+    };
+    pick(&Result::real_ns, mean, median, stddev);
+    pick(&Result::cpu_ns, mean, median, stddev);
+}
+
+bool write_json(const char* path, const std::vector<std::vector<Result>>& results, const Options& options,
+                const char* executable) {
+    FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+
+    fprintf(out, "{\n  \"context\": {\n");
+    fprintf(out, "    \"date\": %s,\n", json_string(date).c_str());
+    fprintf(out, "    \"host_name\": %s,\n", json_string(host).c_str());
+    fprintf(out, "    \"executable\": %s,\n", json_string(executable).c_str());
+    fprintf(out, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(out, "    \"library_build_type\": \"release\",\n");
+    fprintf(out, "    \"firmware_revision\": %s\n", json_string(options.revision ? options.revision : "").c_str());
+    fprintf(out, "  },\n  \"benchmarks\": [\n");
+
+    bool first = true;
+    for (size_t family = 0; family < results.size(); family++) {
+        const auto& runs = results[family];
+        for (const Result& run : runs) {
+            write_entry(out, run, family, options.repetitions, nullptr, first);
+            first = false;
+        }
+        if (runs.size() > 1) {
+            Result mean, median, stddev;
+            aggregate(runs, mean, median, stddev);
+            write_entry(out, mean, family, options.repetitions, "mean", false);
+            write_entry(out, median, family, options.repetitions, "median", false);
+            write_entry(out, stddev, family, options.repetitions, "stddev", false);
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    bool ok = !ferror(out);
+    if (out != stdout) ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --filter TEXT           run the cases whose name contains TEXT\n"
+        "  --min-time SECONDS      minimum time of each measured run (default 0.2)\n"
+        "  --repetitions N         measured runs per case, aggregated in the JSON (default 1)\n"
+        "  --json FILE             write Google Benchmark JSON to FILE, - for stdout\n"
+        "  --revision TEXT         firmware revision recorded in the JSON context\n"
+        "  --list                  print the case names and exit\n",
+        program);
+}
+
+} // namespace
+
+/// @brief Native benchmark build: run the cases and report, see the top of this file
+int main(int argc, char** argv) {
+    enum { FILTER = 1, MIN_TIME, REPETITIONS, JSON, REVISION, LIST };
+    static const option long_options[] = {
+        { "filter", required_argument, nullptr, FILTER },
+        { "min-time", required_argument, nullptr, MIN_TIME },
+        { "repetitions", required_argument, nullptr, REPETITIONS },
+        { "json", required_argument, nullptr, JSON },
+        { "revision", required_argument, nullptr, REVISION },
+        { "list", no_argument, nullptr, LIST },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    Options options;
+    bool list = false;
+    bool ok = true;
+    int option;
+    while (ok && (option = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (option) {
+            case FILTER: options.filter = optarg; break;
+            case MIN_TIME: options.min_time_s = atof(optarg); ok = options.min_time_s > 0; break;
+            case REPETITIONS: options.repetitions = atoi(optarg); ok = options.repetitions > 0; break;
+            case JSON: options.json_path = optarg; break;
+            case REVISION: options.revision = optarg; break;
+            case LIST: list = true; break;
+            default: ok = false; break;
+        }
+    }
+    if (!ok || optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Case> cases;
+    add_communication_cases(cases);
+    add_config_cases(cases);
+    add_checksum_cases(cases);
+    add_pixel_cases(cases);
+    add_image_cases(cases);
+
+    std::vector<std::vector<Result>> results;
+    if (!list) {
+        fprintf(stderr, "%-40s %15s %15s %10s %15s\n", "case", "time", "cpu", "iterations", "throughput");
+    }
+    for (const Case& bench : cases) {
+        if (options.filter && bench.name.find(options.filter) == std::string::npos) continue;
+        if (list) {
+            printf("%s\n", bench.name.c_str());
+            continue;
+        }
+
+        uint64_t iterations = calibrate(bench, options.min_time_s);
+        std::vector<Result> runs;
+        for (uint32_t repetition = 0; repetition < options.repetitions; repetition++) {
+            runs.push_back(measure(bench, iterations, repetition));
+            print_result(runs.back());
+        }
+        results.push_back(std::move(runs));
+    }
+
+    if (options.json_path && !list && !write_json(options.json_path, results, options, argv[0])) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "NvsConfigStore.h"
+#include <cstdio>
+
+namespace {
+
+// Typed accessors so every schema field maps to the matching NVS entry type
+bool nvs_put(Preferences& prefs, const char* key, int8_t value) { return prefs.putChar(key, value) == sizeof(value); }
+bool nvs_put(Preferences& prefs, const char* key, uint8_t value) { return prefs.putUChar(key, value) == sizeof(value); }
+bool nvs_put(Preferences& prefs, const char* key, uint16_t value) { return prefs.putUShort(key, value) == sizeof(value); }
+bool nvs_put(Preferences& prefs, const char* key, uint32_t value) { return prefs.putUInt(key, value) == sizeof(value); }
+bool nvs_put(Preferences& prefs, const char* key, bool value) { return prefs.putBool(key, value) == sizeof(value); }
+
+void nvs_get(Preferences& prefs, const char* key, int8_t& value) { value = prefs.getChar(key, value); }
+void nvs_get(Preferences& prefs, const char* key, uint8_t& value) { value = prefs.getUChar(key, value); }
+void nvs_get(Preferences& prefs, const char* key, uint16_t& value) { value = prefs.getUShort(key, value); }
+void nvs_get(Preferences& prefs, const char* key, uint32_t& value) { value = prefs.getUInt(key, value); }
+void nvs_get(Preferences& prefs, const char* key, bool& value) { value = prefs.getBool(key, value); }
+
+}
+
+bool NvsConfigStore::begin() {
+    if (!_open) {
+        _open = _prefs.begin(NAMESPACE, false);
+    }
+    return _open;
+}
+
+bool NvsConfigStore::has_config() {
+    return begin() && _prefs.isKey(VERSION_KEY);
+}
+
+bool NvsConfigStore::load(DeviceConfig &out) {
+    if (!has_config()) return false;
+
+    uint32_t version = _prefs.getUInt(VERSION_KEY, 0);
+    uint8_t segment_count = _prefs.getUChar(SEGMENT_COUNT_KEY, 0);
+    if (version < config_schema::MIN_CONFIG_VERSION || version > config_schema::CONFIG_VERSION ||
+        segment_count > MAX_SEGMENTS) {
+        return false;
+    }
+
+    DeviceConfig config = out;
+    char key[KEY_SIZE];
+    size_t index = 0;
+    config_schema::for_each_field(config_schema::DEVICE_FIELDS, [&](const auto& f) {
+        device_key(key, index++);
+        nvs_get(_prefs, key, config.*(f.member));
+    });
+
+    for (uint8_t seg = 0; seg < segment_count; seg++) {
+        if (seg >= config.segment_count) config.segments[seg] = SegmentConfig{};
+        index = 0;
+        config_schema::for_each_field(config_schema::SEGMENT_FIELDS, [&](const auto& f) {
+            segment_key(key, seg, index++);
+            nvs_get(_prefs, key, config.segments[seg].*(f.member));
+        });
+    }
+    config.segment_count = segment_count;
+
+    out = config;
+    _stored = config;
+    _has_stored = version == config_schema::CONFIG_VERSION;
+    return true;
+}
+
+bool NvsConfigStore::save(const DeviceConfig &config) {
+    if (!begin() || config.segment_count > MAX_SEGMENTS) return false;
+
+    bool ok = true;
+    char key[KEY_SIZE];
+    size_t index = 0;
+    config_schema::for_each_field(config_schema::DEVICE_FIELDS, [&](const auto& f) {
+        device_key(key, index++);
+        if (_has_stored && _stored.*(f.member) == config.*(f.member)) return;
+        ok &= nvs_put(_prefs, key, config.*(f.member));
+    });
+
+    for (uint8_t seg = 0; seg < config.segment_count; seg++) {
+        bool known = _has_stored && seg < _stored.segment_count;
+        index = 0;
+        config_schema::for_each_field(config_schema::SEGMENT_FIELDS, [&](const auto& f) {
+            segment_key(key, seg, index++);
+            if (known && _stored.segments[seg].*(f.member) == config.segments[seg].*(f.member)) return;
+            ok &= nvs_put(_prefs, key, config.segments[seg].*(f.member));
+        });
+    }
+
+    if (!_has_stored || _stored.segment_count != config.segment_count) {
+        ok &= nvs_put(_prefs, SEGMENT_COUNT_KEY, config.segment_count);
+    }
+    // Written last: a config only counts as present once all of its fields are
+    if (!_has_stored) {
+        ok &= nvs_put(_prefs, VERSION_KEY, config_schema::CONFIG_VERSION);
+    }
+
+    if (ok) {
+        _stored = config;
+        _has_stored = true;
+    }
+    return ok;
+}
+
+void NvsConfigStore::device_key(char *out, size_t index) {
+    snprintf(out, KEY_SIZE, "d%u", static_cast<unsigned>(index));
+}
+
+void NvsConfigStore::segment_key(char *out, uint8_t segment, size_t index) {
+    snprintf(out, KEY_SIZE, "s%u_%u", static_cast<unsigned>(segment), static_cast<unsigned>(index));
+}
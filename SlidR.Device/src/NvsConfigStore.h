@@ -0,0 +1,53 @@
+#ifndef NVSCONFIGSTORE_H
+#define NVSCONFIGSTORE_H
+
+#pragma once
+
+#include "Config.h"
+#include "ConfigSchema.h"
+
+#include <Preferences.h>
+#include <cinttypes>
+
+/// @brief Stores the device config in the NVS partition, one typed key per schema field.
+/// NVS does not depend on the filesystem, so the config is available before LittleFS is mounted.
+///
+/// Keys: `ver` (layout version), `segs` (segment count), `d<field>` for device fields and
+/// `s<segment>_<field>` for segment fields, where `<field>` is the index in the schema table.
+class NvsConfigStore {
+public:
+    NvsConfigStore() = default;
+    ~NvsConfigStore() = default;
+
+    /// @brief Open the NVS namespace
+    /// @return `bool` success
+    bool begin();
+
+    /// @brief Read the stored config.
+    /// @param out Receives the config. Fields missing from NVS keep the value already in `out`.
+    /// @return `false` if nothing has been stored yet
+    bool load(DeviceConfig& out);
+
+    /// @brief Store the config. Only keys whose value changed are written.
+    /// @param config Config to store
+    /// @return `bool` success
+    bool save(const DeviceConfig& config);
+
+    bool has_config();
+
+private:
+    static void device_key(char* out, size_t index);
+    static void segment_key(char* out, uint8_t segment, size_t index);
+
+    Preferences _prefs;
+    bool _open = false;
+    DeviceConfig _stored;
+    bool _has_stored = false;
+
+    static constexpr const char* NAMESPACE = "slidr_cfg";
+    static constexpr const char* VERSION_KEY = "ver";
+    static constexpr const char* SEGMENT_COUNT_KEY = "segs";
+    static constexpr size_t KEY_SIZE = 16; // NVS keys are at most 15 characters
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "Profiler.h"
+
+#ifdef SLIDR_PROFILER
+
+#include "Communication.h"
+#include "Rtos.h"
+
+#include <Arduino.h>
+#include <FreeRTOS.h>
+#ifdef __XTENSA__
+#include <freertos/xtensa_context.h>
+#endif
+
+// Current task per core, maintained by the FreeRTOS port
+extern "C" void* volatile pxCurrentTCB[];
+
+namespace profiler {
+
+namespace {
+
+struct Sample {
+    uint32_t pc;
+    TaskHandle_t task;
+};
+
+constexpr uint8_t TIMER_INDEX = 0;
+constexpr uint16_t TIMER_DIVIDER = 80; // 1 MHz from the 80 MHz APB clock
+constexpr size_t SAMPLES_PER_PACKET = 128;
+constexpr size_t SAMPLE_SIZE = 5;
+
+// Written by the timer interrupt only while sampling; read by `dump()` only while paused
+DRAM_ATTR Sample samples[SAMPLE_CAPACITY];
+DRAM_ATTR volatile size_t sample_count = 0;
+DRAM_ATTR volatile uint32_t dropped = 0;
+
+hw_timer_t* timer = nullptr;
+uint16_t current_rate_hz = 0;
+
+void IRAM_ATTR on_timer() {
+    if (sample_count == SAMPLE_CAPACITY) {
+        dropped = dropped + 1;
+        return;
+    }
+
+    // The first field of a TCB is its top of stack. On entry to a non-nested interrupt the
+    // port saves the interrupted task's exception frame there, including its PC.
+    void* tcb = pxCurrentTCB[0];
+    uint32_t pc = 0;
+#ifdef __XTENSA__
+    const XtExcFrame* frame = *static_cast<XtExcFrame* const*>(tcb);
+    pc = frame->pc;
+#endif
+
+    Sample& sample = samples[sample_count];
+    sample.pc = pc;
+    sample.task = static_cast<TaskHandle_t>(tcb);
+    sample_count = sample_count + 1;
+}
+
+void pause() {
+    if (timer) timerAlarmDisable(timer);
+}
+
+void resume() {
+    if (timer && current_rate_hz) timerAlarmEnable(timer);
+}
+
+void put_u32(uint8_t* out, size_t& size, uint32_t value) {
+    out[size++] = value & 0xFF;
+    out[size++] = (value >> 8) & 0xFF;
+    out[size++] = (value >> 16) & 0xFF;
+    out[size++] = (value >> 24) & 0xFF;
+}
+
+} // namespace
+
+bool start(uint16_t rate_hz) {
+    if (rate_hz == 0 || rate_hz > MAX_RATE_HZ) return false;
+
+    if (!timer) {
+        timer = timerBegin(TIMER_INDEX, TIMER_DIVIDER, true);
+        if (!timer) return false;
+        timerAttachInterrupt(timer, on_timer, true);
+    }
+    pause();
+    current_rate_hz = rate_hz;
+    timerAlarmWrite(timer, 1000000 / rate_hz, true);
+    resume();
+    return true;
+}
+
+void stop() {
+    pause();
+    current_rate_hz = 0;
+}
+
+void dump(Communication& communication) {
+    pause();
+
+    // [flags:uint8][dropped:uint32][count:uint16] then count × [pc:uint32][task:uint8]
+    static uint8_t payload[1 + 4 + 2 + SAMPLES_PER_PACKET * SAMPLE_SIZE];
+    size_t sent = 0;
+    do {
+        size_t count = std::min(SAMPLES_PER_PACKET, sample_count - sent);
+        bool last = sent + count == sample_count;
+
+        size_t size = 0;
+        payload[size++] = last ? 1 : 0;
+        put_u32(payload, size, dropped);
+        payload[size++] = count & 0xFF;
+        payload[size++] = count >> 8;
+        for (size_t i = sent; i < sent + count; i++) {
+            put_u32(payload, size, samples[i].pc);
+            payload[size++] = rtos::task_index(samples[i].task);
+        }
+        communication.send_packet(Command::PROFILE_DATA, payload, size);
+        sent += count;
+    } while (sent < sample_count);
+
+    sample_count = 0;
+    dropped = 0;
+    resume();
+}
+
+} // namespace profiler
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+class Communication;
+
+/// @brief Sampling CPU profiler, enabled with `SLIDR_PROFILER` (PlatformIO env `lolin_s2_mini_profile`).
+///
+/// A hardware timer interrupt records the program counter and task it interrupted into a sample
+/// buffer. `PROFILE_DUMP` streams the samples out; `cpuprofile.py` symbolises them against the
+/// firmware ELF and writes folded stacks for flame graph tools.
+namespace profiler {
+
+#ifdef SLIDR_PROFILER
+
+constexpr size_t SAMPLE_CAPACITY = 2048;
+constexpr uint16_t MAX_RATE_HZ = 10000;
+
+/// @brief Start sampling at `rate_hz`, or change the rate. Keeps samples already taken.
+/// @return `false` if the rate is out of range or the timer could not be started
+bool start(uint16_t rate_hz);
+void stop();
+
+/// @brief Send all samples as `PROFILE_DATA` packets and clear the buffer.
+/// Sampling pauses while the samples are sent. Comm task only.
+void dump(Communication& communication);
+
+#endif
+
+} // namespace profiler
+
+#endif
@@ -3,43 +3,44 @@
 
 #pragma once
 
+#include "ProtocolMessages.h"
+
 #include <cinttypes>
 
 constexpr uint8_t START_BYTE = 0xAA;
 
+/// @brief Command IDs, from `SLIDR_MESSAGES`
 enum class Command : uint8_t {
-    PING = 0x01,
-    PONG = 0x02,
-    SET_CONFIG = 0x03,
-    GET_CONFIG = 0x04,
-    CONFIG_DATA = 0x05,
-    DEFAULT_CONFIG = 0x06,
-    UPLOAD_IMAGE_START = 0x07,
-    UPLOAD_IMAGE_DATA = 0x08,
-    UPLOAD_IMAGE_END = 0x09,
-    DOWNLOAD_IMAGE_START = 0x0A,
-    DOWNLOAD_IMAGE_DATA = 0x0B,
-    DOWNLOAD_IMAGE_END = 0x0C,
-    ACK = 0x0D,
-    SLIDER_VALUE = 0x0E,
-    SET_BACKLIGHT = 0x0F,
-    ERROR_CMD = 0x10,
-    GET_STATUS = 0x11,
-    STATUS_DATA = 0x12,
-    LOG_MESSAGE = 0x13,
-    CHANGE_BAUDRATE = 0x14
+#define SLIDR_COMMAND_ID(name, id, type, direction, fields) name = id,
+    SLIDR_MESSAGES(SLIDR_COMMAND_ID, SLIDR_IGNORE, SLIDR_IGNORE, SLIDR_IGNORE)
+#undef SLIDR_COMMAND_ID
 };
 
+/// @brief `ERROR_CMD` codes, from `SLIDR_ERROR_CODES`
 enum class ErrorCode : uint8_t {
-    NONE = 0x00,
-    INVALID_COMMAND = 0x01,
-    INVALID_DATA = 0x02,
-    CHECKSUM_ERROR = 0x03,
-    FILE_ERROR = 0x04,
-    INVALID_CONFIG = 0x05,
-    BUFFER_OVERFLOW = 0x06,
-    TRANSFER_IN_PROGRESS = 0x07,
-    TRANSFER_TIMEOUT = 0x08
+#define SLIDR_ERROR_ID(name, value, description) name = value,
+    SLIDR_ERROR_CODES(SLIDR_ERROR_ID)
+#undef SLIDR_ERROR_ID
 };
 
+/// @brief Name of `command` as in the enum, for logs and host tools
+constexpr const char* command_name(Command command) {
+    switch (command) {
+#define SLIDR_COMMAND_NAME(name, id, type, direction, fields) case Command::name: return #name;
+        SLIDR_MESSAGES(SLIDR_COMMAND_NAME, SLIDR_IGNORE, SLIDR_IGNORE, SLIDR_IGNORE)
+#undef SLIDR_COMMAND_NAME
+    }
+    return "UNKNOWN";
+}
+
+/// @brief Name of `code` as in the enum
+constexpr const char* error_name(ErrorCode code) {
+    switch (code) {
+#define SLIDR_ERROR_NAME(name, value, description) case ErrorCode::name: return #name;
+        SLIDR_ERROR_CODES(SLIDR_ERROR_NAME)
+#undef SLIDR_ERROR_NAME
+    }
+    return "UNKNOWN";
+}
+
 #endif // PROTOCOL_CONSTANTS_H
@@ -0,0 +1,79 @@
+#ifndef PROTOCOL_MESSAGES_H
+#define PROTOCOL_MESSAGES_H
+
+#pragma once
+
+/// @brief Every command and its payload layout, as X(command, id, type, direction, fields).
+///
+/// This is the only definition of the protocol: `ProtocolConstants.h` builds `Command` and
+/// `ErrorCode` from it, `Messages.h` the payload structs, codecs and dispatch, and `protodef.py`
+/// the Python side. Append new commands at the end; never reuse or renumber an ID.
+///
+/// `direction` is who sends it: `TO_DEVICE`, `TO_HOST` or `BOTH`. `fields` are in wire order,
+/// little-endian and tightly packed, one row per line:
+///
+///     F(type, name)   Integer, `bool` or `ErrorCode`
+///     O(type, name)   Same, but may be left out. Only after every `F`
+///     R(name)         The rest of the payload as bytes, last
+#define SLIDR_MESSAGES(X, F, O, R) \
+    X(PING,                 0x01, Ping,               TO_DEVICE, ) \
+    X(PONG,                 0x02, Pong,               TO_HOST,   ) \
+    X(SET_CONFIG,           0x03, SetConfig,          TO_DEVICE, R(config)) \
+    X(GET_CONFIG,           0x04, GetConfig,          TO_DEVICE, ) \
+    X(CONFIG_DATA,          0x05, ConfigData,         TO_HOST,   R(config)) \
+    X(DEFAULT_CONFIG,       0x06, DefaultConfig,      TO_DEVICE, ) \
+    X(UPLOAD_IMAGE_START,   0x07, UploadImageStart,   TO_DEVICE, F(uint8_t, segment) F(uint32_t, total_size)) \
+    X(UPLOAD_IMAGE_DATA,    0x08, UploadImageData,    TO_DEVICE, R(data)) \
+    X(UPLOAD_IMAGE_END,     0x09, UploadImageEnd,     TO_DEVICE, ) \
+    X(DOWNLOAD_IMAGE_START, 0x0A, DownloadImageStart, TO_DEVICE, F(uint8_t, segment)) \
+    X(DOWNLOAD_IMAGE_DATA,  0x0B, DownloadImageData,  TO_HOST,   R(data)) \
+    X(DOWNLOAD_IMAGE_END,   0x0C, DownloadImageEnd,   TO_HOST,   ) \
+    X(ACK,                  0x0D, Ack,                BOTH,      O(uint16_t, job_id)) \
+    X(SLIDER_VALUE,         0x0E, SliderValue,        TO_HOST,   F(uint8_t, segment) F(uint8_t, value)) \
+    X(SET_BACKLIGHT,        0x0F, SetBacklight,       TO_DEVICE, F(uint8_t, brightness)) \
+    X(ERROR_CMD,            0x10, Error,              TO_HOST,   F(ErrorCode, code)) \
+    X(GET_STATUS,           0x11, GetStatus,          TO_DEVICE, ) \
+    X(STATUS_DATA,          0x12, StatusData,         TO_HOST,   F(bool, awake) F(uint8_t, backlight) F(uint8_t, segment_count)) \
+    X(LOG_MESSAGE,          0x13, LogMessage,         TO_HOST,   R(text)) \
+    X(CHANGE_BAUDRATE,      0x14, ChangeBaudrate,     TO_DEVICE, R(data)) \
+    X(PATCH_CONFIG,         0x15, PatchConfig,        TO_DEVICE, R(patch)) \
+    X(CONFIG_APPLIED,       0x16, ConfigApplied,      TO_HOST,   F(uint16_t, job_id) F(ErrorCode, error) F(uint32_t, duration_us)) \
+    X(GET_TASK_INFO,        0x17, GetTaskInfo,        TO_DEVICE, ) \
+    X(TASK_INFO,            0x18, TaskInfo,           TO_HOST,   F(uint8_t, count) R(tasks)) \
+    X(LOG_EVENT,            0x19, LogEvent,           TO_HOST,   F(uint16_t, message_id) F(uint16_t, suppressed) R(arguments)) \
+    X(GET_STATS,            0x1A, GetStats,           TO_DEVICE, O(uint16_t, interval_ms)) \
+    X(STATS_DATA,           0x1B, StatsData,          TO_HOST,   R(stats)) \
+    X(GET_LATENCY,          0x1C, GetLatency,         TO_DEVICE, O(uint8_t, reset)) \
+    X(LATENCY_DATA,         0x1D, LatencyData,        TO_HOST,   R(histograms)) \
+    X(PROFILE_CONTROL,      0x1E, ProfileControl,     TO_DEVICE, F(uint16_t, rate_hz)) \
+    X(PROFILE_DUMP,         0x1F, ProfileDump,        TO_DEVICE, ) \
+    X(PROFILE_DATA,         0x20, ProfileData,        TO_HOST,   F(uint8_t, flags) F(uint32_t, dropped) F(uint16_t, count) R(samples)) \
+    X(RUN_BENCHMARK,        0x21, RunBenchmark,       TO_DEVICE, O(uint8_t, suites)) \
+    X(BENCHMARK_DATA,       0x22, BenchmarkData,      TO_HOST,   F(uint16_t, job_id) F(uint8_t, count) R(results)) \
+    X(TRACE_DUMP,           0x23, TraceDump,          TO_DEVICE, ) \
+    X(TRACE_DATA,           0x24, TraceData,          TO_HOST,   F(uint8_t, flags) F(uint32_t, overwritten) F(uint16_t, count) R(events)) \
+    X(CAPTURE_DUMP,         0x25, CaptureDump,        TO_DEVICE, ) \
+    X(CAPTURE_DATA,         0x26, CaptureData,        TO_HOST,   F(uint8_t, flags) R(data)) \
+    X(OTA_BEGIN,            0x27, OtaBegin,           TO_DEVICE, F(uint32_t, size) F(uint8_t, flags) R(sha256)) \
+    X(OTA_DATA,             0x28, OtaData,            TO_DEVICE, R(data)) \
+    X(OTA_END,              0x29, OtaEnd,             TO_DEVICE, ) \
+    X(OTA_STATUS,           0x2A, OtaStatus,          TO_HOST,   F(uint32_t, received) F(uint32_t, written) F(uint16_t, window))
+
+/// @brief Every `ERROR_CMD` code, as X(name, value, description)
+#define SLIDR_ERROR_CODES(X) \
+    X(NONE,                 0x00, "No error") \
+    X(INVALID_COMMAND,      0x01, "Command not recognized, not supported by this build, or unexpected now") \
+    X(INVALID_DATA,         0x02, "Payload has the wrong size or an invalid value") \
+    X(CHECKSUM_ERROR,       0x03, "Packet checksum mismatch") \
+    X(FILE_ERROR,           0x04, "Filesystem or underlying IO issue") \
+    X(INVALID_CONFIG,       0x05, "Config payload failed validation") \
+    X(BUFFER_OVERFLOW,      0x06, "Payload length exceeded limits") \
+    X(TRANSFER_IN_PROGRESS, 0x07, "New transfer attempted while another is active") \
+    X(TRANSFER_TIMEOUT,     0x08, "File transfer watchdog expired") \
+    X(BUSY,                 0x09, "Still booting or the config job queue is full, retry later") \
+    X(FIRMWARE_ERROR,       0x0A, "Firmware image rejected: too large, corrupt, digest mismatch or failed validation")
+
+/// @brief Expands to nothing, for the table columns an expansion does not use
+#define SLIDR_IGNORE(...)
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef RCU_H
+#define RCU_H
+
+#pragma once
+
+#include "Rtos.h"
+
+#include <FreeRTOS.h>
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+
+/// @brief Publishes immutable snapshots of `T` to lock-free readers (read-copy-update).
+///
+/// Readers pin the current snapshot with `read()` and never block or lock. One writer at a time
+/// copies the current snapshot with `prepare()`, edits the copy and swaps it in with `publish()`.
+/// A replaced snapshot is reset (releasing anything it owns) only once every reader that might
+/// still see it has left its read section (epoch-based reclamation).
+///
+/// Snapshots live in a fixed pool, so publishing never allocates. If every slot is still pinned
+/// by a reader, `prepare()` waits for a grace period; readers are never delayed.
+///
+/// @tparam T Snapshot type, must be default-constructible and copy-assignable
+/// @tparam Readers Number of reader slots. Every task that reads needs its own slot index.
+/// @tparam Slots Number of preallocated snapshots
+template <typename T, size_t Readers, size_t Slots = 3>
+class Rcu {
+    static_assert(Slots >= 2, "Need at least one spare snapshot to publish into");
+
+public:
+    /// @brief Keeps the snapshot returned by `read()` alive until destroyed.
+    /// Guards for the same reader slot may nest.
+    class ReadGuard {
+    public:
+        ReadGuard(Rcu& rcu, size_t reader) : _rcu(rcu), _reader(reader), _snapshot(rcu.enter(reader)) {}
+        ~ReadGuard() { _rcu.exit(_reader); }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const T* get() const { return _snapshot; }
+        const T* operator->() const { return _snapshot; }
+        const T& operator*() const { return *_snapshot; }
+        explicit operator bool() const { return _snapshot != nullptr; }
+
+    private:
+        Rcu& _rcu;
+        size_t _reader;
+        const T* _snapshot;
+    };
+
+    Rcu() {
+        for (size_t i = 0; i < Readers; i++) {
+            _reader_epochs[i].store(IDLE, std::memory_order_relaxed);
+            _reader_depth[i] = 0;
+        }
+        for (size_t i = 0; i < Slots; i++) {
+            _state[i] = SlotState::FREE;
+        }
+    }
+
+    /// @brief Pin the current snapshot. Wait-free; may return an empty guard before the first publish.
+    /// @param reader Reader slot owned by the calling task
+    ReadGuard read(size_t reader) {
+        return ReadGuard(*this, reader);
+    }
+
+    /// @brief Start an update. Excludes other writers (never readers) until `publish()` or `cancel()`.
+    /// @return A private copy of the current snapshot to modify
+    T& prepare() {
+        xSemaphoreTake(_writer_mutex, portMAX_DELAY);
+
+        size_t slot;
+        while (!take_free_slot(slot)) {
+            reclaim();
+            if (take_free_slot(slot)) break;
+            vTaskDelay(1);
+        }
+
+        const T* current = _current.load(std::memory_order_relaxed);
+        _slots[slot] = current ? *current : T{};
+        _preparing = slot;
+        return _slots[slot];
+    }
+
+    /// @brief The snapshot readers currently see. Only valid between `prepare()` and `publish()`.
+    const T* current() const {
+        return _current.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Make the prepared snapshot visible to readers and retire the previous one.
+    void publish() {
+        T* previous = _current.load(std::memory_order_relaxed);
+        _state[_preparing] = SlotState::CURRENT;
+        _current.store(&_slots[_preparing], std::memory_order_seq_cst);
+
+        if (previous) {
+            size_t index = previous - _slots;
+            _state[index] = SlotState::RETIRED;
+            _retired_at[index] = _epoch.fetch_add(1, std::memory_order_seq_cst);
+        }
+        reclaim();
+
+        xSemaphoreGive(_writer_mutex);
+    }
+
+    /// @brief Drop the prepared snapshot without publishing it.
+    void cancel() {
+        _slots[_preparing] = T{};
+        _state[_preparing] = SlotState::FREE;
+        xSemaphoreGive(_writer_mutex);
+    }
+
+private:
+    enum class SlotState : uint8_t { FREE, PREPARING, CURRENT, RETIRED };
+    static constexpr uint32_t IDLE = 0;
+
+    const T* enter(size_t reader) {
+        if (_reader_depth[reader]++ == 0) {
+            // seq_cst store followed by seq_cst load: a writer that does not see this epoch
+            // yet has already published, so the load below returns the new snapshot
+            _reader_epochs[reader].store(_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        }
+        return _current.load(std::memory_order_seq_cst);
+    }
+
+    void exit(size_t reader) {
+        if (--_reader_depth[reader] == 0) {
+            _reader_epochs[reader].store(IDLE, std::memory_order_release);
+        }
+    }
+
+    bool take_free_slot(size_t& out) {
+        for (size_t i = 0; i < Slots; i++) {
+            if (_state[i] == SlotState::FREE) {
+                _state[i] = SlotState::PREPARING;
+                out = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Readers that entered during or before `epoch` may still hold snapshots retired at it
+    bool grace_period_over(uint32_t epoch) const {
+        for (size_t i = 0; i < Readers; i++) {
+            uint32_t reader_epoch = _reader_epochs[i].load(std::memory_order_seq_cst);
+            if (reader_epoch != IDLE && reader_epoch <= epoch) return false;
+        }
+        return true;
+    }
+
+    /// @brief Reset retired snapshots no reader can see anymore. Writer only.
+    void reclaim() {
+        for (size_t i = 0; i < Slots; i++) {
+            if (_state[i] == SlotState::RETIRED && grace_period_over(_retired_at[i])) {
+                _slots[i] = T{};
+                _state[i] = SlotState::FREE;
+            }
+        }
+    }
+
+    T _slots[Slots];
+    SlotState _state[Slots];
+    uint32_t _retired_at[Slots] = {};
+    size_t _preparing = 0;
+
+    std::atomic<T*> _current{ nullptr };
+    std::atomic<uint32_t> _epoch{ IDLE + 1 };
+    std::atomic<uint32_t> _reader_epochs[Readers];
+    uint8_t _reader_depth[Readers];
+    rtos::Semaphore _writer_mutex{ rtos::Semaphore::Kind::MUTEX };
+};
+
+#endif
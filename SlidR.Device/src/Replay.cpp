@@ -0,0 +1,448 @@
+#include "Replay.h"
+#include "Capture.h"
+#include "FrameParser.h"
+#include "ProtocolConstants.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace replay {
+
+namespace {
+
+using Parser = FrameParser<4096>;
+
+/// @brief Quiet time after which the device is considered done answering
+constexpr uint64_t QUIET_US = 250000;
+/// @brief Longest wait for the device to go quiet after the capture's end
+constexpr uint64_t SETTLE_LIMIT_US = 5000000;
+constexpr size_t MAX_PRINTED_MISMATCHES = 10;
+
+struct Record {
+    uint64_t timestamp_us;
+    capture::Direction direction;
+    std::vector<uint8_t> data;
+};
+
+struct Frame {
+    uint64_t timestamp_us; // Of the record completing the frame
+    Command command;
+    std::vector<uint8_t> payload;
+};
+
+/// @brief Feeds the host's bytes in and timestamps everything the device writes
+class ReplayTransport : public hal::Transport {
+public:
+    void begin(uint32_t baudrate) override {}
+    bool connected() override { return true; }
+
+    size_t read(uint8_t* buffer, size_t size) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size = std::min(size, _rx.size());
+        std::copy_n(_rx.begin(), size, buffer);
+        _rx.erase(_rx.begin(), _rx.begin() + size);
+        return size;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint64_t now = hal::micros64();
+        // Writes within the same microsecond, like the parts of one `send_packet()`, share a record
+        if (!_tx.empty() && _tx.back().timestamp_us == now) {
+            _tx.back().data.insert(_tx.back().data.end(), data, data + size);
+        } else {
+            _tx.push_back({ now, capture::Direction::DEVICE_TO_HOST, std::vector<uint8_t>(data, data + size) });
+        }
+        _last_write_us = now;
+        return size;
+    }
+
+    void push(const std::vector<uint8_t>& data) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rx.insert(_rx.end(), data.begin(), data.end());
+    }
+
+    std::vector<Record> take() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<Record> tx;
+        tx.swap(_tx);
+        return tx;
+    }
+
+    uint64_t last_write_us() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _last_write_us;
+    }
+
+private:
+    std::mutex _mutex;
+    std::deque<uint8_t> _rx;
+    std::vector<Record> _tx;
+    uint64_t _last_write_us = 0;
+};
+
+ReplayTransport replay_transport;
+
+enum class Match : uint8_t {
+    FULL,         // Command and payload
+    COMMAND_ONLY, // Payload depends on time, load or uptime
+    SKIP          // Not compared at all
+};
+
+Match match_of(Command command) {
+    switch (command) {
+        case Command::LOG_EVENT:
+        case Command::SLIDER_VALUE:
+            return Match::SKIP;
+        case Command::STATUS_DATA:
+        case Command::TASK_INFO:
+        case Command::STATS_DATA:
+        case Command::LATENCY_DATA:
+        case Command::PROFILE_DATA:
+        case Command::BENCHMARK_DATA:
+        case Command::TRACE_DATA:
+        case Command::CAPTURE_DATA:
+        // Job IDs count from boot, a capture need not start there
+        case Command::ACK:
+        case Command::CONFIG_APPLIED:
+            return Match::COMMAND_ONLY;
+        default:
+            return Match::FULL;
+    }
+}
+
+uint64_t get_int(const uint8_t* data, size_t width) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < width; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    }
+    return value;
+}
+
+void put_int(std::vector<uint8_t>& out, uint64_t value, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        out.push_back((value >> (i * 8)) & 0xFF);
+    }
+}
+
+bool read_capture(const char* path, std::vector<Record>& records) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t size;
+    while ((size = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + size);
+    }
+    fclose(file);
+
+    if (data.size() < capture::FILE_HEADER_SIZE || get_int(&data[0], 4) != capture::MAGIC) {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return false;
+    }
+    if (get_int(&data[4], 2) != capture::VERSION) {
+        fprintf(stderr, "%s: capture version %u is not supported\n", path, static_cast<unsigned>(get_int(&data[4], 2)));
+        return false;
+    }
+    uint32_t dropped = get_int(&data[8], 4);
+    if (dropped) {
+        fprintf(stderr, "%s: %u records were dropped when recording, the replay starts mid-session\n", path, dropped);
+    }
+
+    size_t offset = capture::FILE_HEADER_SIZE;
+    while (offset + capture::RECORD_HEADER_SIZE <= data.size()) {
+        const uint8_t* header = &data[offset];
+        size_t record_size = get_int(header + 10, 2);
+        offset += capture::RECORD_HEADER_SIZE;
+        if (offset + record_size > data.size() || header[8] > static_cast<uint8_t>(capture::Direction::DEVICE_TO_HOST)) {
+            break;
+        }
+        records.push_back({ get_int(header, 8), static_cast<capture::Direction>(header[8]),
+                            std::vector<uint8_t>(&data[offset], &data[offset] + record_size) });
+        offset += record_size;
+    }
+    if (offset != data.size()) {
+        fprintf(stderr, "%s: ignoring a truncated record at the end\n", path);
+    }
+    return true;
+}
+
+bool write_capture(const char* path, std::vector<Record> records) {
+    std::stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return a.timestamp_us < b.timestamp_us;
+    });
+    std::vector<uint8_t> out;
+    put_int(out, capture::MAGIC, 4);
+    put_int(out, capture::VERSION, 2);
+    out.push_back(static_cast<uint8_t>(capture::Source::HOST));
+    out.push_back(0);
+    put_int(out, 0, 4);
+    for (const Record& record : records) {
+        put_int(out, record.timestamp_us, 8);
+        out.push_back(static_cast<uint8_t>(record.direction));
+        out.push_back(0);
+        put_int(out, record.data.size(), 2);
+        out.insert(out.end(), record.data.begin(), record.data.end());
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && ok;
+}
+
+/// @brief Valid frames sent in `direction` from `start_us` on
+std::vector<Frame> parse_frames(const std::vector<Record>& records, capture::Direction direction, uint64_t start_us) {
+    Parser parser;
+    std::vector<Frame> frames;
+    for (const Record& record : records) {
+        if (record.direction != direction || record.timestamp_us < start_us) continue;
+        for (uint8_t byte : record.data) {
+            if (parser.push(byte) == Parser::Result::PACKET) {
+                ByteView payload = parser.payload();
+                frames.push_back({ record.timestamp_us, parser.command(),
+                                   std::vector<uint8_t>(payload.data(), payload.data() + payload.size()) });
+            }
+        }
+    }
+    return frames;
+}
+
+/// @brief Remove `CAPTURE_DUMP` requests from the host's records. A device capture ends with the
+/// request that downloaded it, and the dump itself was not recorded.
+void strip_capture_dumps(std::vector<Record>& records) {
+    // Host bytes in order, as (record, offset) positions
+    std::vector<std::pair<size_t, size_t>> positions;
+    std::vector<std::vector<bool>> keep(records.size());
+    Parser parser;
+    for (size_t i = 0; i < records.size(); i++) {
+        keep[i].assign(records[i].data.size(), true);
+        if (records[i].direction != capture::Direction::HOST_TO_DEVICE) continue;
+        for (size_t offset = 0; offset < records[i].data.size(); offset++) {
+            positions.emplace_back(i, offset);
+            if (parser.push(records[i].data[offset]) == Parser::Result::PACKET &&
+                parser.command() == Command::CAPTURE_DUMP) {
+                size_t frame_size = 5 + parser.payload().size();
+                for (size_t back = 0; back < frame_size; back++) {
+                    const auto& position = positions[positions.size() - 1 - back];
+                    keep[position.first][position.second] = false;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < records.size(); i++) {
+        std::vector<uint8_t> data;
+        for (size_t offset = 0; offset < records[i].data.size(); offset++) {
+            if (keep[i][offset]) data.push_back(records[i].data[offset]);
+        }
+        records[i].data.swap(data);
+    }
+    records.erase(std::remove_if(records.begin(), records.end(), [](const Record& record) {
+        return record.data.empty();
+    }), records.end());
+}
+
+std::vector<Frame> compared_frames(std::vector<Frame> frames) {
+    frames.erase(std::remove_if(frames.begin(), frames.end(), [](const Frame& frame) {
+        return match_of(frame.command) == Match::SKIP;
+    }), frames.end());
+    return frames;
+}
+
+/// @return Number of mismatching frames, missing and extra ones included
+size_t compare(const std::vector<Frame>& expected, const std::vector<Frame>& actual) {
+    size_t mismatches = 0;
+    size_t common = std::min(expected.size(), actual.size());
+    for (size_t i = 0; i < common; i++) {
+        const Frame& want = expected[i];
+        const Frame& got = actual[i];
+        bool same = want.command == got.command &&
+                    (match_of(want.command) == Match::COMMAND_ONLY || want.payload == got.payload);
+        if (same) continue;
+        if (mismatches++ < MAX_PRINTED_MISMATCHES) {
+            fprintf(stderr, "response %zu: expected %s (%zu bytes), got %s (%zu bytes)\n", i,
+                    command_name(want.command), want.payload.size(), command_name(got.command), got.payload.size());
+        }
+    }
+    if (expected.size() != actual.size()) {
+        fprintf(stderr, "%zu responses expected, %zu received\n", expected.size(), actual.size());
+        mismatches += std::max(expected.size(), actual.size()) - common;
+    }
+    return mismatches;
+}
+
+/// @brief Microseconds from each request to the first response before the next request,
+/// by request command. Requests without a response, like upload chunks, are left out.
+std::map<Command, std::vector<uint64_t>> latencies(const std::vector<Frame>& requests, const std::vector<Frame>& responses) {
+    std::map<Command, std::vector<uint64_t>> result;
+    size_t next = 0;
+    for (size_t i = 0; i < requests.size(); i++) {
+        uint64_t start = requests[i].timestamp_us;
+        uint64_t end = i + 1 < requests.size() ? requests[i + 1].timestamp_us : UINT64_MAX;
+        while (next < responses.size() && responses[next].timestamp_us < start) next++;
+        if (next < responses.size() && responses[next].timestamp_us < end) {
+            result[requests[i].command].push_back(responses[next].timestamp_us - start);
+        }
+    }
+    for (auto& entry : result) {
+        std::sort(entry.second.begin(), entry.second.end());
+    }
+    return result;
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+void print_latencies(const std::map<Command, std::vector<uint64_t>>& recorded,
+                     const std::map<Command, std::vector<uint64_t>>& replayed) {
+    fprintf(stderr, "%-22s %6s %12s %12s %12s %12s\n", "request", "count", "captured p50", "p95",
+            "replayed p50", "p95");
+    for (const auto& entry : replayed) {
+        auto captured = recorded.find(entry.first);
+        const std::vector<uint64_t> none;
+        const std::vector<uint64_t>& before = captured != recorded.end() ? captured->second : none;
+        fprintf(stderr, "%-22s %6zu %9llu us %9llu us %9llu us %9llu us\n", command_name(entry.first),
+                entry.second.size(), static_cast<unsigned long long>(percentile(before, 0.5)),
+                static_cast<unsigned long long>(percentile(before, 0.95)),
+                static_cast<unsigned long long>(percentile(entry.second, 0.5)),
+                static_cast<unsigned long long>(percentile(entry.second, 0.95)));
+    }
+}
+
+bool write_report(const Options& options, const std::map<Command, std::vector<uint64_t>>& recorded,
+                  const std::map<Command, std::vector<uint64_t>>& replayed, size_t mismatches) {
+    FILE* out = fopen(options.report_path, "w");
+    if (!out) {
+        perror(options.report_path);
+        return false;
+    }
+
+    // Capture file name without directories and extension names the cases
+    std::string name = options.capture_path;
+    name = name.substr(name.find_last_of('/') + 1);
+    name = name.substr(0, name.find('.'));
+
+    fprintf(out, "{\n  \"context\": {\n");
+    fprintf(out, "    \"capture\": \"%s\",\n", options.capture_path);
+    fprintf(out, "    \"speed\": %g,\n", options.speed);
+    fprintf(out, "    \"mismatches\": %zu\n", mismatches);
+    fprintf(out, "  },\n  \"benchmarks\": [");
+    bool first = true;
+    for (const auto& entry : replayed) {
+        auto captured = recorded.find(entry.first);
+        uint64_t p50 = percentile(entry.second, 0.5);
+        fprintf(out, "%s\n    {\n", first ? "" : ",");
+        fprintf(out, "      \"name\": \"replay/%s/%s\",\n", name.c_str(), command_name(entry.first));
+        fprintf(out, "      \"run_name\": \"replay/%s/%s\",\n", name.c_str(), command_name(entry.first));
+        fprintf(out, "      \"run_type\": \"iteration\",\n");
+        fprintf(out, "      \"iterations\": %zu,\n", entry.second.size());
+        fprintf(out, "      \"real_time\": %llu,\n", static_cast<unsigned long long>(p50));
+        fprintf(out, "      \"cpu_time\": %llu,\n", static_cast<unsigned long long>(p50));
+        fprintf(out, "      \"time_unit\": \"us\",\n");
+        fprintf(out, "      \"p95_us\": %llu", static_cast<unsigned long long>(percentile(entry.second, 0.95)));
+        if (captured != recorded.end()) {
+            fprintf(out, ",\n      \"captured_p50_us\": %llu,\n", static_cast<unsigned long long>(percentile(captured->second, 0.5)));
+            fprintf(out, "      \"captured_p95_us\": %llu", static_cast<unsigned long long>(percentile(captured->second, 0.95)));
+        }
+        fprintf(out, "\n    }");
+        first = false;
+    }
+    fprintf(out, "\n  ]\n}\n");
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+} // namespace
+
+hal::Transport& transport() {
+    return replay_transport;
+}
+
+int run(const Options& options) {
+    std::vector<Record> captured;
+    if (!read_capture(options.capture_path, captured)) return 2;
+    strip_capture_dumps(captured);
+
+    auto first_host = std::find_if(captured.begin(), captured.end(), [](const Record& record) {
+        return record.direction == capture::Direction::HOST_TO_DEVICE;
+    });
+    if (first_host == captured.end()) {
+        fprintf(stderr, "%s: the host sent nothing\n", options.capture_path);
+        return 2;
+    }
+    const uint64_t capture_start_us = first_host->timestamp_us;
+    uint64_t capture_end_us = capture_start_us;
+    for (const Record& record : captured) {
+        capture_end_us = std::max(capture_end_us, record.timestamp_us);
+    }
+
+    // Boot output is not part of the comparison
+    replay_transport.take();
+    const uint64_t start_us = hal::micros64();
+    auto replay_time = [&](uint64_t captured_us) {
+        return start_us + static_cast<uint64_t>((captured_us - capture_start_us) / options.speed);
+    };
+
+    std::vector<Record> replayed;
+    for (const Record& record : captured) {
+        if (record.direction != capture::Direction::HOST_TO_DEVICE || record.timestamp_us < capture_start_us) continue;
+        uint64_t due = replay_time(record.timestamp_us);
+        uint64_t now = hal::micros64();
+        if (due > now) {
+            std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+        }
+        replayed.push_back({ hal::micros64(), record.direction, record.data });
+        replay_transport.push(record.data);
+    }
+
+    // Until the capture's end, then until the device has been quiet for a while
+    uint64_t end_us = replay_time(capture_end_us);
+    uint64_t limit_us = end_us + SETTLE_LIMIT_US;
+    while (true) {
+        uint64_t now = hal::micros64();
+        uint64_t quiet_since = std::max(replay_transport.last_write_us(), replayed.back().timestamp_us);
+        if ((now >= end_us && now - quiet_since >= QUIET_US) || now >= limit_us) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::vector<Record> output = replay_transport.take();
+    replayed.insert(replayed.end(), output.begin(), output.end());
+
+    auto expected = compared_frames(parse_frames(captured, capture::Direction::DEVICE_TO_HOST, capture_start_us));
+    auto actual = compared_frames(parse_frames(replayed, capture::Direction::DEVICE_TO_HOST, start_us));
+    size_t mismatches = compare(expected, actual);
+
+    auto recorded_latency = latencies(parse_frames(captured, capture::Direction::HOST_TO_DEVICE, capture_start_us), expected);
+    auto replayed_latency = latencies(parse_frames(replayed, capture::Direction::HOST_TO_DEVICE, start_us), actual);
+    print_latencies(recorded_latency, replayed_latency);
+    fprintf(stderr, "%zu responses compared, %zu mismatches\n", expected.size(), mismatches);
+
+    bool ok = true;
+    if (options.report_path) {
+        ok = write_report(options, recorded_latency, replayed_latency, mismatches) && ok;
+    }
+    if (options.output_path) {
+        ok = write_capture(options.output_path, replayed) && ok;
+    }
+    if (!ok) return 2;
+    return mismatches ? 1 : 0;
+}
+
+} // namespace replay
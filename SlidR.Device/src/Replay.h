@@ -0,0 +1,41 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#pragma once
+
+#include "Hal.h"
+
+#include <cinttypes>
+
+/// @brief Replays a serial capture (see `Capture.h`) against the native build, through the
+/// simulator's `--replay` option:
+///
+///     program --replay session.slcap --speed 4 --report replay.json --replay-out replayed.slcap fs
+///
+/// The host's bytes are fed to the controller with their original chunking and spacing, divided
+/// by `speed`. Once the device has gone quiet, its responses are compared frame by frame with
+/// the captured ones and the response latency of each request command is reported for both.
+///
+/// `LOG_EVENT` and `SLIDER_VALUE` frames depend on timing and the sliders and are skipped; for
+/// status, statistics and dump replies only the command is compared, not the payload. Traffic
+/// before the host's first bytes, such as the device's boot, is not compared, and `CAPTURE_DUMP`
+/// requests are not replayed.
+namespace replay {
+
+struct Options {
+    const char* capture_path = nullptr;
+    double speed = 1.0;
+    const char* report_path = nullptr; // Google Benchmark JSON of the latencies, for benchcompare.py
+    const char* output_path = nullptr; // Capture of the replayed session
+};
+
+/// @brief The transport the controller must use, install it before it starts
+hal::Transport& transport();
+
+/// @brief Replay after the controller has booted
+/// @return Exit status: `0` the responses match, `1` they differ, `2` the capture is unusable
+int run(const Options& options);
+
+} // namespace replay
+
+#endif
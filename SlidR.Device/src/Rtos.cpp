@@ -0,0 +1,63 @@
+#include "Rtos.h"
+
+namespace rtos {
+
+namespace {
+
+TaskHandle_t task_handles[TASK_COUNT] = {};
+
+#ifdef SLIDR_STATIC_MEMORY
+constexpr size_t stack_offset(size_t index) {
+    return index == 0 ? 0 : stack_offset(index - 1) + TASKS[index - 1].stack_size;
+}
+constexpr size_t TOTAL_STACK_SIZE = stack_offset(TASK_COUNT);
+
+StackType_t stack_arena[TOTAL_STACK_SIZE / sizeof(StackType_t)] __attribute__((aligned(16)));
+StaticTask_t task_buffers[TASK_COUNT];
+#endif
+
+} // namespace
+
+TaskHandle_t create_task(TaskId id, TaskFunction_t function, void* param) {
+    size_t index = static_cast<size_t>(id);
+    if (task_handles[index]) {
+        return nullptr;
+    }
+
+    const TaskSpec& spec = TASKS[index];
+#ifdef SLIDR_STATIC_MEMORY
+    task_handles[index] = xTaskCreateStatic(
+        function,
+        spec.name,
+        spec.stack_size,
+        param,
+        spec.priority,
+        stack_arena + stack_offset(index) / sizeof(StackType_t),
+        &task_buffers[index]
+    );
+#else
+    if (xTaskCreate(function, spec.name, spec.stack_size, param, spec.priority, &task_handles[index]) != pdPASS) {
+        task_handles[index] = nullptr;
+    }
+#endif
+    return task_handles[index];
+}
+
+TaskHandle_t task_handle(TaskId id) {
+    return task_handles[static_cast<size_t>(id)];
+}
+
+uint8_t task_index(TaskHandle_t task) {
+    for (size_t i = 0; i < TASK_COUNT; i++) {
+        if (task == task_handles[i]) return i;
+    }
+    return task == xTaskGetIdleTaskHandle() ? TASK_INDEX_IDLE : TASK_INDEX_OTHER;
+}
+
+uint32_t stack_high_water_mark(TaskId id) {
+    TaskHandle_t handle = task_handle(id);
+    // ESP-IDF reports stack sizes and high-water marks in bytes
+    return handle ? uxTaskGetStackHighWaterMark(handle) : 0;
+}
+
+} // namespace rtos
@@ -0,0 +1,133 @@
+#ifndef RTOS_H
+#define RTOS_H
+
+#pragma once
+
+#include <FreeRTOS.h>
+#include <cinttypes>
+#include <cstddef>
+
+class Communication;
+
+/// @brief Task table and FreeRTOS object wrappers.
+///
+/// With `SLIDR_STATIC_MEMORY` (PlatformIO env `lolin_s2_mini_static`) every task stack, queue and
+/// semaphore is allocated statically: stacks from one arena sized by `TASKS`, queue and semaphore
+/// storage inside the object that owns them. Otherwise the same calls use the FreeRTOS heap.
+namespace rtos {
+
+enum class TaskId : uint8_t {
+    COMM,
+    SEGMENT,
+    WATCHDOG,
+    CONFIG_JOB,
+    CONFIG_WRITER,
+    SEND_IMAGE,
+    TRANSFER_WATCHDOG,
+    COUNT
+};
+
+struct TaskSpec {
+    TaskId id;
+    const char* name;
+    uint16_t stack_size; // Bytes
+    UBaseType_t priority;
+};
+
+/// @brief Every task the firmware creates. Check `GET_TASK_INFO` before shrinking a stack.
+constexpr TaskSpec TASKS[] = {
+    { TaskId::COMM,              "Comm Task",              6144, 2 },
+    { TaskId::SEGMENT,           "Segment Task",           4096, 1 },
+    { TaskId::WATCHDOG,          "Watchdog Task",          4096, 1 },
+    { TaskId::CONFIG_JOB,        "Config Job Task",        4096, 1 },
+    { TaskId::CONFIG_WRITER,     "Config Writer Task",     4096, 1 },
+    { TaskId::SEND_IMAGE,        "Send Image Task",        8192, 1 },
+    { TaskId::TRANSFER_WATCHDOG, "Transfer Watchdog Task", 1024, 1 },
+};
+constexpr size_t TASK_COUNT = static_cast<size_t>(TaskId::COUNT);
+static_assert(sizeof(TASKS) / sizeof(TASKS[0]) == TASK_COUNT, "Every task needs a TASKS entry");
+
+constexpr bool tasks_in_order(size_t i = 0) {
+    return i == TASK_COUNT || (static_cast<size_t>(TASKS[i].id) == i && tasks_in_order(i + 1));
+}
+static_assert(tasks_in_order(), "TASKS must be ordered by TaskId");
+
+constexpr const TaskSpec& task_spec(TaskId id) {
+    return TASKS[static_cast<size_t>(id)];
+}
+
+/// @brief Queue lengths, allocated together with their owner in static-memory builds
+constexpr size_t CONFIG_JOB_QUEUE_LENGTH = 4;
+
+/// @brief Create the task `id` with the stack size and priority from `TASKS`.
+/// Each task is created once and runs for the lifetime of the firmware.
+/// @return The task handle, `nullptr` if it could not be created
+TaskHandle_t create_task(TaskId id, TaskFunction_t function, void* param);
+
+/// @brief Handle of a created task, `nullptr` before `create_task()`
+TaskHandle_t task_handle(TaskId id);
+
+/// @brief Lowest amount of stack the task has had free since it started, in bytes
+uint32_t stack_high_water_mark(TaskId id);
+
+/// @brief Task indices used by the profiler and trace besides the `TaskId` values
+constexpr uint8_t TASK_INDEX_IDLE = 0xFE;
+constexpr uint8_t TASK_INDEX_OTHER = 0xFF; // Framework tasks (loop, timer, USB)
+
+/// @brief `TaskId` of `task` as a number, or one of the `TASK_INDEX_*` values
+uint8_t task_index(TaskHandle_t task);
+
+/// @brief Owns a FreeRTOS mutex or binary semaphore. Converts to `SemaphoreHandle_t`.
+class Semaphore {
+public:
+    enum class Kind : uint8_t { MUTEX, BINARY };
+
+    explicit Semaphore(Kind kind) {
+#ifdef SLIDR_STATIC_MEMORY
+        _handle = kind == Kind::MUTEX ? xSemaphoreCreateMutexStatic(&_storage)
+                                      : xSemaphoreCreateBinaryStatic(&_storage);
+#else
+        _handle = kind == Kind::MUTEX ? xSemaphoreCreateMutex() : xSemaphoreCreateBinary();
+#endif
+    }
+    ~Semaphore() { vSemaphoreDelete(_handle); }
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    operator SemaphoreHandle_t() const { return _handle; }
+
+private:
+#ifdef SLIDR_STATIC_MEMORY
+    StaticSemaphore_t _storage;
+#endif
+    SemaphoreHandle_t _handle;
+};
+
+/// @brief Owns a FreeRTOS queue of `Length` items of `T`. Converts to `QueueHandle_t`.
+template <typename T, size_t Length>
+class Queue {
+public:
+    Queue() {
+#ifdef SLIDR_STATIC_MEMORY
+        _handle = xQueueCreateStatic(Length, sizeof(T), _items, &_storage);
+#else
+        _handle = xQueueCreate(Length, sizeof(T));
+#endif
+    }
+    ~Queue() { vQueueDelete(_handle); }
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
+    operator QueueHandle_t() const { return _handle; }
+
+private:
+#ifdef SLIDR_STATIC_MEMORY
+    StaticQueue_t _storage;
+    uint8_t _items[Length * sizeof(T)];
+#endif
+    QueueHandle_t _handle;
+};
+
+} // namespace rtos
+
+#endif
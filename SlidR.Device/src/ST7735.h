@@ -9,6 +9,8 @@
 
 class ST7735 : public Adafruit_ST7735 {
 public:
+    static constexpr int16_t PANEL_SIZE = 128;
+
     ST7735(uint8_t cs, SPIClass *spiClass, uint8_t dc, uint8_t rst) : Adafruit_ST7735(spiClass, cs, dc, rst) {}
     ~ST7735() = default;
 
@@ -21,7 +23,92 @@ public:
         digitalWrite(dc, HIGH);
         _dc = dc;
     }
+
+    /// @brief Steps of `initR(INITR_144GREENTAB)`, split where the panel needs time to settle
+    enum class InitStage : uint8_t {
+        RESET,
+        WAKE,
+        CONFIGURE,
+        DISPLAY_ON,
+        COUNT
+    };
+
+    /// @brief Send the commands of one init stage. Unlike `initR()` this does not wait,
+    /// so panels sharing a bus can run a stage one after another and wait it out together.
+    /// @param freq SPI clock from `RESET` on, 0 for the library default
+    /// @return Milliseconds the panel needs before the next stage
+    uint16_t initStage(InitStage stage, uint32_t freq = 0) {
+        switch (stage) {
+            case InitStage::RESET:
+                begin(freq);
+                displayInit(INIT_RESET);
+                return 150;
+            case InitStage::WAKE:
+                displayInit(INIT_WAKE);
+                return 500;
+            case InitStage::CONFIGURE:
+                _width = PANEL_SIZE;
+                _height = PANEL_SIZE;
+                _colstart = 2;
+                _rowstart = 3;
+                displayInit(INIT_CONFIGURE);
+                return 10;
+            case InitStage::DISPLAY_ON:
+                displayInit(INIT_DISPLAY_ON);
+                setRotation(0);
+                return 100;
+            default:
+                return 0;
+        }
+    }
+
+    /// @brief The staged init does not set the tab type `Adafruit_ST7735::setRotation()` uses
+    /// to pick the panel size; every panel here is 128x128
+    void setRotation(uint8_t m) override {
+        Adafruit_ST7735::setRotation(m);
+        _width = PANEL_SIZE;
+        _height = PANEL_SIZE;
+    }
+
 private:
+
+    // Command lists of Adafruit_ST7735::initR() for INITR_144GREENTAB without the delays,
+    // in `displayInit()` format: [count] then count x [command][arg count][args]
+    static constexpr uint8_t INIT_RESET[] = {
+        1,
+        ST77XX_SWRESET, 0,
+    };
+    static constexpr uint8_t INIT_WAKE[] = {
+        1,
+        ST77XX_SLPOUT, 0,
+    };
+    static constexpr uint8_t INIT_CONFIGURE[] = {
+        18,
+        ST7735_FRMCTR1, 3, 0x01, 0x2C, 0x2D,
+        ST7735_FRMCTR2, 3, 0x01, 0x2C, 0x2D,
+        ST7735_FRMCTR3, 6, 0x01, 0x2C, 0x2D, 0x01, 0x2C, 0x2D,
+        ST7735_INVCTR, 1, 0x07,
+        ST7735_PWCTR1, 3, 0xA2, 0x02, 0x84,
+        ST7735_PWCTR2, 1, 0xC5,
+        ST7735_PWCTR3, 2, 0x0A, 0x00,
+        ST7735_PWCTR4, 2, 0x8A, 0x2A,
+        ST7735_PWCTR5, 2, 0x8A, 0xEE,
+        ST7735_VMCTR1, 1, 0x0E,
+        ST77XX_INVOFF, 0,
+        ST77XX_MADCTL, 1, 0xC8,
+        ST77XX_COLMOD, 1, 0x05,
+        ST77XX_CASET, 4, 0x00, 0x00, 0x00, 0x7F,
+        ST77XX_RASET, 4, 0x00, 0x00, 0x00, 0x7F,
+        ST7735_GMCTRP1, 16, 0x02, 0x1C, 0x07, 0x12, 0x37, 0x32, 0x29, 0x2D,
+                            0x29, 0x25, 0x2B, 0x39, 0x00, 0x01, 0x03, 0x10,
+        ST7735_GMCTRN1, 16, 0x03, 0x1D, 0x07, 0x06, 0x2E, 0x2C, 0x29, 0x2D,
+                            0x2E, 0x2E, 0x37, 0x3F, 0x00, 0x00, 0x02, 0x10,
+        ST77XX_NORON, 0,
+    };
+    static constexpr uint8_t INIT_DISPLAY_ON[] = {
+        1,
+        ST77XX_DISPON, 0,
+    };
 };
 
 #endif
\ No newline at end of file
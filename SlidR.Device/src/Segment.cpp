@@ -1,25 +1,27 @@
 #include "Segment.h"
-#include <Arduino.h>
-#include <FS.h>
-#include <LittleFS.h>
-#include <string>
-
-#define LOG(msg) if (_send_logs) { _communication.send_log(msg); }
-
-Segment::Segment(uint8_t index, const SegmentConfig &cfg, Communication &comm, uint8_t dc, SPIClass* spiClass)
-    : _image_path(Segment::get_image_path(index)), _index(index), _config(cfg), _communication(comm), _last_pot_value(0), _last_vol_percent(0) {
-    _display_mutex = xSemaphoreCreateMutex();
-    _tft = std::make_unique<ST7735>(cfg.tft_cs_pin, spiClass, dc, -1);
+#include "HeapTrace.h"
+#include "Stats.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdlib>
+
+#define LOG(...) if (_send_logs) { SLIDR_LOG(_communication, __VA_ARGS__); }
+
+Segment::Segment(uint8_t index, const SegmentConfig &cfg, Communication &comm, uint8_t dc, uint32_t spi_hz)
+    : _index(index), _communication(comm), _last_pot_value(0), _last_vol_percent(0) {
+    Segment::get_image_path(index, _image_path);
+    _tft = hal::create_panel(cfg.tft_cs_pin, dc);
+    _tft->set_spi_speed(spi_hz);
     _send_logs = false;
 }
 
-std::unique_ptr<Segment> Segment::create_and_init(uint8_t index, const SegmentConfig &cfg, Communication &comm, uint8_t dc, SPIClass* spiClass) {
+std::unique_ptr<Segment> Segment::create_and_init(uint8_t index, const SegmentConfig &cfg, Communication &comm, uint8_t dc, uint32_t spi_hz) {
     auto seg = std::make_unique<Segment>(
         index,
         cfg,
         comm,
         dc,
-        spiClass
+        spi_hz
     );
     seg->begin();
     seg->load_and_display_image();
@@ -27,26 +29,37 @@ std::unique_ptr<Segment> Segment::create_and_init(uint8_t index, const SegmentCo
 }
 
 void Segment::set_dc_pin(uint8_t dc) {
-    _tft->setDcPin(dc);
+    _tft->set_dc_pin(dc);
+}
+
+void Segment::set_spi_speed(uint32_t hz) {
+    xSemaphoreTake(_display_mutex, portMAX_DELAY);
+    _tft->set_spi_speed(hz);
+    xSemaphoreGive(_display_mutex);
 }
 
 void Segment::begin() {
-    _tft->initR(INITR_144GREENTAB);
-    _tft->setRotation(0);
-    _tft->setColRowStart(2, 1);
-    _tft->fillScreen(ST7735_BLACK);
-    _tft->invertDisplay(true);
+    for (uint8_t stage = 0; stage < INIT_STAGE_COUNT; stage++) {
+        hal::delay_ms(begin_stage(stage));
+    }
+}
+
+uint16_t Segment::begin_stage(uint8_t stage) {
+    return _tft->init_stage(stage);
 }
 
 bool Segment::load_and_display_image() {
+    HEAP_TRACE_SCOPE(heap_trace::Subsystem::DISPLAY);
+    TRACE_SCOPE(BLIT, _index);
     if (xSemaphoreTake(_display_mutex, pdMS_TO_TICKS(500)) != pdTRUE) {
-        LOG("Failed to acquire display mutex");
+        LOG(DISPLAY_MUTEX_TIMEOUT, _index);
+        stats::add(stats::Counter::DISPLAY_MUTEX_TIMEOUTS);
         return false;
     }
 
-    File img_file = LittleFS.open(_image_path.c_str(), "r");
+    hal::File img_file = hal::filesystem().open(_image_path, "r");
     if (!img_file) {
-        LOG(("Failed to open image: '" + _image_path + "'").c_str());
+        LOG(IMAGE_OPEN_FAILED, _image_path);
         xSemaphoreGive(_display_mutex);
         return false;
     }
@@ -56,55 +69,89 @@ bool Segment::load_and_display_image() {
     img_file.read((uint8_t*)&img_width, sizeof(img_width));
     img_file.read((uint8_t*)&img_height, sizeof(img_height));
 
-    LOG(("Loading image: '" + _image_path + "' (" + std::to_string(img_width) + "x" + std::to_string(img_height) + ")\n").c_str());
+    LOG(IMAGE_LOADING, _image_path, img_width, img_height);
 
     constexpr size_t CHUNK_SIZE = 256;
     uint16_t pixel_buffer[CHUNK_SIZE];
     size_t total_pixels = img_width * img_height;
     size_t pixels_read = 0;
 
-    _tft->startWrite();
-    _tft->setAddrWindow(0, 0, img_width, img_height);
+    // Opening the file allocates inside the FS layer; streaming the pixels must not
+    HEAP_STEADY_STATE(heap_trace::Subsystem::DISPLAY);
+    _tft->begin_write();
+    _tft->set_window(0, 0, img_width, img_height);
     while (pixels_read < total_pixels) {
         size_t pixels_to_read = std::min(CHUNK_SIZE, total_pixels - pixels_read);
         size_t bytes_to_read = pixels_to_read * sizeof(uint16_t);
         size_t read_bytes = img_file.read((uint8_t*)pixel_buffer, bytes_to_read);
         if (read_bytes != bytes_to_read) {
-            LOG(("Read error: expected " + std::to_string(bytes_to_read) + ", got " + std::to_string(read_bytes)).c_str());
-            _tft->endWrite();
+            LOG(IMAGE_READ_FAILED, static_cast<uint16_t>(bytes_to_read), static_cast<uint16_t>(read_bytes));
+            _tft->end_write();
             img_file.close();
             xSemaphoreGive(_display_mutex);
             return false;
         }
 
-        _tft->writePixels(pixel_buffer, read_bytes / 2, true, true);
+        _tft->write_pixels(pixel_buffer, read_bytes / 2);
         pixels_read += pixels_to_read;
     }
-    _tft->endWrite();
+    _tft->end_write();
     img_file.close();
 
-    LOG(("Image '" + _image_path + "' loaded successfully").c_str());
+    LOG(IMAGE_LOADED, _image_path);
+    stats::add(stats::Counter::IMAGES_DRAWN);
 
     xSemaphoreGive(_display_mutex);    
     return true;
 }
 
-uint8_t Segment::read_volume() {
-    uint16_t raw_value = analogRead(_config.pot_pin);
+uint32_t Segment::benchmark_blit(uint32_t spi_hz) {
+    TRACE_SCOPE(BLIT, _index);
+    if (xSemaphoreTake(_display_mutex, pdMS_TO_TICKS(500)) != pdTRUE) {
+        LOG(DISPLAY_MUTEX_TIMEOUT, _index);
+        stats::add(stats::Counter::DISPLAY_MUTEX_TIMEOUTS);
+        return 0;
+    }
+
+    // Same chunking as `load_and_display_image()`, without the file reads
+    constexpr size_t CHUNK_SIZE = 256;
+    constexpr size_t PANEL_PIXELS = hal::Panel::SIZE * hal::Panel::SIZE;
+    uint16_t pixel_buffer[CHUNK_SIZE];
+    for (size_t i = 0; i < CHUNK_SIZE; i++) {
+        pixel_buffer[i] = i * 0x0101;
+    }
+
+    _tft->override_spi_speed(spi_hz);
+    uint32_t start_us = hal::micros();
+    _tft->begin_write();
+    _tft->set_window(0, 0, hal::Panel::SIZE, hal::Panel::SIZE);
+    for (size_t written = 0; written < PANEL_PIXELS; written += CHUNK_SIZE) {
+        _tft->write_pixels(pixel_buffer, CHUNK_SIZE);
+    }
+    _tft->end_write();
+    uint32_t duration_us = hal::micros() - start_us;
+    _tft->reset_spi_speed();
+
+    xSemaphoreGive(_display_mutex);
+    return duration_us;
+}
+
+uint8_t Segment::read_volume(const SegmentConfig& cfg) {
+    uint16_t raw_value = hal::analog_read(cfg.pot_pin);
 
-    uint16_t range = _config.pot_max_value - _config.pot_min_value;
+    uint16_t range = cfg.pot_max_value - cfg.pot_min_value;
     if (range == 0) {
         return 0;
     }
 
-    int32_t mapped = (((int32_t)raw_value - _config.pot_min_value) * 100) / range;
-    mapped = constrain(mapped, 0, 100);
+    int32_t mapped = (((int32_t)raw_value - cfg.pot_min_value) * 100) / range;
+    mapped = std::clamp<int32_t>(mapped, 0, 100);
 
     return static_cast<uint8_t>(mapped);
 }
 
-bool Segment::has_volume_changed(uint8_t &out_vol) {
-    out_vol = read_volume();
+bool Segment::has_volume_changed(const SegmentConfig& cfg, uint8_t &out_vol) {
+    out_vol = read_volume(cfg);
     if (abs(out_vol - _last_vol_percent) >= 2) {
         _last_vol_percent = out_vol;
         return true;
@@ -114,7 +161,7 @@ bool Segment::has_volume_changed(uint8_t &out_vol) {
 
 void Segment::sleep() {
     if (xSemaphoreTake(_display_mutex, pdMS_TO_TICKS(500)) == pdTRUE) {
-        _tft->fillScreen(ST7735_BLACK);
+        _tft->fill(hal::Panel::BLACK);
         // TODO: _tft->enableSleep() ?
         xSemaphoreGive(_display_mutex);
     }
@@ -5,47 +5,63 @@
 
 #include "Config.h"
 #include "Communication.h"
-#include "ST7735.h"
+#include "Hal.h"
+#include "Rtos.h"
 
 #include <FreeRTOS.h>
-#include <SPI.h>
 #include <cinttypes>
+#include <cstdio>
 #include <memory>
-#include <string>
 
 class Segment {
 public:
-    Segment(uint8_t index, const SegmentConfig& cfg, Communication& comm, uint8_t dc, SPIClass* spiClass);
+    Segment(uint8_t index, const SegmentConfig& cfg, Communication& comm, uint8_t dc, uint32_t spi_hz);
     ~Segment() = default;
-    static std::unique_ptr<Segment> create_and_init(uint8_t index, const SegmentConfig& cfg, Communication& comm, uint8_t dc, SPIClass* spiClass);
+    static std::unique_ptr<Segment> create_and_init(uint8_t index, const SegmentConfig& cfg, Communication& comm, uint8_t dc, uint32_t spi_hz);
     void set_dc_pin(uint8_t dc);
+    /// @brief Change the panel's SPI clock, between blits
+    void set_spi_speed(uint32_t hz);
 
+    /// @brief Initialize the panel, waiting between init stages
     void begin();
+    /// @brief Run one stage of `begin()` without waiting, see `hal::Panel::init_stage()`
+    /// @param stage `0` to `INIT_STAGE_COUNT - 1`
+    /// @return Milliseconds the panel needs before the next stage
+    uint16_t begin_stage(uint8_t stage);
+    static constexpr uint8_t INIT_STAGE_COUNT = hal::Panel::INIT_STAGE_COUNT;
     bool load_and_display_image();
+    /// @brief Time a full-panel blit with the panel's SPI clock set to `spi_hz`. Leaves garbage on
+    /// the panel and restores the clock afterwards.
+    /// @return Microseconds, `0` if the display is busy
+    uint32_t benchmark_blit(uint32_t spi_hz);
 
-    uint8_t read_volume();
-    bool has_volume_changed(uint8_t& out_vol);
+    /// @brief Read the slider position using the calibration in `cfg`
+    uint8_t read_volume(const SegmentConfig& cfg);
+    bool has_volume_changed(const SegmentConfig& cfg, uint8_t& out_vol);
     
     void sleep();
 
     void enable_logs(bool enable) {
         _send_logs = enable;
     }
-    SegmentConfig& config() { return _config; }
-    static std::string get_image_path(uint8_t index) {
-        return "/images/img-" + std::to_string(index) + ".bin";
+    const char* image_path() const {
+        return _image_path;
+    }
+
+    static constexpr size_t IMAGE_PATH_SIZE = sizeof("/images/img-255.bin");
+    static void get_image_path(uint8_t index, char (&out)[IMAGE_PATH_SIZE]) {
+        snprintf(out, IMAGE_PATH_SIZE, "/images/img-%u.bin", index);
     }
 
 private:
-    const std::string _image_path;
+    char _image_path[IMAGE_PATH_SIZE];
     uint8_t _index;
-    SegmentConfig _config;
     Communication& _communication;
     bool _send_logs;
-    std::unique_ptr<ST7735> _tft;
+    std::unique_ptr<hal::Panel> _tft;
     uint16_t _last_pot_value;
     uint8_t _last_vol_percent;
-    SemaphoreHandle_t _display_mutex;
+    rtos::Semaphore _display_mutex{ rtos::Semaphore::Kind::MUTEX };
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+/// SHA-256 (FIPS 180-4) for firmware image digests. Header-only so host tools produce identical
+/// values; hashes a few MB/s on the ESP32-S2, well ahead of flash writes.
+namespace sha256 {
+
+constexpr size_t DIGEST_SIZE = 32;
+constexpr size_t BLOCK_SIZE = 64;
+
+struct Digest {
+    uint8_t bytes[DIGEST_SIZE];
+
+    constexpr bool operator==(const Digest& other) const {
+        for (size_t i = 0; i < DIGEST_SIZE; i++) {
+            if (bytes[i] != other.bytes[i]) return false;
+        }
+        return true;
+    }
+    constexpr bool operator!=(const Digest& other) const { return !(*this == other); }
+};
+
+constexpr uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/// @brief Incremental hash: `update()` with the data in pieces of any size, then `finish()` once
+class Hasher {
+public:
+    constexpr void update(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            _block[_block_size++] = data[i];
+            if (_block_size == BLOCK_SIZE) {
+                compress();
+                _block_size = 0;
+            }
+        }
+        _length += size;
+    }
+
+    constexpr Digest finish() {
+        uint64_t bits = _length * 8;
+        const uint8_t pad = 0x80;
+        update(&pad, 1);
+        const uint8_t zero = 0;
+        while (_block_size != BLOCK_SIZE - 8) {
+            update(&zero, 1);
+        }
+        uint8_t length[8] = {};
+        for (int i = 0; i < 8; i++) {
+            length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        }
+        update(length, sizeof(length));
+
+        Digest digest{};
+        for (size_t i = 0; i < DIGEST_SIZE; i++) {
+            digest.bytes[i] = static_cast<uint8_t>(_state[i / 4] >> (24 - 8 * (i % 4)));
+        }
+        return digest;
+    }
+
+private:
+    static constexpr uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    constexpr void compress() {
+        uint32_t w[64] = {};
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t(_block[i * 4]) << 24) | (uint32_t(_block[i * 4 + 1]) << 16) |
+                   (uint32_t(_block[i * 4 + 2]) << 8) | uint32_t(_block[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+        uint32_t e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        _state[0] += a;
+        _state[1] += b;
+        _state[2] += c;
+        _state[3] += d;
+        _state[4] += e;
+        _state[5] += f;
+        _state[6] += g;
+        _state[7] += h;
+    }
+
+    uint32_t _state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    uint8_t _block[BLOCK_SIZE] = {};
+    size_t _block_size = 0;
+    uint64_t _length = 0;
+};
+
+constexpr Digest hash(const uint8_t* data, size_t size) {
+    Hasher hasher;
+    hasher.update(data, size);
+    return hasher.finish();
+}
+
+constexpr uint8_t CHECK_INPUT[] = { 'a', 'b', 'c' };
+constexpr Digest CHECK_DIGEST = { {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+} };
+static_assert(hash(CHECK_INPUT, sizeof(CHECK_INPUT)) == CHECK_DIGEST, "SHA-256 check value mismatch");
+
+} // namespace sha256
+
+#endif // SHA256_H
@@ -0,0 +1,352 @@
+#include "Simulator.h"
+#include "Crc32.h"
+
+#include <FreeRTOS.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace simulator {
+
+namespace {
+
+constexpr uint16_t ADC_FULL_SCALE = 4095;
+constexpr uint32_t RAMP_STEP_MS = 10;
+
+std::unique_ptr<hal::native::FdTransport> pty_transport;
+
+void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [options] [fs_dir]\n"
+        "  fs_dir                  directory standing in for LittleFS (default native_fs)\n"
+        "  --pty                   serve the protocol on a pseudo-terminal, not stdin/stdout\n"
+        "  --link PATH             symlink PATH to the pty\n"
+        "  --png-dir DIR           write DIR/panel-cs<pin>.png when a panel changes\n"
+        "  --png-interval MS       how often panels are checked for changes (default 250)\n"
+        "  --script FILE           slider and PNG script, - for stdin (with --pty only)\n"
+        "  --spi-hz HZ             simulate panel SPI time, at the configured clock (HZ until set)\n"
+        "  --flash-read KIB_S      simulate the flash read rate\n"
+        "  --flash-write KIB_S     simulate the flash write rate\n"
+        "  --flash-op-us US        simulate the latency of each file operation\n"
+        "  --firmware FILE         update partition for OTA updates (default native_firmware.bin)\n"
+        "  --replay FILE           feed a serial capture to the device and compare its responses\n"
+        "  --speed FACTOR          replay faster than captured (default 1)\n"
+        "  --report FILE           write the replay latencies as Google Benchmark JSON\n"
+        "  --replay-out FILE       write the replayed session as a capture\n",
+        program);
+}
+
+bool parse_uint(const char* text, uint32_t& out) {
+    char* end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (*text == '\0' || *end != '\0') return false;
+    out = value;
+    return true;
+}
+
+void put_u32_be(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(value >> 24);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+void put_chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    put_u32_be(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32_be(out, crc32::update(out.data() + start, out.size() - start));
+}
+
+void set_slider(uint8_t pin, uint32_t percent) {
+    hal::native::set_analog_input(pin, std::min<uint32_t>(percent, 100) * ADC_FULL_SCALE / 100);
+}
+
+/// @brief Write every panel whose pixel count changed since `written` was last updated
+void dump_panels(const char* dir, std::map<uint8_t, uint32_t>& written, bool force) {
+    struct Copy {
+        uint8_t cs_pin;
+        uint16_t pixels[hal::Panel::SIZE * hal::Panel::SIZE];
+    };
+    std::vector<std::unique_ptr<Copy>> copies;
+    hal::native::for_each_panel([&](const hal::native::FakePanel& panel) {
+        uint32_t count = panel.pixels_written();
+        auto it = written.find(panel.cs_pin());
+        if (!force && it != written.end() && it->second == count) return;
+        written[panel.cs_pin()] = count;
+
+        auto copy = std::make_unique<Copy>();
+        copy->cs_pin = panel.cs_pin();
+        panel.copy_pixels(copy->pixels);
+        copies.push_back(std::move(copy));
+    });
+
+    // Encoded outside the registry lock so the firmware can keep creating panels
+    for (const auto& copy : copies) {
+        std::string path = std::string(dir) + "/panel-cs" + std::to_string(copy->cs_pin) + ".png";
+        if (!write_png(path.c_str(), copy->pixels, hal::Panel::SIZE, hal::Panel::SIZE)) {
+            fprintf(stderr, "slidr-sim: could not write %s\n", path.c_str());
+        }
+    }
+}
+
+void run_command(const std::string& line, const Options& options, std::map<uint8_t, uint32_t>& written) {
+    std::istringstream in(line.substr(0, line.find('#')));
+    std::string command;
+    if (!(in >> command)) return;
+
+    uint32_t pin, a, b, duration_ms;
+    if (command == "slider" && in >> pin >> a) {
+        set_slider(pin, a);
+    } else if (command == "adc" && in >> pin >> a) {
+        hal::native::set_analog_input(pin, std::min<uint32_t>(a, ADC_FULL_SCALE));
+    } else if (command == "ramp" && in >> pin >> a >> b >> duration_ms) {
+        uint32_t steps = std::max<uint32_t>(duration_ms / RAMP_STEP_MS, 1);
+        for (uint32_t step = 1; step <= steps; step++) {
+            set_slider(pin, a + (static_cast<int32_t>(b) - static_cast<int32_t>(a)) * static_cast<int32_t>(step) / static_cast<int32_t>(steps));
+            vTaskDelay(pdMS_TO_TICKS(RAMP_STEP_MS));
+        }
+    } else if (command == "sleep" && in >> duration_ms) {
+        vTaskDelay(pdMS_TO_TICKS(duration_ms));
+    } else if (command == "png") {
+        if (options.png_dir) {
+            dump_panels(options.png_dir, written, true);
+        } else {
+            fprintf(stderr, "slidr-sim: png needs --png-dir\n");
+        }
+    } else if (command == "quit") {
+        std::_Exit(0);
+    } else {
+        fprintf(stderr, "slidr-sim: bad script line: %s\n", line.c_str());
+    }
+}
+
+} // namespace
+
+bool parse_options(int argc, char** argv, Options& options) {
+    enum {
+        PTY = 1, LINK, PNG_DIR, PNG_INTERVAL, SCRIPT, SPI_HZ, FLASH_READ, FLASH_WRITE, FLASH_OP_US,
+        REPLAY, SPEED, REPORT, REPLAY_OUT, FIRMWARE
+    };
+    const option long_options[] = {
+        { "pty", no_argument, nullptr, PTY },
+        { "link", required_argument, nullptr, LINK },
+        { "png-dir", required_argument, nullptr, PNG_DIR },
+        { "png-interval", required_argument, nullptr, PNG_INTERVAL },
+        { "script", required_argument, nullptr, SCRIPT },
+        { "spi-hz", required_argument, nullptr, SPI_HZ },
+        { "flash-read", required_argument, nullptr, FLASH_READ },
+        { "flash-write", required_argument, nullptr, FLASH_WRITE },
+        { "flash-op-us", required_argument, nullptr, FLASH_OP_US },
+        { "replay", required_argument, nullptr, REPLAY },
+        { "speed", required_argument, nullptr, SPEED },
+        { "report", required_argument, nullptr, REPORT },
+        { "replay-out", required_argument, nullptr, REPLAY_OUT },
+        { "firmware", required_argument, nullptr, FIRMWARE },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    int option;
+    bool ok = true;
+    while (ok && (option = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        uint32_t kib_s;
+        switch (option) {
+            case PTY: options.pty = true; break;
+            case LINK: options.link_path = optarg; break;
+            case PNG_DIR: options.png_dir = optarg; break;
+            case PNG_INTERVAL: ok = parse_uint(optarg, options.png_interval_ms) && options.png_interval_ms > 0; break;
+            case SCRIPT: options.script_path = optarg; break;
+            case SPI_HZ: ok = parse_uint(optarg, options.timing.spi_hz); break;
+            case FLASH_READ:
+                ok = parse_uint(optarg, kib_s);
+                options.timing.flash_read_bytes_per_s = kib_s * 1024;
+                break;
+            case FLASH_WRITE:
+                ok = parse_uint(optarg, kib_s);
+                options.timing.flash_write_bytes_per_s = kib_s * 1024;
+                break;
+            case FLASH_OP_US: ok = parse_uint(optarg, options.timing.flash_op_us); break;
+            case REPLAY: options.replay.capture_path = optarg; break;
+            case SPEED: options.replay.speed = atof(optarg); ok = options.replay.speed > 0; break;
+            case REPORT: options.replay.report_path = optarg; break;
+            case REPLAY_OUT: options.replay.output_path = optarg; break;
+            case FIRMWARE: options.firmware_path = optarg; break;
+            default: ok = false; break;
+        }
+    }
+    if (ok && optind < argc) {
+        options.fs_dir = argv[optind++];
+    }
+    ok = ok && optind == argc;
+    // stdin carries the protocol unless it is on a pty
+    ok = ok && !(options.script_path && strcmp(options.script_path, "-") == 0 && !options.pty);
+    ok = ok && !(options.link_path && !options.pty);
+    // A replay is the host
+    bool replay = options.replay.capture_path;
+    ok = ok && !(replay && (options.pty || options.script_path));
+    ok = ok && (replay || (!options.replay.report_path && !options.replay.output_path));
+
+    if (!ok) usage(argv[0]);
+    return ok;
+}
+
+bool start(const Options& options) {
+    static hal::native::DirectoryFileSystem filesystem(options.fs_dir);
+    hal::native::set_filesystem(filesystem);
+    hal::native::set_timing(options.timing);
+    if (options.firmware_path) {
+        static hal::native::FileFirmware firmware(options.firmware_path);
+        hal::native::set_firmware(firmware);
+    }
+
+    if (options.replay.capture_path) {
+        hal::native::set_transport(replay::transport());
+        return true;
+    }
+    if (!options.pty) return true;
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("slidr-sim: pty");
+        return false;
+    }
+    const char* slave_path = ptsname(master);
+
+    // Held open so the pty survives hosts connecting and disconnecting, raw like a USB CDC port
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    termios attributes;
+    if (slave < 0 || tcgetattr(slave, &attributes) != 0) {
+        perror("slidr-sim: pty");
+        return false;
+    }
+    cfmakeraw(&attributes);
+    tcsetattr(slave, TCSANOW, &attributes);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (options.link_path) {
+        unlink(options.link_path);
+        if (symlink(slave_path, options.link_path) != 0) {
+            perror("slidr-sim: --link");
+            return false;
+        }
+    }
+    fprintf(stderr, "slidr-sim: serial on %s\n", options.link_path ? options.link_path : slave_path);
+
+    pty_transport = std::make_unique<hal::native::FdTransport>(master, master);
+    hal::native::set_transport(*pty_transport);
+    return true;
+}
+
+void run(const Options& options) {
+    if (options.png_dir) {
+        std::thread([dir = options.png_dir, interval_ms = options.png_interval_ms]() {
+            std::map<uint8_t, uint32_t> written;
+            while (true) {
+                dump_panels(dir, written, false);
+                std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+            }
+        }).detach();
+    }
+
+    if (options.replay.capture_path) {
+        std::_Exit(replay::run(options.replay));
+    }
+
+    if (options.script_path) {
+        std::map<uint8_t, uint32_t> written;
+        std::ifstream file;
+        bool from_stdin = strcmp(options.script_path, "-") == 0;
+        if (!from_stdin) {
+            file.open(options.script_path);
+            if (!file) {
+                fprintf(stderr, "slidr-sim: could not open %s\n", options.script_path);
+                std::_Exit(1);
+            }
+        }
+        std::istream& script = from_stdin ? std::cin : file;
+        std::string line;
+        while (std::getline(script, line)) {
+            run_command(line, options, written);
+        }
+    }
+
+    while (options.pty || hal::transport().connected()) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    // Let queued jobs answer, then leave without tearing down objects the tasks still use
+    vTaskDelay(pdMS_TO_TICKS(500));
+    std::_Exit(0);
+}
+
+bool write_png(const char* path, const uint16_t* pixels, uint16_t width, uint16_t height) {
+    // Scanlines with filter type 0, then zlib with stored (uncompressed) deflate blocks
+    std::vector<uint8_t> raw;
+    raw.reserve(height * (1 + width * 3));
+    for (uint16_t y = 0; y < height; y++) {
+        raw.push_back(0);
+        for (uint16_t x = 0; x < width; x++) {
+            uint16_t color = pixels[y * width + x];
+            uint8_t r = (color >> 11) & 0x1F;
+            uint8_t g = (color >> 5) & 0x3F;
+            uint8_t b = color & 0x1F;
+            raw.push_back((r << 3) | (r >> 2));
+            raw.push_back((g << 2) | (g >> 4));
+            raw.push_back((b << 3) | (b >> 2));
+        }
+    }
+
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    constexpr size_t MAX_BLOCK = 0xFFFF;
+    size_t offset = 0;
+    do {
+        size_t size = std::min(MAX_BLOCK, raw.size() - offset);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(size & 0xFF);
+        zlib.push_back(size >> 8);
+        zlib.push_back(~size & 0xFF);
+        zlib.push_back((~size >> 8) & 0xFF);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+
+    uint32_t adler_a = 1, adler_b = 0;
+    for (uint8_t byte : raw) {
+        adler_a = (adler_a + byte) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+    put_u32_be(zlib, (adler_b << 16) | adler_a);
+
+    std::vector<uint8_t> header;
+    put_u32_be(header, width);
+    put_u32_be(header, height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, deflate, no filter, no interlace
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib);
+    put_chunk(png, "IEND", {});
+
+    // Written aside and renamed so viewers never see half a file
+    std::string temp_path = std::string(path) + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+    ok = fclose(file) == 0 && ok;
+    return ok && rename(temp_path.c_str(), path) == 0;
+}
+
+} // namespace simulator
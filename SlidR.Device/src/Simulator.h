@@ -0,0 +1,62 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#pragma once
+
+#include "HalNative.h"
+#include "Replay.h"
+
+#include <cinttypes>
+
+/// @brief Device simulator around the native build (PlatformIO env `native`): the real
+/// controller on top of the `HalNative.h` fakes, with the serial link on stdin/stdout or a pty,
+/// the filesystem in a directory, panels dumped to PNG and sliders driven by a script.
+///
+///     program --pty --link /tmp/slidr0 --png-dir out --script sliders.txt sim_fs
+///     python pro.py   # then connect to /tmp/slidr0
+///
+/// One process is one device; start several with different `--link` and filesystem directories
+/// to load-test a host. Firmware updates are written to `--firmware` and end the process, as the
+/// restart that boots them would; run it again to boot the image on trial.
+///
+/// Script commands, one per line, `#` starts a comment:
+///
+///     slider <pin> <percent>                    ADC reading of `pin` as 0-100 % of full scale
+///     adc <pin> <raw>                           Raw 12-bit ADC reading
+///     ramp <pin> <from %> <to %> <duration ms>  Move a slider in 10 ms steps
+///     sleep <ms>
+///     png                                       Write every panel now, changed or not
+///     quit
+///
+/// With `--replay` the controller gets a recorded session instead of a host, see `Replay.h`.
+namespace simulator {
+
+struct Options {
+    const char* fs_dir = "native_fs";
+    bool pty = false;
+    const char* link_path = nullptr;   // Symlink to the pty
+    const char* png_dir = nullptr;     // Write `panel-cs<pin>.png` here when a panel changes
+    uint32_t png_interval_ms = 250;
+    const char* script_path = nullptr; // `-` for stdin, with `pty` only
+    const char* firmware_path = nullptr; // Update partition, see `hal::native::FileFirmware`
+    hal::native::Timing timing;
+    replay::Options replay;
+};
+
+/// @return `false` after printing the usage if the arguments are invalid
+bool parse_options(int argc, char** argv, Options& options);
+
+/// @brief Install the transport, filesystem and timing. Call before `Controller::begin()`.
+/// @return `false` if the pty could not be created
+bool start(const Options& options);
+
+/// @brief Run the script and the PNG dumps. Exits the process after `quit` or, on stdin/stdout,
+/// once stdin is closed; otherwise runs until killed. A replay exits with its result.
+[[noreturn]] void run(const Options& options);
+
+/// @brief Write RGB565 pixels as an 8-bit RGB PNG
+bool write_png(const char* path, const uint16_t* pixels, uint16_t width, uint16_t height);
+
+} // namespace simulator
+
+#endif
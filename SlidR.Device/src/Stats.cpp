@@ -0,0 +1,65 @@
+#include "Stats.h"
+#include "Hal.h"
+
+#include <FreeRTOS.h>
+
+namespace stats {
+
+std::atomic<uint32_t> counters[COUNTER_COUNT] = {};
+
+namespace {
+
+/// @brief Room for the firmware tasks plus the framework's (idle, timer, loop, event tasks)
+constexpr size_t MAX_SYSTEM_TASKS = rtos::TASK_COUNT + 10;
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+// Too big for the comm task stack, hence `snapshot()` is not reentrant
+TaskStatus_t task_status[MAX_SYSTEM_TASKS];
+#endif
+
+void put_u32(uint8_t* out, size_t& size, uint32_t value) {
+    out[size++] = value & 0xFF;
+    out[size++] = (value >> 8) & 0xFF;
+    out[size++] = (value >> 16) & 0xFF;
+    out[size++] = (value >> 24) & 0xFF;
+}
+
+} // namespace
+
+size_t snapshot(uint8_t (&out)[SNAPSHOT_SIZE]) {
+    size_t size = 0;
+    put_u32(out, size, hal::millis());
+
+    out[size++] = COUNTER_COUNT;
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        put_u32(out, size, counters[i].load(std::memory_order_relaxed));
+    }
+
+    put_u32(out, size, hal::free_heap());
+    put_u32(out, size, hal::min_free_heap());
+
+    uint32_t total_runtime = 0;
+    uint32_t idle_runtime = 0;
+    uint32_t task_runtime[rtos::TASK_COUNT] = {};
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    UBaseType_t count = uxTaskGetSystemState(task_status, MAX_SYSTEM_TASKS, &total_runtime);
+    for (UBaseType_t i = 0; i < count; i++) {
+        uint8_t index = rtos::task_index(task_status[i].xHandle);
+        if (index == rtos::TASK_INDEX_IDLE) {
+            idle_runtime = task_status[i].ulRunTimeCounter;
+        } else if (index < rtos::TASK_COUNT) {
+            task_runtime[index] = task_status[i].ulRunTimeCounter;
+        }
+    }
+#endif
+    put_u32(out, size, total_runtime);
+    put_u32(out, size, idle_runtime);
+    out[size++] = rtos::TASK_COUNT;
+    for (uint32_t runtime : task_runtime) {
+        put_u32(out, size, runtime);
+    }
+
+    return size;
+}
+
+} // namespace stats
@@ -0,0 +1,74 @@
+#ifndef STATS_H
+#define STATS_H
+
+#pragma once
+
+#include "Rtos.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+
+/// @brief Production telemetry reported by `GET_STATS`.
+///
+/// Counters are relaxed atomics that any task may bump; nothing is locked or formatted until a
+/// snapshot is requested. CPU time per task comes from the FreeRTOS runtime stats, when the
+/// kernel is built with them.
+namespace stats {
+
+/// @brief Counter indices in `STATS_DATA`. Append new counters at the end so hosts stay compatible.
+enum class Counter : uint8_t {
+    PACKETS_RX,            // Valid packets received
+    PACKETS_TX,
+    BYTES_RX,              // Including framing and discarded bytes
+    BYTES_TX,
+    CHECKSUM_ERRORS,
+    PACKET_TIMEOUTS,       // Packets abandoned half-received
+    PACKET_OVERFLOWS,      // Packets announcing a payload over `MAX_PACKET_SIZE`
+    ERRORS_SENT,           // `ERROR_CMD` packets sent
+    DOWNLOAD_ACK_TIMEOUTS, // Download chunks the host did not ACK in time
+    TRANSFER_TIMEOUTS,     // Uploads cancelled by the transfer watchdog
+    UPLOADS,               // Completed uploads
+    DOWNLOADS,             // Completed downloads
+    LAST_UPLOAD_MS,        // Duration of the last completed upload
+    LAST_DOWNLOAD_MS,
+    SLIDER_EVENTS,         // `SLIDER_VALUE` packets sent
+    IMAGES_DRAWN,
+    DISPLAY_MUTEX_TIMEOUTS,
+    CONFIG_JOBS,           // Config jobs run
+    CONFIG_JOB_ERRORS,     // Config jobs that failed
+    CONFIG_JOBS_REJECTED,  // Config jobs refused with `BUSY`
+    WAKEUPS,
+    SLEEPS,
+    LOG_EVENTS_SUPPRESSED, // Log events dropped by the rate limit
+    FIRMWARE_UPDATES,      // Firmware images written and switched to
+    LAST_FIRMWARE_UPDATE_MS,
+    COUNT
+};
+
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::COUNT);
+
+extern std::atomic<uint32_t> counters[COUNTER_COUNT];
+
+inline void add(Counter counter, uint32_t amount = 1) {
+    counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+inline void set(Counter counter, uint32_t value) {
+    counters[static_cast<size_t>(counter)].store(value, std::memory_order_relaxed);
+}
+
+inline uint32_t get(Counter counter) {
+    return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+/// @brief Size of the `STATS_DATA` payload: uptime, counters, heap, CPU time
+constexpr size_t SNAPSHOT_SIZE = 4 + (1 + COUNTER_COUNT * 4) + (4 + 4) + (4 + 4 + 1 + rtos::TASK_COUNT * 4);
+
+/// @brief Fill `out` with the `STATS_DATA` payload. Not reentrant, call from one task only.
+/// @return Payload size
+size_t snapshot(uint8_t (&out)[SNAPSHOT_SIZE]);
+
+} // namespace stats
+
+#endif
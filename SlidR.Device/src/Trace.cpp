@@ -0,0 +1,97 @@
+#include "Trace.h"
+
+#ifdef SLIDR_TRACE
+
+#include "Communication.h"
+#include "Hal.h"
+#include "Rtos.h"
+
+#include <FreeRTOS.h>
+
+namespace trace {
+
+namespace {
+
+struct Event {
+    uint32_t timestamp_us;
+    uint16_t arg;
+    uint8_t kind; // Phase in the top two bits, name below
+    uint8_t task;
+};
+static_assert(static_cast<uint8_t>(Name::COUNT) <= 64, "Names must fit below the phase bits");
+
+constexpr size_t EVENTS_PER_PACKET = 128;
+constexpr size_t EVENT_SIZE = 8;
+
+Event events[EVENT_CAPACITY];
+size_t head = 0;  // Next slot to write
+size_t count = 0; // Valid events, at most `EVENT_CAPACITY`
+uint32_t overwritten = 0;
+bool paused = false;
+portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+void put_int(uint8_t* out, size_t& size, uint32_t value, size_t width) {
+    for (size_t i = 0; i < width; i++) {
+        out[size++] = (value >> (i * 8)) & 0xFF;
+    }
+}
+
+} // namespace
+
+void record(Name name, Phase phase, uint16_t arg) {
+    uint8_t task = rtos::task_index(xTaskGetCurrentTaskHandle());
+    uint8_t kind = (static_cast<uint8_t>(phase) << 6) | static_cast<uint8_t>(name);
+
+    portENTER_CRITICAL(&mux);
+    if (!paused) {
+        // Timestamped inside the critical section so buffer order is time order
+        events[head] = Event{ static_cast<uint32_t>(hal::micros()), arg, kind, task };
+        head = (head + 1) % EVENT_CAPACITY;
+        if (count < EVENT_CAPACITY) {
+            count++;
+        } else {
+            overwritten++;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void dump(Communication& communication) {
+    portENTER_CRITICAL(&mux);
+    paused = true;
+    portEXIT_CRITICAL(&mux);
+
+    // [flags:uint8][overwritten:uint32][count:uint16] then count × [timestamp_us:uint32][arg:uint16][kind:uint8][task:uint8]
+    static uint8_t payload[1 + 4 + 2 + EVENTS_PER_PACKET * EVENT_SIZE];
+    size_t first = (head + EVENT_CAPACITY - count) % EVENT_CAPACITY;
+    size_t sent = 0;
+    do {
+        size_t batch = std::min(EVENTS_PER_PACKET, count - sent);
+        bool last = sent + batch == count;
+
+        size_t size = 0;
+        payload[size++] = last ? 1 : 0;
+        put_int(payload, size, overwritten, 4);
+        put_int(payload, size, batch, 2);
+        for (size_t i = 0; i < batch; i++) {
+            const Event& event = events[(first + sent + i) % EVENT_CAPACITY];
+            put_int(payload, size, event.timestamp_us, 4);
+            put_int(payload, size, event.arg, 2);
+            payload[size++] = event.kind;
+            payload[size++] = event.task;
+        }
+        communication.send_packet(Command::TRACE_DATA, payload, size);
+        sent += batch;
+    } while (sent < count);
+
+    portENTER_CRITICAL(&mux);
+    head = 0;
+    count = 0;
+    overwritten = 0;
+    paused = false;
+    portEXIT_CRITICAL(&mux);
+}
+
+} // namespace trace
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+class Communication;
+
+/// @brief Event timeline, enabled with `SLIDR_TRACE` (PlatformIO env `lolin_s2_mini_trace`).
+///
+/// Begin, end and instant events with microsecond timestamps are recorded into a ring buffer
+/// that overwrites the oldest events. `TRACE_DUMP` streams the buffer out and `timeline.py`
+/// converts it to Chrome trace JSON for Perfetto or chrome://tracing, one track per task.
+///
+/// Without the flag the macros expand to nothing and their arguments are not evaluated.
+namespace trace {
+
+/// @brief Event names. Append new names at the end, `timeline.py` lists them in this order.
+enum class Name : uint8_t {
+    PACKET_RX,   // Instant, arg: command
+    DISPATCH,    // arg: command
+    TX,          // arg: command, includes waiting for the TX mutex
+    FLASH_WRITE, // arg: bytes
+    BLIT,        // arg: segment index
+    ADC_TICK,    // arg: segment count
+    CONFIG_JOB,  // arg: job ID
+    COUNT
+};
+
+enum class Phase : uint8_t { BEGIN, END, INSTANT };
+
+#ifdef SLIDR_TRACE
+
+constexpr size_t EVENT_CAPACITY = 2048;
+
+void record(Name name, Phase phase, uint16_t arg);
+
+/// @brief Send all events, oldest first, as `TRACE_DATA` packets and clear the buffer.
+/// Recording pauses while the events are sent. Comm task only.
+void dump(Communication& communication);
+
+/// @brief Records a begin event now and the matching end event when destroyed
+class Scope {
+public:
+    Scope(Name name, uint16_t arg) : _name(name), _arg(arg) { record(name, Phase::BEGIN, arg); }
+    ~Scope() { record(_name, Phase::END, _arg); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Name _name;
+    uint16_t _arg;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, arg) trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(trace::Name::name, static_cast<uint16_t>(arg))
+#define TRACE_INSTANT(name, arg) trace::record(trace::Name::name, trace::Phase::INSTANT, static_cast<uint16_t>(arg))
+
+#else
+
+#define TRACE_SCOPE(name, arg)
+#define TRACE_INSTANT(name, arg)
+
+#endif
+
+} // namespace trace
+
+#endif
@@ -2,10 +2,28 @@
 
 Controller controller;
 
+#ifdef ARDUINO
+
 void setup() {
     controller.begin();
 }
 
 void loop() {
     vTaskDelay(portMAX_DELAY);
-}
\ No newline at end of file
+}
+
+#else
+
+#include "Simulator.h"
+
+/// @brief Native build: the device simulator, see `Simulator.h`
+int main(int argc, char** argv) {
+    simulator::Options options;
+    if (!simulator::parse_options(argc, argv, options) || !simulator::start(options)) {
+        return 2;
+    }
+    controller.begin();
+    simulator::run(options);
+}
+
+#endif
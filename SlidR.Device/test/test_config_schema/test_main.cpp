@@ -0,0 +1,334 @@
+// Round-trip and fuzz tests for the config wire format in ConfigSchema.h.
+// Run with `pio test -e native -f test_config_schema`.
+#include "ConfigSchema.h"
+
+#include <unity.h>
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+
+using namespace config_schema;
+
+namespace {
+
+constexpr uint32_t FUZZ_ITERATIONS = 200000;
+constexpr size_t MAX_PATCH_FIELDS = 32;
+/// @brief Room for any segment count a corrupt blob can claim, and then some
+constexpr size_t BUFFER_SIZE = sizeof(uint32_t) + 64 + 1 + 255 * 16;
+
+/// @brief xorshift32, so failures reproduce from the printed seed
+struct Random {
+    uint32_t state;
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    uint32_t below(uint32_t bound) { return next() % bound; }
+};
+
+template <typename T>
+T random_value(Random& random) {
+    if constexpr (std::is_same<T, bool>::value) {
+        return random.next() & 1;
+    } else {
+        return static_cast<T>(random.next());
+    }
+}
+
+DeviceConfig random_config(Random& random, uint8_t segment_count) {
+    DeviceConfig config{};
+    for_each_field(DEVICE_FIELDS, [&](const auto& f) {
+        config.*(f.member) = random_value<typename std::decay_t<decltype(f)>::value_type>(random);
+    });
+    config.segment_count = segment_count;
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++) {
+        for_each_field(SEGMENT_FIELDS, [&](const auto& f) {
+            config.segments[i].*(f.member) = random_value<typename std::decay_t<decltype(f)>::value_type>(random);
+        });
+    }
+    return config;
+}
+
+/// @brief Field-by-field comparison through the tables, padding is not compared.
+/// All `MAX_SEGMENTS` records count, so a failed decode must not touch any of them.
+bool same(const DeviceConfig& a, const DeviceConfig& b) {
+    bool equal = a.segment_count == b.segment_count;
+    for_each_field(DEVICE_FIELDS, [&](const auto& f) { equal = equal && a.*(f.member) == b.*(f.member); });
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++) {
+        for_each_field(SEGMENT_FIELDS, [&](const auto& f) {
+            equal = equal && a.segments[i].*(f.member) == b.segments[i].*(f.member);
+        });
+    }
+    return equal;
+}
+
+/// @brief Only the fields the wire format carries: the first `segment_count` segments
+bool same_encoded(const DeviceConfig& a, const DeviceConfig& b) {
+    uint8_t out_a[MAX_ENCODED_SIZE];
+    uint8_t out_b[MAX_ENCODED_SIZE];
+    size_t size_a = encode(a, out_a, sizeof(out_a));
+    size_t size_b = encode(b, out_b, sizeof(out_b));
+    return size_a != 0 && size_a == size_b && memcmp(out_a, out_b, size_a) == 0;
+}
+
+void put_u32(uint8_t* out, uint32_t value) {
+    for (size_t i = 0; i < sizeof(value); i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+/// @brief Offset of the segment count in a current-version blob
+constexpr size_t SEGMENT_COUNT_OFFSET = sizeof(uint32_t) + record_size(DEVICE_FIELDS);
+
+/// @brief Decode must either reject `data` and leave the target alone, or accept exactly a blob
+/// that `encode` would produce (bools aside, which read any non-zero byte as `true`)
+void check_decode(const uint8_t* data, size_t size, Random& random) {
+    DeviceConfig base = random_config(random, static_cast<uint8_t>(random.below(MAX_SEGMENTS + 1)));
+    DeviceConfig out = base;
+    if (!decode(data, size, out)) {
+        TEST_ASSERT_TRUE_MESSAGE(same(out, base), "Rejected blob modified the config");
+        return;
+    }
+    TEST_ASSERT_TRUE(out.segment_count <= MAX_SEGMENTS);
+    TEST_ASSERT_EQUAL(encoded_size(out.segment_count), size);
+
+    uint8_t encoded[MAX_ENCODED_SIZE];
+    size_t reencoded_size = encode(out, encoded, sizeof(encoded));
+    TEST_ASSERT_EQUAL(size, reencoded_size);
+    DeviceConfig again = base;
+    TEST_ASSERT_TRUE(decode(encoded, reencoded_size, again));
+    TEST_ASSERT_TRUE(same_encoded(out, again));
+}
+
+/// @brief A patch is applied completely or not at all, and never changes the segment count
+void check_patch(const uint8_t* data, size_t size, Random& random) {
+    DeviceConfig base = random_config(random, static_cast<uint8_t>(random.below(MAX_SEGMENTS + 1)));
+    DeviceConfig config = base;
+    FieldPath paths[MAX_PATCH_FIELDS];
+    size_t count = 0;
+    if (!decode_patch(data, size, config, paths, MAX_PATCH_FIELDS, count)) {
+        TEST_ASSERT_TRUE_MESSAGE(same(config, base), "Rejected patch modified the config");
+        return;
+    }
+    TEST_ASSERT_EQUAL(data[0], count);
+    TEST_ASSERT_EQUAL(base.segment_count, config.segment_count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(path_valid(config, paths[i]));
+    }
+
+    // Applying it again changes nothing
+    DeviceConfig again = config;
+    TEST_ASSERT_TRUE(decode_patch(data, size, again, paths, MAX_PATCH_FIELDS, count));
+    TEST_ASSERT_TRUE(same(config, again));
+}
+
+/// @brief A well-formed patch of `count` random entries, some with out-of-range paths
+size_t random_patch(Random& random, uint8_t count, uint8_t* out, size_t capacity) {
+    DeviceConfig values = random_config(random, MAX_SEGMENTS);
+    Writer w(out, capacity);
+    w.put(count);
+    for (uint8_t i = 0; i < count; i++) {
+        FieldPath path = random.below(2)
+            ? FieldPath::of(static_cast<DeviceField>(random.below(static_cast<uint32_t>(DeviceField::COUNT) + 1)))
+            : FieldPath::of(static_cast<uint8_t>(random.below(MAX_SEGMENTS + 1)),
+                            static_cast<SegmentField>(random.below(static_cast<uint32_t>(SegmentField::COUNT) + 1)));
+        w.put(path.field);
+        w.put(path.segment);
+        uint8_t value[sizeof(uint32_t)];
+        size_t size = encode_field(values, path, value, sizeof(value));
+        // Invalid paths get a value of a random width
+        if (size == 0) size = 1 << random.below(3);
+        w.put_bytes(value, size);
+    }
+    return w.ok() ? w.size() : 0;
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip() {
+    Random random{ 0x51d12 };
+    for (uint32_t round = 0; round < 1000; round++) {
+        uint8_t segment_count = static_cast<uint8_t>(round % (MAX_SEGMENTS + 1));
+        DeviceConfig config = random_config(random, segment_count);
+        uint8_t encoded[MAX_ENCODED_SIZE];
+        size_t size = encode(config, encoded, sizeof(encoded));
+        TEST_ASSERT_EQUAL(encoded_size(segment_count), size);
+
+        DeviceConfig decoded = random_config(random, MAX_SEGMENTS);
+        TEST_ASSERT_TRUE(decode(encoded, size, decoded));
+        TEST_ASSERT_TRUE(same_encoded(config, decoded));
+    }
+}
+
+void test_encode_rejects_small_buffers_and_too_many_segments() {
+    Random random{ 7 };
+    DeviceConfig config = random_config(random, MAX_SEGMENTS);
+    uint8_t encoded[MAX_ENCODED_SIZE];
+    for (size_t capacity = 0; capacity < MAX_ENCODED_SIZE; capacity++) {
+        TEST_ASSERT_EQUAL(0, encode(config, encoded, capacity));
+    }
+    TEST_ASSERT_EQUAL(MAX_ENCODED_SIZE, encode(config, encoded, sizeof(encoded)));
+
+    for (uint32_t count = MAX_SEGMENTS + 1; count <= 255; count++) {
+        config.segment_count = static_cast<uint8_t>(count);
+        TEST_ASSERT_EQUAL(0, encode(config, encoded, sizeof(encoded)));
+    }
+}
+
+void test_decode_rejects_truncated_and_padded_blobs() {
+    Random random{ 11 };
+    for (uint8_t segment_count = 0; segment_count <= MAX_SEGMENTS; segment_count++) {
+        uint8_t encoded[MAX_ENCODED_SIZE + 1] = {};
+        size_t size = encode(random_config(random, segment_count), encoded, sizeof(encoded));
+        for (size_t prefix = 0; prefix < size; prefix++) {
+            DeviceConfig base = random_config(random, MAX_SEGMENTS);
+            DeviceConfig out = base;
+            TEST_ASSERT_FALSE(decode(encoded, prefix, out));
+            TEST_ASSERT_TRUE(same(out, base));
+        }
+        DeviceConfig out{};
+        TEST_ASSERT_FALSE(decode(encoded, size + 1, out));
+    }
+}
+
+void test_decode_rejects_bad_versions() {
+    Random random{ 13 };
+    uint8_t encoded[MAX_ENCODED_SIZE];
+    size_t size = encode(random_config(random, 3), encoded, sizeof(encoded));
+    const uint32_t versions[] = { 0, MIN_CONFIG_VERSION - 1, CONFIG_VERSION + 1, 0x100, 0x01000000, 0xFFFFFFFF };
+    for (uint32_t version : versions) {
+        if (version >= MIN_CONFIG_VERSION && version <= CONFIG_VERSION) continue;
+        put_u32(encoded, version);
+        DeviceConfig base = random_config(random, 2);
+        DeviceConfig out = base;
+        TEST_ASSERT_FALSE(decode(encoded, size, out));
+        TEST_ASSERT_TRUE(same(out, base));
+    }
+}
+
+void test_decode_rejects_oversized_segment_counts() {
+    Random random{ 17 };
+    static uint8_t blob[BUFFER_SIZE];
+    size_t size = encode(random_config(random, MAX_SEGMENTS), blob, sizeof(blob));
+    for (uint32_t count = MAX_SEGMENTS + 1; count <= 255; count++) {
+        blob[SEGMENT_COUNT_OFFSET] = static_cast<uint8_t>(count);
+        // Both at the size the count claims and at the size of a valid blob
+        size_t claimed = SEGMENT_COUNT_OFFSET + 1 + count * record_size(SEGMENT_FIELDS);
+        for (size_t length : { size, claimed }) {
+            DeviceConfig base = random_config(random, 1);
+            DeviceConfig out = base;
+            TEST_ASSERT_FALSE(decode(blob, length, out));
+            TEST_ASSERT_TRUE(same(out, base));
+        }
+    }
+}
+
+void test_decode_patch_rejects_malformed_patches() {
+    Random random{ 19 };
+    uint8_t patch[1 + MAX_PATCH_FIELDS * 6];
+    DeviceConfig config = random_config(random, 4);
+
+    // Valid patch: every prefix fails, the whole applies
+    Writer w(patch, sizeof(patch));
+    w.put(uint8_t{ 2 });
+    w.put(FieldPath::of(DeviceField::SPI_SPEED_HZ).field);
+    w.put(uint8_t{ 0 });
+    w.put(uint32_t{ 40000000 });
+    FieldPath segment = FieldPath::of(3, SegmentField::POT_MAX_VALUE);
+    w.put(segment.field);
+    w.put(segment.segment);
+    w.put(uint16_t{ 3000 });
+    FieldPath paths[MAX_PATCH_FIELDS];
+    size_t count = 0;
+    for (size_t prefix = 0; prefix < w.size(); prefix++) {
+        DeviceConfig out = config;
+        TEST_ASSERT_FALSE(decode_patch(patch, prefix, out, paths, MAX_PATCH_FIELDS, count));
+        TEST_ASSERT_TRUE(same(out, config));
+    }
+    DeviceConfig out = config;
+    TEST_ASSERT_FALSE(decode_patch(patch, w.size() + 1, out, paths, MAX_PATCH_FIELDS, count));
+    TEST_ASSERT_TRUE(decode_patch(patch, w.size(), out, paths, MAX_PATCH_FIELDS, count));
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL(40000000, out.spi_speed_hz);
+    TEST_ASSERT_EQUAL(3000, out.segments[3].pot_max_value);
+
+    // More entries than the caller has room for, and none at all
+    out = config;
+    TEST_ASSERT_FALSE(decode_patch(patch, w.size(), out, paths, 1, count));
+    patch[0] = 0;
+    TEST_ASSERT_FALSE(decode_patch(patch, 1, out, paths, MAX_PATCH_FIELDS, count));
+
+    // Segment beyond the config's count
+    Writer beyond(patch, sizeof(patch));
+    beyond.put(uint8_t{ 1 });
+    FieldPath missing = FieldPath::of(config.segment_count, SegmentField::POT_PIN);
+    beyond.put(missing.field);
+    beyond.put(missing.segment);
+    beyond.put(uint8_t{ 4 });
+    TEST_ASSERT_FALSE(decode_patch(patch, beyond.size(), out, paths, MAX_PATCH_FIELDS, count));
+    TEST_ASSERT_TRUE(same(out, config));
+}
+
+void test_fuzz_decode() {
+    Random random{ 0xc0ff1e };
+    static uint8_t data[BUFFER_SIZE];
+    for (uint32_t i = 0; i < FUZZ_ITERATIONS; i++) {
+        size_t size;
+        switch (random.below(3)) {
+            case 0: // Random bytes
+                size = random.below(MAX_ENCODED_SIZE + 8);
+                for (size_t j = 0; j < size; j++) data[j] = static_cast<uint8_t>(random.next());
+                break;
+            case 1: // Valid blob with a few flipped bits
+                size = encode(random_config(random, static_cast<uint8_t>(random.below(MAX_SEGMENTS + 1))), data, sizeof(data));
+                for (uint32_t flips = 1 + random.below(4); flips > 0; flips--) {
+                    data[random.below(size)] ^= static_cast<uint8_t>(1 << random.below(8));
+                }
+                break;
+            default: // Valid blob, cut or extended
+                size = encode(random_config(random, static_cast<uint8_t>(random.below(MAX_SEGMENTS + 1))), data, sizeof(data));
+                size = random.below(2) ? random.below(size) : size + 1 + random.below(16);
+                break;
+        }
+        check_decode(data, size, random);
+    }
+}
+
+void test_fuzz_decode_patch() {
+    Random random{ 0xbadf00d };
+    uint8_t data[1 + MAX_PATCH_FIELDS * 6 + 16];
+    for (uint32_t i = 0; i < FUZZ_ITERATIONS; i++) {
+        size_t size;
+        if (random.below(4) == 0) {
+            size = random.below(sizeof(data));
+            for (size_t j = 0; j < size; j++) data[j] = static_cast<uint8_t>(random.next());
+        } else {
+            size = random_patch(random, static_cast<uint8_t>(1 + random.below(MAX_PATCH_FIELDS)), data, sizeof(data));
+            if (random.below(2)) {
+                data[random.below(size)] ^= static_cast<uint8_t>(1 << random.below(8));
+            }
+        }
+        if (size == 0) continue;
+        check_patch(data, size, random);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_encode_rejects_small_buffers_and_too_many_segments);
+    RUN_TEST(test_decode_rejects_truncated_and_padded_blobs);
+    RUN_TEST(test_decode_rejects_bad_versions);
+    RUN_TEST(test_decode_rejects_oversized_segment_counts);
+    RUN_TEST(test_decode_patch_rejects_malformed_patches);
+    RUN_TEST(test_fuzz_decode);
+    RUN_TEST(test_fuzz_decode_patch);
+    return UNITY_END();
+}
@@ -0,0 +1,228 @@
+// Steady-state heap checks on the native build: the whole controller runs against an in-memory
+// transport and a temporary data directory, and the paths that HeapTrace.h marks as steady state
+// (packet RX, command dispatch, slider polling, image blits) must not allocate.
+// Run with `pio test -e native_heap_trace`.
+#include "ConfigLoader.h"
+#include "Controller.h"
+#include "HalNative.h"
+#include "HeapTrace.h"
+#include "Messages.h"
+
+#include <unity.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t REPLY_TIMEOUT_MS = 5000;
+constexpr int STATUS_REQUESTS = 50;
+constexpr int SLIDER_MOVES = 8;
+constexpr uint16_t IMAGE_SIZE = hal::Panel::SIZE;
+constexpr size_t UPLOAD_CHUNK_SIZE = 2048;
+/// @brief More than the device sends in one round, so the transport's buffer never grows during one
+constexpr size_t TX_RESERVE = 64 * 1024;
+
+struct Packet {
+    Command command;
+    std::vector<uint8_t> payload;
+};
+
+hal::native::MemoryTransport transport;
+std::string data_dir;
+Controller controller;
+
+FrameParser<4096> parser;
+std::deque<Packet> received;
+
+void send(Command command, const uint8_t* payload = nullptr, size_t size = 0) {
+    std::vector<uint8_t> frame = {
+        START_BYTE,
+        static_cast<uint8_t>(command),
+        static_cast<uint8_t>(size & 0xFF),
+        static_cast<uint8_t>(size >> 8)
+    };
+    frame.insert(frame.end(), payload, payload + size);
+    frame.push_back(FrameParser<4096>::checksum(frame.data() + 1, frame.size() - 1));
+    transport.push(frame.data(), frame.size());
+}
+
+template <typename Message>
+void send(const Message& message) {
+    uint8_t payload[messages::MAX_SIZE<Message> + 1];
+    size_t size = 0;
+    messages::encode(message, payload, sizeof(payload), size);
+    send(Message::COMMAND, payload, size);
+}
+
+void poll() {
+    for (uint8_t byte : transport.take()) {
+        if (parser.push(byte) == FrameParser<4096>::Result::PACKET) {
+            ByteView payload = parser.payload();
+            received.push_back({ parser.command(), std::vector<uint8_t>(payload.data(), payload.data() + payload.size()) });
+        }
+    }
+}
+
+/// @brief Wait for the next packet with `command`, dropping the others (log events, stats pushes)
+/// @return `false` on timeout or if `ERROR_CMD` came first
+bool expect(Command command, Packet* out = nullptr) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+    while (std::chrono::steady_clock::now() < deadline) {
+        poll();
+        while (!received.empty()) {
+            Packet packet = std::move(received.front());
+            received.pop_front();
+            if (packet.command == command) {
+                if (out) *out = std::move(packet);
+                return true;
+            }
+            if (packet.command == Command::ERROR_CMD) return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+uint32_t pixels_written(uint8_t cs_pin) {
+    uint32_t pixels = 0;
+    hal::native::for_each_panel([&](const hal::native::FakePanel& panel) {
+        if (panel.cs_pin() == cs_pin) pixels += panel.pixels_written();
+    });
+    return pixels;
+}
+
+void request_status() {
+    for (int i = 0; i < STATUS_REQUESTS; i++) {
+        send(messages::Ping{});
+        send(messages::GetStatus{});
+    }
+    for (int i = 0; i < STATUS_REQUESTS; i++) {
+        TEST_ASSERT_TRUE(expect(Command::PONG));
+        Packet status;
+        TEST_ASSERT_TRUE(expect(Command::STATUS_DATA, &status));
+        TEST_ASSERT_EQUAL(3, status.payload.size());
+    }
+}
+
+void move_slider() {
+    const SegmentConfig& segment = ConfigLoader::defaults().segments[0];
+    for (int i = 0; i < SLIDER_MOVES; i++) {
+        uint16_t position = (i % 2) ? segment.pot_min_value : segment.pot_max_value;
+        hal::native::set_analog_input(segment.pot_pin, position);
+        Packet value;
+        TEST_ASSERT_TRUE(expect(Command::SLIDER_VALUE, &value));
+        TEST_ASSERT_EQUAL(0, value.payload[0]);
+        TEST_ASSERT_EQUAL((i % 2) ? 0 : 100, value.payload[1]);
+    }
+}
+
+/// @brief Upload an image for segment 0, which is drawn when the upload ends
+void upload_and_blit() {
+    std::vector<uint8_t> image = { IMAGE_SIZE & 0xFF, IMAGE_SIZE >> 8, IMAGE_SIZE & 0xFF, IMAGE_SIZE >> 8 };
+    for (size_t i = 0; i < static_cast<size_t>(IMAGE_SIZE) * IMAGE_SIZE; i++) {
+        image.push_back(static_cast<uint8_t>(i));
+        image.push_back(static_cast<uint8_t>(i >> 8));
+    }
+
+    uint8_t cs_pin = ConfigLoader::defaults().segments[0].tft_cs_pin;
+    uint32_t pixels_before = pixels_written(cs_pin);
+
+    send(messages::UploadImageStart{ 0, static_cast<uint32_t>(image.size()) });
+    TEST_ASSERT_TRUE(expect(Command::ACK));
+    for (size_t offset = 0; offset < image.size(); offset += UPLOAD_CHUNK_SIZE) {
+        size_t size = std::min(UPLOAD_CHUNK_SIZE, image.size() - offset);
+        send(Command::UPLOAD_IMAGE_DATA, image.data() + offset, size);
+        TEST_ASSERT_TRUE(expect(Command::ACK));
+    }
+    send(messages::UploadImageEnd{});
+    TEST_ASSERT_TRUE(expect(Command::ACK));
+
+    // The blit runs on the comm task right after the ACK
+    send(messages::Ping{});
+    TEST_ASSERT_TRUE(expect(Command::PONG));
+    TEST_ASSERT_EQUAL(static_cast<uint32_t>(IMAGE_SIZE) * IMAGE_SIZE, pixels_written(cs_pin) - pixels_before);
+}
+
+void run_round() {
+    request_status();
+    move_slider();
+    upload_and_blit();
+}
+
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_trace_counts_allocations_in_steady_state() {
+    heap_trace::reset();
+    {
+        HEAP_STEADY_STATE(heap_trace::Subsystem::OTHER);
+        void* volatile block = malloc(16);
+        free(block);
+        // `new` comes from libstdc++, which the tracer must see as well
+        int* volatile value = new int(1);
+        delete value;
+    }
+    TEST_ASSERT_EQUAL(2, heap_trace::steady_state_violations());
+
+    heap_trace::reset();
+    {
+        HEAP_TRACE_SCOPE(heap_trace::Subsystem::OTHER);
+        void* volatile block = malloc(16);
+        free(block);
+    }
+    TEST_ASSERT_EQUAL(0, heap_trace::steady_state_violations());
+    TEST_ASSERT_TRUE(heap_trace::counters(heap_trace::Subsystem::OTHER).allocations > 0);
+}
+
+void test_steady_state_paths_do_not_allocate() {
+    // The first round opens files, starts the image download task's buffers and so on
+    run_round();
+
+    heap_trace::reset();
+    run_round();
+
+    for (size_t i = 0; i < static_cast<size_t>(heap_trace::Subsystem::COUNT); i++) {
+        auto subsystem = static_cast<heap_trace::Subsystem>(i);
+        heap_trace::Counters counters = heap_trace::counters(subsystem);
+        if (counters.steady_state_allocations) {
+            printf("%s: %u steady-state allocations, last %u bytes\n", heap_trace::name(subsystem),
+                static_cast<unsigned>(counters.steady_state_allocations), static_cast<unsigned>(counters.last_violation_size));
+        }
+    }
+    TEST_ASSERT_EQUAL(0, heap_trace::steady_state_violations());
+}
+
+int main(int argc, char** argv) {
+    char dir_template[] = "/tmp/slidr-heap-trace-XXXXXX";
+    data_dir = mkdtemp(dir_template);
+    static hal::native::DirectoryFileSystem filesystem(data_dir + "/fs");
+    static hal::native::FileFirmware firmware(data_dir + "/firmware.bin");
+    hal::native::set_transport(transport);
+    hal::native::set_filesystem(filesystem);
+    hal::native::set_firmware(firmware);
+
+    std::vector<uint8_t> reserve(TX_RESERVE);
+    transport.write(reserve.data(), reserve.size());
+    transport.take();
+
+    controller.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_trace_counts_allocations_in_steady_state);
+    RUN_TEST(test_steady_state_paths_do_not_allocate);
+    int failures = UNITY_END();
+
+    std::filesystem::remove_all(data_dir);
+    // The controller's tasks never return, so skip the static destructors
+    fflush(stdout);
+    std::_Exit(failures);
+}
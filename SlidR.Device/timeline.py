@@ -0,0 +1,112 @@
+"""Event timeline client for firmware built with SLIDR_TRACE.
+
+Downloads the device trace buffer and writes Chrome trace JSON, one track per task, which
+opens in https://ui.perfetto.dev or chrome://tracing:
+
+    python timeline.py --port COM4 -o slidr.trace.json
+
+The buffer keeps the last 2048 events; use --wait to let it fill (or wrap) first.
+"""
+from pathlib import Path
+import argparse
+import json
+import struct
+import sys
+import time
+
+from cpuprofile import encode_packet, load_task_names, read_packet
+from protodef import Command
+
+TRACE_DUMP = Command.TRACE_DUMP
+TRACE_DATA = Command.TRACE_DATA
+
+# trace::Name in src/Trace.h, with what `arg` holds
+TRACE_NAMES = [
+    ("PACKET_RX", "command"),
+    ("DISPATCH", "command"),
+    ("TX", "command"),
+    ("FLASH_WRITE", "bytes"),
+    ("BLIT", "segment"),
+    ("ADC_TICK", "segments"),
+    ("CONFIG_JOB", "job_id"),
+]
+PHASES = ["B", "E", "i"]
+
+
+def dump(port) -> tuple[list[tuple[int, int, int, int]], int]:
+    """Request a dump and return ([(timestamp_us, arg, kind, task)], overwritten event count)"""
+    port.write(encode_packet(TRACE_DUMP))
+    events = []
+    while True:
+        packet = read_packet(port, timeout=2.0)
+        if packet is None:
+            raise TimeoutError("No TRACE_DATA received, is the firmware built with SLIDR_TRACE?")
+        command, payload = packet
+        if command != TRACE_DATA:
+            continue
+        flags, overwritten, count = struct.unpack_from("<BIH", payload, 0)
+        for i in range(count):
+            events.append(struct.unpack_from("<IHBB", payload, 7 + i * 8))
+        if flags & 1:
+            return events, overwritten
+
+
+def to_chrome_trace(events: list[tuple[int, int, int, int]], task_names: dict[int, str]) -> dict:
+    trace_events = []
+    for task in sorted({task for *_, task in events}):
+        trace_events.append({
+            "name": "thread_name", "ph": "M", "pid": 1, "tid": task,
+            "args": {"name": task_names.get(task, f"Task {task}")},
+        })
+
+    # Timestamps are 32-bit microseconds and wrap after about 71 minutes
+    offset = 0
+    previous = None
+    # Ends whose begin was overwritten would confuse the viewers
+    depth: dict[int, int] = {}
+    for timestamp, arg, kind, task in events:
+        if previous is not None and timestamp < previous:
+            offset += 1 << 32
+        previous = timestamp
+
+        phase = PHASES[kind >> 6]
+        if phase == "B":
+            depth[task] = depth.get(task, 0) + 1
+        elif phase == "E":
+            if depth.get(task, 0) == 0:
+                continue
+            depth[task] -= 1
+        name_index = kind & 0x3F
+        name, arg_name = TRACE_NAMES[name_index] if name_index < len(TRACE_NAMES) else (f"event_{name_index}", "arg")
+        event = {"name": name, "ph": phase, "ts": timestamp + offset, "pid": 1, "tid": task, "args": {arg_name: arg}}
+        if phase == "i":
+            event["s"] = "t"
+        trace_events.append(event)
+    return {"traceEvents": trace_events, "displayTimeUnit": "ms"}
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Download the SlidR event trace as Chrome trace JSON")
+    parser.add_argument("--port", default="COM4")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--wait", type=float, default=0.0, help="Seconds to wait before dumping")
+    parser.add_argument("-o", "--output", type=Path, help="Trace JSON output (default: stdout)")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(port=args.port, baudrate=args.baudrate, timeout=0.1) as port:
+        time.sleep(args.wait)
+        events, overwritten = dump(port)
+    if overwritten:
+        print(f"note: {overwritten} older events were overwritten", file=sys.stderr)
+
+    text = json.dumps(to_chrome_trace(events, load_task_names()))
+    if args.output:
+        args.output.write_text(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()